@@ -13,18 +13,36 @@ cbuffer InstanceConstantBuffer : register(b1)
     int metallic_roughness_texture_index;
 };
 
+//Set per glTF node
+cbuffer NodeConstantBuffer : register(b2)
+{
+    float4x4 world;
+    uint instances_in_world_space; //Set for the CPU's instance grid, which applies after world
+};
+
+//Transform of each instance (see instancing.h): node space from EXT_mesh_gpu_instancing, world space from the CPU's instance grid
+struct InstanceTransform
+{
+    float4 rows[3];
+};
+StructuredBuffer<InstanceTransform> instance_transforms : register(t0);
+
+//Instances drawn by this draw (the instances that selected its LOD), indexed by SV_InstanceID
+StructuredBuffer<uint> instance_indices : register(t1);
+
 #include "bindless.hlsl"
 
 SamplerState texture_sampler : register(s0);
 
-float4x4 m_translate(const float3 v)
+//Transforms a normal by the cofactor matrix of m's upper 3x3 (the inverse transpose without the division by the determinant),
+//so non-uniform and negative scale keep normals perpendicular to the surface
+float3 transform_normal(const float4x4 m, const float3 n)
 {
-    float4x4 m = identity;
-    const float x = v.x, y = v.y, z = v.z;
-    m[0][3] = x;
-    m[1][3] = y;
-    m[2][3] = z;
-    return m;
+    const float3 c0 = float3(m[0][0], m[1][0], m[2][0]);
+    const float3 c1 = float3(m[0][1], m[1][1], m[2][1]);
+    const float3 c2 = float3(m[0][2], m[1][2], m[2][2]);
+    const float3 result = cross(c1, c2) * n.x + cross(c2, c0) * n.y + cross(c0, c1) * n.z;
+    return dot(c0, cross(c1, c2)) < 0.0 ? -result : result;
 }
 
 struct PsInput
@@ -34,19 +52,17 @@ struct PsInput
     float3 normal : NORMAL;
     float4 color : COLOR;
     float2 uv : TEXCOORD;
-    uint instance_id : SV_InstanceID;
+    nointerpolation uint instance_index : INSTANCE_INDEX;
 };
 
 PsInput vs_main(const float3 position : POSITION, const float3 normal : NORMAL, const float4 color : COLOR, const float2 uv : TEXCOORD, const uint instance_id : SV_InstanceID)
 {
     PsInput result;
 
-    //FCS TODO: pass in Model_Matrix
-
-    const float offset_x = 2.25 * (instance_id / 10) - 10.0;
-    const float offset_y = -2.25 * fmod(instance_id, 10);
-    
-    const float4x4 model = m_translate(float3(offset_x, offset_y, 0));
+    const uint instance_index = instance_indices[instance_id];
+    const InstanceTransform instance = instance_transforms[instance_index];
+    const float4x4 instance_matrix = float4x4(instance.rows[0], instance.rows[1], instance.rows[2], float4(0, 0, 0, 1));
+    const float4x4 model = instances_in_world_space ? mul(instance_matrix, world) : mul(world, instance_matrix);
 
     //Calculate world pos separately, as we pass it to the pixel shader as well
     const float4 world_pos = mul(model, float4(position, 1.0f));
@@ -56,10 +72,10 @@ PsInput vs_main(const float3 position : POSITION, const float3 normal : NORMAL,
     
     result.position = out_position;
     result.world_pos = world_pos;
-    result.normal = normal;
+    result.normal = transform_normal(model, normal);
     result.color = color;
     result.uv = fmod(uv,1.0); //properly wrap UVs
-    result.instance_id = instance_id;
+    result.instance_index = instance_index;
 
     return result;
 }
@@ -84,8 +100,9 @@ float4 ps_main(const PsInput input) : SV_TARGET
         albedo = Texture2DTable[base_color_texture_index].Sample(texture_sampler, input.uv).rgb;
     }
 
-    float roughness = 1.0 - (float)(input.instance_id / 10) / 10.0;
-    float metallic  = 1.0 - fmod(input.instance_id, 10) / 10.0;
+    //Untextured materials vary across the instance grid (EXT_mesh_gpu_instancing draws can have many more instances, so clamp)
+    float roughness = saturate(1.0 - (float)(input.instance_index / 10) / 10.0);
+    float metallic  = saturate(1.0 - fmod(input.instance_index, 10) / 10.0);
     if (metallic_roughness_texture_index != BINDLESS_INVALID_INDEX)
     {
         float4 metallic_roughness = Texture2DTable[metallic_roughness_texture_index].Sample(texture_sampler, input.uv);
@@ -0,0 +1,530 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+#include <EASTL/algorithm.h>
+
+#include "gltf.h"
+#include "scene_graph.h"
+#include "EnkiTS/TaskScheduler.h"
+
+// glTF animation playback into a SceneGraph's local transforms and morph weights.
+// Keyframe times and values are decoded to floats once. Channels of a clip whose samplers share an input accessor share a timeline,
+// and each timeline keeps the keyframe it sampled last: playing forward only steps past the keyframes that went by since the last frame,
+// a binary search only happens when a clip loops or is scrubbed backwards.
+// Channels are sorted by target path and interpolation, so each group is evaluated SceneGraphLanes::WIDTH channels at a time
+// with every lane gathering its own keyframes. Large frames are split into enkiTS tasks of ANIMATION_TASK_CHANNELS.
+// Linear rotations are a normalized lerp along the shortest arc, with its parameter corrected to closely follow a slerp.
+
+static const uint32_t ANIMATION_TASK_CHANNELS = 2048;
+
+// Channels are grouped by GltfAnimationPath * 3 + GltfInterpolation
+static const uint32_t ANIMATION_INTERPOLATION_COUNT = 3;
+static const uint32_t ANIMATION_GROUP_COUNT = 4 * ANIMATION_INTERPOLATION_COUNT;
+
+struct AnimationTimeline
+{
+	uint32_t first_time = 0;	// Into Animations::times
+	uint32_t time_count = 0;
+	uint32_t cursor = 0;		// Keyframe sampled last, where the next search starts
+
+	// Result of the last update: the sample is between keyframes key and key + 1 (only key before the first or after the last keyframe)
+	uint32_t key = 0;
+	float factor = 0.0f;		// [0, 1] between the two keyframes
+	float duration = 0.0f;		// Seconds between the two keyframes, cubic spline tangents are scaled by it
+};
+
+struct AnimationChannel
+{
+	uint32_t timeline = 0;
+	uint32_t first_value = 0;	// Into Animations::values. Cubic spline keyframes are in-tangent, value, out-tangent.
+	uint32_t node = 0;			// Scene graph node
+	uint32_t component_count = 0;
+};
+
+struct AnimationClip
+{
+	std::string name;
+	float duration = 0.0f;		// Last keyframe time of any channel
+	uint32_t first_timeline = 0;
+	uint32_t timeline_count = 0;
+
+	float time = 0.0f;
+	bool playing = false;
+};
+
+struct Animations
+{
+	vector<AnimationClip> clips;
+	vector<AnimationTimeline> timelines;
+	vector<AnimationChannel> channels;	// Sorted by group, then clip
+	vector<uint32_t> channel_ranges;	// Channels of clip c in group g are [channel_ranges[g * clips.size() + c], channel_ranges[g * clips.size() + c + 1])
+	vector<float> times;
+	vector<float> values;
+
+	struct WorkRange
+	{
+		uint32_t group;
+		uint32_t begin;
+		uint32_t end;
+	};
+	vector<WorkRange> work_ranges;		// Rebuilt by evaluate every frame
+
+	// Channels targeting nodes outside of the scene graph, or weights of nodes without morph targets, are dropped
+	void build(const GltfAsset& asset, const SceneGraph& scene_graph)
+	{
+		clips.clear();
+		timelines.clear();
+		channels.clear();
+		times.clear();
+		values.clear();
+
+		vector<AnimationChannel> group_channels[ANIMATION_GROUP_COUNT];
+		vector<uint32_t> group_clip_offsets[ANIMATION_GROUP_COUNT];
+		vector<uint32_t> sampler_first_values;
+		vector<const GltfAccessor*> timeline_inputs;
+
+		clips.resize(asset.num_animations);
+		for (uint32_t clip_idx = 0; clip_idx < asset.num_animations; ++clip_idx)
+		{
+			const GltfAnimation& gltf_animation = asset.animations[clip_idx];
+			AnimationClip& clip = clips[clip_idx];
+			clip.name = gltf_animation.name ? gltf_animation.name : "";
+			clip.first_timeline = (uint32_t) timelines.size();
+
+			for (uint32_t group = 0; group < ANIMATION_GROUP_COUNT; ++group)
+			{
+				group_clip_offsets[group].push_back((uint32_t) group_channels[group].size());
+			}
+
+			// Output values are decoded once per sampler, the first time a channel uses it
+			sampler_first_values.assign(gltf_animation.num_samplers, UINT32_MAX);
+			timeline_inputs.clear();
+
+			for (uint32_t channel_idx = 0; channel_idx < gltf_animation.num_channels; ++channel_idx)
+			{
+				const GltfAnimationChannel& gltf_channel = gltf_animation.channels[channel_idx];
+				if (!gltf_channel.node)
+				{
+					continue;
+				}
+				const int32_t node = scene_graph.node_from_gltf_node[gltf_channel.node - asset.nodes];
+				if (node == SCENE_GRAPH_INVALID_INDEX)
+				{
+					continue;
+				}
+
+				const GltfAnimationSampler& sampler = *gltf_channel.sampler;
+				const bool cubic_spline = sampler.interpolation == GLTF_INTERPOLATION_CUBICSPLINE;
+				const uint32_t output_components = gltf_accessor_type_size(sampler.output->accessor_type);
+
+				AnimationChannel channel;
+				channel.node = (uint32_t) node;
+				channel.component_count = output_components;
+				if (gltf_channel.path == GLTF_ANIMATION_PATH_WEIGHTS)
+				{
+					channel.component_count = sampler.output->count / (sampler.input->count * (cubic_spline ? 3 : 1));
+					if (scene_graph.morph_weight_counts[node] == 0)
+					{
+						continue;
+					}
+				}
+
+				uint32_t timeline_idx = 0;
+				while (timeline_idx < timeline_inputs.size() && timeline_inputs[timeline_idx] != sampler.input)
+				{
+					++timeline_idx;
+				}
+				if (timeline_idx == timeline_inputs.size())
+				{
+					AnimationTimeline timeline;
+					timeline.first_time = (uint32_t) times.size();
+					timeline.time_count = sampler.input->count;
+					times.resize(times.size() + timeline.time_count);
+					gltf_accessor_unpack_floats(sampler.input, 1, &times[timeline.first_time], sizeof(float));
+
+					const float last_time = times.back();
+					clip.duration = last_time > clip.duration ? last_time : clip.duration;
+					timelines.push_back(timeline);
+					timeline_inputs.push_back(sampler.input);
+				}
+				channel.timeline = clip.first_timeline + timeline_idx;
+
+				uint32_t& first_value = sampler_first_values[gltf_channel.sampler - gltf_animation.samplers];
+				if (first_value == UINT32_MAX)
+				{
+					first_value = (uint32_t) values.size();
+					values.resize(values.size() + (size_t) sampler.output->count * output_components);
+					gltf_accessor_unpack_floats(sampler.output, output_components, &values[first_value], output_components * sizeof(float));
+				}
+				channel.first_value = first_value;
+
+				group_channels[gltf_channel.path * ANIMATION_INTERPOLATION_COUNT + sampler.interpolation].push_back(channel);
+			}
+
+			clip.timeline_count = (uint32_t) timelines.size() - clip.first_timeline;
+		}
+
+		channel_ranges.clear();
+		for (uint32_t group = 0; group < ANIMATION_GROUP_COUNT; ++group)
+		{
+			const uint32_t group_begin = (uint32_t) channels.size();
+			for (uint32_t clip_offset : group_clip_offsets[group])
+			{
+				channel_ranges.push_back(group_begin + clip_offset);
+			}
+			channels.insert(channels.end(), group_channels[group].begin(), group_channels[group].end());
+		}
+		channel_ranges.push_back((uint32_t) channels.size());
+	}
+
+	// Moves every playing clip forward, looping at its end
+	void advance(float delta_seconds)
+	{
+		for (AnimationClip& clip : clips)
+		{
+			if (clip.playing && clip.duration > 0.0f)
+			{
+				clip.time = fmodf(clip.time + delta_seconds, clip.duration);
+				clip.time = clip.time < 0.0f ? clip.time + clip.duration : clip.time;
+			}
+		}
+	}
+
+	// Samples every channel of the playing clips at their current time into the scene graph, and marks the animated nodes dirty.
+	// When several playing clips animate the same property of a node, which one ends up in the scene graph is unspecified.
+	void evaluate(SceneGraph& scene_graph, enki::TaskScheduler& task_scheduler)
+	{
+		const uint32_t clip_count = (uint32_t) clips.size();
+		uint32_t channel_count = 0;
+		work_ranges.clear();
+
+		for (uint32_t clip_idx = 0; clip_idx < clip_count; ++clip_idx)
+		{
+			const AnimationClip& clip = clips[clip_idx];
+			if (!clip.playing)
+			{
+				continue;
+			}
+
+			for (uint32_t timeline_idx = clip.first_timeline; timeline_idx < clip.first_timeline + clip.timeline_count; ++timeline_idx)
+			{
+				update_timeline(timelines[timeline_idx], clip.time);
+			}
+
+			for (uint32_t group = 0; group < ANIMATION_GROUP_COUNT; ++group)
+			{
+				const uint32_t begin = channel_ranges[group * clip_count + clip_idx];
+				const uint32_t end = channel_ranges[group * clip_count + clip_idx + 1];
+				for (uint32_t range_begin = begin; range_begin < end; range_begin += ANIMATION_TASK_CHANNELS)
+				{
+					const uint32_t range_end = range_begin + ANIMATION_TASK_CHANNELS;
+					work_ranges.push_back({ group, range_begin, range_end < end ? range_end : end });
+				}
+				channel_count += end - begin;
+			}
+		}
+
+		if (channel_count <= ANIMATION_TASK_CHANNELS)
+		{
+			for (const WorkRange& work_range : work_ranges)
+			{
+				evaluate_range(work_range, scene_graph);
+			}
+		}
+		else
+		{
+			enki::TaskSet evaluate_task((uint32_t) work_ranges.size(), [this, &scene_graph](enki::TaskSetPartition range, uint32_t /*threadnum*/)
+			{
+				for (uint32_t i = range.start; i < range.end; ++i)
+				{
+					evaluate_range(work_ranges[i], scene_graph);
+				}
+			});
+			task_scheduler.AddTaskSetToPipe(&evaluate_task);
+			task_scheduler.WaitforTask(&evaluate_task);
+		}
+
+		// Morph weights have no dirty flags, they're read by whatever blends the targets
+		for (const WorkRange& work_range : work_ranges)
+		{
+			if (work_range.group / ANIMATION_INTERPOLATION_COUNT == GLTF_ANIMATION_PATH_WEIGHTS)
+			{
+				continue;
+			}
+			for (uint32_t channel_idx = work_range.begin; channel_idx < work_range.end; ++channel_idx)
+			{
+				scene_graph.mark_dirty(channels[channel_idx].node);
+			}
+		}
+	}
+
+	// Times outside of the keyframes hold the first or last value
+	void update_timeline(AnimationTimeline& timeline, float time)
+	{
+		const float* key_times = &times[timeline.first_time];
+		const uint32_t last_key = timeline.time_count - 1;
+
+		if (last_key == 0 || time <= key_times[0])
+		{
+			timeline.cursor = 0;
+			timeline.key = 0;
+			timeline.factor = 0.0f;
+			timeline.duration = 0.0f;
+			return;
+		}
+		if (time >= key_times[last_key])
+		{
+			timeline.cursor = last_key - 1;
+			timeline.key = last_key;
+			timeline.factor = 0.0f;
+			timeline.duration = 0.0f;
+			return;
+		}
+
+		// key_times[0] < time < key_times[last_key], so the cursor always stops before the last keyframe
+		uint32_t cursor = timeline.cursor;
+		if (time < key_times[cursor])
+		{
+			cursor = (uint32_t) (eastl::upper_bound(key_times, key_times + cursor, time) - key_times) - 1;
+		}
+		while (time >= key_times[cursor + 1])
+		{
+			++cursor;
+		}
+
+		timeline.cursor = cursor;
+		timeline.key = cursor;
+		timeline.duration = key_times[cursor + 1] - key_times[cursor];
+		timeline.factor = (time - key_times[cursor]) / timeline.duration;
+	}
+
+	void evaluate_range(const WorkRange& work_range, SceneGraph& scene_graph)
+	{
+		const uint32_t path = work_range.group / ANIMATION_INTERPOLATION_COUNT;
+		const GltfInterpolation interpolation = (GltfInterpolation) (work_range.group % ANIMATION_INTERPOLATION_COUNT);
+
+		switch (path)
+		{
+			case GLTF_ANIMATION_PATH_TRANSLATION:
+				evaluate_transform_channels<3, false>(interpolation, work_range.begin, work_range.end, scene_graph.translation);
+				break;
+			case GLTF_ANIMATION_PATH_ROTATION:
+				evaluate_transform_channels<4, true>(interpolation, work_range.begin, work_range.end, scene_graph.rotation);
+				break;
+			case GLTF_ANIMATION_PATH_SCALE:
+				evaluate_transform_channels<3, false>(interpolation, work_range.begin, work_range.end, scene_graph.scale);
+				break;
+			default:
+				for (uint32_t channel_idx = work_range.begin; channel_idx < work_range.end; ++channel_idx)
+				{
+					evaluate_weights_channel(channels[channel_idx], interpolation, scene_graph);
+				}
+				break;
+		}
+	}
+
+	template <uint32_t Components, bool IsRotation>
+	void evaluate_transform_channels(GltfInterpolation interpolation, uint32_t begin, uint32_t end, vector<float>* destination)
+	{
+		switch (interpolation)
+		{
+			case GLTF_INTERPOLATION_LINEAR:
+				evaluate_transform_channels<Components, IsRotation, GLTF_INTERPOLATION_LINEAR>(begin, end, destination);
+				break;
+			case GLTF_INTERPOLATION_STEP:
+				evaluate_transform_channels<Components, IsRotation, GLTF_INTERPOLATION_STEP>(begin, end, destination);
+				break;
+			case GLTF_INTERPOLATION_CUBICSPLINE:
+				evaluate_transform_channels<Components, IsRotation, GLTF_INTERPOLATION_CUBICSPLINE>(begin, end, destination);
+				break;
+		}
+	}
+
+	template <uint32_t Components, bool IsRotation, GltfInterpolation Interpolation>
+	void evaluate_transform_channels(uint32_t begin, uint32_t end, vector<float>* destination)
+	{
+		uint32_t channel_idx = begin;
+		for (; channel_idx + SceneGraphLanes::WIDTH <= end; channel_idx += SceneGraphLanes::WIDTH)
+		{
+			evaluate_lanes<SceneGraphLanes, Components, IsRotation, Interpolation>(&channels[channel_idx], destination);
+		}
+		for (; channel_idx < end; ++channel_idx)
+		{
+			evaluate_lanes<SceneGraphLanes1, Components, IsRotation, Interpolation>(&channels[channel_idx], destination);
+		}
+	}
+
+	// Samples Lanes::WIDTH channels of the same path and interpolation, one channel per lane
+	template <typename Lanes, uint32_t Components, bool IsRotation, GltfInterpolation Interpolation>
+	void evaluate_lanes(const AnimationChannel* lane_channels, vector<float>* destination)
+	{
+		typedef typename Lanes::Type V;
+		static const uint32_t key_stride = Interpolation == GLTF_INTERPOLATION_CUBICSPLINE ? Components * 3 : Components;
+
+		// Start of both keyframes of each lane. Cubic spline values are one component block into their keyframe.
+		int32_t first_keys[Lanes::WIDTH];
+		int32_t second_keys[Lanes::WIDTH];
+		float factors[Lanes::WIDTH];
+		float durations[Lanes::WIDTH];
+		for (uint32_t lane = 0; lane < Lanes::WIDTH; ++lane)
+		{
+			const AnimationChannel& channel = lane_channels[lane];
+			const AnimationTimeline& timeline = timelines[channel.timeline];
+			first_keys[lane] = (int32_t) (channel.first_value + timeline.key * key_stride);
+			second_keys[lane] = first_keys[lane] + (timeline.key + 1 < timeline.time_count ? (int32_t) key_stride : 0);
+			factors[lane] = timeline.factor;
+			durations[lane] = timeline.duration;
+		}
+
+		V result[Components];
+		if (Interpolation == GLTF_INTERPOLATION_STEP)
+		{
+			for (uint32_t component = 0; component < Components; ++component)
+			{
+				result[component] = Lanes::gather(values.data() + component, first_keys);
+			}
+		}
+		else if (Interpolation == GLTF_INTERPOLATION_LINEAR)
+		{
+			V a[Components];
+			V b[Components];
+			for (uint32_t component = 0; component < Components; ++component)
+			{
+				a[component] = Lanes::gather(values.data() + component, first_keys);
+				b[component] = Lanes::gather(values.data() + component, second_keys);
+			}
+
+			V t = Lanes::load(factors);
+			if (IsRotation)
+			{
+				// Shortest arc: b is negated when the quaternions are more than 180 degrees apart, by giving t the sign of their dot product.
+				// The lerp parameter is bent towards a slerp's constant angular velocity (Zeux's fitted correction, within ~5e-4 of slerp).
+				V dot = Lanes::mul(a[0], b[0]);
+				for (uint32_t component = 1; component < Components; ++component)
+				{
+					dot = Lanes::add(dot, Lanes::mul(a[component], b[component]));
+				}
+				const V d = Lanes::copy_sign(dot, Lanes::splat(1.0f));
+				const V half = Lanes::splat(0.5f);
+				V k_a = Lanes::add(Lanes::splat(3.55645f), Lanes::mul(d, Lanes::splat(-1.43519f)));
+				k_a = Lanes::add(Lanes::splat(-3.2452f), Lanes::mul(d, k_a));
+				k_a = Lanes::add(Lanes::splat(1.0904f), Lanes::mul(d, k_a));
+				V k_b = Lanes::add(Lanes::splat(-1.06021f), Lanes::mul(d, Lanes::splat(0.215638f)));
+				k_b = Lanes::add(Lanes::splat(0.848013f), Lanes::mul(d, k_b));
+				const V centered = Lanes::sub(t, half);
+				const V k = Lanes::add(Lanes::mul(k_a, Lanes::mul(centered, centered)), k_b);
+				t = Lanes::add(t, Lanes::mul(Lanes::mul(t, centered), Lanes::mul(Lanes::sub(t, Lanes::splat(1.0f)), k)));
+
+				const V one_minus_t = Lanes::sub(Lanes::splat(1.0f), t);
+				const V signed_t = Lanes::copy_sign(t, dot);
+				for (uint32_t component = 0; component < Components; ++component)
+				{
+					result[component] = Lanes::add(Lanes::mul(a[component], one_minus_t), Lanes::mul(b[component], signed_t));
+				}
+			}
+			else
+			{
+				for (uint32_t component = 0; component < Components; ++component)
+				{
+					result[component] = Lanes::add(a[component], Lanes::mul(Lanes::sub(b[component], a[component]), t));
+				}
+			}
+		}
+		else
+		{
+			// Hermite spline between the first keyframe's value and out-tangent and the second's in-tangent and value
+			const V t = Lanes::load(factors);
+			const V duration = Lanes::load(durations);
+			const V t2 = Lanes::mul(t, t);
+			const V t3 = Lanes::mul(t2, t);
+			const V two_t3 = Lanes::add(t3, t3);
+			const V three_t2 = Lanes::add(t2, Lanes::add(t2, t2));
+			const V value_a_weight = Lanes::add(Lanes::sub(two_t3, three_t2), Lanes::splat(1.0f));
+			const V tangent_a_weight = Lanes::mul(Lanes::add(Lanes::sub(t3, Lanes::add(t2, t2)), t), duration);
+			const V value_b_weight = Lanes::sub(three_t2, two_t3);
+			const V tangent_b_weight = Lanes::mul(Lanes::sub(t3, t2), duration);
+
+			for (uint32_t component = 0; component < Components; ++component)
+			{
+				const V value_a = Lanes::gather(values.data() + Components + component, first_keys);
+				const V out_tangent_a = Lanes::gather(values.data() + 2 * Components + component, first_keys);
+				const V in_tangent_b = Lanes::gather(values.data() + component, second_keys);
+				const V value_b = Lanes::gather(values.data() + Components + component, second_keys);
+				V sum = Lanes::mul(value_a, value_a_weight);
+				sum = Lanes::add(sum, Lanes::mul(out_tangent_a, tangent_a_weight));
+				sum = Lanes::add(sum, Lanes::mul(value_b, value_b_weight));
+				result[component] = Lanes::add(sum, Lanes::mul(in_tangent_b, tangent_b_weight));
+			}
+		}
+
+		if (IsRotation && Interpolation != GLTF_INTERPOLATION_STEP)
+		{
+			V length_squared = Lanes::mul(result[0], result[0]);
+			for (uint32_t component = 1; component < Components; ++component)
+			{
+				length_squared = Lanes::add(length_squared, Lanes::mul(result[component], result[component]));
+			}
+			const V length = Lanes::sqrt(length_squared);
+			for (uint32_t component = 0; component < Components; ++component)
+			{
+				result[component] = Lanes::div(result[component], length);
+			}
+		}
+
+		// Lanes write to unrelated nodes, so results are scattered one lane at a time
+		for (uint32_t component = 0; component < Components; ++component)
+		{
+			float lane_results[Lanes::WIDTH];
+			Lanes::store(lane_results, result[component]);
+			float* component_values = destination[component].data();
+			for (uint32_t lane = 0; lane < Lanes::WIDTH; ++lane)
+			{
+				component_values[lane_channels[lane].node] = lane_results[lane];
+			}
+		}
+	}
+
+	// Weights channels have a value per morph target, so each one is evaluated on its own.
+	// Weights beyond the node's target count are ignored, missing ones keep their value.
+	void evaluate_weights_channel(const AnimationChannel& channel, GltfInterpolation interpolation, SceneGraph& scene_graph)
+	{
+		const uint32_t node_weight_count = scene_graph.morph_weight_counts[channel.node];
+		const uint32_t weight_count = channel.component_count < node_weight_count ? channel.component_count : node_weight_count;
+		float* out_weights = &scene_graph.morph_weights[scene_graph.morph_weight_offsets[channel.node]];
+
+		const AnimationTimeline& timeline = timelines[channel.timeline];
+		const uint32_t key_stride = interpolation == GLTF_INTERPOLATION_CUBICSPLINE ? channel.component_count * 3 : channel.component_count;
+		const float* first_key = &values[channel.first_value + timeline.key * key_stride];
+		const float* second_key = timeline.key + 1 < timeline.time_count ? first_key + key_stride : first_key;
+		const float t = timeline.factor;
+
+		for (uint32_t weight = 0; weight < weight_count; ++weight)
+		{
+			switch (interpolation)
+			{
+				case GLTF_INTERPOLATION_LINEAR:
+					out_weights[weight] = first_key[weight] + (second_key[weight] - first_key[weight]) * t;
+					break;
+				case GLTF_INTERPOLATION_STEP:
+					out_weights[weight] = first_key[weight];
+					break;
+				case GLTF_INTERPOLATION_CUBICSPLINE:
+				{
+					const uint32_t count = channel.component_count;
+					const float t2 = t * t;
+					const float t3 = t2 * t;
+					out_weights[weight] = (2.0f * t3 - 3.0f * t2 + 1.0f) * first_key[count + weight]
+						+ (t3 - 2.0f * t2 + t) * timeline.duration * first_key[2 * count + weight]
+						+ (3.0f * t2 - 2.0f * t3) * second_key[count + weight]
+						+ (t3 - t2) * timeline.duration * second_key[weight];
+					break;
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "gltf.h"
+#include "instancing.h"
+
+// Primitive bounds and CPU frustum culling of instances.
+// Each instance's bounding sphere is transformed to world space into structure of arrays, then tested against the six frustum
+// planes CULLING_BATCH_SIZE instances at a time. The visible instances are compacted into a list of instance indices.
+
+static const uint32_t CULLING_BATCH_SIZE = 8;
+
+// Object space bounds of a primitive's vertices. The sphere is centered on the box and encloses every vertex.
+struct PrimitiveBounds
+{
+	float min[3] = { 0.0f, 0.0f, 0.0f };
+	float max[3] = { 0.0f, 0.0f, 0.0f };
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	float radius = 0.0f;
+};
+
+// position_accessor is optional: its min and max (when present on a float accessor) are used as the box instead of scanning the vertices
+inline PrimitiveBounds compute_primitive_bounds(const float* positions, size_t stride, size_t vertex_count, const GltfAccessor* position_accessor = nullptr)
+{
+	auto position = [positions, stride](size_t v) { return (const float*) ((const uint8_t*) positions + v * stride); };
+
+	PrimitiveBounds bounds;
+	if (position_accessor && position_accessor->has_bounds && position_accessor->component_type == GLTF_COMPONENT_TYPE_FLOAT)
+	{
+		memcpy(bounds.min, position_accessor->min, sizeof(bounds.min));
+		memcpy(bounds.max, position_accessor->max, sizeof(bounds.max));
+	}
+	else
+	{
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float value = position(v)[axis];
+				bounds.min[axis] = v == 0 || value < bounds.min[axis] ? value : bounds.min[axis];
+				bounds.max[axis] = v == 0 || value > bounds.max[axis] ? value : bounds.max[axis];
+			}
+		}
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		bounds.center[axis] = (bounds.min[axis] + bounds.max[axis]) * 0.5f;
+	}
+	float radius_squared = 0.0f;
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		const float* p = position(v);
+		const float dx = p[0] - bounds.center[0], dy = p[1] - bounds.center[1], dz = p[2] - bounds.center[2];
+		const float distance_squared = dx * dx + dy * dy + dz * dz;
+		radius_squared = distance_squared > radius_squared ? distance_squared : radius_squared;
+	}
+	bounds.radius = sqrtf(radius_squared);
+	return bounds;
+}
+
+// Inward facing planes (a, b, c, d), normalized so a point p is inside when a p.x + b p.y + c p.z + d >= 0
+struct Frustum
+{
+	float planes[6][4];
+};
+
+// Planes of a row vector view projection matrix (clip = p * view_proj) with a [0, 1] depth range
+inline Frustum extract_frustum(const float view_proj[16])
+{
+	auto column = [view_proj](int j, float out_column[4])
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			out_column[i] = view_proj[i * 4 + j];
+		}
+	};
+	float x[4], y[4], z[4], w[4];
+	column(0, x);
+	column(1, y);
+	column(2, z);
+	column(3, w);
+
+	Frustum frustum;
+	for (int i = 0; i < 4; ++i)
+	{
+		frustum.planes[0][i] = w[i] + x[i]; // Left
+		frustum.planes[1][i] = w[i] - x[i]; // Right
+		frustum.planes[2][i] = w[i] + y[i]; // Bottom
+		frustum.planes[3][i] = w[i] - y[i]; // Top
+		frustum.planes[4][i] = z[i];        // Near
+		frustum.planes[5][i] = w[i] - z[i]; // Far
+	}
+	for (float* plane : frustum.planes)
+	{
+		const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		const float inverse_length = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int i = 0; i < 4; ++i)
+		{
+			plane[i] *= inverse_length;
+		}
+	}
+	return frustum;
+}
+
+// World space bounding spheres of a primitive's instances, padded to a multiple of CULLING_BATCH_SIZE.
+// scale is the largest axis scale of each instance's transform, which object space distances (e.g. LOD errors) scale by.
+struct InstanceSpheres
+{
+	vector<float> x;
+	vector<float> y;
+	vector<float> z;
+	vector<float> radius;
+	vector<float> scale;
+
+	// world_matrix is the node's row vector world matrix. Instances are in node space (applied before world_matrix),
+	// or in world space (applied after it) when instances_in_world_space is set.
+	void compute(const PrimitiveBounds& bounds, const float world_matrix[16], const InstanceTransform* instances, uint32_t instance_count,
+		bool instances_in_world_space = false)
+	{
+		const uint32_t padded_count = (instance_count + CULLING_BATCH_SIZE - 1) / CULLING_BATCH_SIZE * CULLING_BATCH_SIZE;
+		x.resize(padded_count);
+		y.resize(padded_count);
+		z.resize(padded_count);
+		radius.resize(padded_count);
+		scale.resize(padded_count);
+
+		float world_scale_squared = 0.0f;
+		for (int row = 0; row < 3; ++row)
+		{
+			const float* axis = &world_matrix[row * 4];
+			const float scale_squared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			world_scale_squared = scale_squared > world_scale_squared ? scale_squared : world_scale_squared;
+		}
+		const float world_scale = sqrtf(world_scale_squared);
+
+		for (uint32_t instance = 0; instance < instance_count; ++instance)
+		{
+			const InstanceTransform& transform = instances[instance];
+
+			float instance_scale_squared = 0.0f;
+			for (int column = 0; column < 3; ++column)
+			{
+				const float scale_squared = transform.rows[0][column] * transform.rows[0][column] + transform.rows[1][column] * transform.rows[1][column]
+					+ transform.rows[2][column] * transform.rows[2][column];
+				instance_scale_squared = scale_squared > instance_scale_squared ? scale_squared : instance_scale_squared;
+			}
+
+			auto apply_instance = [&transform](const float in_point[3], float out_point[3])
+			{
+				for (int row = 0; row < 3; ++row)
+				{
+					out_point[row] = transform.rows[row][0] * in_point[0] + transform.rows[row][1] * in_point[1] + transform.rows[row][2] * in_point[2] + transform.rows[row][3];
+				}
+			};
+			auto apply_world = [world_matrix](const float in_point[3], float out_point[3])
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					out_point[axis] = in_point[0] * world_matrix[axis] + in_point[1] * world_matrix[4 + axis] + in_point[2] * world_matrix[8 + axis] + world_matrix[12 + axis];
+				}
+			};
+
+			float transformed_center[3];
+			float world_center[3];
+			if (instances_in_world_space)
+			{
+				apply_world(bounds.center, transformed_center);
+				apply_instance(transformed_center, world_center);
+			}
+			else
+			{
+				apply_instance(bounds.center, transformed_center);
+				apply_world(transformed_center, world_center);
+			}
+
+			x[instance] = world_center[0];
+			y[instance] = world_center[1];
+			z[instance] = world_center[2];
+			scale[instance] = world_scale * sqrtf(instance_scale_squared);
+			radius[instance] = bounds.radius * scale[instance];
+		}
+
+		// Padding lanes are tested too, a negative radius makes them fail every plane
+		for (uint32_t instance = instance_count; instance < padded_count; ++instance)
+		{
+			x[instance] = y[instance] = z[instance] = 0.0f;
+			radius[instance] = -FLT_MAX;
+			scale[instance] = 0.0f;
+		}
+	}
+};
+
+// Bit i is set when sphere first + i intersects the frustum
+inline uint32_t cull_spheres_batch(const Frustum& frustum, const InstanceSpheres& spheres, uint32_t first)
+{
+#if GLTF_SIMD_AVX2
+	const __m256 x = _mm256_loadu_ps(&spheres.x[first]);
+	const __m256 y = _mm256_loadu_ps(&spheres.y[first]);
+	const __m256 z = _mm256_loadu_ps(&spheres.z[first]);
+	const __m256 negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[first]));
+	__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	for (const float* plane : frustum.planes)
+	{
+		const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane[0])), _mm256_mul_ps(y, _mm256_set1_ps(plane[1]))),
+			_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane[2])), _mm256_set1_ps(plane[3])));
+		visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+	}
+	return (uint32_t) _mm256_movemask_ps(visible);
+#elif GLTF_SIMD_SSE2
+	uint32_t mask = 0;
+	for (uint32_t half = 0; half < CULLING_BATCH_SIZE; half += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&spheres.x[first + half]);
+		const __m128 y = _mm_loadu_ps(&spheres.y[first + half]);
+		const __m128 z = _mm_loadu_ps(&spheres.z[first + half]);
+		const __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[first + half]));
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const float* plane : frustum.planes)
+		{
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])), _mm_mul_ps(y, _mm_set1_ps(plane[1]))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane[2])), _mm_set1_ps(plane[3])));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negative_radius));
+		}
+		mask |= (uint32_t) _mm_movemask_ps(visible) << half;
+	}
+	return mask;
+#elif GLTF_SIMD_NEON
+	uint32_t mask = 0;
+	for (uint32_t half = 0; half < CULLING_BATCH_SIZE; half += 4)
+	{
+		const float32x4_t x = vld1q_f32(&spheres.x[first + half]);
+		const float32x4_t y = vld1q_f32(&spheres.y[first + half]);
+		const float32x4_t z = vld1q_f32(&spheres.z[first + half]);
+		const float32x4_t negative_radius = vnegq_f32(vld1q_f32(&spheres.radius[first + half]));
+		uint32x4_t visible = vdupq_n_u32(0xFFFFFFFFu);
+		for (const float* plane : frustum.planes)
+		{
+			const float32x4_t distance = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(plane[3]), x, plane[0]), y, plane[1]), z, plane[2]);
+			visible = vandq_u32(visible, vcgeq_f32(distance, negative_radius));
+		}
+		// One bit per lane
+		const uint32_t lane_bits[4] = { 1, 2, 4, 8 };
+		mask |= vaddvq_u32(vandq_u32(visible, vld1q_u32(lane_bits))) << half;
+	}
+	return mask;
+#else
+	uint32_t mask = 0;
+	for (uint32_t lane = 0; lane < CULLING_BATCH_SIZE; ++lane)
+	{
+		const uint32_t instance = first + lane;
+		bool visible = true;
+		for (const float* plane : frustum.planes)
+		{
+			visible &= spheres.x[instance] * plane[0] + spheres.y[instance] * plane[1] + spheres.z[instance] * plane[2] + plane[3] >= -spheres.radius[instance];
+		}
+		mask |= (uint32_t) visible << lane;
+	}
+	return mask;
+#endif
+}
+
+// Writes the indices of the instances that intersect the frustum to out_visible (which needs room for instance_count rounded up
+// to CULLING_BATCH_SIZE) and returns their count
+inline uint32_t cull_instances(const Frustum& frustum, const InstanceSpheres& spheres, uint32_t instance_count, uint32_t* out_visible)
+{
+	uint32_t visible_count = 0;
+	for (uint32_t first = 0; first < instance_count; first += CULLING_BATCH_SIZE)
+	{
+		// Every lane is written, only visible ones advance the output
+		const uint32_t mask = cull_spheres_batch(frustum, spheres, first);
+		for (uint32_t lane = 0; lane < CULLING_BATCH_SIZE; ++lane)
+		{
+			out_visible[visible_count] = first + lane;
+			visible_count += (mask >> lane) & 1;
+		}
+	}
+	return visible_count;
+}
@@ -93,10 +93,63 @@ struct GpuRenderData
 	}
 
 	template <typename T>
-	GpuRenderData(D3D12MA::Allocator* gpu_memory_allocator, vector<T> vertices, vector<UINT32> indices)
+	GpuRenderData(D3D12MA::Allocator* gpu_memory_allocator, const vector<T>& vertices, const vector<UINT32>& indices)
 	{
 		static_assert(!std::is_pointer<T>(), "vertices must be an array to some non-pointer type");
-		
+
+		//16 bit indices whenever they can address every vertex, which halves index memory and bandwidth
+		const bool use_16_bit_indices = vertices.size() <= 0x10000;
+		create_buffers(gpu_memory_allocator, sizeof(T), vertices.size(), use_16_bit_indices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, indices.size());
+
+		// Copy the triangle data to the vertex buffer.
+		UINT8* vertex_data_begin;
+		HR_CHECK(vertex_buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&vertex_data_begin)));
+		memcpy(vertex_data_begin, vertices.data(), vertex_buffer_view.SizeInBytes);
+		vertex_buffer->Unmap(0, nullptr);
+
+		//Copy index data
+		UINT8* index_data_begin;
+		HR_CHECK(index_buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&index_data_begin)));
+		if (use_16_bit_indices)
+		{
+			UINT16* index_data_16 = reinterpret_cast<UINT16*>(index_data_begin);
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				index_data_16[i] = static_cast<UINT16>(indices[i]);
+			}
+		}
+		else
+		{
+			memcpy(index_data_begin, indices.data(), index_buffer_view.SizeInBytes);
+		}
+		index_buffer->Unmap(0, nullptr);
+	}
+
+	//Vertex and index data already in their buffer formats (e.g. mapped from the mesh cache), copied as is
+	GpuRenderData(D3D12MA::Allocator* gpu_memory_allocator, const void* vertex_data, UINT vertex_stride, size_t vertex_count, const void* index_data, DXGI_FORMAT index_format, size_t index_count)
+	{
+		create_buffers(gpu_memory_allocator, vertex_stride, vertex_count, index_format, index_count);
+
+		UINT8* vertex_data_begin;
+		HR_CHECK(vertex_buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&vertex_data_begin)));
+		memcpy(vertex_data_begin, vertex_data, vertex_buffer_view.SizeInBytes);
+		vertex_buffer->Unmap(0, nullptr);
+
+		UINT8* index_data_begin;
+		HR_CHECK(index_buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&index_data_begin)));
+		memcpy(index_data_begin, index_data, index_buffer_view.SizeInBytes);
+		index_buffer->Unmap(0, nullptr);
+	}
+
+	UINT index_count() const
+	{
+		const UINT index_size = index_buffer_view.Format == DXGI_FORMAT_R16_UINT ? sizeof(UINT16) : sizeof(UINT32);
+		return index_buffer_view.SizeInBytes / index_size;
+	}
+
+	//Creates both buffers in the upload heap and their views, contents are filled by the caller
+	void create_buffers(D3D12MA::Allocator* gpu_memory_allocator, UINT vertex_stride, size_t vertex_count, DXGI_FORMAT index_format, size_t index_count)
+	{
 		D3D12_RESOURCE_DESC resource_desc = {};
 		resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 		resource_desc.Alignment = 0;
@@ -114,7 +167,7 @@ struct GpuRenderData
 		D3D12MA::ALLOCATION_DESC alloc_desc = {};
 		alloc_desc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
 
-		const size_t vertices_size = sizeof(T) * vertices.size();
+		const size_t vertices_size = vertex_stride * vertex_count;
 
 		//update resource desc to vertices_size
 		resource_desc.Width = vertices_size; 
@@ -131,18 +184,12 @@ struct GpuRenderData
 		vertex_buffer->SetName(TEXT("mesh vertex buffer"));
 		vertex_buffer_allocation->SetName(TEXT("mesh vertex buffer memory"));
 
-		// Copy the triangle data to the vertex buffer.
-		UINT8* vertex_data_begin;
-		HR_CHECK(vertex_buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&vertex_data_begin)));
-		memcpy(vertex_data_begin, vertices.data(), vertices_size);
-		vertex_buffer->Unmap(0, nullptr);
-
 		// Init the vertex buffer view.
 		vertex_buffer_view.BufferLocation = vertex_buffer->GetGPUVirtualAddress();
-		vertex_buffer_view.StrideInBytes = sizeof(T);
+		vertex_buffer_view.StrideInBytes = vertex_stride;
 		vertex_buffer_view.SizeInBytes = static_cast<UINT>(vertices_size);
 
-		const size_t indices_size = sizeof(UINT32) * indices.size();
+		const size_t indices_size = (index_format == DXGI_FORMAT_R16_UINT ? sizeof(UINT16) : sizeof(UINT32)) * index_count;
 
 		//update resource desc to indices_size
 		resource_desc.Width = indices_size;
@@ -159,21 +206,10 @@ struct GpuRenderData
 		index_buffer->SetName(TEXT("mesh index buffer"));
 		index_buffer->SetName(TEXT("mesh index buffer memory"));
 
-		//Copy index data
-		UINT8* index_data_begin;
-		HR_CHECK(index_buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&index_data_begin)));
-		memcpy(index_data_begin, indices.data(), indices_size);
-		index_buffer->Unmap(0, nullptr);
-
 		//Init the index buffer view
 		index_buffer_view.BufferLocation = index_buffer->GetGPUVirtualAddress();
 		index_buffer_view.SizeInBytes = static_cast<UINT>(indices_size);
-		index_buffer_view.Format = DXGI_FORMAT_R32_UINT;
-	}
-
-	UINT index_count() const
-	{
-		return index_buffer_view.SizeInBytes / sizeof(UINT32);
+		index_buffer_view.Format = index_format;
 	}
 
 	void release()
@@ -191,6 +227,159 @@ struct GpuRenderData
 	}
 };
 
+//Upload heap vertex buffer that stays mapped, for vertices the CPU rewrites every frame (e.g. skinning). Use one per frame in flight.
+struct GpuDynamicVertexBuffer
+{
+	ComPtr<ID3D12Resource> vertex_buffer;
+	D3D12MA::Allocation* vertex_buffer_allocation = nullptr;
+	D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view = {};
+	UINT8* mapped_data = nullptr; //Write only, upload memory is write combined
+
+	GpuDynamicVertexBuffer() = default;
+
+	GpuDynamicVertexBuffer(D3D12MA::Allocator* gpu_memory_allocator, UINT vertex_stride, size_t vertex_count)
+	{
+		const size_t vertices_size = vertex_stride * vertex_count;
+
+		D3D12_RESOURCE_DESC resource_desc = CD3DX12_RESOURCE_DESC::Buffer(vertices_size);
+
+		D3D12MA::ALLOCATION_DESC alloc_desc = {};
+		alloc_desc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
+
+		HR_CHECK(gpu_memory_allocator->CreateResource(
+			&alloc_desc,
+			&resource_desc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			&vertex_buffer_allocation,
+			IID_PPV_ARGS(&vertex_buffer)
+		));
+		vertex_buffer->SetName(TEXT("dynamic vertex buffer"));
+		vertex_buffer_allocation->SetName(TEXT("dynamic vertex buffer memory"));
+
+		vertex_buffer_view.BufferLocation = vertex_buffer->GetGPUVirtualAddress();
+		vertex_buffer_view.StrideInBytes = vertex_stride;
+		vertex_buffer_view.SizeInBytes = static_cast<UINT>(vertices_size);
+
+		HR_CHECK(vertex_buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&mapped_data)));
+	}
+
+	void release()
+	{
+		if (vertex_buffer_allocation)
+		{
+			vertex_buffer_allocation->Release();
+			vertex_buffer_allocation = nullptr;
+		}
+		mapped_data = nullptr;
+	}
+};
+
+//Upload heap buffer written once at creation and read by shaders through a root SRV (e.g. StructuredBuffer<T>)
+struct GpuStructuredBuffer
+{
+	ComPtr<ID3D12Resource> buffer;
+	D3D12MA::Allocation* buffer_allocation = nullptr;
+	UINT element_count = 0;
+
+	GpuStructuredBuffer() = default;
+
+	GpuStructuredBuffer(D3D12MA::Allocator* gpu_memory_allocator, const void* elements, UINT element_stride, UINT in_element_count)
+		: element_count(in_element_count)
+	{
+		const size_t buffer_size = (size_t) element_stride * element_count;
+
+		D3D12_RESOURCE_DESC resource_desc = CD3DX12_RESOURCE_DESC::Buffer(buffer_size);
+
+		D3D12MA::ALLOCATION_DESC alloc_desc = {};
+		alloc_desc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
+
+		HR_CHECK(gpu_memory_allocator->CreateResource(
+			&alloc_desc,
+			&resource_desc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			&buffer_allocation,
+			IID_PPV_ARGS(&buffer)
+		));
+		buffer->SetName(TEXT("structured buffer"));
+		buffer_allocation->SetName(TEXT("structured buffer memory"));
+
+		UINT8* buffer_data_begin;
+		HR_CHECK(buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&buffer_data_begin)));
+		memcpy(buffer_data_begin, elements, buffer_size);
+		buffer->Unmap(0, nullptr);
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS get_gpu_virtual_address() const
+	{
+		return buffer->GetGPUVirtualAddress();
+	}
+
+	void release()
+	{
+		if (buffer_allocation)
+		{
+			buffer_allocation->Release();
+			buffer_allocation = nullptr;
+		}
+	}
+};
+
+//Persistently mapped upload heap buffer rewritten by the CPU every frame (one per backbuffer) and read by shaders through a root SRV
+struct GpuDynamicStructuredBuffer
+{
+	ComPtr<ID3D12Resource> buffer;
+	D3D12MA::Allocation* buffer_allocation = nullptr;
+	UINT element_stride = 0;
+	UINT element_count = 0;
+	UINT8* mapped_data = nullptr; //Write only, upload memory is write combined
+
+	GpuDynamicStructuredBuffer() = default;
+
+	GpuDynamicStructuredBuffer(D3D12MA::Allocator* gpu_memory_allocator, UINT in_element_stride, UINT in_element_count)
+		: element_stride(in_element_stride)
+		, element_count(in_element_count)
+	{
+		//Zero sized buffers can't be created
+		const size_t buffer_size = (size_t) element_stride * (element_count > 0 ? element_count : 1);
+
+		D3D12_RESOURCE_DESC resource_desc = CD3DX12_RESOURCE_DESC::Buffer(buffer_size);
+
+		D3D12MA::ALLOCATION_DESC alloc_desc = {};
+		alloc_desc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
+
+		HR_CHECK(gpu_memory_allocator->CreateResource(
+			&alloc_desc,
+			&resource_desc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			&buffer_allocation,
+			IID_PPV_ARGS(&buffer)
+		));
+		buffer->SetName(TEXT("dynamic structured buffer"));
+		buffer_allocation->SetName(TEXT("dynamic structured buffer memory"));
+
+		HR_CHECK(buffer->Map(0, &no_read_range, reinterpret_cast<void**>(&mapped_data)));
+	}
+
+	//Root SRVs can start at any element, so draws can read different ranges of one buffer
+	D3D12_GPU_VIRTUAL_ADDRESS get_gpu_virtual_address(UINT first_element = 0) const
+	{
+		return buffer->GetGPUVirtualAddress() + (UINT64) first_element * element_stride;
+	}
+
+	void release()
+	{
+		if (buffer_allocation)
+		{
+			buffer_allocation->Release();
+			buffer_allocation = nullptr;
+		}
+		mapped_data = nullptr;
+	}
+};
+
 struct GraphicsPipelineBuilder
 {
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc;
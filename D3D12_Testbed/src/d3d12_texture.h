@@ -23,6 +23,11 @@ using eastl::optional;
 #include "Remotery/Remotery.h"
 
 #include "d3d12_helpers.h"
+#include "mip_generation.h"
+#include "hdr_texels.h"
+#include "texture_compression.h"
+#include "texture_cache.h"
+#include "texture_container.h"
 
 constexpr int BINDLESS_INVALID_INDEX = -1;
 
@@ -34,6 +39,9 @@ struct Texture
 	int bindless_index = BINDLESS_INVALID_INDEX;
 	bool is_cubemap = false;
 
+	//Channel swizzle of the texture's SRV (e.g. to read two channel block formats back where the shaders expect them)
+	UINT shader_component_mapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
 	//TODO: this likely shouldn't be managed by the texture resource
 	ComPtr<ID3D12DescriptorHeap> texture_descriptor_heap_rtv;
 	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> rtv_handles;
@@ -123,6 +131,16 @@ struct Texture
 	{
 		const size_t image_pixel_size = desired_channels * sizeof(T);
 
+		D3D12_SUBRESOURCE_DATA subresource_data = {};
+		subresource_data.pData = image_data;
+		subresource_data.RowPitch = image_width * image_pixel_size;
+		subresource_data.SlicePitch = subresource_data.RowPitch * image_height;
+		upload_subresources(device, gpu_memory_allocator, command_queue, &subresource_data, 1);
+	}
+
+	//Uploads subresources [0, subresource_count) (e.g. every mip of a texture) through one staging buffer and one UpdateSubresources call
+	void upload_subresources(const ComPtr<ID3D12Device> device, D3D12MA::Allocator* gpu_memory_allocator, const ComPtr<ID3D12CommandQueue> command_queue, const D3D12_SUBRESOURCE_DATA* subresources, const UINT subresource_count) const
+	{
 			ComPtr<ID3D12Resource> staging_buffer;
 			D3D12MA::Allocation* staging_buffer_allocation = nullptr;
 
@@ -133,7 +151,7 @@ struct Texture
 			D3D12_RESOURCE_DESC staging_buffer_desc = {};
 			staging_buffer_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 			staging_buffer_desc.Alignment = 0;
-			staging_buffer_desc.Width = GetRequiredIntermediateSize(resource.Get(), 0, 1); //Important
+			staging_buffer_desc.Width = GetRequiredIntermediateSize(resource.Get(), 0, subresource_count); //Important
 			staging_buffer_desc.Height = 1;
 			staging_buffer_desc.DepthOrArraySize = 1;
 			staging_buffer_desc.MipLevels = 1;
@@ -161,12 +179,7 @@ struct Texture
 			command_list->Close();
 			command_list->Reset(command_allocator.Get(), nullptr);
 
-			D3D12_SUBRESOURCE_DATA subresource_data = {};
-			subresource_data.pData = image_data;
-			subresource_data.RowPitch = image_width * image_pixel_size;
-			subresource_data.SlicePitch = subresource_data.RowPitch * image_height;
-
-			UpdateSubresources(command_list.Get(), resource.Get(), staging_buffer.Get(), 0, 0, 1, &subresource_data);
+			UpdateSubresources(command_list.Get(), resource.Get(), staging_buffer.Get(), 0, 0, subresource_count, subresources);
 			auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 			command_list->ResourceBarrier(1, &barrier);
 
@@ -311,6 +324,30 @@ struct Texture
 	}
 };
 
+//What a decoded image is used for, which picks its GPU format
+enum class TextureUsage : uint8_t
+{
+	Uncompressed,		//RGBA8 sRGB, or the builder's hdr_format for HDR images
+	Color,				//BC7 sRGB, BC6H for HDR images
+	ColorOpaque,		//BC1 sRGB (alpha is dropped), BC6H for HDR images
+	MetallicRoughness,	//BC5 of the G (roughness) and B (metallic) channels, linear
+	Mask,				//BC4 of the R channel, linear
+	Environment,		//BC6H for HDR images, BC7 sRGB otherwise
+};
+
+inline DXGI_FORMAT block_format_dxgi(const BlockFormat format, const bool is_srgb)
+{
+	switch (format)
+	{
+		case BlockFormat::BC1:	return is_srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		case BlockFormat::BC4:	return DXGI_FORMAT_BC4_UNORM;
+		case BlockFormat::BC5:	return DXGI_FORMAT_BC5_UNORM;
+		case BlockFormat::BC6H:	return DXGI_FORMAT_BC6H_UF16;
+		case BlockFormat::BC7:	return is_srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
 struct TextureBuilder
 {
 	D3D12MA::ALLOCATION_DESC texture_alloc_desc = {};
@@ -319,7 +356,29 @@ struct TextureBuilder
 	std::string debug_name;
 	
 	std::vector<uint8_t> binary_file_data;
+
+	//DDS or KTX2 file from from_file, mapped in build() instead of being read up front
+	std::string container_path;
+
+	//Non-owning view of encoded image data (see from_binary_data), takes precedence over binary_file_data
+	const uint8_t* binary_data = nullptr;
+	size_t binary_data_size = 0;
+
 	bool flip_vertically_on_load = false;
+
+	//Mips below the decoded image, see with_generated_mips
+	bool generate_mips = false;
+	MipFilter mip_filter = MipFilter::Box;
+
+	//Runs mip generation and block compression when set
+	enki::TaskScheduler* task_scheduler = nullptr;
+
+	//Format of HDR images that aren't block compressed, see with_hdr_format
+	DXGI_FORMAT hdr_format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+	//See with_usage and with_compression_cache
+	TextureUsage usage = TextureUsage::Uncompressed;
+	std::string compression_cache_directory;
 	
 	TextureBuilder()
 	{
@@ -378,9 +437,19 @@ struct TextureBuilder
 
 	TextureBuilder& from_file(const char* in_file)
 	{
-		if (FILE *fp = open_binary_file(in_file)) //See gltf.h
+		container_path.clear();
+		if (is_texture_container_file(in_file))
 		{
 			binary_file_data.clear();
+			binary_data = nullptr;
+			binary_data_size = 0;
+			container_path = in_file;
+		}
+		else if (FILE *fp = open_binary_file(in_file)) //See gltf.h
+		{
+			binary_file_data.clear();
+			binary_data = nullptr;
+			binary_data_size = 0;
 			//Go to the end of the file. 
 			if (fseek(fp, 0L, SEEK_END) == 0)
 			{
@@ -404,10 +473,13 @@ struct TextureBuilder
 		return* this;
 	}
 
-	TextureBuilder& from_binary_data(uint8_t* buffer, const size_t buffer_len)
+	//Doesn't copy: buffer must stay valid until build() is called
+	TextureBuilder& from_binary_data(const uint8_t* buffer, const size_t buffer_len)
 	{
 		binary_file_data.clear();
-		binary_file_data.assign(buffer, buffer + buffer_len);
+		container_path.clear();
+		binary_data = buffer;
+		binary_data_size = buffer_len;
 		return *this;
 	}
 
@@ -417,36 +489,343 @@ struct TextureBuilder
 		return *this;
 	}
 
+	//Generates the full mip chain of decoded images on the CPU (replacing with_mip_levels), on task_scheduler's threads if given
+	TextureBuilder& with_generated_mips(const MipFilter in_filter, enki::TaskScheduler* in_task_scheduler = nullptr)
+	{
+		generate_mips = true;
+		mip_filter = in_filter;
+		if (in_task_scheduler)
+		{
+			task_scheduler = in_task_scheduler;
+		}
+		return *this;
+	}
+
+	//Block compresses decoded images (with every generated mip) into the usage's format on the CPU, see TextureUsage.
+	//Images whose size isn't a multiple of 4 texels stay uncompressed.
+	TextureBuilder& with_usage(const TextureUsage in_usage, enki::TaskScheduler* in_task_scheduler = nullptr)
+	{
+		usage = in_usage;
+		if (in_task_scheduler)
+		{
+			task_scheduler = in_task_scheduler;
+		}
+		return *this;
+	}
+
+	//Stores decoded HDR images (and their generated mips) that aren't block compressed as R16G16B16A16_FLOAT, R11G11B10_FLOAT or
+	//R9G9B9E5_SHAREDEXP instead of R32G32B32A32_FLOAT. The last two drop alpha and clamp negative values to 0.
+	TextureBuilder& with_hdr_format(const DXGI_FORMAT in_hdr_format)
+	{
+		assert(is_hdr_texel_format(in_hdr_format));
+		hdr_format = in_hdr_format;
+		return *this;
+	}
+
+	//Caches the processed levels of encoded images in in_directory, keyed by the encoded bytes and the builder's settings
+	TextureBuilder& with_compression_cache(const char* in_directory)
+	{
+		compression_cache_directory = in_directory;
+		return *this;
+	}
+
+	//Block format and first encoded channel of the usage, false if it stays uncompressed
+	bool select_block_format(const bool is_hdr, BlockFormat& out_block_format, uint32_t& out_first_channel) const
+	{
+		out_first_channel = 0;
+		switch (usage)
+		{
+			case TextureUsage::Color:
+			case TextureUsage::Environment:
+				out_block_format = is_hdr ? BlockFormat::BC6H : BlockFormat::BC7;
+				return true;
+			case TextureUsage::ColorOpaque:
+				out_block_format = is_hdr ? BlockFormat::BC6H : BlockFormat::BC1;
+				return true;
+			case TextureUsage::MetallicRoughness:
+				out_block_format = BlockFormat::BC5;
+				out_first_channel = 1;
+				return !is_hdr;
+			case TextureUsage::Mask:
+				out_block_format = BlockFormat::BC4;
+				return !is_hdr;
+			default:
+				return false;
+		}
+	}
+
+	//Creates the (empty) texture resource described so far and names it
+	Texture create_texture(const ComPtr<ID3D12Device> device, D3D12MA::Allocator* gpu_memory_allocator) const
+	{
+		Texture out_texture(device, gpu_memory_allocator, texture_alloc_desc, texture_desc);
+
+		if (!debug_name.empty())
+		{
+			out_texture.set_name(debug_name.c_str());
+		}
+
+		return out_texture;
+	}
+
+	//Creates the texture with the image's full mip chain when mips are generated, otherwise only the image as mip 0.
+	//Levels are block compressed if the usage has a block format, then written to cache_path when it isn't null.
+	template <typename T>
+	Texture build_from_image(const ComPtr<ID3D12Device> device, D3D12MA::Allocator* gpu_memory_allocator, const ComPtr<ID3D12CommandQueue> command_queue, const T* image_data, const int image_width, const int image_height, const MipFormat mip_format,
+							 const char* cache_path = nullptr, const uint64_t cache_key = 0)
+	{
+		MipChain mip_chain;
+		if (generate_mips)
+		{
+			rmt_ScopedCPUSample(GenerateMips, 0);
+			generate_mip_chain(image_data, image_width, image_height, mip_format, mip_filter, 0, task_scheduler, mip_chain);
+			with_mip_levels(static_cast<UINT16>(mip_chain.levels.size() + 1));
+		}
+
+		std::vector<D3D12_SUBRESOURCE_DATA> subresources(mip_chain.levels.size() + 1);
+		std::vector<UINT> row_counts(subresources.size());
+		subresources[0].pData = image_data;
+		subresources[0].RowPitch = image_width * mip_format_texel_size(mip_format);
+		subresources[0].SlicePitch = subresources[0].RowPitch * image_height;
+		row_counts[0] = image_height;
+		for (size_t level = 0; level < mip_chain.levels.size(); ++level)
+		{
+			const MipLevel& mip_level = mip_chain.levels[level];
+			subresources[level + 1].pData = mip_chain.level_data(static_cast<uint32_t>(level));
+			subresources[level + 1].RowPitch = mip_level.row_pitch;
+			subresources[level + 1].SlicePitch = static_cast<LONG_PTR>(mip_level.row_pitch) * mip_level.height;
+			row_counts[level + 1] = mip_level.height;
+		}
+
+		//Compressed levels replace the decoded ones in subresources. D3D12 needs the top level to be a whole number of blocks.
+		BlockFormat block_format;
+		uint32_t first_channel = 0;
+		std::vector<uint8_t> compressed_data;
+		UINT component_mapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		if (select_block_format(mip_format == MipFormat::RGBA32_FLOAT, block_format, first_channel) && image_width % 4 == 0 && image_height % 4 == 0)
+		{
+			rmt_ScopedCPUSample(CompressTexture, 0);
+
+			auto level_size = [](const int top_level_size, const size_t level) { return static_cast<uint32_t>(top_level_size >> level > 0 ? top_level_size >> level : 1); };
+
+			std::vector<size_t> level_offsets(subresources.size());
+			size_t compressed_size = 0;
+			for (size_t level = 0; level < subresources.size(); ++level)
+			{
+				uint32_t row_pitch, row_count;
+				block_level_layout(level_size(image_width, level), level_size(image_height, level), block_format, row_pitch, row_count);
+				level_offsets[level] = compressed_size;
+				compressed_size += static_cast<size_t>(row_pitch) * row_count;
+			}
+			compressed_data.resize(compressed_size);
+
+			for (size_t level = 0; level < subresources.size(); ++level)
+			{
+				const uint32_t level_width = level_size(image_width, level);
+				const uint32_t level_height = level_size(image_height, level);
+				uint8_t* level_blocks = compressed_data.data() + level_offsets[level];
+				compress_level(subresources[level].pData, level_width, level_height, block_format, first_channel, task_scheduler, level_blocks);
+
+				uint32_t row_pitch, row_count;
+				block_level_layout(level_width, level_height, block_format, row_pitch, row_count);
+				subresources[level].pData = level_blocks;
+				subresources[level].RowPitch = row_pitch;
+				subresources[level].SlicePitch = static_cast<LONG_PTR>(row_pitch) * row_count;
+				row_counts[level] = row_count;
+			}
+
+			with_format(block_format_dxgi(block_format, mip_format == MipFormat::RGBA8_SRGB));
+			if (block_format == BlockFormat::BC5 && first_channel == 1)
+			{
+				//Roughness and metallic are stored in R and G, shaders read them from G and B
+				component_mapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1, D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+																			D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_1, D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1);
+			}
+		}
+		else if (mip_format == MipFormat::RGBA32_FLOAT && hdr_format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+		{
+			//Packed levels replace the float ones in subresources, keeping their row counts
+			rmt_ScopedCPUSample(PackHdrTexture, 0);
+			const uint32_t texel_size = hdr_texel_size(hdr_format);
+			size_t packed_size = 0;
+			for (const D3D12_SUBRESOURCE_DATA& subresource : subresources)
+			{
+				packed_size += static_cast<size_t>(subresource.SlicePitch) / mip_format_texel_size(mip_format) * texel_size;
+			}
+			compressed_data.resize(packed_size);
+
+			size_t packed_offset = 0;
+			for (size_t level = 0; level < subresources.size(); ++level)
+			{
+				const uint32_t level_width = static_cast<uint32_t>(subresources[level].RowPitch) / mip_format_texel_size(mip_format);
+				uint8_t* level_texels = compressed_data.data() + packed_offset;
+				convert_hdr_level(static_cast<const float*>(subresources[level].pData), level_width, row_counts[level], hdr_format, task_scheduler, level_texels);
+
+				subresources[level].pData = level_texels;
+				subresources[level].RowPitch = static_cast<LONG_PTR>(level_width) * texel_size;
+				subresources[level].SlicePitch = subresources[level].RowPitch * row_counts[level];
+				packed_offset += subresources[level].SlicePitch;
+			}
+			with_format(hdr_format);
+		}
+
+		Texture out_texture = create_texture(device, gpu_memory_allocator);
+
+		out_texture.shader_component_mapping = component_mapping;
+		out_texture.upload_subresources(device, gpu_memory_allocator, command_queue, subresources.data(), static_cast<UINT>(subresources.size()));
+
+		if (cache_path)
+		{
+			rmt_ScopedCPUSample(WriteTextureCache, 0);
+			std::vector<TextureCacheLevelData> cache_levels(subresources.size());
+			for (size_t level = 0; level < subresources.size(); ++level)
+			{
+				cache_levels[level] = { subresources[level].pData, static_cast<uint32_t>(subresources[level].RowPitch), row_counts[level] };
+			}
+			texture_cache_create_directory(compression_cache_directory.c_str());
+			write_texture_cache(cache_path, cache_key, texture_desc.Format, image_width, image_height, component_mapping, cache_levels.data(), static_cast<uint32_t>(cache_levels.size()));
+		}
+
+		return out_texture;
+	}
+
+	//Creates the texture from its compression cache file, skipping decoding, mip generation and compression. Empty if there's no valid file.
+	optional<Texture> build_from_cache(const ComPtr<ID3D12Device> device, D3D12MA::Allocator* gpu_memory_allocator, const ComPtr<ID3D12CommandQueue> command_queue, const char* cache_path, const uint64_t cache_key)
+	{
+		TextureCache cache;
+		if (!cache.open(cache_path, cache_key))
+		{
+			return {};
+		}
+
+		rmt_ScopedCPUSample(LoadCachedTexture, 0);
+		with_width(cache.header->width);
+		with_height(cache.header->height);
+		with_format(static_cast<DXGI_FORMAT>(cache.header->format));
+		with_mip_levels(static_cast<UINT16>(cache.header->level_count));
+
+		Texture out_texture = create_texture(device, gpu_memory_allocator);
+
+		std::vector<D3D12_SUBRESOURCE_DATA> subresources(cache.header->level_count);
+		for (uint32_t level = 0; level < cache.header->level_count; ++level)
+		{
+			subresources[level].pData = cache.level_data(level);
+			subresources[level].RowPitch = cache.levels[level].row_pitch;
+			subresources[level].SlicePitch = static_cast<LONG_PTR>(cache.levels[level].row_pitch) * cache.levels[level].row_count;
+		}
+		out_texture.shader_component_mapping = cache.header->component_mapping;
+		out_texture.upload_subresources(device, gpu_memory_allocator, command_queue, subresources.data(), static_cast<UINT>(subresources.size()));
+
+		cache.release();
+		return out_texture;
+	}
+
+	//Bindless tables only hold Texture2D and TextureCube views, so containers with more than one 2D texture or cubemap can't be built
+	static bool check_container_supported(TextureContainer& container)
+	{
+		const uint32_t supported_array_size = container.is_cubemap ? 6 : 1;
+		return container.array_size == supported_array_size || container.fail("Texture arrays and cubemap arrays aren't supported");
+	}
+
+	//Creates the texture with every mip and array slice stored in the container, in the container's format (usage and generated mips don't apply)
+	Texture build_from_container(const ComPtr<ID3D12Device> device, D3D12MA::Allocator* gpu_memory_allocator, const ComPtr<ID3D12CommandQueue> command_queue, const TextureContainer& container)
+	{
+		rmt_ScopedCPUSample(LoadTextureContainer, 0);
+		with_width(container.width);
+		with_height(container.height);
+		with_array_size(static_cast<UINT16>(container.array_size));
+		with_mip_levels(static_cast<UINT16>(container.mip_count));
+		with_format(container.format);
+
+		Texture out_texture = create_texture(device, gpu_memory_allocator);
+
+		//Container subresources are already in D3D12 order, and point into the mapped file
+		std::vector<D3D12_SUBRESOURCE_DATA> subresources(container.subresources.size());
+		for (size_t i = 0; i < subresources.size(); ++i)
+		{
+			const TextureSubresource& container_subresource = container.subresources[i];
+			subresources[i].pData = container_subresource.data;
+			subresources[i].RowPitch = container_subresource.row_pitch;
+			subresources[i].SlicePitch = static_cast<LONG_PTR>(container_subresource.row_pitch) * container_subresource.row_count;
+		}
+		out_texture.upload_subresources(device, gpu_memory_allocator, command_queue, subresources.data(), static_cast<UINT>(subresources.size()));
+
+		if (container.is_cubemap)
+		{
+			out_texture.set_is_cubemap(true);
+		}
+
+		return out_texture;
+	}
+
 	//TODO: from_file and from_binary_data should take in required GPU objects and store refs to them?
 	
 	Texture build(const ComPtr<ID3D12Device> device, D3D12MA::Allocator* gpu_memory_allocator, const ComPtr<ID3D12CommandQueue> command_queue)
 	{
 		rmt_ScopedCPUSample(TextureBuilder_build, 0);
-		if (!binary_file_data.empty() && command_queue != nullptr)
+		if (!container_path.empty() && command_queue != nullptr)
 		{
+			TextureContainer container;
+			if (container.open(container_path.c_str()) && check_container_supported(container))
+			{
+				Texture out_texture = build_from_container(device, gpu_memory_allocator, command_queue, container);
+				container.release();
+				return out_texture;
+			}
+			container.release();
+			printf("Error: Failed to load %s: %s\n", container_path.c_str(), container.error);
+		}
+
+		const uint8_t* encoded_data = binary_data ? binary_data : binary_file_data.data();
+		const int encoded_data_size = static_cast<int>(binary_data ? binary_data_size : binary_file_data.size());
+		
+		if (encoded_data_size > 0 && command_queue != nullptr && is_texture_container(encoded_data, encoded_data_size))
+		{
+			TextureContainer container;
+			if (container.parse(encoded_data, encoded_data_size) && check_container_supported(container))
+			{
+				return build_from_container(device, gpu_memory_allocator, command_queue, container);
+			}
+			printf("Error: Failed to load texture container: %s\n", container.error);
+		}
+		else if (encoded_data_size > 0 && command_queue != nullptr)
+		{
+			std::string cache_path;
+			uint64_t cache_key = 0;
+			if (!compression_cache_directory.empty())
+			{
+				//Everything besides the encoded bytes that changes the cached levels
+				struct
+				{
+					TextureUsage usage;
+					MipFilter mip_filter;
+					bool generate_mips;
+					bool flip_vertically_on_load;
+					DXGI_FORMAT hdr_format;
+				} cache_settings = { usage, mip_filter, generate_mips, flip_vertically_on_load, hdr_format };
+				cache_key = texture_cache_key(encoded_data, encoded_data_size, &cache_settings, sizeof(cache_settings));
+				cache_path = texture_cache_path(compression_cache_directory.c_str(), cache_key);
+
+				if (optional<Texture> cached_texture = build_from_cache(device, gpu_memory_allocator, command_queue, cache_path.c_str(), cache_key))
+				{
+					return *cached_texture;
+				}
+			}
+			const char* out_cache_path = cache_path.empty() ? nullptr : cache_path.c_str();
+
 			const int32_t required_components = 4;
-			stbi_set_flip_vertically_on_load(flip_vertically_on_load);
+			stbi_set_flip_vertically_on_load_thread(flip_vertically_on_load); //Per thread, builds run on several tasks at once
 			
-			const bool is_file_hdr = stbi_is_hdr_from_memory(binary_file_data.data(), static_cast<int>(binary_file_data.size()));
+			const bool is_file_hdr = stbi_is_hdr_from_memory(encoded_data, encoded_data_size);
 			if (is_file_hdr)
 			{
 				int image_width, image_height, image_components;
-				if (float* image_data = stbi_loadf_from_memory(binary_file_data.data(), static_cast<int>(binary_file_data.size()), &image_width, &image_height, &image_components, required_components))
+				if (float* image_data = stbi_loadf_from_memory(encoded_data, encoded_data_size, &image_width, &image_height, &image_components, required_components))
 				{
 					with_width(image_width);
 					with_height(image_height);
-					with_format(DXGI_FORMAT_R32G32B32A32_FLOAT); //FCS TODO: Don't assume format
+					with_format(DXGI_FORMAT_R32G32B32A32_FLOAT);
 
-					//FCS TODO: BEGIN DUPLICATE CODE
-					Texture out_texture(device, gpu_memory_allocator, texture_alloc_desc, texture_desc);
-
-					if (!debug_name.empty())
-					{
-						out_texture.set_name(debug_name.c_str());
-					}
-					//FCS TODO: END DUPLICATE CODE
-
-					out_texture.upload_texture_data(device, gpu_memory_allocator, command_queue, required_components, image_data, image_width, image_height);
+					Texture out_texture = build_from_image(device, gpu_memory_allocator, command_queue, image_data, image_width, image_height, MipFormat::RGBA32_FLOAT, out_cache_path, cache_key);
 		
 					stbi_image_free(image_data);
 
@@ -456,22 +835,16 @@ struct TextureBuilder
 			else
 			{
 				int image_width, image_height, image_components;
-				if (stbi_uc* image_data = stbi_load_from_memory(binary_file_data.data(), static_cast<int>(binary_file_data.size()), &image_width, &image_height, &image_components, required_components))
+				if (stbi_uc* image_data = stbi_load_from_memory(encoded_data, encoded_data_size, &image_width, &image_height, &image_components, required_components))
 				{
 					with_width(image_width);
 					with_height(image_height);
-					with_format(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB); //FCS TODO: Don't assume format
-
-					//FCS TODO: BEGIN DUPLICATE CODE
-					Texture out_texture(device, gpu_memory_allocator, texture_alloc_desc, texture_desc);
-
-					if (!debug_name.empty())
-					{
-						out_texture.set_name(debug_name.c_str());
-					}
-					//FCS TODO: END DUPLICATE CODE
+					//Data textures are linear, everything else is assumed to be sRGB color
+					const bool is_linear = usage == TextureUsage::MetallicRoughness || usage == TextureUsage::Mask;
+					with_format(is_linear ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
 
-					out_texture.upload_texture_data(device, gpu_memory_allocator, command_queue, required_components, image_data, image_width, image_height);
+					Texture out_texture = build_from_image(device, gpu_memory_allocator, command_queue, image_data, image_width, image_height, is_linear ? MipFormat::RGBA8_UNORM : MipFormat::RGBA8_SRGB,
+														   out_cache_path, cache_key);
 		
 					stbi_image_free(image_data);
 
@@ -480,16 +853,7 @@ struct TextureBuilder
 			}
 		}
 
-		//FCS TODO: BEGIN DUPLICATE CODE
-		Texture out_texture(device, gpu_memory_allocator, texture_alloc_desc, texture_desc);
-
-		if (!debug_name.empty())
-		{
-			out_texture.set_name(debug_name.c_str());
-		}
-		//FCS TODO: END DUPLICATE CODE
-
-		return out_texture; //FCS TODO: Unify returns
+		return create_texture(device, gpu_memory_allocator); //FCS TODO: Unify returns
 	}
 };
 
@@ -576,7 +940,7 @@ struct BindlessResourceManager
 		//Shared State
 		srv_desc.Format = in_texture.resource->GetDesc().Format;
 		srv_desc.ViewDimension = is_cubemap ? D3D12_SRV_DIMENSION_TEXTURECUBE : D3D12_SRV_DIMENSION_TEXTURE2D;
-		srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srv_desc.Shader4ComponentMapping = in_texture.shader_component_mapping;
 
 		if (is_cubemap)
 		{
@@ -8,13 +8,131 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <time.h>
+#include <math.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//SIMD: SSE2 is always available on x64, SSSE3, AVX2 and NEON are used when the compiler targets them. Define GLTF_DISABLE_SIMD to force scalar paths.
+#ifndef GLTF_DISABLE_SIMD
+    #if defined(__AVX2__)
+        #define GLTF_SIMD_AVX2 1
+        #include <immintrin.h>
+    #endif
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define GLTF_SIMD_SSE2 1
+        #include <emmintrin.h>
+    #endif
+    #if defined(__SSSE3__) || defined(__AVX__)
+        #define GLTF_SIMD_SSSE3 1
+        #include <tmmintrin.h>
+    #elif defined(_MSC_VER) && defined(_M_X64)
+        //MSVC emits SSSE3 intrinsics without /arch, so they are used after a cpuid check
+        #define GLTF_SIMD_SSSE3 1
+        #define GLTF_SIMD_SSSE3_RUNTIME_CHECK 1
+        #include <tmmintrin.h>
+    #endif
+    #if defined(__aarch64__) || defined(_M_ARM64)
+        #define GLTF_SIMD_NEON 1
+        #include <arm_neon.h>
+    #endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline uint32_t gltf_count_trailing_zeros64(uint64_t value) {
+    #ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (uint32_t) index;
+    #else
+    return (uint32_t) __builtin_ctzll(value);
+    #endif
+}
+
+static inline uint32_t gltf_popcount64(uint64_t value) {
+    #ifdef _MSC_VER
+    return (uint32_t) __popcnt64(value);
+    #else
+    return (uint32_t) __builtin_popcountll(value);
+    #endif
+}
 
 const uint32_t GLTF_MAGIC_NUMBER      = 0x46546C67;
 const uint32_t GLTF_CHUNK_TYPE_JSON   = 0x4E4F534A;
 const uint32_t GLTF_CHUNK_TYPE_BUFFER = 0x004E4942;
 
-const char* STRING_TRUE = "true";
-const char* STRING_FALSE = "false";
+//Arena allocator: every json node and string of an asset is carved out of a few large blocks that are released together
+typedef struct GltfArenaBlock {
+    struct GltfArenaBlock* next;
+    size_t capacity;
+    size_t used;
+} GltfArenaBlock;
+
+typedef struct GltfArena {
+    GltfArenaBlock* blocks;
+} GltfArena;
+
+const size_t GLTF_ARENA_BLOCK_SIZE = 256 * 1024;
+
+void* gltf_arena_alloc(GltfArena* arena, size_t size) {
+    size = (size + 7) & ~(size_t) 7;
+
+    GltfArenaBlock* head = arena->blocks;
+    if (head && head->capacity - head->used >= size) {
+        void* out_ptr = (uint8_t*) (head + 1) + head->used;
+        head->used += size;
+        return out_ptr;
+    }
+
+    //Large allocations get a dedicated block that is linked behind the head, so the head's free space isn't abandoned
+    const bool is_large = size > GLTF_ARENA_BLOCK_SIZE / 4;
+    const size_t capacity = is_large ? size : GLTF_ARENA_BLOCK_SIZE;
+    GltfArenaBlock* block = (GltfArenaBlock*) malloc(sizeof(GltfArenaBlock) + capacity);
+    if (!block) {
+        return NULL;
+    }
+    block->capacity = capacity;
+    block->used = size;
+
+    if (is_large && head) {
+        block->next = head->next;
+        head->next = block;
+    } else {
+        block->next = head;
+        arena->blocks = block;
+    }
+    return block + 1;
+}
+
+void gltf_arena_free(GltfArena* arena) {
+    GltfArenaBlock* block = arena->blocks;
+    while (block) {
+        GltfArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
+
+//Wall-clock time in seconds, used for load throughput stats
+double gltf_get_time_seconds() {
+    struct timespec time_spec;
+    timespec_get(&time_spec, TIME_UTC);
+    return (double) time_spec.tv_sec + (double) time_spec.tv_nsec * 1e-9;
+}
 
 typedef struct JsonObject {
     uint32_t count;
@@ -32,13 +150,21 @@ typedef enum JsonValueType {
     JSON_VALUE_TYPE_OBJECT,
     JSON_VALUE_TYPE_BOOLEAN,
     JSON_VALUE_TYPE_ARRAY,
+    JSON_VALUE_TYPE_NULL,
 } JsonValueType;
 
+//Integers are kept exactly, since glTF sizes and offsets can exceed the 53 bits a double holds exactly
+typedef struct JsonNumber {
+    double value;
+    int64_t integer; //Exact value when is_integer is set
+    bool is_integer; //No fraction or exponent, and fits in an int64_t
+} JsonNumber;
+
 typedef struct JsonValue {
     JsonValueType type;
     union {
         char* string;
-        float number;
+        JsonNumber number;
         JsonObject object;
         bool boolean;
         JsonArray array;
@@ -50,321 +176,1250 @@ typedef struct JsonKeyValuePair {
     JsonValue value;
 } JsonKeyValuePair;
 
-//returns true if char c exists in string str
-bool is_char_in_string(char c, const char* str) {
-    for (uint32_t i = 0; i < strlen(str); ++i) {
-        if (c == str[i]) {
-            return true;
-        }
+//Single pass, length-bounded parser. Nodes and strings are allocated from a GltfArena.
+//Children of arrays and objects are collected on scratch stacks and copied to the arena once their count is known,
+//so each node is allocated exactly once.
+typedef struct JsonParser {
+    const char* begin;
+    const char* cursor;
+    const char* end;
+    GltfArena* arena;
+
+    //Only used by the structural index parser (json_parse_indexed)
+    const uint32_t* structural_offsets;
+    uint32_t structural_count;
+    uint32_t structural_position;
+
+    //Set by the pull reader (json_reader_*) on malformed input
+    bool failed;
+
+    JsonValue* value_stack;
+    uint32_t value_stack_count;
+    uint32_t value_stack_capacity;
+
+    JsonKeyValuePair* pair_stack;
+    uint32_t pair_stack_count;
+    uint32_t pair_stack_capacity;
+} JsonParser;
+
+static inline bool json_is_whitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline void json_skip_whitespace(JsonParser* parser) {
+    while (parser->cursor < parser->end && json_is_whitespace(*parser->cursor)) {
+        parser->cursor++;
+    }
+}
+
+//Skips whitespace and attempts to consume char c
+static inline bool json_consume(JsonParser* parser, char c) {
+    json_skip_whitespace(parser);
+    if (parser->cursor < parser->end && *parser->cursor == c) {
+        parser->cursor++;
+        return true;
     }
     return false;
 }
 
-//can modify p_string, trims p_string of leading chars_to_trim
-int trim_characters(char** p_string, const char* chars_to_trim) {
-    uint32_t i = 0;
-    for (; i < strlen(*p_string); ++i) {
-        if (!is_char_in_string(*p_string[i], chars_to_trim)) {
-            *p_string = *p_string + i;
-            break;
+static bool json_push_value(JsonParser* parser, const JsonValue* value) {
+    if (parser->value_stack_count == parser->value_stack_capacity) {
+        const uint32_t new_capacity = parser->value_stack_capacity ? parser->value_stack_capacity * 2 : 64;
+        JsonValue* new_stack = (JsonValue*) realloc(parser->value_stack, sizeof(JsonValue) * new_capacity);
+        if (!new_stack) {
+            return false;
+        }
+        parser->value_stack = new_stack;
+        parser->value_stack_capacity = new_capacity;
+    }
+    parser->value_stack[parser->value_stack_count++] = *value;
+    return true;
+}
+
+static bool json_push_pair(JsonParser* parser, const JsonKeyValuePair* pair) {
+    if (parser->pair_stack_count == parser->pair_stack_capacity) {
+        const uint32_t new_capacity = parser->pair_stack_capacity ? parser->pair_stack_capacity * 2 : 64;
+        JsonKeyValuePair* new_stack = (JsonKeyValuePair*) realloc(parser->pair_stack, sizeof(JsonKeyValuePair) * new_capacity);
+        if (!new_stack) {
+            return false;
         }
+        parser->pair_stack = new_stack;
+        parser->pair_stack_capacity = new_capacity;
     }
-    return i;
+    parser->pair_stack[parser->pair_stack_count++] = *pair;
+    return true;
 }
 
-//can modify p_string, trims whitespace characters
-int trim_whitespace(char** p_string) {
-    return trim_characters(p_string, " \t\v\n\r\f");
+static inline int json_hex_digit(char c) {
+    if (c >= '0' && c <= '9') { return c - '0'; }
+    if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+    if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+    return -1;
 }
 
-//can modify p_string, trims whitespace and attempts to consume char c
-bool consume(char c, char** p_string) {
-    int chars_trimmed = trim_whitespace(p_string);
-    if (c == *p_string[0]) {
-        *p_string = *p_string + 1;
-        return true;
+static bool json_parse_hex4(const char* in_string, uint32_t* out_code_point) {
+    uint32_t code_point = 0;
+    for (int i = 0; i < 4; ++i) {
+        const int digit = json_hex_digit(in_string[i]);
+        if (digit < 0) {
+            return false;
+        }
+        code_point = (code_point << 4) | (uint32_t) digit;
     }
-    return false;
+    *out_code_point = code_point;
+    return true;
+}
+
+static char* json_write_utf8(char* out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        *out++ = (char) code_point;
+    } else if (code_point < 0x800) {
+        *out++ = (char) (0xC0 | (code_point >> 6));
+        *out++ = (char) (0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        *out++ = (char) (0xE0 | (code_point >> 12));
+        *out++ = (char) (0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = (char) (0x80 | (code_point & 0x3F));
+    } else {
+        *out++ = (char) (0xF0 | (code_point >> 18));
+        *out++ = (char) (0x80 | ((code_point >> 12) & 0x3F));
+        *out++ = (char) (0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = (char) (0x80 | (code_point & 0x3F));
+    }
+    return out;
+}
+
+//Unescapes the string contents [begin, end) into out_string (which must hold at least end - begin + 1 chars)
+static bool json_unescape_string(const char* begin, const char* end, char* out_string) {
+    char* out = out_string;
+    for (const char* p = begin; p < end; ++p) {
+        if (*p != '\\') {
+            *out++ = *p;
+            continue;
+        }
+
+        if (++p >= end) {
+            return false;
+        }
+
+        switch (*p) {
+            case '"':  *out++ = '"';  break;
+            case '\\': *out++ = '\\'; break;
+            case '/':  *out++ = '/';  break;
+            case 'b':  *out++ = '\b'; break;
+            case 'f':  *out++ = '\f'; break;
+            case 'n':  *out++ = '\n'; break;
+            case 'r':  *out++ = '\r'; break;
+            case 't':  *out++ = '\t'; break;
+            case 'u': {
+                uint32_t code_point = 0;
+                if (end - p < 5 || !json_parse_hex4(p + 1, &code_point)) {
+                    return false;
+                }
+                p += 4;
+
+                //Surrogate pair
+                if (code_point >= 0xD800 && code_point <= 0xDBFF && end - p >= 7 && p[1] == '\\' && p[2] == 'u') {
+                    uint32_t low_surrogate = 0;
+                    if (json_parse_hex4(p + 3, &low_surrogate) && low_surrogate >= 0xDC00 && low_surrogate <= 0xDFFF) {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                        p += 6;
+                    }
+                }
+                //Escaped UTF-8 is never longer than its escape sequence, so this can't overflow out_string
+                out = json_write_utf8(out, code_point);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    *out = '\0';
+    return true;
 }
 
-//Finds next occurrence of c in in_string
-int find_next(char c, char* in_string) {
-    for (uint32_t i = 0; i < strlen(in_string); ++i) {
-        if (c == in_string[i]) {
-            return i;
+//Copies the string contents [begin, end) into the arena, unescaping if necessary
+static char* json_arena_string(GltfArena* arena, const char* begin, const char* end, bool has_escapes) {
+    const size_t length = (size_t) (end - begin);
+    char* out_string = (char*) gltf_arena_alloc(arena, length + 1);
+    if (!out_string) {
+        return NULL;
+    }
+
+    if (has_escapes) {
+        if (!json_unescape_string(begin, end, out_string)) {
+            return NULL;
         }
+    } else {
+        memcpy(out_string, begin, length);
+        out_string[length] = '\0';
     }
-    return -1;
+    return out_string;
+}
+
+//Parses a quoted string at the cursor, returns an arena-allocated, null-terminated string
+static char* json_parse_string(JsonParser* parser) {
+    if (!json_consume(parser, '"')) {
+        return NULL;
+    }
+
+    const char* begin = parser->cursor;
+    const char* p = begin;
+    bool has_escapes = false;
+    while (p < parser->end && *p != '"') {
+        if (*p == '\\') {
+            has_escapes = true;
+            p++;
+        }
+        p++;
+    }
+
+    if (p >= parser->end) {
+        return NULL;
+    }
+
+    parser->cursor = p + 1;
+    return json_arena_string(parser->arena, begin, p, has_escapes);
 }
 
-//returns true if the next n-chars of in_string match identifier (n == strlen(identifier))
-bool string_check(const char* in_string, const char* identifier) {
-    for (int i = 0; i < strlen(identifier); ++i) {
-        if (i >= strlen(in_string) || in_string[i] != identifier[i]) {
+static inline bool json_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static const double JSON_EXACT_POWERS_OF_TEN[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+//Parses the json number at begin (bounded by end), returns the position after it in out_end.
+//Correctly rounded: mantissas that fit in 53 bits with |exponent| <= 22 are exact in double arithmetic (Clinger's fast path),
+//everything else falls back to strtod. Integers are also returned exactly in out_number->integer.
+static bool json_parse_number_span(const char* begin, const char* end, JsonNumber* out_number, const char** out_end) {
+    const char* p = begin;
+    const bool negative = p < end && *p == '-';
+    if (negative) {
+        p++;
+    }
+
+    if (p >= end || !json_is_digit(*p)) {
+        return false;
+    }
+
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+
+    //Integer part
+    for (; p < end && json_is_digit(*p); ++p) {
+        if (significant_digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+            significant_digits += mantissa != 0;
+        } else {
+            exponent++;
+            truncated = true;
+        }
+    }
+
+    //Up to 19 digits are accumulated exactly, int64_t covers magnitudes up to 2^63 - 1 (2^63 when negative)
+    bool is_integer = !truncated && mantissa <= (negative ? (1ULL << 63) : (uint64_t) INT64_MAX);
+
+    //Fraction
+    if (p < end && *p == '.') {
+        is_integer = false;
+        p++;
+        if (p >= end || !json_is_digit(*p)) {
+            return false;
+        }
+        for (; p < end && json_is_digit(*p); ++p) {
+            if (significant_digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+                significant_digits += mantissa != 0;
+                exponent--;
+            } else {
+                truncated = true;
+            }
+        }
+    }
+
+    //Exponent
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        is_integer = false;
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative_exponent = *p == '-';
+            p++;
+        }
+        if (p >= end || !json_is_digit(*p)) {
+            return false;
+        }
+        int explicit_exponent = 0;
+        for (; p < end && json_is_digit(*p); ++p) {
+            if (explicit_exponent < 100000) {
+                explicit_exponent = explicit_exponent * 10 + (*p - '0');
+            }
+        }
+        exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+    }
+
+    if (!truncated && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double) mantissa;
+        value = exponent < 0 ? value / JSON_EXACT_POWERS_OF_TEN[-exponent] : value * JSON_EXACT_POWERS_OF_TEN[exponent];
+        out_number->value = negative ? -value : value;
+    } else {
+        //The input isn't necessarily null-terminated, so strtod works on a copy
+        const size_t length = (size_t) (p - begin);
+        char local_string[128];
+        char* number_string = length < sizeof(local_string) ? local_string : (char*) malloc(length + 1);
+        if (!number_string) {
             return false;
         }
+        memcpy(number_string, begin, length);
+        number_string[length] = '\0';
+        out_number->value = strtod(number_string, NULL);
+        if (number_string != local_string) {
+            free(number_string);
+        }
+    }
+
+    out_number->is_integer = is_integer;
+    out_number->integer = !is_integer ? 0 : negative ? (int64_t) (0 - mantissa) : (int64_t) mantissa;
+
+    *out_end = p;
+    return true;
+}
+
+static bool json_parse_number(JsonParser* parser, JsonNumber* out_number) {
+    const char* number_end = NULL;
+    if (!json_parse_number_span(parser->cursor, parser->end, out_number, &number_end)) {
+        return false;
     }
+
+    parser->cursor = number_end;
     return true;
 }
 
-//can modify p_string, allocates and returns a new string
-char* parse_string(char** p_string) {
-    char** old_string = p_string;
-    bool found_leading_quote = consume('\"', p_string);
-    if (found_leading_quote) {
-        int key_length = find_next('\"', *p_string);
-        //FIXME: check for escape char before ending quote
-        if (key_length >= 0) {
-            char* parsed_string = (char*) calloc(key_length + 1, 1);
-            memcpy(parsed_string, *p_string, key_length);
-            *p_string = *p_string + key_length + 1;
-            return parsed_string;
+//Non-negative integer value of a number. Integral numbers written with a fraction or exponent are accepted while exact in a double.
+static bool json_number_as_uint64(const JsonNumber* number, uint64_t* out_int) {
+    if (number->is_integer) {
+        if (number->integer < 0) {
+            return false;
         }
+        *out_int = (uint64_t) number->integer;
+        return true;
     }
-    return NULL;
+    if (number->value >= 0.0 && number->value <= 9007199254740992.0 && number->value == (double) (uint64_t) number->value) {
+        *out_int = (uint64_t) number->value;
+        return true;
+    }
+    return false;
 }
 
-//Allocations: Parsed Strings, Arrays, JsonObject KeyValue pairs
+static inline bool json_consume_literal(JsonParser* parser, const char* literal, size_t literal_length) {
+    if ((size_t) (parser->end - parser->cursor) >= literal_length && memcmp(parser->cursor, literal, literal_length) == 0) {
+        parser->cursor += literal_length;
+        return true;
+    }
+    return false;
+}
 
-bool parse_json_object(char** json_string, JsonObject* out_json_object);
+static bool json_parse_object_internal(JsonParser* parser, JsonObject* out_json_object);
 
-bool parse_json_value(char** json_string, JsonValue* out_value) {
-    char* current_position = *json_string;
+static bool json_parse_value_internal(JsonParser* parser, JsonValue* out_value) {
+    json_skip_whitespace(parser);
+    if (parser->cursor >= parser->end) {
+        return false;
+    }
 
-    trim_whitespace(&current_position);
-    if (current_position[0] == '{') {
+    const char c = *parser->cursor;
+    if (c == '{') {
         out_value->type = JSON_VALUE_TYPE_OBJECT;
-        parse_json_object(&current_position, &out_value->data.object);
+        return json_parse_object_internal(parser, &out_value->data.object);
     }
-    else if (current_position[0] == '"') {
+    else if (c == '"') {
         out_value->type = JSON_VALUE_TYPE_STRING;
-        out_value->data.string = parse_string(&current_position);
+        out_value->data.string = json_parse_string(parser);
+        return out_value->data.string != NULL;
     }
-    else if (isdigit(current_position[0]) || current_position[0] == '-') {
-        char* end_ptr = NULL;
+    else if (c == '-' || (c >= '0' && c <= '9')) {
         out_value->type = JSON_VALUE_TYPE_NUMBER;
-        out_value->data.number = strtof(current_position, &end_ptr);
-        if (current_position != end_ptr) {
-            current_position = end_ptr;
-        }
+        return json_parse_number(parser, &out_value->data.number);
     }
-    else if (current_position[0] == '[') {
+    else if (c == '[') {
+        parser->cursor++;
         out_value->type = JSON_VALUE_TYPE_ARRAY;
         out_value->data.array.count = 0;
         out_value->data.array.values = NULL;
-        consume('[', &current_position);
 
-        //TODO: check for closing brace here to support empty arrays
+        //Empty array
+        if (json_consume(parser, ']')) {
+            return true;
+        }
 
+        const uint32_t stack_base = parser->value_stack_count;
         do {
-            out_value->data.array.count += 1;
-            out_value->data.array.values = (JsonValue*) realloc(out_value->data.array.values, sizeof(JsonValue) * out_value->data.array.count);
-            JsonValue* array_value = &out_value->data.array.values[out_value->data.array.count - 1];
-            memset(array_value, 0, sizeof(JsonValue));
-            if (!parse_json_value(&current_position, array_value))
-            {
+            JsonValue array_value;
+            memset(&array_value, 0, sizeof(JsonValue));
+            if (!json_parse_value_internal(parser, &array_value) || !json_push_value(parser, &array_value)) {
                 return false;
             }
+        } while (json_consume(parser, ','));
+
+        if (!json_consume(parser, ']')) {
+            return false;
+        }
+
+        const uint32_t count = parser->value_stack_count - stack_base;
+        JsonValue* values = (JsonValue*) gltf_arena_alloc(parser->arena, sizeof(JsonValue) * count);
+        if (!values) {
+            return false;
+        }
+        memcpy(values, &parser->value_stack[stack_base], sizeof(JsonValue) * count);
+        parser->value_stack_count = stack_base;
 
-        } while(consume(',', &current_position));
-        consume(']', &current_position);
+        out_value->data.array.count = count;
+        out_value->data.array.values = values;
+        return true;
     }
-    else if (string_check(current_position, STRING_TRUE)) {
+    else if (json_consume_literal(parser, "true", 4)) {
         out_value->type = JSON_VALUE_TYPE_BOOLEAN;
         out_value->data.boolean = true;
-        current_position += strlen(STRING_TRUE);
+        return true;
     }
-    else if (string_check(current_position, STRING_FALSE)) {
+    else if (json_consume_literal(parser, "false", 5)) {
         out_value->type = JSON_VALUE_TYPE_BOOLEAN;
         out_value->data.boolean = false;
-        current_position += strlen(STRING_FALSE);
+        return true;
+    }
+    else if (json_consume_literal(parser, "null", 4)) {
+        out_value->type = JSON_VALUE_TYPE_NULL;
+        return true;
     }
 
-    *json_string = current_position;
-    return true;
+    return false;
 }
 
-//Modifies json_string (necessary for recursion)
-bool parse_json_object(char** json_string, JsonObject* out_json_object) {
-    char* current_position = *json_string;
+static bool json_parse_object_internal(JsonParser* parser, JsonObject* out_json_object) {
+    out_json_object->count = 0;
+    out_json_object->key_value_pairs = NULL;
+
     //Consume leading whitespace and '{'
-    if (!consume('{', &current_position))
-    {
+    if (!json_consume(parser, '{')) {
         return false;
     }
 
     //Check for empty object
-    if (consume('}', &current_position))
-    {
-        *json_string = current_position;
+    if (json_consume(parser, '}')) {
         return true;
     }
 
     //Iterate over key/value pairs
-    out_json_object->count = 0;
-    out_json_object->key_value_pairs = NULL;
+    const uint32_t stack_base = parser->pair_stack_count;
     do {
-        out_json_object->count += 1;
-        out_json_object->key_value_pairs = (JsonKeyValuePair*) realloc(out_json_object->key_value_pairs, sizeof(JsonKeyValuePair) * out_json_object->count);
-        JsonKeyValuePair* key_value = &out_json_object->key_value_pairs[out_json_object->count - 1];
-        memset(key_value, 0, sizeof(JsonKeyValuePair));
+        JsonKeyValuePair key_value;
+        memset(&key_value, 0, sizeof(JsonKeyValuePair));
 
-        //Key (string)
-        key_value->key = parse_string(&current_position);
-        if (key_value->key == NULL)
-        {
-            return false; //FIXME: DamagedHelmet failing here
-        }
-        
-        if (!consume(':', &current_position))
-        {
+        key_value.key = json_parse_string(parser);
+        if (key_value.key == NULL || !json_consume(parser, ':')) {
             return false;
         }
-        if (!parse_json_value(&current_position, &key_value->value))
-        {
+
+        if (!json_parse_value_internal(parser, &key_value.value) || !json_push_pair(parser, &key_value)) {
             return false;
         }
-
-    } while (consume(',', &current_position));
+    } while (json_consume(parser, ','));
 
     //Consume final closing bracket
-    if (!consume('}', &current_position))
-    {
+    if (!json_consume(parser, '}')) {
         return false;
     }
 
-    *json_string = current_position;
+    const uint32_t count = parser->pair_stack_count - stack_base;
+    JsonKeyValuePair* key_value_pairs = (JsonKeyValuePair*) gltf_arena_alloc(parser->arena, sizeof(JsonKeyValuePair) * count);
+    if (!key_value_pairs) {
+        return false;
+    }
+    memcpy(key_value_pairs, &parser->pair_stack[stack_base], sizeof(JsonKeyValuePair) * count);
+    parser->pair_stack_count = stack_base;
+
+    out_json_object->count = count;
+    out_json_object->key_value_pairs = key_value_pairs;
     return true;
 }
 
-bool json_value_as_float(const JsonValue* value, float* out_float) {
-    if (value && value->type == JSON_VALUE_TYPE_NUMBER && out_float) {
-        *out_float = value->data.number;
-        return true;
-    }
-    return false;
+//Parses json_length bytes of json_string (which doesn't need to be null-terminated) into out_json_object.
+//All nodes and strings are allocated from arena, and are released with gltf_arena_free.
+bool json_parse(const char* json_string, size_t json_length, GltfArena* arena, JsonObject* out_json_object) {
+    JsonParser parser;
+    memset(&parser, 0, sizeof(JsonParser));
+    parser.begin = json_string;
+    parser.cursor = json_string;
+    parser.end = json_string + json_length;
+    parser.arena = arena;
+
+    const bool succeeded = json_parse_object_internal(&parser, out_json_object);
+
+    free(parser.value_stack);
+    free(parser.pair_stack);
+    return succeeded;
 }
 
-bool json_value_as_int32(const JsonValue* value, int32_t* out_int) {
-    if (value && value->type == JSON_VALUE_TYPE_NUMBER && out_int) {
-        *out_int = (int32_t) value->data.number;
-        return true;
+//Two-stage parser: stage one finds the offset of every structural character ({}[]:, and string quotes) plus the first character
+//of every number/literal, 64 bytes at a time with SIMD. Stage two builds the same JsonObject tree by walking that index,
+//so it never looks at bytes inside strings or between tokens.
+
+//Bitmasks for one 64 byte block, bit i corresponds to byte i
+typedef struct JsonBlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;         //{}[]:,
+    uint64_t whitespace;
+} JsonBlockMasks;
+
+#if GLTF_SIMD_NEON
+static inline uint64_t json_neon_movemask(uint8x16_t in_mask) {
+    const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t masked = vandq_u8(in_mask, vld1q_u8(bits));
+    return (uint64_t) vaddv_u8(vget_low_u8(masked)) | ((uint64_t) vaddv_u8(vget_high_u8(masked)) << 8);
+}
+#endif
+
+static inline void json_classify_block(const uint8_t* block, JsonBlockMasks* out_masks) {
+    memset(out_masks, 0, sizeof(JsonBlockMasks));
+
+    #if GLTF_SIMD_AVX2
+    //'[' | 0x20 == '{' and ']' | 0x20 == '}', so two compares cover all brackets
+    const __m256i lower_case_bit = _mm256_set1_epi8(0x20);
+    for (uint32_t i = 0; i < 64; i += 32) {
+        const __m256i chars = _mm256_loadu_si256((const __m256i*) (block + i));
+        const __m256i folded = _mm256_or_si256(chars, lower_case_bit);
+
+        const __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(','))));
+        const __m256i whitespace = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t'))));
+
+        out_masks->quote      |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('"'))) << i;
+        out_masks->backslash  |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\\'))) << i;
+        out_masks->op         |= (uint64_t) (uint32_t) _mm256_movemask_epi8(op) << i;
+        out_masks->whitespace |= (uint64_t) (uint32_t) _mm256_movemask_epi8(whitespace) << i;
     }
-    return false;
+    #elif GLTF_SIMD_SSE2
+    const __m128i lower_case_bit = _mm_set1_epi8(0x20);
+    for (uint32_t i = 0; i < 64; i += 16) {
+        const __m128i chars = _mm_loadu_si128((const __m128i*) (block + i));
+        const __m128i folded = _mm_or_si128(chars, lower_case_bit);
+
+        const __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chars, _mm_set1_epi8(','))));
+        const __m128i whitespace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))));
+
+        out_masks->quote      |= (uint64_t) (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"'))) << i;
+        out_masks->backslash  |= (uint64_t) (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'))) << i;
+        out_masks->op         |= (uint64_t) (uint32_t) _mm_movemask_epi8(op) << i;
+        out_masks->whitespace |= (uint64_t) (uint32_t) _mm_movemask_epi8(whitespace) << i;
+    }
+    #elif GLTF_SIMD_NEON
+    const uint8x16_t lower_case_bit = vdupq_n_u8(0x20);
+    for (uint32_t i = 0; i < 64; i += 16) {
+        const uint8x16_t chars = vld1q_u8(block + i);
+        const uint8x16_t folded = vorrq_u8(chars, lower_case_bit);
+
+        const uint8x16_t op = vorrq_u8(
+            vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')), vceqq_u8(folded, vdupq_n_u8('}'))),
+            vorrq_u8(vceqq_u8(chars, vdupq_n_u8(':')), vceqq_u8(chars, vdupq_n_u8(','))));
+        const uint8x16_t whitespace = vorrq_u8(
+            vorrq_u8(vceqq_u8(chars, vdupq_n_u8(' ')), vceqq_u8(chars, vdupq_n_u8('\n'))),
+            vorrq_u8(vceqq_u8(chars, vdupq_n_u8('\r')), vceqq_u8(chars, vdupq_n_u8('\t'))));
+
+        out_masks->quote      |= json_neon_movemask(vceqq_u8(chars, vdupq_n_u8('"'))) << i;
+        out_masks->backslash  |= json_neon_movemask(vceqq_u8(chars, vdupq_n_u8('\\'))) << i;
+        out_masks->op         |= json_neon_movemask(op) << i;
+        out_masks->whitespace |= json_neon_movemask(whitespace) << i;
+    }
+    #else
+    for (uint32_t i = 0; i < 64; ++i) {
+        const uint8_t c = block[i];
+        const uint64_t bit = 1ULL << i;
+        const uint8_t folded = c | 0x20;
+        if (c == '"')                                                      { out_masks->quote |= bit; }
+        else if (c == '\\')                                                { out_masks->backslash |= bit; }
+        else if (folded == '{' || folded == '}' || c == ':' || c == ',')   { out_masks->op |= bit; }
+        else if (c == ' ' || c == '\n' || c == '\r' || c == '\t')          { out_masks->whitespace |= bit; }
+    }
+    #endif
 }
 
-bool json_value_as_uint32(const JsonValue* value, uint32_t* out_int) {
-    if (value && value->type == JSON_VALUE_TYPE_NUMBER && out_int) {
-        *out_int = (uint32_t) value->data.number;
-        return true;
-    }
-    return false;
+//Bit i of the result is the xor of bits [0, i] of the input
+static inline uint64_t json_prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
 }
 
-bool json_value_as_bool(const JsonValue* value, bool* out_bool) {
-    if (value && value->type == JSON_VALUE_TYPE_BOOLEAN && out_bool) {
-        *out_bool = value->data.boolean;
-        return true;
+typedef struct JsonStructuralIndex {
+    uint32_t* offsets;
+    uint32_t count;
+    uint32_t capacity;
+} JsonStructuralIndex;
+
+//Stage one: fills out_index with the byte offset of each structural character. Returns false on unterminated strings.
+bool json_build_structural_index(const char* json_string, size_t json_length, JsonStructuralIndex* out_index) {
+    memset(out_index, 0, sizeof(JsonStructuralIndex));
+    if (json_length >= UINT32_MAX) {
+        return false;
     }
-    return false;
-}
 
-bool json_value_as_string(const JsonValue* value, const char** out_string) {
-    if (value && value->type == JSON_VALUE_TYPE_STRING && out_string) {
-        *out_string = value->data.string;
-        return true;
+    uint64_t prev_escaped = 0;   //1 if the first byte of the next block is escaped
+    uint64_t prev_in_string = 0; //all ones if the previous block ended inside a string
+    uint64_t prev_atom = 0;      //1 if the previous block ended in the middle of a number/literal
+
+    for (size_t block_offset = 0; block_offset < json_length; block_offset += 64) {
+        //The last partial block is padded with whitespace
+        uint8_t padded_block[64];
+        const uint8_t* block = (const uint8_t*) json_string + block_offset;
+        if (json_length - block_offset < 64) {
+            memset(padded_block, ' ', sizeof(padded_block));
+            memcpy(padded_block, block, json_length - block_offset);
+            block = padded_block;
+        }
+
+        JsonBlockMasks masks;
+        json_classify_block(block, &masks);
+
+        //Backslashes are rare in glTF, so escapes are resolved one backslash at a time
+        uint64_t escaped = prev_escaped;
+        prev_escaped = 0;
+        for (uint64_t backslash = masks.backslash & ~escaped; backslash != 0; backslash &= backslash - 1) {
+            const uint32_t bit_index = gltf_count_trailing_zeros64(backslash);
+            if (escaped & (1ULL << bit_index)) {
+                continue;
+            }
+            if (bit_index == 63) {
+                prev_escaped = 1;
+            } else {
+                escaped |= 1ULL << (bit_index + 1);
+            }
+        }
+
+        //in_string covers opening quotes and string contents, but not closing quotes
+        const uint64_t quotes = masks.quote & ~escaped;
+        const uint64_t in_string = json_prefix_xor(quotes) ^ prev_in_string;
+        prev_in_string = (uint64_t) ((int64_t) in_string >> 63);
+
+        //Numbers and literals: anything outside strings that isn't whitespace or an operator. Only their first byte is indexed.
+        const uint64_t atom = ~(masks.op | masks.whitespace | quotes | in_string);
+        const uint64_t atom_start = atom & ~((atom << 1) | prev_atom);
+        prev_atom = atom >> 63;
+
+        uint64_t structurals = (masks.op & ~in_string) | quotes | atom_start;
+
+        //Make sure a full block of entries fits before flattening the bits
+        const uint32_t block_count = gltf_popcount64(structurals);
+        if (out_index->count + block_count > out_index->capacity) {
+            uint32_t new_capacity = out_index->capacity ? out_index->capacity * 2 : (uint32_t) (json_length / 8 + 64);
+            while (new_capacity < out_index->count + block_count) {
+                new_capacity *= 2;
+            }
+            uint32_t* new_offsets = (uint32_t*) realloc(out_index->offsets, sizeof(uint32_t) * new_capacity);
+            if (!new_offsets) {
+                free(out_index->offsets);
+                memset(out_index, 0, sizeof(JsonStructuralIndex));
+                return false;
+            }
+            out_index->offsets = new_offsets;
+            out_index->capacity = new_capacity;
+        }
+
+        uint32_t* out_offsets = out_index->offsets + out_index->count;
+        for (; structurals != 0; structurals &= structurals - 1) {
+            *out_offsets++ = (uint32_t) block_offset + gltf_count_trailing_zeros64(structurals);
+        }
+        out_index->count += block_count;
     }
-    return false;
+
+    return prev_in_string == 0;
 }
 
-bool json_value_as_array(const JsonValue* value, const JsonArray** out_array) {
-    if (value && value->type == JSON_VALUE_TYPE_ARRAY) {
-        *out_array = &value->data.array;
-        return true;
-    }
-    return false;
+void json_free_structural_index(JsonStructuralIndex* index) {
+    free(index->offsets);
+    memset(index, 0, sizeof(JsonStructuralIndex));
 }
 
-bool json_value_as_object(const JsonValue* value, const JsonObject** out_object) {
-    if (value && value->type == JSON_VALUE_TYPE_OBJECT) {
-        *out_object = &value->data.object;
+static inline char json_indexed_peek(const JsonParser* parser) {
+    return parser->structural_position < parser->structural_count ? parser->begin[parser->structural_offsets[parser->structural_position]] : '\0';
+}
+
+static inline bool json_indexed_consume(JsonParser* parser, char c) {
+    if (json_indexed_peek(parser) == c) {
+        parser->structural_position++;
         return true;
     }
     return false;
 }
 
-const JsonValue* json_object_get_value(const JsonObject* object, const char* key) {
-    for (uint32_t i = 0; i < object->count; ++i) {
-        JsonKeyValuePair* key_value = &object->key_value_pairs[i];
-        if (strcmp(key_value->key, key) == 0) {
-            return &key_value->value;
-        }
+//The string's opening quote is at the current position and its closing quote is always the next entry
+static char* json_indexed_parse_string(JsonParser* parser) {
+    if (json_indexed_peek(parser) != '"' || parser->structural_position + 1 >= parser->structural_count) {
+        return NULL;
     }
-    return NULL;
+
+    const char* begin = parser->begin + parser->structural_offsets[parser->structural_position] + 1;
+    const char* end = parser->begin + parser->structural_offsets[parser->structural_position + 1];
+    parser->structural_position += 2;
+
+    const bool has_escapes = memchr(begin, '\\', (size_t) (end - begin)) != NULL;
+    return json_arena_string(parser->arena, begin, end, has_escapes);
 }
 
-const JsonValue* json_array_get_value(const JsonArray* array, uint32_t index) {
-    if (index < array->count) {
-        return &array->values[index];
+static bool json_indexed_parse_object(JsonParser* parser, JsonObject* out_json_object);
+
+static bool json_indexed_parse_value(JsonParser* parser, JsonValue* out_value) {
+    if (parser->structural_position >= parser->structural_count) {
+        return false;
     }
-    return NULL;
-}
 
-//Convenience Functions Below
-// the JsonObject and JsonArray getters return pointers
-// TODO: the other value getters return true on success and set the output via an argument
+    const char* token = parser->begin + parser->structural_offsets[parser->structural_position];
+    switch (*token) {
+        case '{':
+            out_value->type = JSON_VALUE_TYPE_OBJECT;
+            return json_indexed_parse_object(parser, &out_value->data.object);
+        case '"':
+            out_value->type = JSON_VALUE_TYPE_STRING;
+            out_value->data.string = json_indexed_parse_string(parser);
+            return out_value->data.string != NULL;
+        case '[': {
+            parser->structural_position++;
+            out_value->type = JSON_VALUE_TYPE_ARRAY;
+            out_value->data.array.count = 0;
+            out_value->data.array.values = NULL;
+
+            //Empty array
+            if (json_indexed_consume(parser, ']')) {
+                return true;
+            }
 
-const JsonObject* json_object_get_object(const JsonObject* object, const char* key) {
-    const JsonObject* out_object = NULL;
-    json_value_as_object(json_object_get_value(object, key), &out_object);
-    return out_object;
-}
+            const uint32_t stack_base = parser->value_stack_count;
+            do {
+                JsonValue array_value;
+                memset(&array_value, 0, sizeof(JsonValue));
+                if (!json_indexed_parse_value(parser, &array_value) || !json_push_value(parser, &array_value)) {
+                    return false;
+                }
+            } while (json_indexed_consume(parser, ','));
 
-const JsonArray* json_object_get_array(const JsonObject* object, const char* key) {
-    const JsonArray* out_array = NULL;
-    json_value_as_array(json_object_get_value(object, key), &out_array);
-    return out_array;
-}
+            if (!json_indexed_consume(parser, ']')) {
+                return false;
+            }
 
-const JsonObject* json_array_get_object(const JsonArray* array, uint32_t index) {
-    const JsonObject* out_object = NULL;
-    json_value_as_object(json_array_get_value(array, index), &out_object);
-    return out_object;
+            const uint32_t count = parser->value_stack_count - stack_base;
+            JsonValue* values = (JsonValue*) gltf_arena_alloc(parser->arena, sizeof(JsonValue) * count);
+            if (!values) {
+                return false;
+            }
+            memcpy(values, &parser->value_stack[stack_base], sizeof(JsonValue) * count);
+            parser->value_stack_count = stack_base;
+
+            out_value->data.array.count = count;
+            out_value->data.array.values = values;
+            return true;
+        }
+        default:
+            break;
+    }
+
+    //Number or literal, which must end before the next structural character
+    parser->structural_position++;
+    const char* token_end = parser->structural_position < parser->structural_count
+        ? parser->begin + parser->structural_offsets[parser->structural_position]
+        : parser->end;
+
+    const char* atom_end = NULL;
+    if (*token == '-' || json_is_digit(*token)) {
+        if (!json_parse_number_span(token, token_end, &out_value->data.number, &atom_end)) {
+            return false;
+        }
+        out_value->type = JSON_VALUE_TYPE_NUMBER;
+    } else if (token_end - token >= 4 && memcmp(token, "true", 4) == 0) {
+        out_value->type = JSON_VALUE_TYPE_BOOLEAN;
+        out_value->data.boolean = true;
+        atom_end = token + 4;
+    } else if (token_end - token >= 5 && memcmp(token, "false", 5) == 0) {
+        out_value->type = JSON_VALUE_TYPE_BOOLEAN;
+        out_value->data.boolean = false;
+        atom_end = token + 5;
+    } else if (token_end - token >= 4 && memcmp(token, "null", 4) == 0) {
+        out_value->type = JSON_VALUE_TYPE_NULL;
+        atom_end = token + 4;
+    } else {
+        return false;
+    }
+
+    //Only whitespace may follow the atom
+    for (; atom_end < token_end; ++atom_end) {
+        if (!json_is_whitespace(*atom_end)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-const JsonArray* json_array_get_array(const JsonArray* array, uint32_t index) {
-    const JsonArray* out_array = NULL;
-    json_value_as_array(json_array_get_value(array, index), &out_array);
-    return out_array;
+static bool json_indexed_parse_object(JsonParser* parser, JsonObject* out_json_object) {
+    out_json_object->count = 0;
+    out_json_object->key_value_pairs = NULL;
+
+    if (!json_indexed_consume(parser, '{')) {
+        return false;
+    }
+
+    //Check for empty object
+    if (json_indexed_consume(parser, '}')) {
+        return true;
+    }
+
+    const uint32_t stack_base = parser->pair_stack_count;
+    do {
+        JsonKeyValuePair key_value;
+        memset(&key_value, 0, sizeof(JsonKeyValuePair));
+
+        key_value.key = json_indexed_parse_string(parser);
+        if (key_value.key == NULL || !json_indexed_consume(parser, ':')) {
+            return false;
+        }
+
+        if (!json_indexed_parse_value(parser, &key_value.value) || !json_push_pair(parser, &key_value)) {
+            return false;
+        }
+    } while (json_indexed_consume(parser, ','));
+
+    if (!json_indexed_consume(parser, '}')) {
+        return false;
+    }
+
+    const uint32_t count = parser->pair_stack_count - stack_base;
+    JsonKeyValuePair* key_value_pairs = (JsonKeyValuePair*) gltf_arena_alloc(parser->arena, sizeof(JsonKeyValuePair) * count);
+    if (!key_value_pairs) {
+        return false;
+    }
+    memcpy(key_value_pairs, &parser->pair_stack[stack_base], sizeof(JsonKeyValuePair) * count);
+    parser->pair_stack_count = stack_base;
+
+    out_json_object->count = count;
+    out_json_object->key_value_pairs = key_value_pairs;
+    return true;
 }
 
-void free_json_object(JsonObject* in_object);
+//Same result as json_parse, using the two-stage structural index parser
+bool json_parse_indexed(const char* json_string, size_t json_length, GltfArena* arena, JsonObject* out_json_object) {
+    JsonStructuralIndex structural_index;
+    if (!json_build_structural_index(json_string, json_length, &structural_index)) {
+        return false;
+    }
 
-void free_json_value(JsonValue* in_value) {
-    switch(in_value->type) {
-        case JSON_VALUE_TYPE_OBJECT:
-            free_json_object(&in_value->data.object);
-            break;
-        case JSON_VALUE_TYPE_ARRAY:
-            for (uint32_t i = 0; i < in_value->data.array.count; ++i) {
-                free_json_value(&in_value->data.array.values[i]);
+    JsonParser parser;
+    memset(&parser, 0, sizeof(JsonParser));
+    parser.begin = json_string;
+    parser.cursor = json_string;
+    parser.end = json_string + json_length;
+    parser.arena = arena;
+    parser.structural_offsets = structural_index.offsets;
+    parser.structural_count = structural_index.count;
+
+    //Like json_parse, anything after the root object (e.g. chunk padding) is ignored
+    const bool succeeded = json_indexed_parse_object(&parser, out_json_object);
+
+    free(parser.value_stack);
+    free(parser.pair_stack);
+    json_free_structural_index(&structural_index);
+    return succeeded;
+}
+
+//Pull reader: walks a document token by token without building a JsonObject tree. Used by the glTF loader to fill its structs directly.
+//Works on raw text, or on a structural index when parser->structural_offsets is set.
+//Iteration functions return false at the end of an object/array, and set parser->failed if the json was malformed.
+
+typedef struct JsonStringSpan {
+    const char* begin;
+    const char* end;
+    bool has_escapes;
+} JsonStringSpan;
+
+static inline char json_reader_peek(JsonParser* parser) {
+    if (parser->structural_offsets) {
+        return json_indexed_peek(parser);
+    }
+    json_skip_whitespace(parser);
+    return parser->cursor < parser->end ? *parser->cursor : '\0';
+}
+
+static inline bool json_reader_consume(JsonParser* parser, char c) {
+    return parser->structural_offsets ? json_indexed_consume(parser, c) : json_consume(parser, c);
+}
+
+//Reads a string without copying it. Spans point into the json text, escapes are left as-is.
+static bool json_reader_string_span(JsonParser* parser, JsonStringSpan* out_span) {
+    if (parser->structural_offsets) {
+        if (json_indexed_peek(parser) != '"' || parser->structural_position + 1 >= parser->structural_count) {
+            return false;
+        }
+        out_span->begin = parser->begin + parser->structural_offsets[parser->structural_position] + 1;
+        out_span->end = parser->begin + parser->structural_offsets[parser->structural_position + 1];
+        out_span->has_escapes = memchr(out_span->begin, '\\', (size_t) (out_span->end - out_span->begin)) != NULL;
+        parser->structural_position += 2;
+        return true;
+    }
+
+    if (!json_consume(parser, '"')) {
+        return false;
+    }
+
+    const char* p = parser->cursor;
+    out_span->begin = p;
+    out_span->has_escapes = false;
+    while (p < parser->end && *p != '"') {
+        if (*p == '\\') {
+            out_span->has_escapes = true;
+            p++;
+        }
+        p++;
+    }
+    if (p >= parser->end) {
+        return false;
+    }
+
+    out_span->end = p;
+    parser->cursor = p + 1;
+    return true;
+}
+
+//Keys with escape sequences never match. glTF keys are plain ASCII.
+static inline bool json_span_equals(const JsonStringSpan* span, const char* literal) {
+    const size_t length = strlen(literal);
+    return !span->has_escapes && (size_t) (span->end - span->begin) == length && memcmp(span->begin, literal, length) == 0;
+}
+
+//Numbers and literals: out_limit is how far the token may extend
+static bool json_reader_atom_begin(JsonParser* parser, const char** out_begin, const char** out_limit) {
+    if (parser->structural_offsets) {
+        if (parser->structural_position >= parser->structural_count) {
+            return false;
+        }
+        *out_begin = parser->begin + parser->structural_offsets[parser->structural_position++];
+        *out_limit = parser->structural_position < parser->structural_count
+            ? parser->begin + parser->structural_offsets[parser->structural_position]
+            : parser->end;
+        return true;
+    }
+
+    json_skip_whitespace(parser);
+    *out_begin = parser->cursor;
+    *out_limit = parser->end;
+    return true;
+}
+
+static bool json_reader_atom_end(JsonParser* parser, const char* atom_end, const char* limit) {
+    if (parser->structural_offsets) {
+        for (; atom_end < limit; ++atom_end) {
+            if (!json_is_whitespace(*atom_end)) {
+                return false;
             }
-            free(in_value->data.array.values);
-            break;
-        case JSON_VALUE_TYPE_STRING:
-            free(in_value->data.string);
-            break;
-        default: 
-            break;
+        }
+        return true;
     }
+    parser->cursor = atom_end;
+    return true;
 }
 
-void free_json_object(JsonObject* in_object) {
-    for (uint32_t i = 0; i < in_object->count; ++i) {
-        JsonKeyValuePair* key_value = &in_object->key_value_pairs[i];
-        free_json_value(&key_value->value);
+static bool json_reader_number(JsonParser* parser, JsonNumber* out_number) {
+    const char* begin = NULL;
+    const char* limit = NULL;
+    const char* number_end = NULL;
+    return json_reader_atom_begin(parser, &begin, &limit)
+        && json_parse_number_span(begin, limit, out_number, &number_end)
+        && json_reader_atom_end(parser, number_end, limit);
+}
+
+static bool json_reader_float(JsonParser* parser, float* out_float) {
+    JsonNumber number;
+    if (!json_reader_number(parser, &number)) {
+        return false;
+    }
+    *out_float = (float) number.value;
+    return true;
+}
+
+static bool json_reader_uint64(JsonParser* parser, uint64_t* out_int) {
+    JsonNumber number;
+    return json_reader_number(parser, &number) && json_number_as_uint64(&number, out_int);
+}
+
+static bool json_reader_uint32(JsonParser* parser, uint32_t* out_int) {
+    uint64_t number = 0;
+    if (!json_reader_uint64(parser, &number) || number > UINT32_MAX) {
+        return false;
+    }
+    *out_int = (uint32_t) number;
+    return true;
+}
+
+static bool json_reader_literal(JsonParser* parser, const char* literal) {
+    const char* begin = NULL;
+    const char* limit = NULL;
+    const size_t length = strlen(literal);
+    return json_reader_atom_begin(parser, &begin, &limit)
+        && (size_t) (limit - begin) >= length
+        && memcmp(begin, literal, length) == 0
+        && json_reader_atom_end(parser, begin + length, limit);
+}
+
+static bool json_reader_bool(JsonParser* parser, bool* out_bool) {
+    if (json_reader_peek(parser) == 't') {
+        *out_bool = true;
+        return json_reader_literal(parser, "true");
+    }
+    *out_bool = false;
+    return json_reader_literal(parser, "false");
+}
+
+//Copies a string value into the parser's arena
+static char* json_reader_string(JsonParser* parser) {
+    JsonStringSpan span;
+    if (!json_reader_string_span(parser, &span)) {
+        return NULL;
+    }
+    return json_arena_string(parser->arena, span.begin, span.end, span.has_escapes);
+}
+
+//Call with *io_member_count = 0 to start an object. Returns true with the next key (the caller then reads or skips its value),
+//or false once the object is closed.
+static bool json_reader_next_key(JsonParser* parser, uint32_t* io_member_count, JsonStringSpan* out_key) {
+    if (*io_member_count == 0) {
+        if (!json_reader_consume(parser, '{')) {
+            parser->failed = true;
+            return false;
+        }
+        if (json_reader_consume(parser, '}')) {
+            return false;
+        }
+    } else if (!json_reader_consume(parser, ',')) {
+        if (!json_reader_consume(parser, '}')) {
+            parser->failed = true;
+        }
+        return false;
+    }
+
+    if (!json_reader_string_span(parser, out_key) || !json_reader_consume(parser, ':')) {
+        parser->failed = true;
+        return false;
+    }
+    (*io_member_count)++;
+    return true;
+}
+
+//Call with *io_element_count = 0 to start an array. Returns true when another element follows (the caller then reads or skips it),
+//or false once the array is closed.
+static bool json_reader_next_element(JsonParser* parser, uint32_t* io_element_count) {
+    if (*io_element_count == 0) {
+        if (!json_reader_consume(parser, '[')) {
+            parser->failed = true;
+            return false;
+        }
+        if (json_reader_consume(parser, ']')) {
+            return false;
+        }
+    } else if (!json_reader_consume(parser, ',')) {
+        if (!json_reader_consume(parser, ']')) {
+            parser->failed = true;
+        }
+        return false;
+    }
+
+    (*io_element_count)++;
+    return true;
+}
+
+static bool json_reader_skip_value(JsonParser* parser) {
+    const char c = json_reader_peek(parser);
+
+    //With an index, brackets inside strings aren't structural, so a container is skipped by matching brackets alone
+    if (parser->structural_offsets && (c == '{' || c == '[')) {
+        uint32_t depth = 0;
+        do {
+            if (parser->structural_position >= parser->structural_count) {
+                return false;
+            }
+            const char token = parser->begin[parser->structural_offsets[parser->structural_position++]];
+            depth += token == '{' || token == '[';
+            depth -= token == '}' || token == ']';
+        } while (depth > 0);
+        return true;
     }
-    free(in_object->key_value_pairs);
+
+    switch (c) {
+        case '{': {
+            uint32_t member_count = 0;
+            JsonStringSpan key;
+            while (json_reader_next_key(parser, &member_count, &key)) {
+                if (!json_reader_skip_value(parser)) {
+                    return false;
+                }
+            }
+            return !parser->failed;
+        }
+        case '[': {
+            uint32_t element_count = 0;
+            while (json_reader_next_element(parser, &element_count)) {
+                if (!json_reader_skip_value(parser)) {
+                    return false;
+                }
+            }
+            return !parser->failed;
+        }
+        case '"': {
+            JsonStringSpan span;
+            return json_reader_string_span(parser, &span);
+        }
+        case 't': return json_reader_literal(parser, "true");
+        case 'f': return json_reader_literal(parser, "false");
+        case 'n': return json_reader_literal(parser, "null");
+        default: {
+            JsonNumber number;
+            return json_reader_number(parser, &number);
+        }
+    }
+}
+
+bool json_value_as_float(const JsonValue* value, float* out_float) {
+    if (value && value->type == JSON_VALUE_TYPE_NUMBER && out_float) {
+        *out_float = (float) value->data.number.value;
+        return true;
+    }
+    return false;
+}
+
+bool json_value_as_double(const JsonValue* value, double* out_double) {
+    if (value && value->type == JSON_VALUE_TYPE_NUMBER && out_double) {
+        *out_double = value->data.number.value;
+        return true;
+    }
+    return false;
+}
+
+//Integer getters fail for numbers that aren't integral or don't fit, rather than truncating
+bool json_value_as_int32(const JsonValue* value, int32_t* out_int) {
+    if (value && value->type == JSON_VALUE_TYPE_NUMBER && out_int) {
+        const JsonNumber* number = &value->data.number;
+        if (number->is_integer && number->integer >= INT32_MIN && number->integer <= INT32_MAX) {
+            *out_int = (int32_t) number->integer;
+            return true;
+        }
+        uint64_t non_negative = 0;
+        if (json_number_as_uint64(number, &non_negative) && non_negative <= INT32_MAX) {
+            *out_int = (int32_t) non_negative;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool json_value_as_uint64(const JsonValue* value, uint64_t* out_int) {
+    return value && value->type == JSON_VALUE_TYPE_NUMBER && out_int && json_number_as_uint64(&value->data.number, out_int);
+}
+
+bool json_value_as_uint32(const JsonValue* value, uint32_t* out_int) {
+    uint64_t number = 0;
+    if (json_value_as_uint64(value, &number) && number <= UINT32_MAX && out_int) {
+        *out_int = (uint32_t) number;
+        return true;
+    }
+    return false;
+}
+
+bool json_value_as_bool(const JsonValue* value, bool* out_bool) {
+    if (value && value->type == JSON_VALUE_TYPE_BOOLEAN && out_bool) {
+        *out_bool = value->data.boolean;
+        return true;
+    }
+    return false;
+}
+
+bool json_value_as_string(const JsonValue* value, const char** out_string) {
+    if (value && value->type == JSON_VALUE_TYPE_STRING && out_string) {
+        *out_string = value->data.string;
+        return true;
+    }
+    return false;
+}
+
+bool json_value_as_array(const JsonValue* value, const JsonArray** out_array) {
+    if (value && value->type == JSON_VALUE_TYPE_ARRAY) {
+        *out_array = &value->data.array;
+        return true;
+    }
+    return false;
+}
+
+bool json_value_as_object(const JsonValue* value, const JsonObject** out_object) {
+    if (value && value->type == JSON_VALUE_TYPE_OBJECT) {
+        *out_object = &value->data.object;
+        return true;
+    }
+    return false;
+}
+
+const JsonValue* json_object_get_value(const JsonObject* object, const char* key) {
+    for (uint32_t i = 0; i < object->count; ++i) {
+        JsonKeyValuePair* key_value = &object->key_value_pairs[i];
+        if (strcmp(key_value->key, key) == 0) {
+            return &key_value->value;
+        }
+    }
+    return NULL;
+}
+
+const JsonValue* json_array_get_value(const JsonArray* array, uint32_t index) {
+    if (index < array->count) {
+        return &array->values[index];
+    }
+    return NULL;
+}
+
+//Convenience Functions Below
+// the JsonObject and JsonArray getters return pointers
+// TODO: the other value getters return true on success and set the output via an argument
+
+const JsonObject* json_object_get_object(const JsonObject* object, const char* key) {
+    const JsonObject* out_object = NULL;
+    json_value_as_object(json_object_get_value(object, key), &out_object);
+    return out_object;
+}
+
+const JsonArray* json_object_get_array(const JsonObject* object, const char* key) {
+    const JsonArray* out_array = NULL;
+    json_value_as_array(json_object_get_value(object, key), &out_array);
+    return out_array;
+}
+
+const JsonObject* json_array_get_object(const JsonArray* array, uint32_t index) {
+    const JsonObject* out_object = NULL;
+    json_value_as_object(json_array_get_value(array, index), &out_object);
+    return out_object;
+}
+
+const JsonArray* json_array_get_array(const JsonArray* array, uint32_t index) {
+    const JsonArray* out_array = NULL;
+    json_value_as_array(json_array_get_value(array, index), &out_array);
+    return out_array;
 }
 
 static inline void indent(FILE* out_file, int n)
@@ -397,7 +1452,11 @@ void print_json_value(JsonValue* in_value, int depth, bool leading_indent, FILE*
                 print_json_object(&in_value->data.object, depth, out_file);
                 break;
             case JSON_VALUE_TYPE_NUMBER:
-                fprintf(out_file, "%f", in_value->data.number);
+                if (in_value->data.number.is_integer) {
+                    fprintf(out_file, "%lld", (long long) in_value->data.number.integer);
+                } else {
+                    fprintf(out_file, "%.17g", in_value->data.number.value);
+                }
                 break;
             case JSON_VALUE_TYPE_BOOLEAN:
                 fprintf(out_file, "%s", in_value->data.boolean ? "true" : "false");
@@ -417,39 +1476,998 @@ void print_json_value(JsonValue* in_value, int depth, bool leading_indent, FILE*
             case JSON_VALUE_TYPE_STRING:
                 fprintf(out_file, "\"%s\"", in_value->data.string);
                 break;
+            case JSON_VALUE_TYPE_NULL:
+                fprintf(out_file, "null");
+                break;
             default: 
                 break;
         }
 }
 
-void print_json_object(JsonObject* in_object, int depth, FILE* out_file) {
+void print_json_object(JsonObject* in_object, int depth, FILE* out_file) {
+
+    fprintf(out_file, "{\n");
+    
+    for (uint32_t i = 0; i < in_object->count; ++i) {
+        JsonKeyValuePair* key_value = &in_object->key_value_pairs[i];
+        indent_printf(out_file, depth + 1, "\"%s\" : ", key_value->key);
+
+        print_json_value(&key_value->value, depth + 1, false, out_file);
+        if (i < in_object->count - 1) {
+            fprintf(out_file, ",");
+        }
+        fprintf(out_file, "\n");
+    }
+    indent_printf(out_file, depth, "}");
+
+    if (depth == 0) { fprintf(out_file, "\n"); }
+}
+
+FILE* open_binary_file(const char* filename)
+{
+    #ifdef _MSC_VER
+    #pragma warning(disable : 4996)
+    #endif
+    return fopen(filename, "rb");
+    #ifdef _MSC_VER
+    #pragma warning(default : 4996)
+    #endif
+}
+
+//Raw bytes of a file, either read into a heap allocation or memory-mapped
+typedef struct GltfFileData {
+    uint8_t* data;
+    uint64_t size;
+    bool is_mapped;
+    #ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+    #endif
+} GltfFileData;
+
+bool gltf_file_read(const char* filename, GltfFileData* out_file_data) {
+    memset(out_file_data, 0, sizeof(GltfFileData));
+
+    FILE* file = open_binary_file(filename);
+    if (!file) {
+        return false;
+    }
+
+    #ifdef _MSC_VER
+    const bool seek_succeeded = _fseeki64(file, 0, SEEK_END) == 0;
+    const int64_t file_size = seek_succeeded ? _ftelli64(file) : -1;
+    #else
+    const bool seek_succeeded = fseeko(file, 0, SEEK_END) == 0;
+    const int64_t file_size = seek_succeeded ? (int64_t) ftello(file) : -1;
+    #endif
+
+    bool succeeded = file_size > 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (succeeded) {
+        out_file_data->data = (uint8_t*) malloc((size_t) file_size);
+        out_file_data->size = (uint64_t) file_size;
+        succeeded = out_file_data->data && fread(out_file_data->data, (size_t) file_size, 1, file) == 1;
+    }
+    fclose(file);
+
+    if (!succeeded) {
+        free(out_file_data->data);
+        memset(out_file_data, 0, sizeof(GltfFileData));
+    }
+    return succeeded;
+}
+
+//Maps the file read-only. Pages are faulted in on first access, so nothing is copied to the heap
+bool gltf_file_map(const char* filename, GltfFileData* out_file_data) {
+    memset(out_file_data, 0, sizeof(GltfFileData));
+
+    #ifdef _WIN32
+    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    HANDLE mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_handle) {
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    void* mapped_data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped_data) {
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    out_file_data->file_handle = file_handle;
+    out_file_data->mapping_handle = mapping_handle;
+    out_file_data->size = (uint64_t) file_size.QuadPart;
+    #else
+    const int file_descriptor = open(filename, O_RDONLY);
+    if (file_descriptor < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(file_descriptor);
+        return false;
+    }
+
+    void* mapped_data = mmap(NULL, (size_t) file_stat.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    //The mapping keeps its own reference to the file
+    close(file_descriptor);
+    if (mapped_data == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapped_data, (size_t) file_stat.st_size, MADV_WILLNEED);
+
+    out_file_data->size = (uint64_t) file_stat.st_size;
+    #endif
+
+    out_file_data->data = (uint8_t*) mapped_data;
+    out_file_data->is_mapped = true;
+    return true;
+}
+
+void gltf_file_release(GltfFileData* file_data) {
+    if (file_data->is_mapped) {
+        #ifdef _WIN32
+        UnmapViewOfFile(file_data->data);
+        CloseHandle(file_data->mapping_handle);
+        CloseHandle(file_data->file_handle);
+        #else
+        munmap(file_data->data, (size_t) file_data->size);
+        #endif
+    } else {
+        free(file_data->data);
+    }
+    memset(file_data, 0, sizeof(GltfFileData));
+}
+
+//BASE64 (used by data: uris)
+
+//6 bit value of each base64 character, 0xFF for anything else
+static const uint8_t GLTF_BASE64_DECODE_TABLE[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+//Number of bytes encoded by length base64 characters (padding included), or SIZE_MAX if length isn't a valid base64 length
+size_t gltf_base64_decoded_size(const char* in_base64, size_t length) {
+    while (length > 0 && in_base64[length - 1] == '=') {
+        length--;
+    }
+    if (length % 4 == 1) {
+        return SIZE_MAX;
+    }
+    return length / 4 * 3 + (length % 4 ? length % 4 - 1 : 0);
+}
+
+//SIMD kernels translate characters to 6 bit values with nibble lookups (W. Mula, D. Lemire, "Faster Base64 Encoding and Decoding
+//Using AVX2 Instructions"), then pack each group of four 6 bit values into three bytes
+
+#if GLTF_SIMD_SSSE3
+#if GLTF_SIMD_SSSE3_RUNTIME_CHECK
+static bool gltf_cpu_has_ssse3() {
+    int cpu_info[4];
+    __cpuid(cpu_info, 1);
+    return (cpu_info[2] & (1 << 9)) != 0;
+}
+#endif
+
+//Decodes 16 characters, writing 16 bytes of which the first 12 are valid. Returns false if any character is invalid.
+static inline bool gltf_base64_decode_block_ssse3(const uint8_t* in, uint8_t* out) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2F);
+
+    const __m128i chars = _mm_loadu_si128((const __m128i*) in);
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), mask_2f);
+    const __m128i lo_nibbles = _mm_and_si128(chars, mask_2f);
+    const __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xFFFF) {
+        return false;
+    }
+
+    const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(chars, mask_2f), hi_nibbles));
+    const __m128i values = _mm_add_epi8(chars, roll);
+
+    const __m128i merged_pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i merged_quads = _mm_madd_epi16(merged_pairs, _mm_set1_epi32(0x00011000));
+    const __m128i packed = _mm_shuffle_epi8(merged_quads, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i*) out, packed);
+    return true;
+}
+#endif
+
+#if GLTF_SIMD_AVX2
+//Decodes 32 characters, writing 32 bytes of which the first 24 are valid. Returns false if any character is invalid.
+static inline bool gltf_base64_decode_block_avx2(const uint8_t* in, uint8_t* out) {
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+
+    const __m256i chars = _mm256_loadu_si256((const __m256i*) in);
+    const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask_2f);
+    const __m256i lo_nibbles = _mm256_and_si256(chars, mask_2f);
+    const __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles), _mm256_shuffle_epi8(lut_hi, hi_nibbles));
+    if (!_mm256_testz_si256(invalid, invalid)) {
+        return false;
+    }
+
+    const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(chars, mask_2f), hi_nibbles));
+    const __m256i values = _mm256_add_epi8(chars, roll);
+
+    const __m256i merged_pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const __m256i merged_quads = _mm256_madd_epi16(merged_pairs, _mm256_set1_epi32(0x00011000));
+    const __m256i packed_lanes = _mm256_shuffle_epi8(merged_quads, _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    const __m256i packed = _mm256_permutevar8x32_epi32(packed_lanes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    _mm256_storeu_si256((__m256i*) out, packed);
+    return true;
+}
+#endif
+
+#if GLTF_SIMD_NEON
+static inline bool gltf_base64_translate_neon(uint8x16_t chars, uint8x16_t* out_values) {
+    static const uint8_t lut_lo_bytes[16] = { 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A };
+    static const uint8_t lut_hi_bytes[16] = { 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 };
+    static const int8_t lut_roll_bytes[16] = { 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    const uint8x16_t hi_nibbles = vshrq_n_u8(chars, 4);
+    const uint8x16_t lo_nibbles = vandq_u8(chars, vdupq_n_u8(0x0F));
+    const uint8x16_t invalid = vandq_u8(vqtbl1q_u8(vld1q_u8(lut_lo_bytes), lo_nibbles), vqtbl1q_u8(vld1q_u8(lut_hi_bytes), hi_nibbles));
+    if (vmaxvq_u8(invalid) != 0) {
+        return false;
+    }
+
+    const uint8x16_t roll_index = vandq_u8(vaddq_u8(vceqq_u8(chars, vdupq_n_u8(0x2F)), hi_nibbles), vdupq_n_u8(0x0F));
+    *out_values = vaddq_u8(chars, vqtbl1q_u8(vreinterpretq_u8_s8(vld1q_s8(lut_roll_bytes)), roll_index));
+    return true;
+}
+
+//Decodes 64 characters into 48 bytes. Returns false if any character is invalid.
+static inline bool gltf_base64_decode_block_neon(const uint8_t* in, uint8_t* out) {
+    const uint8x16x4_t chars = vld4q_u8(in);
+    uint8x16_t a, b, c, d;
+    if (!gltf_base64_translate_neon(chars.val[0], &a) || !gltf_base64_translate_neon(chars.val[1], &b)
+        || !gltf_base64_translate_neon(chars.val[2], &c) || !gltf_base64_translate_neon(chars.val[3], &d)) {
+        return false;
+    }
+
+    uint8x16x3_t packed;
+    packed.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+    packed.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+    packed.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+    vst3q_u8(out, packed);
+    return true;
+}
+#endif
+
+//Decodes length base64 characters into out_data, which must hold gltf_base64_decoded_size bytes. Nothing is written past that size.
+//Padding is only allowed at the end, so large inputs can be decoded in independent chunks that are multiples of 4 characters.
+bool gltf_base64_decode(const char* in_base64, size_t length, uint8_t* out_data) {
+    while (length > 0 && in_base64[length - 1] == '=') {
+        length--;
+    }
+    if (length % 4 == 1) {
+        return false;
+    }
+
+    const uint8_t* in = (const uint8_t*) in_base64;
+    const uint8_t* in_end = in + length;
+    uint8_t* out = out_data;
+
+    //SIMD blocks store whole vectors, so they stop while the decoded output still has room for the full store.
+    //Blocks that contain invalid characters are left to the scalar loop, which reports the error.
+    #if GLTF_SIMD_AVX2
+    while (in_end - in >= 44 && gltf_base64_decode_block_avx2(in, out)) {
+        in += 32;
+        out += 24;
+    }
+    #elif GLTF_SIMD_SSSE3
+    #if GLTF_SIMD_SSSE3_RUNTIME_CHECK
+    if (gltf_cpu_has_ssse3())
+    #endif
+    {
+        while (in_end - in >= 24 && gltf_base64_decode_block_ssse3(in, out)) {
+            in += 16;
+            out += 12;
+        }
+    }
+    #elif GLTF_SIMD_NEON
+    while (in_end - in >= 64 && gltf_base64_decode_block_neon(in, out)) {
+        in += 64;
+        out += 48;
+    }
+    #endif
+
+    for (; in_end - in >= 4; in += 4, out += 3) {
+        const uint32_t a = GLTF_BASE64_DECODE_TABLE[in[0]], b = GLTF_BASE64_DECODE_TABLE[in[1]];
+        const uint32_t c = GLTF_BASE64_DECODE_TABLE[in[2]], d = GLTF_BASE64_DECODE_TABLE[in[3]];
+        if ((a | b | c | d) & 0x80) {
+            return false;
+        }
+        const uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = (uint8_t) (triple >> 16);
+        out[1] = (uint8_t) (triple >> 8);
+        out[2] = (uint8_t) triple;
+    }
+
+    //Final 2 or 3 characters encode 1 or 2 bytes
+    if (in < in_end) {
+        const uint32_t a = GLTF_BASE64_DECODE_TABLE[in[0]], b = GLTF_BASE64_DECODE_TABLE[in[1]];
+        const uint32_t c = in_end - in == 3 ? GLTF_BASE64_DECODE_TABLE[in[2]] : 0;
+        if ((a | b | c) & 0x80) {
+            return false;
+        }
+        out[0] = (uint8_t) ((a << 2) | (b >> 4));
+        if (in_end - in == 3) {
+            out[1] = (uint8_t) ((b << 4) | (c >> 2));
+        }
+    }
+    return true;
+}
+
+//EXT_MESHOPT_COMPRESSION
+//Decoders for the meshoptimizer vertex and index codecs and the attribute filters of EXT_meshopt_compression
+//(see the extension spec for the bitstream). Decoded buffer views are written to the asset's fallback buffer.
+
+#define GLTF_MESHOPT_BYTE_GROUP_SIZE          16
+#define GLTF_MESHOPT_BYTE_GROUP_DECODE_LIMIT  24 //Largest byte group: 4 bytes of 2 bit values and 16 escaped bytes, plus slack for 16 byte loads
+#define GLTF_MESHOPT_VERTEX_BLOCK_SIZE_BYTES  8192
+#define GLTF_MESHOPT_VERTEX_BLOCK_MAX_SIZE    256
+#define GLTF_MESHOPT_TAIL_MAX_SIZE            32
+
+const uint8_t GLTF_MESHOPT_VERTEX_HEADER   = 0xA0;
+const uint8_t GLTF_MESHOPT_INDEX_HEADER    = 0xE0;
+const uint8_t GLTF_MESHOPT_SEQUENCE_HEADER = 0xD0;
+
+static inline uint8_t gltf_meshopt_unzigzag8(uint8_t value) {
+    return (uint8_t) (-(value & 1) ^ (value >> 1));
+}
+
+//Decodes 16 values packed with 0, 2, 4 or 8 bits each. Packed values that are all ones are escapes, their bytes follow the packed values.
+static const uint8_t* gltf_meshopt_decode_byte_group(const uint8_t* data, uint8_t* out, uint32_t bits) {
+    if (bits == 0) {
+        memset(out, 0, GLTF_MESHOPT_BYTE_GROUP_SIZE);
+        return data;
+    }
+    if (bits == 8) {
+        memcpy(out, data, GLTF_MESHOPT_BYTE_GROUP_SIZE);
+        return data + GLTF_MESHOPT_BYTE_GROUP_SIZE;
+    }
+
+    //Values are stored from the high bits of each byte down
+    const uint8_t escape = (uint8_t) ((1 << bits) - 1);
+    const uint8_t* escaped = data + GLTF_MESHOPT_BYTE_GROUP_SIZE * bits / 8;
+    for (uint32_t i = 0; i < GLTF_MESHOPT_BYTE_GROUP_SIZE; ++i) {
+        const uint32_t bit_offset = i * bits;
+        const uint8_t value = (uint8_t) (data[bit_offset / 8] >> (8 - bits - bit_offset % 8)) & escape;
+        out[i] = value == escape ? *escaped++ : value;
+    }
+    return escaped;
+}
+
+#if GLTF_SIMD_SSSE3
+//Same as gltf_meshopt_decode_byte_group. The escaped bytes are moved into place with a shuffle whose indices are a prefix count of the escapes.
+//Reads up to GLTF_MESHOPT_BYTE_GROUP_DECODE_LIMIT bytes.
+static inline const uint8_t* gltf_meshopt_decode_byte_group_ssse3(const uint8_t* data, uint8_t* out, uint32_t bits) {
+    __m128i values;
+    __m128i escaped;
+    switch (bits) {
+    case 0:
+        _mm_storeu_si128((__m128i*) out, _mm_setzero_si128());
+        return data;
+    case 2: {
+        int32_t packed;
+        memcpy(&packed, data, sizeof(packed));
+        const __m128i packed_2 = _mm_cvtsi32_si128(packed);
+        const __m128i packed_4 = _mm_unpacklo_epi8(_mm_srli_epi16(packed_2, 4), packed_2);
+        values = _mm_and_si128(_mm_unpacklo_epi8(_mm_srli_epi16(packed_4, 2), packed_4), _mm_set1_epi8(3));
+        escaped = _mm_loadu_si128((const __m128i*) (data + 4));
+        data += 4;
+        break;
+    }
+    case 4: {
+        const __m128i packed_4 = _mm_loadl_epi64((const __m128i*) data);
+        values = _mm_and_si128(_mm_unpacklo_epi8(_mm_srli_epi16(packed_4, 4), packed_4), _mm_set1_epi8(15));
+        escaped = _mm_loadu_si128((const __m128i*) (data + 8));
+        data += 8;
+        break;
+    }
+    default:
+        _mm_storeu_si128((__m128i*) out, _mm_loadu_si128((const __m128i*) data));
+        return data + GLTF_MESHOPT_BYTE_GROUP_SIZE;
+    }
+
+    const __m128i escape_mask = _mm_cmpeq_epi8(values, _mm_set1_epi8((char) ((1 << bits) - 1)));
+
+    //Inclusive prefix count of escapes, minus one, is the index of each escaped byte. Other lanes get the high bit set and shuffle in zero.
+    __m128i escape_count = _mm_sub_epi8(_mm_setzero_si128(), escape_mask);
+    escape_count = _mm_add_epi8(escape_count, _mm_slli_si128(escape_count, 1));
+    escape_count = _mm_add_epi8(escape_count, _mm_slli_si128(escape_count, 2));
+    escape_count = _mm_add_epi8(escape_count, _mm_slli_si128(escape_count, 4));
+    escape_count = _mm_add_epi8(escape_count, _mm_slli_si128(escape_count, 8));
+    const __m128i shuffle = _mm_or_si128(_mm_add_epi8(escape_count, escape_mask), _mm_andnot_si128(escape_mask, _mm_set1_epi8((char) 0x80)));
+
+    const __m128i result = _mm_or_si128(_mm_shuffle_epi8(escaped, shuffle), _mm_andnot_si128(escape_mask, values));
+    _mm_storeu_si128((__m128i*) out, result);
+    return data + gltf_popcount64((uint64_t) _mm_movemask_epi8(escape_mask));
+}
+#endif
+
+//Decodes count values (a multiple of 16): a header with 2 bits per byte group selecting its bit width, then the byte groups
+static const uint8_t* gltf_meshopt_decode_bytes(const uint8_t* data, const uint8_t* data_end, uint8_t* out, uint32_t count, bool use_ssse3) {
+    const uint8_t* header = data;
+    const uint32_t header_size = (count / GLTF_MESHOPT_BYTE_GROUP_SIZE + 3) / 4;
+    if ((size_t) (data_end - data) < header_size) {
+        return NULL;
+    }
+    data += header_size;
+
+    static const uint32_t group_bits[4] = { 0, 2, 4, 8 };
+    for (uint32_t i = 0; i < count; i += GLTF_MESHOPT_BYTE_GROUP_SIZE) {
+        if ((size_t) (data_end - data) < GLTF_MESHOPT_BYTE_GROUP_DECODE_LIMIT) {
+            return NULL;
+        }
+        const uint32_t group = i / GLTF_MESHOPT_BYTE_GROUP_SIZE;
+        const uint32_t bits = group_bits[(header[group / 4] >> (group % 4 * 2)) & 3];
+
+        #if GLTF_SIMD_SSSE3
+        if (use_ssse3) {
+            data = gltf_meshopt_decode_byte_group_ssse3(data, out + i, bits);
+            continue;
+        }
+        #else
+        (void) use_ssse3;
+        #endif
+        data = gltf_meshopt_decode_byte_group(data, out + i, bits);
+    }
+    return data;
+}
+
+#if GLTF_SIMD_SSE2
+//Unzigzags 16 byte deltas and adds them up on top of io_last (the previous value, in every lane)
+static inline __m128i gltf_meshopt_decode_deltas_sse2(__m128i deltas, __m128i* io_last) {
+    const __m128i sign = _mm_cmpeq_epi8(_mm_and_si128(deltas, _mm_set1_epi8(1)), _mm_set1_epi8(1));
+    __m128i sum = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(deltas, 1), _mm_set1_epi8(0x7F)), sign);
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+    sum = _mm_add_epi8(sum, *io_last);
+    *io_last = _mm_set1_epi8((char) (_mm_extract_epi16(sum, 7) >> 8));
+    return sum;
+}
+#endif
+
+//Each byte of the vertex is a separate stream of zigzagged deltas from the same byte of the previous vertex
+static const uint8_t* gltf_meshopt_decode_vertex_block(const uint8_t* data, const uint8_t* data_end, uint8_t* vertex_data, uint32_t vertex_count,
+    uint32_t vertex_size, uint8_t last_vertex[256], bool use_ssse3) {
+    uint8_t streams[4][GLTF_MESHOPT_VERTEX_BLOCK_MAX_SIZE];
+    const uint32_t vertex_count_aligned = (vertex_count + GLTF_MESHOPT_BYTE_GROUP_SIZE - 1) & ~(GLTF_MESHOPT_BYTE_GROUP_SIZE - 1);
+
+    //Vertex sizes are multiples of 4, so 4 streams are decoded at a time and written out as one 4 byte store per vertex
+    for (uint32_t k = 0; k < vertex_size; k += 4) {
+        for (uint32_t j = 0; j < 4; ++j) {
+            data = gltf_meshopt_decode_bytes(data, data_end, streams[j], vertex_count_aligned, use_ssse3);
+            if (!data) {
+                return NULL;
+            }
+        }
+
+        #if GLTF_SIMD_SSE2
+        __m128i last[4];
+        for (uint32_t j = 0; j < 4; ++j) {
+            last[j] = _mm_set1_epi8((char) last_vertex[k + j]);
+        }
+        for (uint32_t i = 0; i < vertex_count; i += GLTF_MESHOPT_BYTE_GROUP_SIZE) {
+            const __m128i r0 = gltf_meshopt_decode_deltas_sse2(_mm_loadu_si128((const __m128i*) (streams[0] + i)), &last[0]);
+            const __m128i r1 = gltf_meshopt_decode_deltas_sse2(_mm_loadu_si128((const __m128i*) (streams[1] + i)), &last[1]);
+            const __m128i r2 = gltf_meshopt_decode_deltas_sse2(_mm_loadu_si128((const __m128i*) (streams[2] + i)), &last[2]);
+            const __m128i r3 = gltf_meshopt_decode_deltas_sse2(_mm_loadu_si128((const __m128i*) (streams[3] + i)), &last[3]);
+
+            //Transpose 4 streams of 16 bytes into 16 vertices of 4 bytes
+            const __m128i r01_lo = _mm_unpacklo_epi8(r0, r1), r01_hi = _mm_unpackhi_epi8(r0, r1);
+            const __m128i r23_lo = _mm_unpacklo_epi8(r2, r3), r23_hi = _mm_unpackhi_epi8(r2, r3);
+            uint32_t transposed[GLTF_MESHOPT_BYTE_GROUP_SIZE];
+            _mm_storeu_si128((__m128i*) (transposed + 0), _mm_unpacklo_epi16(r01_lo, r23_lo));
+            _mm_storeu_si128((__m128i*) (transposed + 4), _mm_unpackhi_epi16(r01_lo, r23_lo));
+            _mm_storeu_si128((__m128i*) (transposed + 8), _mm_unpacklo_epi16(r01_hi, r23_hi));
+            _mm_storeu_si128((__m128i*) (transposed + 12), _mm_unpackhi_epi16(r01_hi, r23_hi));
+
+            const uint32_t group_count = vertex_count - i < GLTF_MESHOPT_BYTE_GROUP_SIZE ? vertex_count - i : GLTF_MESHOPT_BYTE_GROUP_SIZE;
+            for (uint32_t v = 0; v < group_count; ++v) {
+                memcpy(vertex_data + (size_t) (i + v) * vertex_size + k, &transposed[v], 4);
+            }
+        }
+        memcpy(&last_vertex[k], vertex_data + (size_t) (vertex_count - 1) * vertex_size + k, 4);
+        #else
+        for (uint32_t j = 0; j < 4; ++j) {
+            uint8_t value = last_vertex[k + j];
+            for (uint32_t i = 0; i < vertex_count; ++i) {
+                value = (uint8_t) (value + gltf_meshopt_unzigzag8(streams[j][i]));
+                vertex_data[(size_t) i * vertex_size + k + j] = value;
+            }
+            last_vertex[k + j] = value;
+        }
+        #endif
+    }
+    return data;
+}
+
+//Decodes vertex_count vertices of vertex_size bytes (a multiple of 4, at most 256). Returns false on malformed data.
+bool gltf_meshopt_decode_vertex_buffer(uint8_t* out_vertices, uint32_t vertex_count, uint32_t vertex_size, const uint8_t* data, size_t data_size) {
+    if (vertex_size == 0 || vertex_size > 256 || vertex_size % 4 != 0) {
+        return false;
+    }
+    const uint8_t* data_end = data + data_size;
+    if (data_size < 1 + vertex_size || (data[0] & 0xF0) != GLTF_MESHOPT_VERTEX_HEADER || (data[0] & 0x0F) > 0) {
+        return false;
+    }
+    ++data;
+
+    //The tail holds the first vertex's base values
+    uint8_t last_vertex[256];
+    memcpy(last_vertex, data_end - vertex_size, vertex_size);
+
+    bool use_ssse3 = false;
+    #if GLTF_SIMD_SSSE3
+    #if GLTF_SIMD_SSSE3_RUNTIME_CHECK
+    use_ssse3 = gltf_cpu_has_ssse3();
+    #else
+    use_ssse3 = true;
+    #endif
+    #endif
+
+    uint32_t block_size = GLTF_MESHOPT_VERTEX_BLOCK_SIZE_BYTES / vertex_size & ~(GLTF_MESHOPT_BYTE_GROUP_SIZE - 1);
+    block_size = block_size < GLTF_MESHOPT_VERTEX_BLOCK_MAX_SIZE ? block_size : GLTF_MESHOPT_VERTEX_BLOCK_MAX_SIZE;
+
+    for (uint32_t vertex_offset = 0; vertex_offset < vertex_count; vertex_offset += block_size) {
+        const uint32_t block_count = vertex_count - vertex_offset < block_size ? vertex_count - vertex_offset : block_size;
+        data = gltf_meshopt_decode_vertex_block(data, data_end, out_vertices + (size_t) vertex_offset * vertex_size, block_count, vertex_size, last_vertex, use_ssse3);
+        if (!data) {
+            return false;
+        }
+    }
+
+    const size_t tail_size = vertex_size < GLTF_MESHOPT_TAIL_MAX_SIZE ? GLTF_MESHOPT_TAIL_MAX_SIZE : vertex_size;
+    return (size_t) (data_end - data) == tail_size;
+}
+
+static inline uint32_t gltf_meshopt_decode_vbyte(const uint8_t** io_data) {
+    const uint8_t* data = *io_data;
+    const uint8_t lead = *data++;
+    uint32_t result = lead & 127;
+    if (lead >= 128) {
+        //At most 4 more bytes, so malformed data can't run on
+        for (uint32_t i = 0, shift = 7; i < 4; ++i, shift += 7) {
+            const uint8_t group = *data++;
+            result |= (uint32_t) (group & 127) << shift;
+            if (group < 128) {
+                break;
+            }
+        }
+    }
+    *io_data = data;
+    return result;
+}
+
+static inline uint32_t gltf_meshopt_decode_index(const uint8_t** io_data, uint32_t last) {
+    const uint32_t value = gltf_meshopt_decode_vbyte(io_data);
+    return last + ((value >> 1) ^ (0 - (value & 1)));
+}
+
+static inline void gltf_meshopt_write_index(void* out_indices, uint32_t index_size, size_t i, uint32_t index) {
+    if (index_size == 2) {
+        ((uint16_t*) out_indices)[i] = (uint16_t) index;
+    } else {
+        ((uint32_t*) out_indices)[i] = index;
+    }
+}
+
+//Triangle list codec. Triangles are coded relative to a 16 entry fifo of recent edges and a 16 entry fifo of recent vertices,
+//new vertices are mostly the next unused index and the rest are deltas from the last explicitly coded index.
+//The triangle order is inherently serial, so unlike the vertex codec this one is scalar.
+bool gltf_meshopt_decode_index_buffer(void* out_indices, uint32_t index_count, uint32_t index_size, const uint8_t* data, size_t data_size) {
+    if (index_count % 3 != 0 || (index_size != 2 && index_size != 4)) {
+        return false;
+    }
+    //Header, a code byte per triangle and the 16 byte codeaux table at the end
+    if (data_size < 1 + (size_t) index_count / 3 + 16 || (data[0] & 0xF0) != GLTF_MESHOPT_INDEX_HEADER || (data[0] & 0x0F) > 1) {
+        return false;
+    }
+    const uint32_t version = data[0] & 0x0F;
+
+    uint32_t edge_fifo[16][2];
+    uint32_t vertex_fifo[16];
+    memset(edge_fifo, -1, sizeof(edge_fifo));
+    memset(vertex_fifo, -1, sizeof(vertex_fifo));
+    uint32_t edge_fifo_offset = 0;
+    uint32_t vertex_fifo_offset = 0;
+
+    uint32_t next = 0;
+    uint32_t last = 0;
+    const uint32_t fec_max = version >= 1 ? 13 : 15;
+
+    const uint8_t* code = data + 1;
+    const uint8_t* free_data = code + index_count / 3;
+    const uint8_t* free_data_safe_end = data + data_size - 16;
+    const uint8_t* codeaux_table = free_data_safe_end;
+
+    #define GLTF_MESHOPT_PUSH_EDGE(a, b) edge_fifo[edge_fifo_offset][0] = (a), edge_fifo[edge_fifo_offset][1] = (b), edge_fifo_offset = (edge_fifo_offset + 1) & 15
+    #define GLTF_MESHOPT_PUSH_VERTEX(v, condition) vertex_fifo[vertex_fifo_offset] = (v), vertex_fifo_offset = (vertex_fifo_offset + ((condition) ? 1 : 0)) & 15
+
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        //A triangle reads at most 16 bytes (a codeaux byte and three 5 byte indices), the codeaux table covers the overrun
+        if (free_data > free_data_safe_end) {
+            return false;
+        }
+
+        uint32_t a, b, c;
+        const uint8_t codetri = *code++;
+        if (codetri < 0xF0) {
+            //Edge from the fifo and a third vertex that's new, from the vertex fifo or coded relative to last
+            const uint32_t fe = codetri >> 4;
+            a = edge_fifo[(edge_fifo_offset - 1 - fe) & 15][0];
+            b = edge_fifo[(edge_fifo_offset - 1 - fe) & 15][1];
+
+            const uint32_t fec = codetri & 15;
+            if (fec < fec_max) {
+                c = fec == 0 ? next++ : vertex_fifo[(vertex_fifo_offset - 1 - fec) & 15];
+                GLTF_MESHOPT_PUSH_VERTEX(c, fec == 0);
+            } else {
+                //13 and 14 are last - 1 and last + 1
+                c = last = fec != 15 ? last + fec - (fec ^ 3) : gltf_meshopt_decode_index(&free_data, last);
+                GLTF_MESHOPT_PUSH_VERTEX(c, true);
+            }
+            GLTF_MESHOPT_PUSH_EDGE(c, b);
+            GLTF_MESHOPT_PUSH_EDGE(a, c);
+        } else {
+            //No shared edge. 0xF0-0xFD look the vertex codes up in the table, 0xFE and 0xFF read them from the next byte.
+            const bool explicit_codeaux = codetri >= 0xFE;
+            const uint8_t codeaux = explicit_codeaux ? *free_data++ : codeaux_table[codetri & 15];
+            const uint32_t fea = codetri == 0xFF ? 15 : 0;
+            const uint32_t feb = codeaux >> 4;
+            const uint32_t fec = codeaux & 15;
+
+            //Explicit zero codeaux restarts the new vertex numbering
+            if (explicit_codeaux && codeaux == 0) {
+                next = 0;
+            }
+
+            a = fea == 0 ? next++ : 0;
+            b = feb == 0 ? next++ : vertex_fifo[(vertex_fifo_offset - feb) & 15];
+            c = fec == 0 ? next++ : vertex_fifo[(vertex_fifo_offset - fec) & 15];
+            if (fea == 15) {
+                a = last = gltf_meshopt_decode_index(&free_data, last);
+            }
+            if (explicit_codeaux && feb == 15) {
+                b = last = gltf_meshopt_decode_index(&free_data, last);
+            }
+            if (explicit_codeaux && fec == 15) {
+                c = last = gltf_meshopt_decode_index(&free_data, last);
+            }
+
+            GLTF_MESHOPT_PUSH_VERTEX(a, true);
+            GLTF_MESHOPT_PUSH_VERTEX(b, feb == 0 || (explicit_codeaux && feb == 15));
+            GLTF_MESHOPT_PUSH_VERTEX(c, fec == 0 || (explicit_codeaux && fec == 15));
+            GLTF_MESHOPT_PUSH_EDGE(b, a);
+            GLTF_MESHOPT_PUSH_EDGE(c, b);
+            GLTF_MESHOPT_PUSH_EDGE(a, c);
+        }
+
+        gltf_meshopt_write_index(out_indices, index_size, i + 0, a);
+        gltf_meshopt_write_index(out_indices, index_size, i + 1, b);
+        gltf_meshopt_write_index(out_indices, index_size, i + 2, c);
+    }
+
+    #undef GLTF_MESHOPT_PUSH_EDGE
+    #undef GLTF_MESHOPT_PUSH_VERTEX
+
+    //All free index data has to be consumed, up to the codeaux table
+    return free_data == free_data_safe_end;
+}
+
+//Index sequence codec (arbitrary index lists): each index is a zigzagged delta from one of two previous indices
+bool gltf_meshopt_decode_index_sequence(void* out_indices, uint32_t index_count, uint32_t index_size, const uint8_t* data, size_t data_size) {
+    if (index_size != 2 && index_size != 4) {
+        return false;
+    }
+    //Header, at least a byte per index and a 4 byte tail
+    if (data_size < 1 + (size_t) index_count + 4 || (data[0] & 0xF0) != GLTF_MESHOPT_SEQUENCE_HEADER || (data[0] & 0x0F) > 1) {
+        return false;
+    }
+
+    const uint8_t* index_data = data + 1;
+    const uint8_t* index_data_safe_end = data + data_size - 4;
+    uint32_t last[2] = { 0, 0 };
+    for (uint32_t i = 0; i < index_count; ++i) {
+        //An index reads at most 5 bytes, the tail covers the overrun
+        if (index_data >= index_data_safe_end) {
+            return false;
+        }
+        const uint32_t value = gltf_meshopt_decode_vbyte(&index_data);
+        const uint32_t baseline = value & 1;
+        const uint32_t delta = value >> 1;
+        last[baseline] += (delta >> 1) ^ (0 - (delta & 1));
+        gltf_meshopt_write_index(out_indices, index_size, i, last[baseline]);
+    }
+    return index_data == index_data_safe_end;
+}
+
+//Filters are applied in place after the vertex codec. The SIMD loops handle 4 elements at a time and round exactly like the scalar tails.
+
+#if GLTF_SIMD_SSE2
+//Loads 4 elements of 4 signed 8 or 16 bit components, transposed into one vector per component
+static inline void gltf_meshopt_load_filter_components_sse2(const uint8_t* data, bool is_16_bit, __m128i out_components[4]) {
+    __m128i pairs_01, pairs_23;
+    if (is_16_bit) {
+        pairs_01 = _mm_loadu_si128((const __m128i*) data);
+        pairs_23 = _mm_loadu_si128((const __m128i*) (data + 16));
+    } else {
+        const __m128i bytes = _mm_loadu_si128((const __m128i*) data);
+        pairs_01 = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+        pairs_23 = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+    }
+    __m128 e0 = _mm_castsi128_ps(_mm_srai_epi32(_mm_unpacklo_epi16(pairs_01, pairs_01), 16));
+    __m128 e1 = _mm_castsi128_ps(_mm_srai_epi32(_mm_unpackhi_epi16(pairs_01, pairs_01), 16));
+    __m128 e2 = _mm_castsi128_ps(_mm_srai_epi32(_mm_unpacklo_epi16(pairs_23, pairs_23), 16));
+    __m128 e3 = _mm_castsi128_ps(_mm_srai_epi32(_mm_unpackhi_epi16(pairs_23, pairs_23), 16));
+    _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+    out_components[0] = _mm_castps_si128(e0);
+    out_components[1] = _mm_castps_si128(e1);
+    out_components[2] = _mm_castps_si128(e2);
+    out_components[3] = _mm_castps_si128(e3);
+}
 
-    fprintf(out_file, "{\n");
-    
-    for (uint32_t i = 0; i < in_object->count; ++i) {
-        JsonKeyValuePair* key_value = &in_object->key_value_pairs[i];
-        indent_printf(out_file, depth + 1, "\"%s\" : ", key_value->key);
+//Inverse of gltf_meshopt_load_filter_components_sse2
+static inline void gltf_meshopt_store_filter_components_sse2(uint8_t* data, bool is_16_bit, const __m128i components[4]) {
+    __m128 e0 = _mm_castsi128_ps(components[0]), e1 = _mm_castsi128_ps(components[1]);
+    __m128 e2 = _mm_castsi128_ps(components[2]), e3 = _mm_castsi128_ps(components[3]);
+    _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+    const __m128i pairs_01 = _mm_packs_epi32(_mm_castps_si128(e0), _mm_castps_si128(e1));
+    const __m128i pairs_23 = _mm_packs_epi32(_mm_castps_si128(e2), _mm_castps_si128(e3));
+    if (is_16_bit) {
+        _mm_storeu_si128((__m128i*) data, pairs_01);
+        _mm_storeu_si128((__m128i*) (data + 16), pairs_23);
+    } else {
+        _mm_storeu_si128((__m128i*) data, _mm_packs_epi16(pairs_01, pairs_23));
+    }
+}
 
-        print_json_value(&key_value->value, depth + 1, false, out_file);
-        if (i < in_object->count - 1) {
-            fprintf(out_file, ",");
+//Float to int, rounding half away from zero
+static inline __m128i gltf_meshopt_round_sse2(__m128 value) {
+    const __m128 is_negative = _mm_cmplt_ps(value, _mm_setzero_ps());
+    const __m128 half = _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(is_negative, _mm_set1_ps(-0.0f)));
+    return _mm_cvttps_epi32(_mm_add_ps(value, half));
+}
+#endif
+
+static inline int32_t gltf_meshopt_round(float value) {
+    return (int32_t) (value + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+//Octahedral unit vectors in 8 bit (stride 4) or 16 bit (stride 8) components. x and y are octahedral coordinates, z is the value
+//that represents 1 and w is kept as is.
+static void gltf_meshopt_decode_filter_octahedral(uint8_t* data, uint32_t count, uint32_t stride) {
+    const bool is_16_bit = stride == 8;
+    const float max = is_16_bit ? 32767.0f : 127.0f;
+
+    uint32_t i = 0;
+    #if GLTF_SIMD_SSE2
+    const __m128 sign_bit = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128i components[4];
+        gltf_meshopt_load_filter_components_sse2(data + (size_t) i * stride, is_16_bit, components);
+
+        __m128 x = _mm_cvtepi32_ps(components[0]);
+        __m128 y = _mm_cvtepi32_ps(components[1]);
+        const __m128 z = _mm_sub_ps(_mm_sub_ps(_mm_cvtepi32_ps(components[2]), _mm_andnot_ps(sign_bit, x)), _mm_andnot_ps(sign_bit, y));
+
+        //Fold back the lower hemisphere: x += x >= 0 ? t : -t with t = min(z, 0)
+        const __m128 t = _mm_min_ps(z, _mm_setzero_ps());
+        x = _mm_add_ps(x, _mm_xor_ps(t, _mm_andnot_ps(_mm_cmpge_ps(x, _mm_setzero_ps()), sign_bit)));
+        y = _mm_add_ps(y, _mm_xor_ps(t, _mm_andnot_ps(_mm_cmpge_ps(y, _mm_setzero_ps()), sign_bit)));
+
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        const __m128 scale = _mm_div_ps(_mm_set1_ps(max), length);
+        components[0] = gltf_meshopt_round_sse2(_mm_mul_ps(x, scale));
+        components[1] = gltf_meshopt_round_sse2(_mm_mul_ps(y, scale));
+        components[2] = gltf_meshopt_round_sse2(_mm_mul_ps(z, scale));
+        gltf_meshopt_store_filter_components_sse2(data + (size_t) i * stride, is_16_bit, components);
+    }
+    #endif
+
+    for (; i < count; ++i) {
+        float components[3];
+        for (uint32_t j = 0; j < 3; ++j) {
+            if (is_16_bit) {
+                int16_t component;
+                memcpy(&component, data + (size_t) i * stride + j * 2, sizeof(component));
+                components[j] = (float) component;
+            } else {
+                components[j] = (float) (int8_t) data[(size_t) i * stride + j];
+            }
+        }
+
+        float x = components[0];
+        float y = components[1];
+        const float z = components[2] - fabsf(x) - fabsf(y);
+        const float t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        const float length = sqrtf(x * x + y * y + z * z);
+        const float scale = max / length;
+        const int32_t result[3] = { gltf_meshopt_round(x * scale), gltf_meshopt_round(y * scale), gltf_meshopt_round(z * scale) };
+        for (uint32_t j = 0; j < 3; ++j) {
+            if (is_16_bit) {
+                const int16_t component = (int16_t) result[j];
+                memcpy(data + (size_t) i * stride + j * 2, &component, sizeof(component));
+            } else {
+                data[(size_t) i * stride + j] = (uint8_t) (int8_t) result[j];
+            }
         }
-        fprintf(out_file, "\n");
     }
-    indent_printf(out_file, depth, "}");
+}
 
-    if (depth == 0) { fprintf(out_file, "\n"); }
+//Unit quaternions in 16 bit components (stride 8): the three smallest components, scaled by sqrt(2) and by the scale stored in the
+//high bits of w. The low 2 bits of w say which component was dropped and is reconstructed.
+static void gltf_meshopt_decode_filter_quaternion(uint8_t* data, uint32_t count) {
+    const float scale = 0.70710678f; //1 / sqrt(2)
+
+    uint32_t i = 0;
+    #if GLTF_SIMD_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128i components[4];
+        gltf_meshopt_load_filter_components_sse2(data + (size_t) i * 8, true, components);
+
+        const __m128 component_scale = _mm_div_ps(_mm_set1_ps(scale), _mm_cvtepi32_ps(_mm_or_si128(components[3], _mm_set1_epi32(3))));
+        const __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(components[0]), component_scale);
+        const __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(components[1]), component_scale);
+        const __m128 z = _mm_mul_ps(_mm_cvtepi32_ps(components[2]), component_scale);
+        const __m128 ww = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        const __m128 w = _mm_sqrt_ps(_mm_max_ps(ww, _mm_setzero_ps()));
+
+        int32_t result[4][4];
+        int32_t dropped[4];
+        _mm_storeu_si128((__m128i*) result[0], gltf_meshopt_round_sse2(_mm_mul_ps(x, _mm_set1_ps(32767.0f))));
+        _mm_storeu_si128((__m128i*) result[1], gltf_meshopt_round_sse2(_mm_mul_ps(y, _mm_set1_ps(32767.0f))));
+        _mm_storeu_si128((__m128i*) result[2], gltf_meshopt_round_sse2(_mm_mul_ps(z, _mm_set1_ps(32767.0f))));
+        _mm_storeu_si128((__m128i*) result[3], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(w, _mm_set1_ps(32767.0f)), _mm_set1_ps(0.5f))));
+        _mm_storeu_si128((__m128i*) dropped, _mm_and_si128(components[3], _mm_set1_epi32(3)));
+
+        //The output order depends on the dropped component of each element
+        for (uint32_t j = 0; j < 4; ++j) {
+            int16_t quaternion[4];
+            quaternion[(dropped[j] + 1) & 3] = (int16_t) result[0][j];
+            quaternion[(dropped[j] + 2) & 3] = (int16_t) result[1][j];
+            quaternion[(dropped[j] + 3) & 3] = (int16_t) result[2][j];
+            quaternion[(dropped[j] + 0) & 3] = (int16_t) result[3][j];
+            memcpy(data + (size_t) (i + j) * 8, quaternion, sizeof(quaternion));
+        }
+    }
+    #endif
+
+    for (; i < count; ++i) {
+        int16_t quaternion[4];
+        memcpy(quaternion, data + (size_t) i * 8, sizeof(quaternion));
+
+        const float component_scale = scale / (float) (quaternion[3] | 3);
+        const float x = (float) quaternion[0] * component_scale;
+        const float y = (float) quaternion[1] * component_scale;
+        const float z = (float) quaternion[2] * component_scale;
+        const float ww = 1.0f - x * x - y * y - z * z;
+        const float w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+        const int32_t dropped = quaternion[3] & 3;
+        quaternion[(dropped + 1) & 3] = (int16_t) gltf_meshopt_round(x * 32767.0f);
+        quaternion[(dropped + 2) & 3] = (int16_t) gltf_meshopt_round(y * 32767.0f);
+        quaternion[(dropped + 3) & 3] = (int16_t) gltf_meshopt_round(z * 32767.0f);
+        quaternion[(dropped + 0) & 3] = (int16_t) (int32_t) (w * 32767.0f + 0.5f);
+        memcpy(data + (size_t) i * 8, quaternion, sizeof(quaternion));
+    }
+}
+
+//32 bit floats stored as a signed 24 bit mantissa and a signed 8 bit exponent
+static void gltf_meshopt_decode_filter_exponential(uint8_t* data, size_t count) {
+    size_t i = 0;
+    #if GLTF_SIMD_SSE2
+    for (; i + 4 <= count; i += 4) {
+        const __m128i value = _mm_loadu_si128((const __m128i*) (data + i * 4));
+        const __m128i mantissa = _mm_srai_epi32(_mm_slli_epi32(value, 8), 8);
+        const __m128i exponent = _mm_srai_epi32(value, 24);
+        const __m128 power = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23));
+        _mm_storeu_ps((float*) (data + i * 4), _mm_mul_ps(power, _mm_cvtepi32_ps(mantissa)));
+    }
+    #endif
+
+    for (; i < count; ++i) {
+        int32_t value;
+        memcpy(&value, data + i * 4, sizeof(value));
+        const int32_t mantissa = (int32_t) ((uint32_t) value << 8) >> 8;
+        const int32_t exponent = value >> 24;
+
+        //ldexpf(mantissa, exponent), building 2^exponent directly
+        const uint32_t power_bits = (uint32_t) (exponent + 127) << 23;
+        float power;
+        memcpy(&power, &power_bits, sizeof(power));
+        const float result = power * (float) mantissa;
+        memcpy(data + i * 4, &result, sizeof(result));
+    }
 }
 
+//Sizes and offsets are 64 bit, external .bin files can be larger than 4 GB
 typedef struct GltfBuffer {
-    uint32_t byte_length;
-    uint8_t* data;
+    uint64_t byte_length;
+    const uint8_t* data;  //Points into GltfAsset::file for the .glb binary chunk, otherwise into storage
+    char* uri;            //NULL for the .glb binary chunk
+    GltfFileData storage; //Owns external .bin files and decoded data: uris
+    bool is_fallback;     //EXT_meshopt_compression fallback buffer. Its uri isn't loaded, compressed buffer views are decoded into storage instead.
 } GltfBuffer;
 
+typedef enum GltfMeshoptMode {
+    GLTF_MESHOPT_MODE_ATTRIBUTES,
+    GLTF_MESHOPT_MODE_TRIANGLES,
+    GLTF_MESHOPT_MODE_INDICES,
+} GltfMeshoptMode;
+
+typedef enum GltfMeshoptFilter {
+    GLTF_MESHOPT_FILTER_NONE,
+    GLTF_MESHOPT_FILTER_OCTAHEDRAL,
+    GLTF_MESHOPT_FILTER_QUATERNION,
+    GLTF_MESHOPT_FILTER_EXPONENTIAL,
+} GltfMeshoptFilter;
+
+//EXT_meshopt_compression source of a buffer view: count elements of byte_stride bytes, compressed in buffer
+typedef struct GltfMeshoptCompression {
+    GltfBuffer* buffer; //NULL if the buffer view isn't compressed
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint32_t byte_stride;
+    uint32_t count;
+    GltfMeshoptMode mode;
+    GltfMeshoptFilter filter;
+} GltfMeshoptCompression;
+
 typedef struct GltfBufferView {
-    uint32_t byte_length;
-    uint32_t byte_offset;
+    uint64_t byte_length;
+    uint64_t byte_offset;
+    uint32_t byte_stride; //0 when elements are tightly packed
     GltfBuffer* buffer;
+    GltfMeshoptCompression meshopt_compression;
 } GltfBufferView;
 
 typedef enum GltfComponentType {
@@ -525,22 +2543,142 @@ typedef struct GltfAccessor {
     GltfComponentType component_type;
     GltfAccessorType accessor_type;
     uint32_t count;
-    uint32_t byte_offset;
+    uint64_t byte_offset;
+    bool normalized; //Integer components map to [0,1] (unsigned) or [-1,1] (signed) when read as floats
     GltfBufferView* buffer_view;
+    bool has_bounds; //min and max were given with one value per component (required for POSITION accessors)
+    float min[16];
+    float max[16];
 } GltfAccessor;
 
-uint32_t gltf_accessor_get_initial_offset(GltfAccessor* accessor) {
+uint64_t gltf_accessor_get_initial_offset(const GltfAccessor* accessor) {
     return accessor->byte_offset + accessor->buffer_view->byte_offset;
 }
 
-uint32_t gltf_accessor_get_stride(GltfAccessor* accessor) {
+//Size of one element. Matrices of 1 and 2 byte components have column padding that isn't included here.
+uint32_t gltf_accessor_get_element_size(const GltfAccessor* accessor) {
     return gltf_accessor_type_size(accessor->accessor_type) 
         * gltf_component_type_size(accessor->component_type);
 }
 
+//Distance between elements, which is larger than the element size for interleaved buffer views
+uint32_t gltf_accessor_get_stride(const GltfAccessor* accessor) {
+    return accessor->buffer_view->byte_stride ? accessor->buffer_view->byte_stride : gltf_accessor_get_element_size(accessor);
+}
+
+static inline float gltf_component_to_float(const uint8_t* component, GltfComponentType component_type, bool normalized) {
+    switch (component_type) {
+        case GLTF_COMPONENT_TYPE_BYTE: {
+            const float value = (float) *(const int8_t*) component;
+            return normalized ? (value / 127.0f > -1.0f ? value / 127.0f : -1.0f) : value;
+        }
+        case GLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+            const float value = (float) *component;
+            return normalized ? value / 255.0f : value;
+        }
+        case GLTF_COMPONENT_TYPE_SHORT: {
+            int16_t short_value;
+            memcpy(&short_value, component, sizeof(short_value));
+            const float value = (float) short_value;
+            return normalized ? (value / 32767.0f > -1.0f ? value / 32767.0f : -1.0f) : value;
+        }
+        case GLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+            uint16_t short_value;
+            memcpy(&short_value, component, sizeof(short_value));
+            const float value = (float) short_value;
+            return normalized ? value / 65535.0f : value;
+        }
+        case GLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+            uint32_t int_value;
+            memcpy(&int_value, component, sizeof(int_value));
+            return normalized ? (float) (int_value / 4294967295.0) : (float) int_value;
+        }
+        case GLTF_COMPONENT_TYPE_FLOAT: {
+            float value;
+            memcpy(&value, component, sizeof(value));
+            return value;
+        }
+        default:
+            return 0.0f;
+    }
+}
+
+//Decodes every element of a vector or scalar accessor to floats, for any component type (normalized or not, e.g. KHR_mesh_quantization data).
+//Writes num_components floats per element, out_stride bytes apart, so elements can go straight into an interleaved vertex.
+//Components the accessor doesn't have are written as 0.
+bool gltf_accessor_unpack_floats(const GltfAccessor* accessor, uint32_t num_components, void* out_data, size_t out_stride) {
+    const uint32_t accessor_components = gltf_accessor_type_size(accessor->accessor_type);
+    const uint32_t component_size = gltf_component_type_size(accessor->component_type);
+    if (accessor->accessor_type > GLTF_ACCESSOR_TYPE_VEC4 || component_size == 0) {
+        return false;
+    }
+
+    const uint8_t* in = accessor->buffer_view->buffer->data + gltf_accessor_get_initial_offset(accessor);
+    const uint32_t in_stride = gltf_accessor_get_stride(accessor);
+    uint8_t* out = (uint8_t*) out_data;
+    const uint32_t copied_components = accessor_components < num_components ? accessor_components : num_components;
+
+    if (accessor->component_type == GLTF_COMPONENT_TYPE_FLOAT) {
+        for (uint32_t i = 0; i < accessor->count; ++i, in += in_stride, out += out_stride) {
+            memcpy(out, in, copied_components * sizeof(float));
+            memset(out + copied_components * sizeof(float), 0, (num_components - copied_components) * sizeof(float));
+        }
+        return true;
+    }
+
+    for (uint32_t i = 0; i < accessor->count; ++i, in += in_stride, out += out_stride) {
+        float element[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (uint32_t component = 0; component < copied_components; ++component) {
+            element[component] = gltf_component_to_float(in + component * component_size, accessor->component_type, accessor->normalized);
+        }
+        memcpy(out, element, num_components * sizeof(float));
+    }
+    return true;
+}
+
+//Decodes an index accessor (unsigned byte, short or int) to 32 bit indices
+bool gltf_accessor_unpack_indices(const GltfAccessor* accessor, uint32_t* out_indices) {
+    if (accessor->accessor_type != GLTF_ACCESSOR_TYPE_SCALAR) {
+        return false;
+    }
+
+    const uint8_t* in = accessor->buffer_view->buffer->data + gltf_accessor_get_initial_offset(accessor);
+    const uint32_t in_stride = gltf_accessor_get_stride(accessor);
+
+    switch (accessor->component_type) {
+        case GLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            for (uint32_t i = 0; i < accessor->count; ++i, in += in_stride) {
+                out_indices[i] = *in;
+            }
+            return true;
+        case GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            for (uint32_t i = 0; i < accessor->count; ++i, in += in_stride) {
+                uint16_t index;
+                memcpy(&index, in, sizeof(index));
+                out_indices[i] = index;
+            }
+            return true;
+        case GLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            if (in_stride == sizeof(uint32_t)) {
+                memcpy(out_indices, in, (size_t) accessor->count * sizeof(uint32_t));
+                return true;
+            }
+            for (uint32_t i = 0; i < accessor->count; ++i, in += in_stride) {
+                memcpy(&out_indices[i], in, sizeof(uint32_t));
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
 typedef struct GltfImage {
-    GltfBufferView* buffer_view;
-    //TODO: MIME Type
+    GltfBufferView* buffer_view; //Set for images stored in a buffer
+    char* uri;                   //Set for external files and data: uris
+    char* mime_type;             //Optional for external files
+    const uint8_t* data;         //Encoded image, wherever it came from
+    uint64_t data_size;
+    GltfFileData storage;        //Owns external image files and decoded data: uris
 } GltfImage;
 
 //TODO: Samplers
@@ -571,6 +2709,13 @@ typedef struct GltfMaterial {
     //TODO: occlusion texture
 } GltfMaterial;
 
+//Per vertex deltas added to the primitive's attributes, scaled by the target's weight
+typedef struct GltfMorphTarget {
+    GltfAccessor* positions; //Can be NULL
+    GltfAccessor* normals;   //Can be NULL
+    //TODO: Tangent deltas
+} GltfMorphTarget;
+
 typedef struct GltfPrimitive {
     GltfAccessor* positions;
     GltfAccessor* normals;
@@ -578,19 +2723,93 @@ typedef struct GltfPrimitive {
     GltfAccessor* texcoord0;
     //TODO: TexCoords Accessors (0,1)
     //TODO: Color Accessor
-    //TODO: Joints, Weights Accessors
+    GltfAccessor* joints0;  //JOINTS_0: unsigned byte or short joint indices into the skin of the node using the mesh
+    GltfAccessor* weights0; //WEIGHTS_0
     GltfAccessor* indices;
     GltfMaterial* material;
+    uint32_t num_targets;   //All primitives of a mesh have the same number of morph targets
+    GltfMorphTarget* targets;
 } GltfPrimitive;
 
 typedef struct GltfMesh {
     char* name;
     uint32_t num_primitives;
     GltfPrimitive* primitives;
+    uint32_t num_weights;
+    float* weights; //Default morph target weights, can be empty
 } GltfMesh;
 
+typedef struct GltfSkin {
+    char* name;
+    GltfAccessor* inverse_bind_matrices; //MAT4 floats, one per joint. NULL means every one is identity
+    struct GltfNode* skeleton;           //Common root of the joints, can be NULL
+    uint32_t num_joints;
+    struct GltfNode** joints;
+} GltfSkin;
+
+typedef struct GltfNode {
+    char* name;
+    GltfMesh* mesh;
+    GltfSkin* skin; //Skins mesh, whose primitives then have joints0 and weights0
+    struct GltfNode* parent; //NULL for root nodes
+    uint32_t num_children;
+    struct GltfNode** children;
+    //Local transform. A node's matrix is decomposed into these when it's read (glTF requires matrices to be decomposable).
+    float translation[3];    //default [0,0,0]
+    float rotation[4];       //Unit quaternion (x, y, z, w), default [0,0,0,1]
+    float scale[3];          //default [1,1,1]
+    uint32_t num_weights;
+    float* weights;          //Overrides the morph target weights of the mesh when not empty
+    //EXT_mesh_gpu_instancing: the mesh is drawn num_instances times, each at the node's world transform times its instance transform.
+    //Absent attributes default to the identity, they all have num_instances elements when present.
+    uint32_t num_instances;  //0 when the node isn't instanced
+    GltfAccessor* instance_translations; //VEC3
+    GltfAccessor* instance_rotations;    //VEC4 unit quaternions (x, y, z, w)
+    GltfAccessor* instance_scales;       //VEC3
+} GltfNode;
+
+typedef struct GltfScene {
+    char* name;
+    uint32_t num_nodes;
+    GltfNode** nodes; //Root nodes
+} GltfScene;
+
+typedef enum GltfInterpolation {
+    GLTF_INTERPOLATION_LINEAR,      //Rotations are spherically interpolated
+    GLTF_INTERPOLATION_STEP,
+    GLTF_INTERPOLATION_CUBICSPLINE, //Every keyframe stores (in-tangent, value, out-tangent)
+} GltfInterpolation;
+
+typedef enum GltfAnimationPath {
+    GLTF_ANIMATION_PATH_TRANSLATION,
+    GLTF_ANIMATION_PATH_ROTATION,
+    GLTF_ANIMATION_PATH_SCALE,
+    GLTF_ANIMATION_PATH_WEIGHTS,
+} GltfAnimationPath;
+
+typedef struct GltfAnimationSampler {
+    GltfAccessor* input;  //Keyframe times in seconds: SCALAR floats, strictly increasing
+    GltfAccessor* output; //Keyframe values: VEC3 (translation, scale), VEC4 (rotation) or SCALAR (weights, one per morph target)
+    GltfInterpolation interpolation;
+} GltfAnimationSampler;
+
+typedef struct GltfAnimationChannel {
+    GltfAnimationSampler* sampler; //One of the samplers of the same animation
+    GltfNode* node;                //NULL when the target is defined by an extension
+    GltfAnimationPath path;
+} GltfAnimationChannel;
+
+typedef struct GltfAnimation {
+    char* name;
+    uint32_t num_samplers;
+    GltfAnimationSampler* samplers;
+    uint32_t num_channels;
+    GltfAnimationChannel* channels;
+} GltfAnimation;
+
 typedef struct GltfAsset {
-    JsonObject      json;
+    GltfFileData    file;  //Owns the .glb/.gltf bytes (the .glb binary chunk is used in place)
+    GltfArena       arena; //Owns strings (e.g. mesh names)
     uint32_t        num_buffers;
     GltfBuffer*     buffers;
     uint32_t        num_buffer_views;
@@ -605,349 +2824,1490 @@ typedef struct GltfAsset {
     GltfMaterial*   materials;
     uint32_t        num_meshes;
     GltfMesh*       meshes;
+    uint32_t        num_nodes;
+    GltfNode*       nodes;
+    uint32_t        num_skins;
+    GltfSkin*       skins;
+    uint32_t        num_scenes;
+    GltfScene*      scenes;
+    GltfScene*      scene; //Scene to display by default, can be NULL
+    uint32_t        num_animations;
+    GltfAnimation*  animations;
 } GltfAsset;
 
-FILE* open_binary_file(const char* filename)
-{
-    #ifdef _MSC_VER
-    #pragma warning(disable : 4996)
-    #endif
-    return fopen(filename, "rb");
-    #ifdef _MSC_VER
-    #pragma warning(default : 4996)
-    #endif
+
+typedef enum GltfLoadFlags {
+    GLTF_LOAD_FLAGS_NONE       = 0,
+    GLTF_LOAD_FLAGS_MEMORY_MAP       = 1 << 0, //Map the file instead of reading it. Buffers point straight into the mapping.
+    GLTF_LOAD_FLAGS_STRUCTURAL_INDEX = 1 << 1, //Build a structural index of the json chunk (json_build_structural_index) and read from that
+} GltfLoadFlags;
+
+//Calls task(task_data, begin, end) over sub-ranges covering [0, count), possibly from several threads, and returns once all have finished
+typedef void (*GltfTaskFunction)(void* task_data, uint32_t begin, uint32_t end);
+typedef void (*GltfParallelForFunction)(void* user_data, uint32_t count, GltfTaskFunction task, void* task_data);
+
+typedef struct GltfLoadOptions {
+    uint32_t flags; //GltfLoadFlags
+
+    //Used to load external files, decode data: uris and decode EXT_meshopt_compression buffer views in parallel.
+    //Everything runs on the calling thread when NULL.
+    GltfParallelForFunction parallel_for;
+    void* parallel_for_user_data;
+} GltfLoadOptions;
+
+typedef struct GltfChunkHeader {
+    uint32_t length;
+    uint32_t type;
+} GltfChunkHeader;
+
+//The json chunk is streamed straight into the asset's arrays (see json_reader_*), no JsonObject tree is built.
+//References can point forward (e.g. meshes before accessors), so while streaming they are stored in the pointer fields
+//as index + 1 and resolved by gltf_resolve_references once the whole document has been read.
+#define GLTF_INDEX_AS_POINTER(type, index) ((type*) (uintptr_t) ((uintptr_t) (index) + 1))
+
+#define GLTF_RESOLVE_POINTER(pointer, array, count)                         \
+    if (pointer) {                                                          \
+        const uintptr_t resolved_index = (uintptr_t) (pointer) - 1;         \
+        if (resolved_index >= (count)) { return false; }                    \
+        (pointer) = &(array)[resolved_index];                               \
+    }
+
+//Appends a zeroed element, growing the array geometrically
+static void* gltf_array_push(void** io_array, uint32_t* io_count, uint32_t* io_capacity, size_t element_size) {
+    if (*io_count == *io_capacity) {
+        const uint32_t new_capacity = *io_capacity ? *io_capacity * 2 : 8;
+        void* new_array = realloc(*io_array, element_size * new_capacity);
+        if (!new_array) {
+            return NULL;
+        }
+        *io_array = new_array;
+        *io_capacity = new_capacity;
+    }
+    void* element = (uint8_t*) *io_array + element_size * (*io_count)++;
+    memset(element, 0, element_size);
+    return element;
+}
+
+#define GLTF_ARRAY_PUSH(type, array, count, capacity) ((type*) gltf_array_push((void**) &(array), &(count), &(capacity), sizeof(type)))
+
+//Reads a string that has to be one of names, returning its index
+static bool gltf_read_name(JsonParser* parser, const char* const* names, uint32_t num_names, uint32_t* out_index) {
+    JsonStringSpan span;
+    if (!json_reader_string_span(parser, &span)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_names; ++i) {
+        if (json_span_equals(&span, names[i])) {
+            *out_index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool gltf_read_buffer_extensions(JsonParser* parser, GltfBuffer* out_buffer) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "EXT_meshopt_compression")) {
+            uint32_t extension_member_count = 0;
+            JsonStringSpan extension_key;
+            while (json_reader_next_key(parser, &extension_member_count, &extension_key)) {
+                if (json_span_equals(&extension_key, "fallback")) {
+                    if (!json_reader_bool(parser, &out_buffer->is_fallback)) { return false; }
+                } else if (!json_reader_skip_value(parser)) {
+                    return false;
+                }
+            }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_buffer(JsonParser* parser, GltfBuffer* out_buffer) {
+    bool has_byte_length = false;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "byteLength")) {
+            if (!json_reader_uint64(parser, &out_buffer->byte_length)) { return false; }
+            has_byte_length = true;
+        } else if (json_span_equals(&key, "uri")) {
+            out_buffer->uri = json_reader_string(parser);
+            if (!out_buffer->uri) { return false; }
+        } else if (json_span_equals(&key, "extensions")) {
+            if (!gltf_read_buffer_extensions(parser, out_buffer)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && has_byte_length;
+}
+
+static bool gltf_read_meshopt_compression(JsonParser* parser, GltfMeshoptCompression* out_compression) {
+    static const char* mode_names[] = { "ATTRIBUTES", "TRIANGLES", "INDICES" };
+    static const char* filter_names[] = { "NONE", "OCTAHEDRAL", "QUATERNION", "EXPONENTIAL" };
+
+    bool has_buffer = false;
+    bool has_byte_length = false;
+    bool has_byte_stride = false;
+    bool has_count = false;
+    bool has_mode = false;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "buffer")) {
+            uint32_t buffer_index;
+            if (!json_reader_uint32(parser, &buffer_index)) { return false; }
+            out_compression->buffer = GLTF_INDEX_AS_POINTER(GltfBuffer, buffer_index);
+            has_buffer = true;
+        } else if (json_span_equals(&key, "byteOffset")) {
+            if (!json_reader_uint64(parser, &out_compression->byte_offset)) { return false; }
+        } else if (json_span_equals(&key, "byteLength")) {
+            if (!json_reader_uint64(parser, &out_compression->byte_length)) { return false; }
+            has_byte_length = true;
+        } else if (json_span_equals(&key, "byteStride")) {
+            if (!json_reader_uint32(parser, &out_compression->byte_stride)) { return false; }
+            has_byte_stride = true;
+        } else if (json_span_equals(&key, "count")) {
+            if (!json_reader_uint32(parser, &out_compression->count)) { return false; }
+            has_count = true;
+        } else if (json_span_equals(&key, "mode")) {
+            if (!gltf_read_name(parser, mode_names, sizeof(mode_names) / sizeof(mode_names[0]), (uint32_t*) &out_compression->mode)) { return false; }
+            has_mode = true;
+        } else if (json_span_equals(&key, "filter")) {
+            if (!gltf_read_name(parser, filter_names, sizeof(filter_names) / sizeof(filter_names[0]), (uint32_t*) &out_compression->filter)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && has_buffer && has_byte_length && has_byte_stride && has_count && has_mode;
+}
+
+static bool gltf_read_buffer_view_extensions(JsonParser* parser, GltfBufferView* out_buffer_view) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "EXT_meshopt_compression")) {
+            if (!gltf_read_meshopt_compression(parser, &out_buffer_view->meshopt_compression)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_buffer_view(JsonParser* parser, GltfBufferView* out_buffer_view) {
+    bool has_buffer = false;
+    bool has_byte_length = false;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "buffer")) {
+            uint32_t buffer_index;
+            if (!json_reader_uint32(parser, &buffer_index)) { return false; }
+            out_buffer_view->buffer = GLTF_INDEX_AS_POINTER(GltfBuffer, buffer_index);
+            has_buffer = true;
+        } else if (json_span_equals(&key, "byteLength")) {
+            if (!json_reader_uint64(parser, &out_buffer_view->byte_length)) { return false; }
+            has_byte_length = true;
+        } else if (json_span_equals(&key, "byteOffset")) {
+            if (!json_reader_uint64(parser, &out_buffer_view->byte_offset)) { return false; }
+        } else if (json_span_equals(&key, "byteStride")) {
+            if (!json_reader_uint32(parser, &out_buffer_view->byte_stride)) { return false; }
+        } else if (json_span_equals(&key, "extensions")) {
+            if (!gltf_read_buffer_view_extensions(parser, out_buffer_view)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && has_buffer && has_byte_length;
+}
+
+static bool gltf_read_accessor_type(JsonParser* parser, GltfAccessorType* out_accessor_type) {
+    static const char* accessor_type_names[] = { "SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4" };
+
+    uint32_t index;
+    if (!gltf_read_name(parser, accessor_type_names, sizeof(accessor_type_names) / sizeof(accessor_type_names[0]), &index)) {
+        return false;
+    }
+    *out_accessor_type = (GltfAccessorType) (GLTF_ACCESSOR_TYPE_SCALAR + index);
+    return true;
+}
+
+//Reads an accessor's min or max, which has at most 16 components (MAT4)
+static bool gltf_read_accessor_bound(JsonParser* parser, float* out_values, uint32_t* out_count) {
+    uint32_t element_count = 0;
+    while (json_reader_next_element(parser, &element_count)) {
+        if (element_count > 16 || !json_reader_float(parser, &out_values[element_count - 1])) {
+            return false;
+        }
+    }
+    *out_count = element_count;
+    return !parser->failed;
+}
+
+static bool gltf_read_accessor(JsonParser* parser, GltfAccessor* out_accessor) {
+    bool has_buffer_view = false;
+    bool has_component_type = false;
+    bool has_count = false;
+    bool has_type = false;
+    uint32_t num_min = 0;
+    uint32_t num_max = 0;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "bufferView")) {
+            uint32_t buffer_view_index;
+            if (!json_reader_uint32(parser, &buffer_view_index)) { return false; }
+            out_accessor->buffer_view = GLTF_INDEX_AS_POINTER(GltfBufferView, buffer_view_index);
+            has_buffer_view = true;
+        } else if (json_span_equals(&key, "componentType")) {
+            if (!json_reader_uint32(parser, (uint32_t*) &out_accessor->component_type)) { return false; }
+            has_component_type = true;
+        } else if (json_span_equals(&key, "count")) {
+            if (!json_reader_uint32(parser, &out_accessor->count)) { return false; }
+            has_count = true;
+        } else if (json_span_equals(&key, "type")) {
+            if (!gltf_read_accessor_type(parser, &out_accessor->accessor_type)) { return false; }
+            has_type = true;
+        } else if (json_span_equals(&key, "byteOffset")) {
+            if (!json_reader_uint64(parser, &out_accessor->byte_offset)) { return false; }
+        } else if (json_span_equals(&key, "normalized")) {
+            if (!json_reader_bool(parser, &out_accessor->normalized)) { return false; }
+        } else if (json_span_equals(&key, "min")) {
+            if (!gltf_read_accessor_bound(parser, out_accessor->min, &num_min)) { return false; }
+        } else if (json_span_equals(&key, "max")) {
+            if (!gltf_read_accessor_bound(parser, out_accessor->max, &num_max)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    //Bounds that don't match the type are ignored rather than failing the load
+    out_accessor->has_bounds = has_type && num_min == gltf_accessor_type_size(out_accessor->accessor_type) && num_max == num_min;
+    return !parser->failed && has_buffer_view && has_component_type && has_count && has_type;
+}
+
+static bool gltf_read_image(JsonParser* parser, GltfImage* out_image) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "bufferView")) {
+            uint32_t buffer_view_index;
+            if (!json_reader_uint32(parser, &buffer_view_index)) { return false; }
+            out_image->buffer_view = GLTF_INDEX_AS_POINTER(GltfBufferView, buffer_view_index);
+        } else if (json_span_equals(&key, "uri")) {
+            out_image->uri = json_reader_string(parser);
+            if (!out_image->uri) { return false; }
+        } else if (json_span_equals(&key, "mimeType")) {
+            out_image->mime_type = json_reader_string(parser);
+            if (!out_image->mime_type) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && (out_image->buffer_view || out_image->uri);
+}
+
+static bool gltf_read_texture(JsonParser* parser, GltfTexture* out_texture) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "source")) {
+            uint32_t image_index;
+            if (!json_reader_uint32(parser, &image_index)) { return false; }
+            out_texture->image = GLTF_INDEX_AS_POINTER(GltfImage, image_index);
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+//Reads a textureInfo object ({ "index": ..., "texCoord": ... })
+static bool gltf_read_texture_info(JsonParser* parser, GltfTexture** out_texture, uint32_t* out_tex_coord) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "index")) {
+            uint32_t texture_index;
+            if (!json_reader_uint32(parser, &texture_index)) { return false; }
+            *out_texture = GLTF_INDEX_AS_POINTER(GltfTexture, texture_index);
+        } else if (json_span_equals(&key, "texCoord")) {
+            if (!json_reader_uint32(parser, out_tex_coord)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_pbr_metallic_roughness(JsonParser* parser, GltfPbrMetallicRoughness* out_pbr_metallic_roughness) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        //TODO: base color factor
+        if (json_span_equals(&key, "baseColorTexture")) {
+            if (!gltf_read_texture_info(parser, &out_pbr_metallic_roughness->base_color_texture, &out_pbr_metallic_roughness->base_color_tex_coord)) { return false; }
+        } else if (json_span_equals(&key, "metallicFactor")) {
+            if (!json_reader_float(parser, &out_pbr_metallic_roughness->metallic_factor)) { return false; }
+        } else if (json_span_equals(&key, "roughnessFactor")) {
+            if (!json_reader_float(parser, &out_pbr_metallic_roughness->roughness_factor)) { return false; }
+        } else if (json_span_equals(&key, "metallicRoughnessTexture")) {
+            if (!gltf_read_texture_info(parser, &out_pbr_metallic_roughness->metallic_roughness_texture, &out_pbr_metallic_roughness->metallic_roughness_tex_coord)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_material(JsonParser* parser, GltfMaterial* out_material) {
+    out_material->pbr_metallic_roughness.metallic_factor = 1.0f;
+    out_material->pbr_metallic_roughness.roughness_factor = 1.0f;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "doubleSided")) {
+            if (!json_reader_bool(parser, &out_material->double_sided)) { return false; }
+        } else if (json_span_equals(&key, "pbrMetallicRoughness")) {
+            if (!gltf_read_pbr_metallic_roughness(parser, &out_material->pbr_metallic_roughness)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_primitive_attributes(JsonParser* parser, GltfPrimitive* out_primitive) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        GltfAccessor** accessor = NULL;
+        if (json_span_equals(&key, "POSITION"))        { accessor = &out_primitive->positions; }
+        else if (json_span_equals(&key, "NORMAL"))     { accessor = &out_primitive->normals; }
+        else if (json_span_equals(&key, "TEXCOORD_0")) { accessor = &out_primitive->texcoord0; }
+        else if (json_span_equals(&key, "JOINTS_0"))   { accessor = &out_primitive->joints0; }
+        else if (json_span_equals(&key, "WEIGHTS_0"))  { accessor = &out_primitive->weights0; }
+
+        if (accessor) {
+            uint32_t accessor_index;
+            if (!json_reader_uint32(parser, &accessor_index)) { return false; }
+            *accessor = GLTF_INDEX_AS_POINTER(GltfAccessor, accessor_index);
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_morph_target(JsonParser* parser, GltfMorphTarget* out_target) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "POSITION")) {
+            uint32_t accessor_index;
+            if (!json_reader_uint32(parser, &accessor_index)) { return false; }
+            out_target->positions = GLTF_INDEX_AS_POINTER(GltfAccessor, accessor_index);
+        } else if (json_span_equals(&key, "NORMAL")) {
+            uint32_t accessor_index;
+            if (!json_reader_uint32(parser, &accessor_index)) { return false; }
+            out_target->normals = GLTF_INDEX_AS_POINTER(GltfAccessor, accessor_index);
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+//Reads an array of floats of any length, appending to *io_values
+static bool gltf_read_float_list(JsonParser* parser, float** io_values, uint32_t* io_num_values) {
+    uint32_t capacity = *io_num_values;
+    uint32_t element_count = 0;
+    while (json_reader_next_element(parser, &element_count)) {
+        float* value = GLTF_ARRAY_PUSH(float, *io_values, *io_num_values, capacity);
+        if (!value || !json_reader_float(parser, value)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_primitive(JsonParser* parser, GltfPrimitive* out_primitive) {
+    //TODO: Primitive Topology (Triangle (4) is default, but check for others)
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "attributes")) {
+            if (!gltf_read_primitive_attributes(parser, out_primitive)) { return false; }
+        } else if (json_span_equals(&key, "indices")) {
+            uint32_t indices_index;
+            if (!json_reader_uint32(parser, &indices_index)) { return false; }
+            out_primitive->indices = GLTF_INDEX_AS_POINTER(GltfAccessor, indices_index);
+        } else if (json_span_equals(&key, "material")) {
+            uint32_t material_index;
+            if (!json_reader_uint32(parser, &material_index)) { return false; }
+            out_primitive->material = GLTF_INDEX_AS_POINTER(GltfMaterial, material_index);
+        } else if (json_span_equals(&key, "targets")) {
+            uint32_t targets_capacity = out_primitive->num_targets;
+            uint32_t element_count = 0;
+            while (json_reader_next_element(parser, &element_count)) {
+                GltfMorphTarget* target = GLTF_ARRAY_PUSH(GltfMorphTarget, out_primitive->targets, out_primitive->num_targets, targets_capacity);
+                if (!target || !gltf_read_morph_target(parser, target)) {
+                    return false;
+                }
+            }
+            if (parser->failed) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_mesh(JsonParser* parser, GltfMesh* out_mesh) {
+    bool has_primitives = false;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "name")) {
+            //Allocated from the asset's arena
+            out_mesh->name = json_reader_string(parser);
+            if (!out_mesh->name) { return false; }
+        } else if (json_span_equals(&key, "primitives")) {
+            uint32_t primitives_capacity = out_mesh->num_primitives;
+            uint32_t element_count = 0;
+            while (json_reader_next_element(parser, &element_count)) {
+                GltfPrimitive* primitive = GLTF_ARRAY_PUSH(GltfPrimitive, out_mesh->primitives, out_mesh->num_primitives, primitives_capacity);
+                if (!primitive || !gltf_read_primitive(parser, primitive)) {
+                    return false;
+                }
+            }
+            if (parser->failed) { return false; }
+            has_primitives = true;
+        } else if (json_span_equals(&key, "weights")) {
+            if (!gltf_read_float_list(parser, &out_mesh->weights, &out_mesh->num_weights)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && has_primitives;
+}
+
+//Reads an array of exactly count numbers
+static bool gltf_read_float_array(JsonParser* parser, float* out_values, uint32_t count) {
+    uint32_t element_count = 0;
+    while (json_reader_next_element(parser, &element_count)) {
+        if (element_count > count || !json_reader_float(parser, &out_values[element_count - 1])) {
+            return false;
+        }
+    }
+    return !parser->failed && element_count == count;
+}
+
+//Reads an array of node indices, stored as pointers until they're resolved
+static bool gltf_read_node_references(JsonParser* parser, GltfNode*** io_nodes, uint32_t* io_num_nodes) {
+    uint32_t capacity = *io_num_nodes;
+    uint32_t element_count = 0;
+    while (json_reader_next_element(parser, &element_count)) {
+        uint32_t node_index;
+        GltfNode** node = GLTF_ARRAY_PUSH(GltfNode*, *io_nodes, *io_num_nodes, capacity);
+        if (!node || !json_reader_uint32(parser, &node_index)) {
+            return false;
+        }
+        *node = GLTF_INDEX_AS_POINTER(GltfNode, node_index);
+    }
+    return !parser->failed;
+}
+
+//Splits a column major affine matrix into translation, rotation and scale. A negative determinant is folded into scale x.
+static void gltf_decompose_matrix(const float matrix[16], GltfNode* out_node) {
+    const float* columns[3] = { &matrix[0], &matrix[4], &matrix[8] };
+    memcpy(out_node->translation, &matrix[12], 3 * sizeof(float));
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        out_node->scale[i] = sqrtf(columns[i][0] * columns[i][0] + columns[i][1] * columns[i][1] + columns[i][2] * columns[i][2]);
+    }
+    const float determinant = columns[0][0] * (columns[1][1] * columns[2][2] - columns[1][2] * columns[2][1])
+                            - columns[1][0] * (columns[0][1] * columns[2][2] - columns[0][2] * columns[2][1])
+                            + columns[2][0] * (columns[0][1] * columns[1][2] - columns[0][2] * columns[1][1]);
+    if (determinant < 0.0f) {
+        out_node->scale[0] = -out_node->scale[0];
+    }
+
+    //r[row][column] of the pure rotation
+    float r[3][3];
+    for (uint32_t column = 0; column < 3; ++column) {
+        const float inverse_scale = out_node->scale[column] != 0.0f ? 1.0f / out_node->scale[column] : 0.0f;
+        for (uint32_t row = 0; row < 3; ++row) {
+            r[row][column] = columns[column][row] * inverse_scale;
+        }
+    }
+
+    float* q = out_node->rotation;
+    const float trace = r[0][0] + r[1][1] + r[2][2];
+    if (trace > 0.0f) {
+        const float s = sqrtf(trace + 1.0f) * 2.0f;
+        q[0] = (r[2][1] - r[1][2]) / s;
+        q[1] = (r[0][2] - r[2][0]) / s;
+        q[2] = (r[1][0] - r[0][1]) / s;
+        q[3] = 0.25f * s;
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        const float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+        q[0] = 0.25f * s;
+        q[1] = (r[0][1] + r[1][0]) / s;
+        q[2] = (r[0][2] + r[2][0]) / s;
+        q[3] = (r[2][1] - r[1][2]) / s;
+    } else if (r[1][1] > r[2][2]) {
+        const float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+        q[0] = (r[0][1] + r[1][0]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (r[1][2] + r[2][1]) / s;
+        q[3] = (r[0][2] - r[2][0]) / s;
+    } else {
+        const float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+        q[0] = (r[0][2] + r[2][0]) / s;
+        q[1] = (r[1][2] + r[2][1]) / s;
+        q[2] = 0.25f * s;
+        q[3] = (r[1][0] - r[0][1]) / s;
+    }
+
+    const float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (length > 0.0f) {
+        for (uint32_t i = 0; i < 4; ++i) { q[i] /= length; }
+    } else {
+        q[0] = q[1] = q[2] = 0.0f;
+        q[3] = 1.0f;
+    }
+}
+
+static bool gltf_read_node_extensions(JsonParser* parser, GltfNode* out_node) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "EXT_mesh_gpu_instancing")) {
+            uint32_t extension_member_count = 0;
+            JsonStringSpan extension_key;
+            while (json_reader_next_key(parser, &extension_member_count, &extension_key)) {
+                if (json_span_equals(&extension_key, "attributes")) {
+                    uint32_t attribute_count = 0;
+                    JsonStringSpan attribute;
+                    while (json_reader_next_key(parser, &attribute_count, &attribute)) {
+                        GltfAccessor** accessor = NULL;
+                        if (json_span_equals(&attribute, "TRANSLATION")) {
+                            accessor = &out_node->instance_translations;
+                        } else if (json_span_equals(&attribute, "ROTATION")) {
+                            accessor = &out_node->instance_rotations;
+                        } else if (json_span_equals(&attribute, "SCALE")) {
+                            accessor = &out_node->instance_scales;
+                        }
+
+                        //Custom attributes (e.g. _ID) aren't used
+                        if (!accessor) {
+                            if (!json_reader_skip_value(parser)) { return false; }
+                            continue;
+                        }
+                        uint32_t accessor_index;
+                        if (!json_reader_uint32(parser, &accessor_index)) { return false; }
+                        *accessor = GLTF_INDEX_AS_POINTER(GltfAccessor, accessor_index);
+                    }
+                } else if (!json_reader_skip_value(parser)) {
+                    return false;
+                }
+            }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_node(JsonParser* parser, GltfNode* out_node) {
+    out_node->rotation[3] = 1.0f;
+    out_node->scale[0] = out_node->scale[1] = out_node->scale[2] = 1.0f;
+
+    bool has_matrix = false;
+    float matrix[16];
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "name")) {
+            out_node->name = json_reader_string(parser);
+            if (!out_node->name) { return false; }
+        } else if (json_span_equals(&key, "mesh")) {
+            uint32_t mesh_index;
+            if (!json_reader_uint32(parser, &mesh_index)) { return false; }
+            out_node->mesh = GLTF_INDEX_AS_POINTER(GltfMesh, mesh_index);
+        } else if (json_span_equals(&key, "skin")) {
+            uint32_t skin_index;
+            if (!json_reader_uint32(parser, &skin_index)) { return false; }
+            out_node->skin = GLTF_INDEX_AS_POINTER(GltfSkin, skin_index);
+        } else if (json_span_equals(&key, "children")) {
+            if (!gltf_read_node_references(parser, &out_node->children, &out_node->num_children)) { return false; }
+        } else if (json_span_equals(&key, "matrix")) {
+            if (!gltf_read_float_array(parser, matrix, 16)) { return false; }
+            has_matrix = true;
+        } else if (json_span_equals(&key, "translation")) {
+            if (!gltf_read_float_array(parser, out_node->translation, 3)) { return false; }
+        } else if (json_span_equals(&key, "rotation")) {
+            if (!gltf_read_float_array(parser, out_node->rotation, 4)) { return false; }
+        } else if (json_span_equals(&key, "scale")) {
+            if (!gltf_read_float_array(parser, out_node->scale, 3)) { return false; }
+        } else if (json_span_equals(&key, "weights")) {
+            if (!gltf_read_float_list(parser, &out_node->weights, &out_node->num_weights)) { return false; }
+        } else if (json_span_equals(&key, "extensions")) {
+            if (!gltf_read_node_extensions(parser, out_node)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+
+    if (has_matrix) {
+        gltf_decompose_matrix(matrix, out_node);
+    }
+    return !parser->failed;
+}
+
+static bool gltf_read_skin(JsonParser* parser, GltfSkin* out_skin) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "name")) {
+            out_skin->name = json_reader_string(parser);
+            if (!out_skin->name) { return false; }
+        } else if (json_span_equals(&key, "inverseBindMatrices")) {
+            uint32_t accessor_index;
+            if (!json_reader_uint32(parser, &accessor_index)) { return false; }
+            out_skin->inverse_bind_matrices = GLTF_INDEX_AS_POINTER(GltfAccessor, accessor_index);
+        } else if (json_span_equals(&key, "skeleton")) {
+            uint32_t node_index;
+            if (!json_reader_uint32(parser, &node_index)) { return false; }
+            out_skin->skeleton = GLTF_INDEX_AS_POINTER(GltfNode, node_index);
+        } else if (json_span_equals(&key, "joints")) {
+            if (!gltf_read_node_references(parser, &out_skin->joints, &out_skin->num_joints)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && out_skin->num_joints > 0;
+}
+
+static bool gltf_read_scene(JsonParser* parser, GltfScene* out_scene) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "name")) {
+            out_scene->name = json_reader_string(parser);
+            if (!out_scene->name) { return false; }
+        } else if (json_span_equals(&key, "nodes")) {
+            if (!gltf_read_node_references(parser, &out_scene->nodes, &out_scene->num_nodes)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
 }
 
-bool gltf_load_asset(const char* filename, GltfAsset* out_asset) {
+static bool gltf_read_animation_sampler(JsonParser* parser, GltfAnimationSampler* out_sampler) {
+    static const char* interpolation_names[] = { "LINEAR", "STEP", "CUBICSPLINE" };
+
+    bool has_input = false;
+    bool has_output = false;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "input")) {
+            uint32_t accessor_index;
+            if (!json_reader_uint32(parser, &accessor_index)) { return false; }
+            out_sampler->input = GLTF_INDEX_AS_POINTER(GltfAccessor, accessor_index);
+            has_input = true;
+        } else if (json_span_equals(&key, "output")) {
+            uint32_t accessor_index;
+            if (!json_reader_uint32(parser, &accessor_index)) { return false; }
+            out_sampler->output = GLTF_INDEX_AS_POINTER(GltfAccessor, accessor_index);
+            has_output = true;
+        } else if (json_span_equals(&key, "interpolation")) {
+            if (!gltf_read_name(parser, interpolation_names, sizeof(interpolation_names) / sizeof(interpolation_names[0]), (uint32_t*) &out_sampler->interpolation)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && has_input && has_output;
+}
 
-    //TODO: check extension, add functions for GLB and GLTF (only GLB is currently supported)
+static bool gltf_read_animation_channel(JsonParser* parser, GltfAnimationChannel* out_channel) {
+    static const char* path_names[] = { "translation", "rotation", "scale", "weights" };
+
+    bool has_sampler = false;
+    bool has_path = false;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "sampler")) {
+            uint32_t sampler_index;
+            if (!json_reader_uint32(parser, &sampler_index)) { return false; }
+            out_channel->sampler = GLTF_INDEX_AS_POINTER(GltfAnimationSampler, sampler_index);
+            has_sampler = true;
+        } else if (json_span_equals(&key, "target")) {
+            uint32_t target_member_count = 0;
+            JsonStringSpan target_key;
+            while (json_reader_next_key(parser, &target_member_count, &target_key)) {
+                if (json_span_equals(&target_key, "node")) {
+                    uint32_t node_index;
+                    if (!json_reader_uint32(parser, &node_index)) { return false; }
+                    out_channel->node = GLTF_INDEX_AS_POINTER(GltfNode, node_index);
+                } else if (json_span_equals(&target_key, "path")) {
+                    //Paths added by extensions (e.g. KHR_animation_pointer's "pointer") fail here
+                    if (!gltf_read_name(parser, path_names, sizeof(path_names) / sizeof(path_names[0]), (uint32_t*) &out_channel->path)) { return false; }
+                    has_path = true;
+                } else if (!json_reader_skip_value(parser)) {
+                    return false;
+                }
+            }
+            if (parser->failed) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed && has_sampler && has_path;
+}
 
-    FILE* file = open_binary_file(filename);
+static bool gltf_read_animation(JsonParser* parser, GltfAnimation* out_animation) {
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "name")) {
+            out_animation->name = json_reader_string(parser);
+            if (!out_animation->name) { return false; }
+        } else if (json_span_equals(&key, "samplers")) {
+            uint32_t capacity = out_animation->num_samplers;
+            uint32_t element_count = 0;
+            while (json_reader_next_element(parser, &element_count)) {
+                GltfAnimationSampler* sampler = GLTF_ARRAY_PUSH(GltfAnimationSampler, out_animation->samplers, out_animation->num_samplers, capacity);
+                if (!sampler || !gltf_read_animation_sampler(parser, sampler)) {
+                    return false;
+                }
+            }
+            if (parser->failed) { return false; }
+        } else if (json_span_equals(&key, "channels")) {
+            uint32_t capacity = out_animation->num_channels;
+            uint32_t element_count = 0;
+            while (json_reader_next_element(parser, &element_count)) {
+                GltfAnimationChannel* channel = GLTF_ARRAY_PUSH(GltfAnimationChannel, out_animation->channels, out_animation->num_channels, capacity);
+                if (!channel || !gltf_read_animation_channel(parser, channel)) {
+                    return false;
+                }
+            }
+            if (parser->failed) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            return false;
+        }
+    }
+    return !parser->failed;
+}
 
-    if (file && out_asset)
-    {
-        // HEADER
-        uint32_t magic, version, length;
-        if (fread(&magic, 4, 1, file) == 1 && magic == GLTF_MAGIC_NUMBER) {
-            printf("We have GLTF Binary!\n");
+//Extensions the loader understands. KHR_mesh_quantization only widens the allowed accessor component types (see gltf_accessor_unpack_floats),
+//EXT_meshopt_compression buffer views are decoded by gltf_decode_meshopt_buffer_views, EXT_mesh_gpu_instancing is read with the nodes.
+static const char* GLTF_SUPPORTED_EXTENSIONS[] = {
+    "KHR_mesh_quantization",
+    "EXT_meshopt_compression",
+    "EXT_mesh_gpu_instancing",
+};
+
+//Fails if the asset requires an extension that isn't in GLTF_SUPPORTED_EXTENSIONS
+static bool gltf_read_extensions_required(JsonParser* parser) {
+    uint32_t element_count = 0;
+    while (json_reader_next_element(parser, &element_count)) {
+        JsonStringSpan extension;
+        if (!json_reader_string_span(parser, &extension)) {
+            return false;
         }
-        if (fread(&version, 4, 1, file) == 1) {
-            printf("Version: %i\n", version);
+
+        bool supported = false;
+        for (uint32_t i = 0; i < sizeof(GLTF_SUPPORTED_EXTENSIONS) / sizeof(GLTF_SUPPORTED_EXTENSIONS[0]); ++i) {
+            supported |= json_span_equals(&extension, GLTF_SUPPORTED_EXTENSIONS[i]);
         }
-        if (fread(&length, 4, 1, file) == 1) {
-            printf("Length: %i\n", length);
+        if (!supported) {
+            printf("Unsupported required glTF extension: %.*s\n", (int) (extension.end - extension.begin), extension.begin);
+            return false;
         }
+    }
+    return !parser->failed;
+}
+
+//Reads each element of a top-level array with read_element. Elements are zeroed before being read.
+#define GLTF_READ_ARRAY(parser, type, array, count, read_element)                           \
+    {                                                                                       \
+        uint32_t capacity = count;                                                          \
+        uint32_t element_count = 0;                                                         \
+        while (json_reader_next_element(parser, &element_count)) {                          \
+            type* element = GLTF_ARRAY_PUSH(type, array, count, capacity);                  \
+            if (!element || !read_element(parser, element)) {                               \
+                return false;                                                               \
+            }                                                                               \
+        }                                                                                   \
+        if ((parser)->failed) { return false; }                                             \
+    }
 
-        // JSON
-        uint32_t json_length, json_type;
-        if (fread(&json_length, 4, 1, file) == 1) {
-            printf("Json Length: %i\n", json_length);
+static bool gltf_read_json(JsonParser* parser, GltfAsset* out_asset) {
+    bool has_buffer_views = false;
+    bool has_accessors = false;
+    bool has_meshes = false;
+
+    uint32_t member_count = 0;
+    JsonStringSpan key;
+    while (json_reader_next_key(parser, &member_count, &key)) {
+        if (json_span_equals(&key, "buffers")) {
+            GLTF_READ_ARRAY(parser, GltfBuffer, out_asset->buffers, out_asset->num_buffers, gltf_read_buffer);
+        } else if (json_span_equals(&key, "bufferViews")) {
+            GLTF_READ_ARRAY(parser, GltfBufferView, out_asset->buffer_views, out_asset->num_buffer_views, gltf_read_buffer_view);
+            has_buffer_views = true;
+        } else if (json_span_equals(&key, "accessors")) {
+            GLTF_READ_ARRAY(parser, GltfAccessor, out_asset->accessors, out_asset->num_accessors, gltf_read_accessor);
+            has_accessors = true;
+        } else if (json_span_equals(&key, "images")) {
+            GLTF_READ_ARRAY(parser, GltfImage, out_asset->images, out_asset->num_images, gltf_read_image);
+        } else if (json_span_equals(&key, "textures")) {
+            GLTF_READ_ARRAY(parser, GltfTexture, out_asset->textures, out_asset->num_textures, gltf_read_texture);
+        } else if (json_span_equals(&key, "materials")) {
+            GLTF_READ_ARRAY(parser, GltfMaterial, out_asset->materials, out_asset->num_materials, gltf_read_material);
+        } else if (json_span_equals(&key, "meshes")) {
+            GLTF_READ_ARRAY(parser, GltfMesh, out_asset->meshes, out_asset->num_meshes, gltf_read_mesh);
+            has_meshes = true;
+        } else if (json_span_equals(&key, "nodes")) {
+            GLTF_READ_ARRAY(parser, GltfNode, out_asset->nodes, out_asset->num_nodes, gltf_read_node);
+        } else if (json_span_equals(&key, "skins")) {
+            GLTF_READ_ARRAY(parser, GltfSkin, out_asset->skins, out_asset->num_skins, gltf_read_skin);
+        } else if (json_span_equals(&key, "scenes")) {
+            GLTF_READ_ARRAY(parser, GltfScene, out_asset->scenes, out_asset->num_scenes, gltf_read_scene);
+        } else if (json_span_equals(&key, "scene")) {
+            uint32_t scene_index;
+            if (!json_reader_uint32(parser, &scene_index)) { return false; }
+            out_asset->scene = GLTF_INDEX_AS_POINTER(GltfScene, scene_index);
+        } else if (json_span_equals(&key, "animations")) {
+            GLTF_READ_ARRAY(parser, GltfAnimation, out_asset->animations, out_asset->num_animations, gltf_read_animation);
+        } else if (json_span_equals(&key, "extensionsRequired")) {
+            if (!gltf_read_extensions_required(parser)) { return false; }
+        } else if (!json_reader_skip_value(parser)) {
+            //TODO: Samplers
+            return false;
         }
-        if (fread(&json_type, 4, 1, file) == 1 && json_type == GLTF_CHUNK_TYPE_JSON) {
-            printf("Found Json Chunk\n");
+    }
+    return !parser->failed && has_buffer_views && has_accessors && has_meshes;
+}
+
+//Turns the indices stored by the gltf_read_* functions into pointers, failing on out of range indices
+static bool gltf_resolve_references(GltfAsset* asset) {
+    for (uint32_t i = 0; i < asset->num_buffer_views; ++i) {
+        GltfBufferView* buffer_view = &asset->buffer_views[i];
+        GLTF_RESOLVE_POINTER(buffer_view->buffer, asset->buffers, asset->num_buffers);
+        if (!buffer_view->buffer->data || buffer_view->byte_offset > buffer_view->buffer->byte_length
+            || buffer_view->byte_length > buffer_view->buffer->byte_length - buffer_view->byte_offset) {
+            return false;
         }
 
-        char* json_string = (char*) malloc(json_length + 1);
-        json_string[json_length] = '\0'; //Null-terminate string
+        GltfMeshoptCompression* compression = &buffer_view->meshopt_compression;
+        GLTF_RESOLVE_POINTER(compression->buffer, asset->buffers, asset->num_buffers);
+        if (compression->buffer) {
+            if (!compression->buffer->data || compression->byte_offset > compression->buffer->byte_length
+                || compression->byte_length > compression->buffer->byte_length - compression->byte_offset
+                || (uint64_t) compression->count * compression->byte_stride > buffer_view->byte_length) {
+                return false;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < asset->num_accessors; ++i) {
+        GltfAccessor* accessor = &asset->accessors[i];
+        GLTF_RESOLVE_POINTER(accessor->buffer_view, asset->buffer_views, asset->num_buffer_views);
+
+        //The last element has to end inside the buffer view
+        if (accessor->count > 0) {
+            const uint64_t data_size = (uint64_t) gltf_accessor_get_stride(accessor) * (accessor->count - 1) + gltf_accessor_get_element_size(accessor);
+            if (accessor->byte_offset > accessor->buffer_view->byte_length || data_size > accessor->buffer_view->byte_length - accessor->byte_offset) {
+                return false;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < asset->num_images; ++i) {
+        GltfImage* image = &asset->images[i];
+        GLTF_RESOLVE_POINTER(image->buffer_view, asset->buffer_views, asset->num_buffer_views);
+        if (image->buffer_view) {
+            image->data = image->buffer_view->buffer->data + image->buffer_view->byte_offset;
+            image->data_size = image->buffer_view->byte_length;
+        }
+    }
+    for (uint32_t i = 0; i < asset->num_textures; ++i) {
+        GLTF_RESOLVE_POINTER(asset->textures[i].image, asset->images, asset->num_images);
+    }
+    for (uint32_t i = 0; i < asset->num_materials; ++i) {
+        GltfPbrMetallicRoughness* pbr_metallic_roughness = &asset->materials[i].pbr_metallic_roughness;
+        GLTF_RESOLVE_POINTER(pbr_metallic_roughness->base_color_texture, asset->textures, asset->num_textures);
+        GLTF_RESOLVE_POINTER(pbr_metallic_roughness->metallic_roughness_texture, asset->textures, asset->num_textures);
+    }
+    for (uint32_t i = 0; i < asset->num_meshes; ++i) {
+        GltfMesh* mesh = &asset->meshes[i];
+        for (uint32_t j = 0; j < mesh->num_primitives; ++j) {
+            GltfPrimitive* primitive = &mesh->primitives[j];
+            GLTF_RESOLVE_POINTER(primitive->positions, asset->accessors, asset->num_accessors);
+            GLTF_RESOLVE_POINTER(primitive->normals, asset->accessors, asset->num_accessors);
+            GLTF_RESOLVE_POINTER(primitive->texcoord0, asset->accessors, asset->num_accessors);
+            GLTF_RESOLVE_POINTER(primitive->joints0, asset->accessors, asset->num_accessors);
+            GLTF_RESOLVE_POINTER(primitive->weights0, asset->accessors, asset->num_accessors);
+            GLTF_RESOLVE_POINTER(primitive->indices, asset->accessors, asset->num_accessors);
+            GLTF_RESOLVE_POINTER(primitive->material, asset->materials, asset->num_materials);
+            for (uint32_t k = 0; k < primitive->num_targets; ++k) {
+                GLTF_RESOLVE_POINTER(primitive->targets[k].positions, asset->accessors, asset->num_accessors);
+                GLTF_RESOLVE_POINTER(primitive->targets[k].normals, asset->accessors, asset->num_accessors);
+            }
+        }
+    }
+    //Nodes form a forest: every node has at most one parent and scene roots have none.
+    //Cycles can't be reached from a root, so walking down from the roots always terminates.
+    for (uint32_t i = 0; i < asset->num_nodes; ++i) {
+        GltfNode* node = &asset->nodes[i];
+        GLTF_RESOLVE_POINTER(node->mesh, asset->meshes, asset->num_meshes);
+        GLTF_RESOLVE_POINTER(node->skin, asset->skins, asset->num_skins);
+        GLTF_RESOLVE_POINTER(node->instance_translations, asset->accessors, asset->num_accessors);
+        GLTF_RESOLVE_POINTER(node->instance_rotations, asset->accessors, asset->num_accessors);
+        GLTF_RESOLVE_POINTER(node->instance_scales, asset->accessors, asset->num_accessors);
+        const GltfAccessor* instance_attributes[3] = { node->instance_translations, node->instance_rotations, node->instance_scales };
+        const GltfAccessorType instance_attribute_types[3] = { GLTF_ACCESSOR_TYPE_VEC3, GLTF_ACCESSOR_TYPE_VEC4, GLTF_ACCESSOR_TYPE_VEC3 };
+        for (uint32_t j = 0; j < 3; ++j) {
+            if (!instance_attributes[j]) {
+                continue;
+            }
+            if (instance_attributes[j]->accessor_type != instance_attribute_types[j] || instance_attributes[j]->count == 0
+                || (node->num_instances != 0 && instance_attributes[j]->count != node->num_instances)) {
+                return false;
+            }
+            node->num_instances = instance_attributes[j]->count;
+        }
+        for (uint32_t j = 0; j < node->num_children; ++j) {
+            GLTF_RESOLVE_POINTER(node->children[j], asset->nodes, asset->num_nodes);
+            if (node->children[j]->parent || node->children[j] == node) {
+                return false;
+            }
+            node->children[j]->parent = node;
+        }
+    }
+    for (uint32_t i = 0; i < asset->num_scenes; ++i) {
+        GltfScene* scene = &asset->scenes[i];
+        for (uint32_t j = 0; j < scene->num_nodes; ++j) {
+            GLTF_RESOLVE_POINTER(scene->nodes[j], asset->nodes, asset->num_nodes);
+            if (scene->nodes[j]->parent) {
+                return false;
+            }
+        }
+    }
+    GLTF_RESOLVE_POINTER(asset->scene, asset->scenes, asset->num_scenes);
+    for (uint32_t i = 0; i < asset->num_skins; ++i) {
+        GltfSkin* skin = &asset->skins[i];
+        GLTF_RESOLVE_POINTER(skin->inverse_bind_matrices, asset->accessors, asset->num_accessors);
+        GLTF_RESOLVE_POINTER(skin->skeleton, asset->nodes, asset->num_nodes);
+        for (uint32_t j = 0; j < skin->num_joints; ++j) {
+            GLTF_RESOLVE_POINTER(skin->joints[j], asset->nodes, asset->num_nodes);
+        }
+        const GltfAccessor* inverse_bind_matrices = skin->inverse_bind_matrices;
+        if (inverse_bind_matrices && (inverse_bind_matrices->accessor_type != GLTF_ACCESSOR_TYPE_MAT4
+                                      || inverse_bind_matrices->component_type != GLTF_COMPONENT_TYPE_FLOAT
+                                      || inverse_bind_matrices->count < skin->num_joints)) {
+            return false;
+        }
+    }
+    //Sampler data is checked against the path of every channel using it: times are scalar floats,
+    //and there's one output element per keyframe (three for cubic splines), times the number of morph targets for weights
+    for (uint32_t i = 0; i < asset->num_animations; ++i) {
+        GltfAnimation* animation = &asset->animations[i];
+        for (uint32_t j = 0; j < animation->num_samplers; ++j) {
+            GltfAnimationSampler* sampler = &animation->samplers[j];
+            GLTF_RESOLVE_POINTER(sampler->input, asset->accessors, asset->num_accessors);
+            GLTF_RESOLVE_POINTER(sampler->output, asset->accessors, asset->num_accessors);
+            if (sampler->input->accessor_type != GLTF_ACCESSOR_TYPE_SCALAR || sampler->input->component_type != GLTF_COMPONENT_TYPE_FLOAT
+                || sampler->input->count == 0) {
+                return false;
+            }
+        }
+        for (uint32_t j = 0; j < animation->num_channels; ++j) {
+            GltfAnimationChannel* channel = &animation->channels[j];
+            GLTF_RESOLVE_POINTER(channel->sampler, animation->samplers, animation->num_samplers);
+            GLTF_RESOLVE_POINTER(channel->node, asset->nodes, asset->num_nodes);
+
+            const GltfAnimationSampler* sampler = channel->sampler;
+            const uint32_t keyframe_elements = sampler->input->count * (sampler->interpolation == GLTF_INTERPOLATION_CUBICSPLINE ? 3 : 1);
+            GltfAccessorType expected_type = GLTF_ACCESSOR_TYPE_SCALAR;
+            uint32_t values_per_keyframe = 1;
+            switch (channel->path) {
+                case GLTF_ANIMATION_PATH_TRANSLATION:
+                case GLTF_ANIMATION_PATH_SCALE:
+                    expected_type = GLTF_ACCESSOR_TYPE_VEC3;
+                    break;
+                case GLTF_ANIMATION_PATH_ROTATION:
+                    expected_type = GLTF_ACCESSOR_TYPE_VEC4;
+                    break;
+                case GLTF_ANIMATION_PATH_WEIGHTS:
+                    values_per_keyframe = sampler->output->count / keyframe_elements;
+                    break;
+            }
+            if (sampler->output->accessor_type != expected_type || values_per_keyframe == 0
+                || sampler->output->count != keyframe_elements * values_per_keyframe) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-        if (fread(json_string, json_length, 1, file) != 0) {
-            printf("json data: %s\n", json_string);
-            char* modified_json_string = json_string;
-            const bool succeeded = parse_json_object(&modified_json_string, &out_asset->json);
-            //TODO: Make sure to clean up invalid json if we fail to parse it
+//Reads the glTF json (a .gltf file, or the json chunk of a .glb) in place into out_asset
+static bool gltf_parse_json(const GltfLoadOptions* options, const char* json_string, uint32_t json_length, GltfAsset* out_asset) {
+    #ifdef GLTF_PRINT_JSON
+    {
+        GltfArena print_arena;
+        memset(&print_arena, 0, sizeof(GltfArena));
+        JsonObject json;
+        if (json_parse(json_string, json_length, &print_arena, &json)) {
+            print_json_object(&json, 0, stdout);
         }
+        gltf_arena_free(&print_arena);
+    }
+    #endif
 
-        print_json_object(&out_asset->json, 0, stdout);
+    const double parse_start = gltf_get_time_seconds();
+
+    JsonParser parser;
+    memset(&parser, 0, sizeof(JsonParser));
+    parser.begin = json_string;
+    parser.cursor = json_string;
+    parser.end = json_string + json_length;
+    parser.arena = &out_asset->arena;
+
+    JsonStructuralIndex structural_index;
+    memset(&structural_index, 0, sizeof(JsonStructuralIndex));
+    const bool use_structural_index = options && (options->flags & GLTF_LOAD_FLAGS_STRUCTURAL_INDEX);
+    bool json_succeeded = true;
+    if (use_structural_index) {
+        json_succeeded = json_build_structural_index(json_string, json_length, &structural_index);
+        parser.structural_offsets = structural_index.offsets;
+        parser.structural_count = structural_index.count;
+    }
 
-        free(json_string);
-        json_string = NULL;
+    json_succeeded = json_succeeded && gltf_read_json(&parser, out_asset);
+    json_free_structural_index(&structural_index);
 
-        //BUFFERS
-        {
-            //Note: .glb files only use only 1 buffer chunk
-            
-            out_asset->num_buffers = 0;
-            out_asset->buffers = NULL;
+    const double parse_seconds = gltf_get_time_seconds() - parse_start;
 
-            uint32_t buffer_length;
-            while (fread(&buffer_length, 4, 1, file) == 1) {
-                // Increment num_buffers and realloc
-                out_asset->num_buffers++;
-                out_asset->buffers = (GltfBuffer*) realloc(out_asset->buffers, sizeof(GltfBuffer) * out_asset->num_buffers);
+    const double json_megabytes = (double) json_length / (1024.0 * 1024.0);
+    printf("Json Parse: %.2f MB in %.3f ms (%.1f MB/s)\n", json_megabytes, parse_seconds * 1000.0, parse_seconds > 0.0 ? json_megabytes / parse_seconds : 0.0);
 
-                printf("Buffer Length: %i\n", buffer_length);
+    return json_succeeded;
+}
 
-                uint32_t buffer_type = 0;
-                if (fread(&buffer_type, 4, 1, file) != 1 || buffer_type != GLTF_CHUNK_TYPE_BUFFER) {
-                    return false;
-                }
+//Parses a GLB whose bytes are in out_asset->file. On failure, the caller frees out_asset
+static bool gltf_parse_glb(const GltfLoadOptions* options, GltfAsset* out_asset) {
+    const uint8_t* file_data = out_asset->file.data;
+    const uint64_t file_size = out_asset->file.size;
 
-                uint8_t* buffer_data = (uint8_t*) malloc(buffer_length);
-                if (fread(buffer_data, buffer_length, 1, file) == 1) {
-                    out_asset->buffers[out_asset->num_buffers - 1].byte_length = buffer_length;
-                    out_asset->buffers[out_asset->num_buffers - 1].data = buffer_data;
-                } else {
-                    return false;
-                }
-            }
-        }
+    // HEADER
+    uint32_t header[3];
+    if (file_size < sizeof(header)) {
+        return false;
+    }
+    memcpy(header, file_data, sizeof(header));
 
-        //BUFFER VIEWS
-        {
-            const JsonArray* json_buffer_views = json_object_get_array(&out_asset->json, "bufferViews");
-            if (!json_buffer_views) {
-                return false;
-            }
+    const uint32_t magic = header[0], version = header[1], length = header[2];
+    if (magic != GLTF_MAGIC_NUMBER) {
+        return false;
+    }
+    printf("Version: %u\n", version);
+    printf("Length: %u\n", length);
 
-            out_asset->num_buffer_views = json_buffer_views->count;
-            out_asset->buffer_views = (GltfBufferView*) calloc(sizeof(GltfBufferView), out_asset->num_buffer_views);
+    // JSON
+    uint64_t offset = sizeof(header);
+    GltfChunkHeader json_header;
+    if (offset + sizeof(GltfChunkHeader) > file_size) {
+        return false;
+    }
+    memcpy(&json_header, file_data + offset, sizeof(GltfChunkHeader));
+    offset += sizeof(GltfChunkHeader);
 
-            for (uint32_t i = 0; i < out_asset->num_buffer_views; ++i) {
-                GltfBufferView* buffer_view = &out_asset->buffer_views[i];
-                const JsonObject* json_buffer_view = json_array_get_object(json_buffer_views, i);
-            
-                uint32_t buffer_index = 0;
-                if (json_value_as_uint32(json_object_get_value(json_buffer_view, "buffer"), &buffer_index) && buffer_index < out_asset->num_buffers) {
-                    buffer_view->buffer = &out_asset->buffers[buffer_index];
-                } else {
-                    return false;
-                }
+    if (json_header.type != GLTF_CHUNK_TYPE_JSON || offset + json_header.length > file_size) {
+        return false;
+    }
+    printf("Json Length: %u\n", json_header.length);
 
-                if (!json_value_as_uint32(json_object_get_value(json_buffer_view, "byteLength"), &buffer_view->byte_length)) {
-                    return false;
-                }
+    //The json chunk is parsed in place
+    const char* json_string = (const char*) (file_data + offset);
+    offset += json_header.length;
 
-                json_value_as_uint32(json_object_get_value(json_buffer_view, "byteOffset"), &buffer_view->byte_offset);
-            }
+    if (!gltf_parse_json(options, json_string, json_header.length, out_asset)) {
+        return false;
+    }
+
+    //BINARY CHUNK
+    //Optional, and only used by the first buffer, which then has no uri (and isn't an EXT_meshopt_compression fallback)
+    if (offset + sizeof(GltfChunkHeader) <= file_size) {
+        GltfChunkHeader buffer_header;
+        memcpy(&buffer_header, file_data + offset, sizeof(GltfChunkHeader));
+        offset += sizeof(GltfChunkHeader);
+
+        if (buffer_header.type != GLTF_CHUNK_TYPE_BUFFER || offset + buffer_header.length > file_size) {
+            return false;
         }
 
-        //ACCESSORS
-        {
-            const JsonArray* json_accessors = json_object_get_array(&out_asset->json, "accessors");
-            if (!json_accessors) {
+        printf("Buffer Length: %u\n", buffer_header.length);
+
+        //Buffers point into the file data (heap or mapping), which the asset owns
+        if (out_asset->num_buffers > 0 && !out_asset->buffers[0].uri && !out_asset->buffers[0].is_fallback) {
+            if (out_asset->buffers[0].byte_length > buffer_header.length) {
                 return false;
             }
+            out_asset->buffers[0].data = file_data + offset;
+        }
+    }
 
-            out_asset->num_accessors = json_accessors->count;
-            out_asset->accessors = (GltfAccessor*) calloc(sizeof(GltfAccessor), out_asset->num_accessors);
+    return true;
+}
 
-            for (uint32_t i = 0; i < out_asset->num_accessors; ++i) {
-                GltfAccessor* accessor = &out_asset->accessors[i];
-                const JsonObject* json_accessor = json_array_get_object(json_accessors, i);
-            
-                uint32_t buffer_view_index = 0;
-                if (json_value_as_uint32(json_object_get_value(json_accessor, "bufferView"), &buffer_view_index) && buffer_view_index < out_asset->num_buffer_views) {
-                    accessor->buffer_view = &out_asset->buffer_views[buffer_view_index];
-                } else {
-                    return false;
-                }
+//EXTERNAL RESOURCES
+//Buffers and images with a uri are loaded once the json has been read. Each external file and each chunk of base64 is an
+//independent job, so options->parallel_for can spread them across threads.
+
+#define GLTF_BASE64_JOB_LENGTH (4 * 1024 * 1024) //Characters per base64 job, must be a multiple of 4
+
+typedef struct GltfResourceJob {
+    //External file jobs
+    const char* path;
+    GltfFileData* out_file;
+    bool use_memory_map;
+
+    //Base64 jobs
+    const char* base64;
+    size_t base64_length;
+    uint8_t* out_data;
+
+    bool succeeded;
+} GltfResourceJob;
+
+static void gltf_run_resource_jobs(void* task_data, uint32_t begin, uint32_t end) {
+    GltfResourceJob* jobs = (GltfResourceJob*) task_data;
+    for (uint32_t i = begin; i < end; ++i) {
+        GltfResourceJob* job = &jobs[i];
+        if (job->path) {
+            job->succeeded = job->use_memory_map ? gltf_file_map(job->path, job->out_file) : gltf_file_read(job->path, job->out_file);
+        } else {
+            job->succeeded = gltf_base64_decode(job->base64, job->base64_length, job->out_data);
+        }
+    }
+}
 
-                if (!json_value_as_uint32(json_object_get_value(json_accessor, "componentType"), (uint32_t*) &accessor->component_type)) {
-                    return false;
-                }
-                if (!json_value_as_uint32(json_object_get_value(json_accessor, "count"), &accessor->count)) {
-                    return false;
-                }
-                const char* type_string = NULL;
-                if (json_value_as_string(json_object_get_value(json_accessor, "type"), &type_string)) {
-                    accessor->accessor_type = str_to_gltf_accessor_type(type_string);
-                }
+static inline bool gltf_uri_is_data(const char* uri) {
+    return strncmp(uri, "data:", 5) == 0;
+}
 
-                json_value_as_uint32(json_object_get_value(json_accessor, "byteOffset"), &accessor->byte_offset);
-            }
+//Resolves a relative uri against the directory of gltf_filename, decoding %XX escapes. Allocated from the arena.
+static char* gltf_resolve_uri_path(GltfArena* arena, const char* gltf_filename, const char* uri) {
+    const char* last_slash = strrchr(gltf_filename, '/');
+    const char* last_backslash = strrchr(gltf_filename, '\\');
+    if (last_backslash > last_slash) {
+        last_slash = last_backslash;
+    }
+    const size_t directory_length = last_slash ? (size_t) (last_slash - gltf_filename) + 1 : 0;
+
+    char* path = (char*) gltf_arena_alloc(arena, directory_length + strlen(uri) + 1);
+    if (!path) {
+        return NULL;
+    }
+    memcpy(path, gltf_filename, directory_length);
+
+    char* out = path + directory_length;
+    for (const char* c = uri; *c != '\0'; ++c) {
+        if (c[0] == '%' && json_hex_digit(c[1]) >= 0 && json_hex_digit(c[2]) >= 0) {
+            *out++ = (char) (json_hex_digit(c[1]) * 16 + json_hex_digit(c[2]));
+            c += 2;
+        } else {
+            *out++ = *c;
+        }
+    }
+    *out = '\0';
+    return path;
+}
+
+//Adds the jobs for one uri. Data uris are allocated here at their decoded size, and decoded straight into out_storage by the jobs.
+static bool gltf_add_resource_jobs(const char* gltf_filename, const char* uri, bool use_memory_map, GltfArena* arena,
+                                   GltfFileData* out_storage, GltfResourceJob** io_jobs, uint32_t* io_job_count, uint32_t* io_job_capacity) {
+    if (!gltf_uri_is_data(uri)) {
+        GltfResourceJob* job = GLTF_ARRAY_PUSH(GltfResourceJob, *io_jobs, *io_job_count, *io_job_capacity);
+        if (!job) {
+            return false;
         }
+        job->path = gltf_resolve_uri_path(arena, gltf_filename, uri);
+        job->out_file = out_storage;
+        job->use_memory_map = use_memory_map;
+        return job->path != NULL;
+    }
 
-        //IMAGES
-        {
-            out_asset->num_images = 0;
-            out_asset->images = NULL;
-            
-            const JsonArray* json_images = json_object_get_array(&out_asset->json, "images");
-            if (json_images) {
-                out_asset->num_images = json_images->count;
-                out_asset->images = (GltfImage*) calloc(sizeof(GltfImage), out_asset->num_images);
+    //Only base64 data uris are supported: "data:[<mime type>];base64,<data>"
+    const char* comma = strchr(uri, ',');
+    if (!comma || comma - uri < 12 || memcmp(comma - 7, ";base64", 7) != 0) {
+        return false;
+    }
+    const char* base64 = comma + 1;
+    const size_t base64_length = strlen(base64);
 
-                for (uint32_t i = 0; i < out_asset->num_images; ++i) {
-                    const JsonObject* json_image = json_array_get_object(json_images, i);
-                
-                    uint32_t buffer_view_index;
-                    if (json_value_as_uint32(json_object_get_value(json_image, "bufferView"), &buffer_view_index)) {
-                        //This shouldn't be a failure case if we have a URI-based image
-                        out_asset->images[i].buffer_view = &out_asset->buffer_views[buffer_view_index];
-                    }
-                    //TODO: when adding support for GLTF (not just GLB), support URI-based images
-                }
-            }
+    const size_t decoded_size = gltf_base64_decoded_size(base64, base64_length);
+    if (decoded_size == SIZE_MAX) {
+        return false;
+    }
+    out_storage->data = (uint8_t*) malloc(decoded_size ? decoded_size : 1);
+    out_storage->size = decoded_size;
+    if (!out_storage->data) {
+        return false;
+    }
+
+    for (size_t offset = 0; offset < base64_length; offset += GLTF_BASE64_JOB_LENGTH) {
+        GltfResourceJob* job = GLTF_ARRAY_PUSH(GltfResourceJob, *io_jobs, *io_job_count, *io_job_capacity);
+        if (!job) {
+            return false;
         }
+        job->base64 = base64 + offset;
+        job->base64_length = base64_length - offset < GLTF_BASE64_JOB_LENGTH ? base64_length - offset : GLTF_BASE64_JOB_LENGTH;
+        job->out_data = out_storage->data + offset / 4 * 3;
+    }
+    return true;
+}
 
-        //TODO: Samplers
+//Mime type of a data uri, allocated from the arena
+static char* gltf_data_uri_mime_type(GltfArena* arena, const char* uri) {
+    const char* mime_type_begin = uri + 5;
+    const char* mime_type_end = strchr(mime_type_begin, ';');
+    return json_arena_string(arena, mime_type_begin, mime_type_end, false);
+}
 
-        //TEXTURES
-        {
-            out_asset->num_textures = 0;
-            out_asset->textures = NULL;
-            
-            const JsonArray* json_textures = json_object_get_array(&out_asset->json, "textures");
-            if (json_textures) {
-                out_asset->num_textures = json_textures->count;
-                out_asset->textures = (GltfTexture*) calloc(sizeof(GltfTexture), out_asset->num_textures);
+static bool gltf_load_external_resources(const char* gltf_filename, const GltfLoadOptions* options, GltfAsset* out_asset) {
+    const bool use_memory_map = options && (options->flags & GLTF_LOAD_FLAGS_MEMORY_MAP);
 
-                for (uint32_t i = 0; i < out_asset->num_textures; ++i) {
-                    const JsonObject* json_texture = json_array_get_object(json_textures, i);
+    GltfResourceJob* jobs = NULL;
+    uint32_t job_count = 0;
+    uint32_t job_capacity = 0;
 
-                    uint32_t image_index;
-                    if (json_value_as_uint32(json_object_get_value(json_texture, "source"), &image_index)) {
-                        out_asset->textures[i].image = &out_asset->images[image_index];
-                    }
-                }
+    bool succeeded = true;
+    for (uint32_t i = 0; succeeded && i < out_asset->num_buffers; ++i) {
+        GltfBuffer* buffer = &out_asset->buffers[i];
+        if (buffer->uri && !buffer->is_fallback) {
+            succeeded = gltf_add_resource_jobs(gltf_filename, buffer->uri, use_memory_map, &out_asset->arena, &buffer->storage, &jobs, &job_count, &job_capacity);
+        }
+    }
+    for (uint32_t i = 0; succeeded && i < out_asset->num_images; ++i) {
+        GltfImage* image = &out_asset->images[i];
+        if (image->uri && !image->buffer_view) {
+            succeeded = gltf_add_resource_jobs(gltf_filename, image->uri, use_memory_map, &out_asset->arena, &image->storage, &jobs, &job_count, &job_capacity);
+            if (succeeded && !image->mime_type && gltf_uri_is_data(image->uri)) {
+                image->mime_type = gltf_data_uri_mime_type(&out_asset->arena, image->uri);
             }
         }
-        
-        //MATERIALS
-        {
-            out_asset->num_materials = 0;
-            out_asset->materials = NULL;
-            
-            const JsonArray* json_materials = json_object_get_array(&out_asset->json, "materials");
-            if (json_materials) {
-                out_asset->num_materials = json_materials->count;
-                out_asset->materials = (GltfMaterial*) calloc(sizeof(GltfMaterial), out_asset->num_materials);
-
-                for (uint32_t i = 0; i < out_asset->num_materials; ++i) {
-                    const JsonObject* json_material = json_array_get_object(json_materials, i);
-                    GltfMaterial* material = &out_asset->materials[i];
-
-                    material->double_sided = false;
-                    json_value_as_bool(json_object_get_value(json_material, "doubleSided"), &material->double_sided);
-
-                    const JsonObject* json_pbr_metallic_roughness = json_object_get_object(json_material, "pbrMetallicRoughness");
-                    if (json_pbr_metallic_roughness) {
-                        GltfPbrMetallicRoughness* pbr_metallic_roughness = &material->pbr_metallic_roughness;
-                        
-                        //TODO: base color factor
-
-                        const JsonObject* json_base_color_texture = json_object_get_object(json_pbr_metallic_roughness, "baseColorTexture");
-                        if (json_base_color_texture)
-                        {
-                            uint32_t base_color_texture_index;
-                            if (json_value_as_uint32(json_object_get_value(json_base_color_texture, "index"), &base_color_texture_index))
-                            {
-                                pbr_metallic_roughness->base_color_texture = &out_asset->textures[base_color_texture_index];
-                            }
-
-                            pbr_metallic_roughness->base_color_tex_coord = 0;
-                            json_value_as_uint32(json_object_get_value(json_base_color_texture, "texCoord"), &pbr_metallic_roughness->base_color_tex_coord);
-                        }
+    }
 
-                        pbr_metallic_roughness->metallic_factor = 1.0;
-                        json_value_as_float(json_object_get_value(json_pbr_metallic_roughness, "metallicFactor"), &pbr_metallic_roughness->metallic_factor);
-                        
-                        pbr_metallic_roughness->roughness_factor = 1.0;
-                        json_value_as_float(json_object_get_value(json_pbr_metallic_roughness, "roughnessFactor"), &pbr_metallic_roughness->roughness_factor);
-
-                        const JsonObject* json_metallic_roughness_texture = json_object_get_object(json_pbr_metallic_roughness, "metallicRoughnessTexture");
-                        if (json_metallic_roughness_texture)
-                        {
-                            uint32_t metallic_roughness_texture_index;
-                            if (json_value_as_uint32(json_object_get_value(json_metallic_roughness_texture, "index"), &metallic_roughness_texture_index))
-                            {
-                                pbr_metallic_roughness->metallic_roughness_texture = &out_asset->textures[metallic_roughness_texture_index];
-                            }
-
-                            pbr_metallic_roughness->metallic_roughness_tex_coord = 0;
-                            json_value_as_uint32(json_object_get_value(json_metallic_roughness_texture, "texCoord"), &pbr_metallic_roughness->metallic_roughness_tex_coord);
-                        }
-                    }
-                }
+    if (succeeded && job_count > 0) {
+        if (options && options->parallel_for) {
+            options->parallel_for(options->parallel_for_user_data, job_count, gltf_run_resource_jobs, jobs);
+        } else {
+            gltf_run_resource_jobs(jobs, 0, job_count);
+        }
+
+        for (uint32_t i = 0; i < job_count; ++i) {
+            if (!jobs[i].succeeded) {
+                printf("Failed to load glTF resource: %s\n", jobs[i].path ? jobs[i].path : "(data uri)");
+                succeeded = false;
             }
         }
+    }
+    free(jobs);
+
+    if (!succeeded) {
+        return false;
+    }
 
-        //MESHES
-        {
-            const JsonArray* json_meshes = json_object_get_array(&out_asset->json, "meshes");
-            if (!json_meshes)
-            {
+    for (uint32_t i = 0; i < out_asset->num_buffers; ++i) {
+        GltfBuffer* buffer = &out_asset->buffers[i];
+        if (buffer->is_fallback) {
+            //Compressed buffer views are decoded into this by gltf_decode_meshopt_buffer_views, anything they don't cover stays zero
+            buffer->storage.data = (uint8_t*) calloc((size_t) buffer->byte_length + 1, 1);
+            if (!buffer->storage.data) {
                 return false;
             }
+            buffer->storage.size = buffer->byte_length;
+            buffer->data = buffer->storage.data;
+        } else if (buffer->uri) {
+            if (buffer->storage.size < buffer->byte_length) {
+                return false;
+            }
+            buffer->data = buffer->storage.data;
+        }
+    }
+    for (uint32_t i = 0; i < out_asset->num_images; ++i) {
+        GltfImage* image = &out_asset->images[i];
+        if (image->uri && !image->buffer_view) {
+            image->data = image->storage.data;
+            image->data_size = image->storage.size;
+        }
+    }
+    return true;
+}
 
-            out_asset->num_meshes = json_meshes->count;
-            out_asset->meshes = (GltfMesh*) calloc(sizeof(GltfMesh), out_asset->num_meshes);
-
-            for (uint32_t i = 0; i < out_asset->num_meshes; ++i) {
-                GltfMesh* mesh = &out_asset->meshes[i];
-                const JsonObject* json_mesh = json_array_get_object(json_meshes, i);
+//EXT_meshopt_compression buffer views that point at a fallback buffer are decoded into it once references are resolved.
+//Each buffer view is an independent job for options->parallel_for. Views in regular buffers already hold the uncompressed data.
 
-                const char* json_mesh_name;
-                if (json_value_as_string(json_object_get_value(json_mesh, "name"), &json_mesh_name))
-                {
-                    const size_t name_len = strlen(json_mesh_name);
-                    mesh->name = (char*) calloc(name_len + 1, sizeof(char));
-                    for (size_t char_idx = 0; char_idx < name_len; ++char_idx)
-                    {
-                        mesh->name[char_idx] = json_mesh_name[char_idx];
-                    }
-                    mesh->name[name_len] = '\0';
-                }
-                else
-                {
-                    mesh->name = NULL;
-                }
-                
-                const JsonArray* json_primitives = json_object_get_array(json_mesh, "primitives");
-            
-                if (!json_primitives) {
-                    return false;
-                }
+typedef struct GltfMeshoptJob {
+    GltfBufferView* buffer_view;
+    bool succeeded;
+} GltfMeshoptJob;
+
+static bool gltf_decode_meshopt_buffer_view(GltfBufferView* buffer_view) {
+    const GltfMeshoptCompression* compression = &buffer_view->meshopt_compression;
+    const uint8_t* source = compression->buffer->data + compression->byte_offset;
+    const size_t source_size = (size_t) compression->byte_length;
+    uint8_t* destination = buffer_view->buffer->storage.data + buffer_view->byte_offset;
+
+    switch (compression->mode) {
+    case GLTF_MESHOPT_MODE_ATTRIBUTES:
+        if (!gltf_meshopt_decode_vertex_buffer(destination, compression->count, compression->byte_stride, source, source_size)) {
+            return false;
+        }
+        switch (compression->filter) {
+        case GLTF_MESHOPT_FILTER_NONE:
+            return true;
+        case GLTF_MESHOPT_FILTER_OCTAHEDRAL:
+            if (compression->byte_stride != 4 && compression->byte_stride != 8) {
+                return false;
+            }
+            gltf_meshopt_decode_filter_octahedral(destination, compression->count, compression->byte_stride);
+            return true;
+        case GLTF_MESHOPT_FILTER_QUATERNION:
+            if (compression->byte_stride != 8) {
+                return false;
+            }
+            gltf_meshopt_decode_filter_quaternion(destination, compression->count);
+            return true;
+        case GLTF_MESHOPT_FILTER_EXPONENTIAL:
+            gltf_meshopt_decode_filter_exponential(destination, (size_t) compression->count * compression->byte_stride / 4);
+            return true;
+        }
+        return false;
+    case GLTF_MESHOPT_MODE_TRIANGLES:
+        return compression->filter == GLTF_MESHOPT_FILTER_NONE
+            && gltf_meshopt_decode_index_buffer(destination, compression->count, compression->byte_stride, source, source_size);
+    case GLTF_MESHOPT_MODE_INDICES:
+        return compression->filter == GLTF_MESHOPT_FILTER_NONE
+            && gltf_meshopt_decode_index_sequence(destination, compression->count, compression->byte_stride, source, source_size);
+    }
+    return false;
+}
 
-                mesh->num_primitives = json_primitives->count;
-                mesh->primitives = (GltfPrimitive*) calloc(sizeof(GltfPrimitive), mesh->num_primitives);
+static void gltf_run_meshopt_jobs(void* task_data, uint32_t begin, uint32_t end) {
+    GltfMeshoptJob* jobs = (GltfMeshoptJob*) task_data;
+    for (uint32_t i = begin; i < end; ++i) {
+        jobs[i].succeeded = gltf_decode_meshopt_buffer_view(jobs[i].buffer_view);
+    }
+}
 
-                for (uint32_t j = 0; j < mesh->num_primitives; ++j) {
-                    GltfPrimitive* primitive = &mesh->primitives[j];
-                    const JsonObject* json_primitive = json_array_get_object(json_primitives, j);
-                    const JsonObject* json_attributes = json_object_get_object(json_primitive, "attributes");
+static bool gltf_decode_meshopt_buffer_views(const GltfLoadOptions* options, GltfAsset* asset) {
+    uint32_t job_count = 0;
+    for (uint32_t i = 0; i < asset->num_buffer_views; ++i) {
+        const GltfBufferView* buffer_view = &asset->buffer_views[i];
+        job_count += buffer_view->meshopt_compression.buffer && buffer_view->buffer->is_fallback;
+    }
+    if (job_count == 0) {
+        return true;
+    }
 
-                    //TODO: Primitive Topology (Triangle (4) is default, but check for others)
+    GltfMeshoptJob* jobs = (GltfMeshoptJob*) malloc(sizeof(GltfMeshoptJob) * job_count);
+    if (!jobs) {
+        return false;
+    }
+    uint64_t compressed_size = 0;
+    for (uint32_t i = 0, job_index = 0; i < asset->num_buffer_views; ++i) {
+        GltfBufferView* buffer_view = &asset->buffer_views[i];
+        if (buffer_view->meshopt_compression.buffer && buffer_view->buffer->is_fallback) {
+            jobs[job_index].buffer_view = buffer_view;
+            jobs[job_index].succeeded = false;
+            compressed_size += buffer_view->meshopt_compression.byte_length;
+            ++job_index;
+        }
+    }
 
-                    uint32_t positions_index = 0;
-                    if (json_value_as_uint32(json_object_get_value(json_attributes, "POSITION"), &positions_index) && positions_index < out_asset->num_accessors) {
-                        primitive->positions = &out_asset->accessors[positions_index];
-                    }
- 
-                    uint32_t normals_index = 0;
-                    if (json_value_as_uint32(json_object_get_value(json_attributes, "NORMAL"), &normals_index) && normals_index < out_asset->num_accessors) {
-                        primitive->normals = &out_asset->accessors[normals_index];
-                    }
+    const double decode_start = gltf_get_time_seconds();
+    if (options && options->parallel_for) {
+        options->parallel_for(options->parallel_for_user_data, job_count, gltf_run_meshopt_jobs, jobs);
+    } else {
+        gltf_run_meshopt_jobs(jobs, 0, job_count);
+    }
+    const double decode_seconds = gltf_get_time_seconds() - decode_start;
 
-                    uint32_t texcoord0_index = 0;
-                    if (json_value_as_uint32(json_object_get_value(json_attributes, "TEXCOORD_0"), &texcoord0_index) && texcoord0_index < out_asset->num_accessors) {
-                        primitive->texcoord0 = &out_asset->accessors[texcoord0_index];
-                    }
+    bool succeeded = true;
+    for (uint32_t i = 0; i < job_count; ++i) {
+        if (!jobs[i].succeeded) {
+            printf("Failed to decode EXT_meshopt_compression buffer view %u\n", (uint32_t) (jobs[i].buffer_view - asset->buffer_views));
+            succeeded = false;
+        }
+    }
+    free(jobs);
 
-                    uint32_t indices_index = 0;
-                    if (json_value_as_uint32(json_object_get_value(json_primitive, "indices"), &indices_index) && indices_index < out_asset->num_accessors) {
-                        primitive->indices = &out_asset->accessors[indices_index];
-                    }
+    const double compressed_megabytes = compressed_size / (1024.0 * 1024.0);
+    printf("Meshopt Decode: %u buffer views, %.2f MB in %.3f ms (%.1f MB/s)\n", job_count, compressed_megabytes, decode_seconds * 1000.0,
+        decode_seconds > 0.0 ? compressed_megabytes / decode_seconds : 0.0);
+    return succeeded;
+}
 
-                    uint32_t material_index = 0;
-                    if (json_value_as_uint32(json_object_get_value(json_primitive, "material"), &material_index)) {
-                        primitive->material = &out_asset->materials[material_index];
-                    }
-                }
-            }
-        }
+void gltf_free_asset(GltfAsset* asset);
 
-        //TODO: NODES
+bool gltf_load_asset_with_options(const char* filename, const GltfLoadOptions* options, GltfAsset* out_asset) {
 
-        //TODO: SCENES
+    if (!out_asset) {
+        return false;
+    }
+    memset(out_asset, 0, sizeof(GltfAsset));
 
-        //TODO: Skinning
+    const bool use_memory_map = options && (options->flags & GLTF_LOAD_FLAGS_MEMORY_MAP);
+    const bool file_loaded = use_memory_map ? gltf_file_map(filename, &out_asset->file) : gltf_file_read(filename, &out_asset->file);
+    if (!file_loaded) {
+        return false;
+    }
 
-        fclose(file);
-        return true;
+    //.glb files start with the magic number, anything else is treated as .gltf json
+    uint32_t magic = 0;
+    if (out_asset->file.size >= sizeof(magic)) {
+        memcpy(&magic, out_asset->file.data, sizeof(magic));
+    }
+    const bool parsed = magic == GLTF_MAGIC_NUMBER
+        ? gltf_parse_glb(options, out_asset)
+        : out_asset->file.size <= UINT32_MAX && gltf_parse_json(options, (const char*) out_asset->file.data, (uint32_t) out_asset->file.size, out_asset);
+
+    //Index references are resolved once every buffer has its data, compressed buffer views are decoded after that
+    if (!parsed || !gltf_load_external_resources(filename, options, out_asset) || !gltf_resolve_references(out_asset)
+        || !gltf_decode_meshopt_buffer_views(options, out_asset)) {
+        gltf_free_asset(out_asset);
+        return false;
     }
 
-    return false;
+    return true;
+}
+
+bool gltf_load_asset(const char* filename, GltfAsset* out_asset) {
+    GltfLoadOptions options;
+    memset(&options, 0, sizeof(GltfLoadOptions));
+    options.flags = GLTF_LOAD_FLAGS_NONE;
+    return gltf_load_asset_with_options(filename, &options, out_asset);
 }
 
 //FIXME: better checks above
@@ -956,24 +4316,48 @@ bool gltf_load_asset(const char* filename, GltfAsset* out_asset) {
 void gltf_free_asset(GltfAsset* asset) {
 
     for (uint32_t i = 0; i < asset->num_meshes; ++i) {
-        free(asset->meshes[i].primitives);
-        if (asset->meshes[i].name)
-        {
-            free(asset->meshes[i].name);
+        for (uint32_t j = 0; j < asset->meshes[i].num_primitives; ++j) {
+            free(asset->meshes[i].primitives[j].targets);
         }
+        free(asset->meshes[i].primitives);
+        free(asset->meshes[i].weights);
     }
     free(asset->meshes);
 
+    for (uint32_t i = 0; i < asset->num_nodes; ++i) {
+        free(asset->nodes[i].children);
+        free(asset->nodes[i].weights);
+    }
+    free(asset->nodes);
+    for (uint32_t i = 0; i < asset->num_scenes; ++i) {
+        free(asset->scenes[i].nodes);
+    }
+    free(asset->scenes);
+    for (uint32_t i = 0; i < asset->num_skins; ++i) {
+        free(asset->skins[i].joints);
+    }
+    free(asset->skins);
+    for (uint32_t i = 0; i < asset->num_animations; ++i) {
+        free(asset->animations[i].samplers);
+        free(asset->animations[i].channels);
+    }
+    free(asset->animations);
+
     free(asset->accessors);
     free(asset->buffer_views);
 
     for (uint32_t i = 0; i < asset->num_buffers; ++i) {
-        free(asset->buffers[i].data);
+        gltf_file_release(&asset->buffers[i].storage);
     }
     free(asset->buffers);
+
+    for (uint32_t i = 0; i < asset->num_images; ++i) {
+        gltf_file_release(&asset->images[i].storage);
+    }
     free(asset->images);
     free(asset->textures);
     free(asset->materials);
 
-    free_json_object(&asset->json);
+    gltf_arena_free(&asset->arena);
+    gltf_file_release(&asset->file);
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <dxgiformat.h>
+
+#include "gltf.h"
+#include "vertex_pack.h"
+#include "EnkiTS/TaskScheduler.h"
+
+// Packs decoded RGBA32 float texels of HDR images into smaller float formats:
+//  R16G16B16A16_FLOAT  8 bytes, keeps alpha and negative values
+//  R11G11B10_FLOAT     4 bytes, unsigned, 6/6/5 bit mantissas, no alpha
+//  R9G9B9E5_SHAREDEXP  4 bytes, unsigned, 9 bit mantissas sharing the largest channel's exponent, no alpha
+// Conversions round to nearest and clamp to each format's finite range (negative and NaN become 0 in the unsigned formats),
+// matching how D3D converts render target writes. Four texels are converted per step with SSE2 (F16C or NEON for halves).
+
+static const uint32_t HDR_TASK_ROWS = 64;
+
+inline bool is_hdr_texel_format(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R32G32B32A32_FLOAT || format == DXGI_FORMAT_R16G16B16A16_FLOAT
+		|| format == DXGI_FORMAT_R11G11B10_FLOAT || format == DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+}
+
+inline uint32_t hdr_texel_size(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:	return 16;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:	return 8;
+		case DXGI_FORMAT_R11G11B10_FLOAT:
+		case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:	return 4;
+		default:								return 0;
+	}
+}
+
+// Unsigned float with a 5 bit exponent (bias 15) and mantissa_bits of mantissa, as in R11G11B10_FLOAT
+inline uint32_t hdr_float_to_unsigned_small_float(float value, uint32_t mantissa_bits)
+{
+	uint32_t magnitude;
+	memcpy(&magnitude, &value, sizeof(magnitude));
+	if (magnitude & 0x80000000u || magnitude > 0x7F800000u)
+	{
+		return 0;
+	}
+	const uint32_t max_encoded = (30u << mantissa_bits) | ((1u << mantissa_bits) - 1);
+	const uint32_t shift = 23 - mantissa_bits;
+	magnitude = magnitude < (127u + 16u) << 23 ? magnitude : ((127u + 16u) << 23) - 1;
+
+	uint32_t encoded;
+	if (magnitude < 113u << 23)
+	{
+		// Denormals: adding the magic number rounds the mantissa into place, as in vertex_pack_float_to_half
+		const uint32_t denormal_magic_bits = ((127u - 15u) + shift + 1u) << 23;
+		float magnitude_float, denormal_magic;
+		memcpy(&magnitude_float, &magnitude, sizeof(magnitude));
+		memcpy(&denormal_magic, &denormal_magic_bits, sizeof(denormal_magic_bits));
+		magnitude_float += denormal_magic;
+		memcpy(&magnitude, &magnitude_float, sizeof(magnitude));
+		encoded = magnitude - denormal_magic_bits;
+	}
+	else
+	{
+		const uint32_t mantissa_odd = (magnitude >> shift) & 1;
+		encoded = (magnitude + ((15u - 127u) << 23) + (1u << (shift - 1)) - 1 + mantissa_odd) >> shift;
+	}
+	// Rounding up past the largest finite value would give infinity
+	return encoded < max_encoded ? encoded : max_encoded;
+}
+
+inline uint32_t hdr_pack_r11g11b10(const float* rgba)
+{
+	return hdr_float_to_unsigned_small_float(rgba[0], 6) | (hdr_float_to_unsigned_small_float(rgba[1], 6) << 11) | (hdr_float_to_unsigned_small_float(rgba[2], 5) << 22);
+}
+
+// Shared exponent encoding from the D3D format conversion rules
+inline uint32_t hdr_pack_rgb9e5(const float* rgba)
+{
+	const float max_value = 65408.0f; // (511 / 512) * 2^16
+	float channels[3];
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		// Written so NaN fails the first comparison and becomes 0
+		channels[i] = rgba[i] > 0.0f ? (rgba[i] < max_value ? rgba[i] : max_value) : 0.0f;
+	}
+	const float max_channel = channels[0] > channels[1] ? (channels[0] > channels[2] ? channels[0] : channels[2]) : (channels[1] > channels[2] ? channels[1] : channels[2]);
+
+	// exponent = max(-16, floor(log2(max_channel))) + 16, read from the float's exponent bits
+	uint32_t max_bits;
+	memcpy(&max_bits, &max_channel, sizeof(max_bits));
+	const int32_t biased_exponent = (int32_t) (max_bits >> 23) - 127 + 16;
+	uint32_t exponent = biased_exponent > 0 ? (uint32_t) biased_exponent : 0;
+
+	// Scale by 2^(24 - exponent) so the largest channel has 9 bits, one more exponent if it rounds up to 512
+	auto scale_of = [](uint32_t in_exponent) { const uint32_t bits = (127u + 24u - in_exponent) << 23; float scale; memcpy(&scale, &bits, sizeof(scale)); return scale; };
+	float scale = scale_of(exponent);
+	if ((uint32_t) (max_channel * scale + 0.5f) == 512)
+	{
+		exponent += 1;
+		scale = scale_of(exponent);
+	}
+	return (uint32_t) (channels[0] * scale + 0.5f) | ((uint32_t) (channels[1] * scale + 0.5f) << 9) | ((uint32_t) (channels[2] * scale + 0.5f) << 18) | (exponent << 27);
+}
+
+#if GLTF_SIMD_SSE2
+// SSE2 has no 32 bit min or blend, so both are built from compares and masks
+inline __m128i hdr_select_sse2(__m128i mask, __m128i if_true, __m128i if_false)
+{
+	return _mm_or_si128(_mm_and_si128(mask, if_true), _mm_andnot_si128(mask, if_false));
+}
+
+// Four lanes of hdr_float_to_unsigned_small_float
+inline __m128i hdr_float_to_unsigned_small_float_sse2(__m128 values, uint32_t mantissa_bits)
+{
+	const uint32_t shift = 23 - mantissa_bits;
+	const __m128i shift_count = _mm_cvtsi32_si128((int) shift);
+	const __m128i max_encoded = _mm_set1_epi32((int) ((30u << mantissa_bits) | ((1u << mantissa_bits) - 1)));
+
+	// Negative values and NaNs are 0, signed compares see negative floats as negative integers
+	__m128i magnitude = _mm_castps_si128(values);
+	const __m128i is_zero = _mm_or_si128(_mm_cmplt_epi32(magnitude, _mm_setzero_si128()), _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7F800000)));
+	const __m128i largest = _mm_set1_epi32(((127 + 16) << 23) - 1);
+	magnitude = hdr_select_sse2(_mm_cmpgt_epi32(magnitude, largest), largest, magnitude);
+
+	const __m128i denormal_magic = _mm_set1_epi32((int) (((127u - 15u) + shift + 1u) << 23));
+	const __m128i is_denormal = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(113 << 23));
+	const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), _mm_castsi128_ps(denormal_magic))), denormal_magic);
+
+	const __m128i mantissa_odd = _mm_and_si128(_mm_srl_epi32(magnitude, shift_count), _mm_set1_epi32(1));
+	const __m128i rounding = _mm_set1_epi32((int) (((15u - 127u) << 23) + (1u << (shift - 1)) - 1));
+	const __m128i normal = _mm_srl_epi32(_mm_add_epi32(_mm_add_epi32(magnitude, rounding), mantissa_odd), shift_count);
+
+	__m128i encoded = hdr_select_sse2(is_denormal, denormal, normal);
+	encoded = hdr_select_sse2(_mm_cmpgt_epi32(encoded, max_encoded), max_encoded, encoded);
+	return _mm_andnot_si128(is_zero, encoded);
+}
+
+// Four texels from SoA channels
+inline __m128i hdr_pack_r11g11b10_sse2(__m128 r, __m128 g, __m128 b)
+{
+	return _mm_or_si128(_mm_or_si128(hdr_float_to_unsigned_small_float_sse2(r, 6), _mm_slli_epi32(hdr_float_to_unsigned_small_float_sse2(g, 6), 11)),
+		_mm_slli_epi32(hdr_float_to_unsigned_small_float_sse2(b, 5), 22));
+}
+
+inline __m128i hdr_pack_rgb9e5_sse2(__m128 r, __m128 g, __m128 b)
+{
+	// max_ps returns its second operand for NaN, so NaN channels become 0
+	const __m128 max_value = _mm_set1_ps(65408.0f);
+	r = _mm_min_ps(_mm_max_ps(r, _mm_setzero_ps()), max_value);
+	g = _mm_min_ps(_mm_max_ps(g, _mm_setzero_ps()), max_value);
+	b = _mm_min_ps(_mm_max_ps(b, _mm_setzero_ps()), max_value);
+	const __m128 max_channel = _mm_max_ps(r, _mm_max_ps(g, b));
+
+	__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(max_channel), 23), _mm_set1_epi32(127 - 16));
+	exponent = _mm_and_si128(exponent, _mm_cmpgt_epi32(exponent, _mm_setzero_si128()));
+
+	const __m128i scale_exponent_base = _mm_set1_epi32(127 + 24);
+	__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(scale_exponent_base, exponent), 23));
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128i rounds_up = _mm_cmpeq_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(max_channel, scale), half)), _mm_set1_epi32(512));
+	exponent = _mm_sub_epi32(exponent, rounds_up);
+	scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(scale_exponent_base, exponent), 23));
+
+	const __m128i mantissa_r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+	const __m128i mantissa_g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+	const __m128i mantissa_b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+	return _mm_or_si128(_mm_or_si128(mantissa_r, _mm_slli_epi32(mantissa_g, 9)), _mm_or_si128(_mm_slli_epi32(mantissa_b, 18), _mm_slli_epi32(exponent, 27)));
+}
+#endif
+
+// Converts texel_count RGBA32 float texels to format (see is_hdr_texel_format), out holds texel_count * hdr_texel_size(format) bytes
+inline void convert_hdr_texels(const float* texels, size_t texel_count, DXGI_FORMAT format, uint8_t* out)
+{
+	size_t texel = 0;
+	switch (format)
+	{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			memcpy(out, texels, texel_count * 4 * sizeof(float));
+			return;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		{
+			uint16_t* out_halves = (uint16_t*) out;
+			#if VERTEX_PACK_F16C
+			for (; texel + 2 <= texel_count; texel += 2)
+			{
+				_mm_storeu_si128((__m128i*) &out_halves[texel * 4], _mm256_cvtps_ph(_mm256_loadu_ps(&texels[texel * 4]), 0));
+			}
+			#elif GLTF_SIMD_SSE2
+			for (; texel + 2 <= texel_count; texel += 2)
+			{
+				const __m128i first = vertex_pack_float_to_half_sse2(_mm_loadu_ps(&texels[texel * 4]));
+				const __m128i second = vertex_pack_float_to_half_sse2(_mm_loadu_ps(&texels[texel * 4 + 4]));
+				// Sign extending the 16 bit lanes keeps the signed saturating pack from clamping them
+				const __m128i packed = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(first, 16), 16), _mm_srai_epi32(_mm_slli_epi32(second, 16), 16));
+				_mm_storeu_si128((__m128i*) &out_halves[texel * 4], packed);
+			}
+			#elif GLTF_SIMD_NEON
+			for (; texel < texel_count; ++texel)
+			{
+				vst1_u16(&out_halves[texel * 4], vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(&texels[texel * 4]))));
+			}
+			#endif
+			for (; texel < texel_count; ++texel)
+			{
+				for (uint32_t component = 0; component < 4; ++component)
+				{
+					out_halves[texel * 4 + component] = vertex_pack_float_to_half(texels[texel * 4 + component]);
+				}
+			}
+			return;
+		}
+		case DXGI_FORMAT_R11G11B10_FLOAT:
+		case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+		{
+			const bool is_shared_exponent = format == DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+			uint32_t* out_packed = (uint32_t*) out;
+			#if GLTF_SIMD_SSE2
+			for (; texel + 4 <= texel_count; texel += 4)
+			{
+				__m128 r = _mm_loadu_ps(&texels[texel * 4]);
+				__m128 g = _mm_loadu_ps(&texels[texel * 4 + 4]);
+				__m128 b = _mm_loadu_ps(&texels[texel * 4 + 8]);
+				__m128 a = _mm_loadu_ps(&texels[texel * 4 + 12]);
+				_MM_TRANSPOSE4_PS(r, g, b, a);
+				const __m128i packed = is_shared_exponent ? hdr_pack_rgb9e5_sse2(r, g, b) : hdr_pack_r11g11b10_sse2(r, g, b);
+				_mm_storeu_si128((__m128i*) &out_packed[texel], packed);
+			}
+			#endif
+			for (; texel < texel_count; ++texel)
+			{
+				out_packed[texel] = is_shared_exponent ? hdr_pack_rgb9e5(&texels[texel * 4]) : hdr_pack_r11g11b10(&texels[texel * 4]);
+			}
+			return;
+		}
+		default:
+			return;
+	}
+}
+
+// Converts a width x height level in tasks of HDR_TASK_ROWS rows on task_scheduler when given, out rows are tightly packed
+inline void convert_hdr_level(const float* texels, uint32_t width, uint32_t height, DXGI_FORMAT format, enki::TaskScheduler* task_scheduler, uint8_t* out)
+{
+	const size_t out_row_pitch = (size_t) width * hdr_texel_size(format);
+	auto convert_rows = [&](uint32_t first_row, uint32_t end_row)
+	{
+		convert_hdr_texels(texels + (size_t) first_row * width * 4, (size_t) (end_row - first_row) * width, format, out + first_row * out_row_pitch);
+	};
+
+	const uint32_t task_count = (height + HDR_TASK_ROWS - 1) / HDR_TASK_ROWS;
+	if (!task_scheduler || task_count <= 1)
+	{
+		convert_rows(0, height);
+		return;
+	}
+	enki::TaskSet convert_task(task_count, [&convert_rows, height](enki::TaskSetPartition range, uint32_t /*threadnum*/)
+	{
+		const uint32_t end_row = range.end * HDR_TASK_ROWS;
+		convert_rows(range.start * HDR_TASK_ROWS, end_row < height ? end_row : height);
+	});
+	task_scheduler->AddTaskSetToPipe(&convert_task);
+	task_scheduler->WaitforTask(&convert_task);
+}
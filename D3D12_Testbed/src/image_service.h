@@ -0,0 +1,169 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+
+#include <EASTL/hash_map.h>
+#include <EASTL/shared_ptr.h>
+#include <EASTL/unique_ptr.h>
+
+#include "gltf.h"
+#include "mesh_cache.h"
+#include "d3d12_texture.h"
+#include "EnkiTS/TaskScheduler.h"
+
+//Shared textures of encoded images (glTF images, for now). Each image is decoded, processed and uploaded once per set of
+//ImageSettings, however many primitives, meshes or models request it: requests are keyed by a hash of the encoded bytes and
+//the settings, so identical images in different files are shared too.
+//The first request of a key runs the build as an enkiTS task, later requests wait on that task (running other tasks meanwhile),
+//so different images build in parallel on the worker threads. Textures are released when their last TextureRef goes away.
+
+using TextureRef = eastl::shared_ptr<Texture>;
+
+//Everything besides the encoded bytes that changes the built texture. Kept free of padding, it is hashed as is.
+struct ImageSettings
+{
+	TextureUsage usage = TextureUsage::Uncompressed;
+	MipFilter mip_filter = MipFilter::Box;
+	bool generate_mips = false;
+	bool flip_vertically = false;
+};
+
+struct ImageService
+{
+	ComPtr<ID3D12Device> device;
+	D3D12MA::Allocator* gpu_memory_allocator = nullptr;
+	ComPtr<ID3D12CommandQueue> command_queue;
+	enki::TaskScheduler* task_scheduler = nullptr;
+	BindlessResourceManager* bindless_resource_manager = nullptr; //Registers built textures when set
+	std::string compression_cache_directory; //See TextureBuilder::with_compression_cache, unused when empty
+
+	//The build task of one key and its result
+	struct Entry : enki::ITaskSet
+	{
+		ImageService* service = nullptr;
+		const uint8_t* data = nullptr;
+		size_t data_size = 0;
+		ImageSettings settings;
+		std::string debug_name;
+		TextureRef texture;
+
+		void ExecuteRange(enki::TaskSetPartition, uint32_t) override
+		{
+			service->build_entry(*this);
+		}
+	};
+
+	eastl::hash_map<uint64_t, eastl::unique_ptr<Entry>> entries;
+	std::mutex entries_mutex;
+
+	ImageService(const ComPtr<ID3D12Device> in_device, D3D12MA::Allocator* in_gpu_memory_allocator, const ComPtr<ID3D12CommandQueue> in_command_queue,
+				 enki::TaskScheduler* in_task_scheduler, BindlessResourceManager* in_bindless_resource_manager = nullptr)
+		: device(in_device)
+		, gpu_memory_allocator(in_gpu_memory_allocator)
+		, command_queue(in_command_queue)
+		, task_scheduler(in_task_scheduler)
+		, bindless_resource_manager(in_bindless_resource_manager)
+	{
+	}
+
+	ImageService& with_compression_cache(const char* in_directory)
+	{
+		compression_cache_directory = in_directory;
+		return *this;
+	}
+
+	//Returns the texture of the encoded image, building it if this is the first request with these bytes and settings.
+	//data must stay valid until the texture is built (until this returns). debug_name only names the first request's texture.
+	//Safe to call from any thread, including enkiTS tasks.
+	TextureRef request(const uint8_t* data, const size_t data_size, const ImageSettings& settings, const char* debug_name = nullptr)
+	{
+		if (!data || data_size == 0)
+		{
+			return {};
+		}
+
+		const uint64_t key = hash_bytes(data, data_size, hash_bytes(&settings, sizeof(settings), 0));
+
+		Entry* entry = nullptr;
+		bool is_new_entry = false;
+		{
+			std::scoped_lock lock(entries_mutex);
+			eastl::unique_ptr<Entry>& found_entry = entries[key];
+			if (!found_entry)
+			{
+				found_entry = eastl::make_unique<Entry>();
+				found_entry->service = this;
+				found_entry->data = data;
+				found_entry->data_size = data_size;
+				found_entry->settings = settings;
+				found_entry->debug_name = debug_name ? debug_name : "";
+				is_new_entry = true;
+			}
+			entry = found_entry.get();
+		}
+
+		if (is_new_entry)
+		{
+			task_scheduler->AddTaskSetToPipe(entry);
+		}
+		task_scheduler->WaitforTask(entry);
+		return entry->texture;
+	}
+
+	TextureRef request(const GltfImage* image, const ImageSettings& settings, const char* debug_name = nullptr)
+	{
+		return image ? request(image->data, static_cast<size_t>(image->data_size), settings, debug_name) : TextureRef();
+	}
+
+	//Drops the service's references, textures still referenced elsewhere stay alive until their last TextureRef is gone
+	void release()
+	{
+		std::scoped_lock lock(entries_mutex);
+		entries.clear();
+	}
+
+	void build_entry(Entry& entry)
+	{
+		rmt_ScopedCPUSample(BuildSharedImage, 0);
+
+		TextureBuilder builder;
+		builder.from_binary_data(entry.data, entry.data_size)
+			.flip_vertically(entry.settings.flip_vertically)
+			.with_usage(entry.settings.usage, task_scheduler);
+		if (entry.settings.generate_mips)
+		{
+			builder.with_generated_mips(entry.settings.mip_filter, task_scheduler);
+		}
+		if (!compression_cache_directory.empty())
+		{
+			builder.with_compression_cache(compression_cache_directory.c_str());
+		}
+		if (!entry.debug_name.empty())
+		{
+			builder.with_debug_name(entry.debug_name.c_str());
+		}
+
+		//The deleter frees the bindless slot and the GPU allocation along with the last reference,
+		//so the bindless resource manager has to outlive every TextureRef
+		Texture* texture = new Texture(builder.build(device, gpu_memory_allocator, command_queue));
+		entry.texture = TextureRef(texture, [in_bindless_resource_manager = bindless_resource_manager](Texture* in_texture)
+		{
+			if (in_bindless_resource_manager)
+			{
+				in_bindless_resource_manager->unregister_texture(*in_texture);
+			}
+			in_texture->release();
+			delete in_texture;
+		});
+
+		if (bindless_resource_manager)
+		{
+			bindless_resource_manager->register_texture(*texture);
+		}
+
+		//Only needed while building
+		entry.data = nullptr;
+		entry.data_size = 0;
+	}
+};
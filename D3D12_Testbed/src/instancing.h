@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "gltf.h"
+#include "scene_graph.h"
+
+// Per instance transforms of instanced draws, read by pbr.hlsl from a structured buffer (one InstanceTransform per SV_InstanceID).
+// EXT_mesh_gpu_instancing transforms are in the space of the node they instance, so the vertex shader applies them before the node's
+// world matrix. The debug instance grid is in world space instead and applies after it (see build_instance_grid).
+// EXT_mesh_gpu_instancing stores instances as TRS accessors. They are unpacked to structure of arrays and composed
+// Lanes::WIDTH instances at a time with the scene graph's TRS kernel, then transposed to InstanceTransform.
+
+static const uint32_t INSTANCE_TRANSFORM_COMPONENTS = 12;
+
+// Column vector affine matrix (float3x4, the translation is the last column), the layout of pbr.hlsl's InstanceTransform
+struct InstanceTransform
+{
+	float rows[3][4];
+};
+static_assert(sizeof(InstanceTransform) == INSTANCE_TRANSFORM_COMPONENTS * sizeof(float), "InstanceTransform is uploaded as is");
+
+// Composes instance_count TRS transforms given as structure of arrays
+inline void compose_instance_transforms(const float* const translation[3], const float* const rotation[4], const float* const scale[3], uint32_t instance_count,
+	InstanceTransform* out_transforms)
+{
+	// Transposes the row vector matrices of Lanes::WIDTH instances to column vector InstanceTransforms
+	auto compose = [&](auto lanes, uint32_t first)
+	{
+		typedef decltype(lanes) Lanes;
+
+		typename Lanes::Type matrix[SCENE_GRAPH_WORLD_COMPONENTS];
+		scene_graph_compose_lanes<Lanes>(translation, rotation, scale, first, matrix);
+
+		float components[SCENE_GRAPH_WORLD_COMPONENTS][Lanes::WIDTH];
+		for (uint32_t i = 0; i < SCENE_GRAPH_WORLD_COMPONENTS; ++i)
+		{
+			Lanes::store(components[i], matrix[i]);
+		}
+		for (uint32_t lane = 0; lane < Lanes::WIDTH; ++lane)
+		{
+			InstanceTransform& transform = out_transforms[first + lane];
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				for (uint32_t column = 0; column < 4; ++column)
+				{
+					transform.rows[row][column] = components[column * 3 + row][lane];
+				}
+			}
+		}
+	};
+
+	uint32_t instance = 0;
+	for (; instance + SceneGraphLanes::WIDTH <= instance_count; instance += SceneGraphLanes::WIDTH)
+	{
+		compose(SceneGraphLanes(), instance);
+	}
+	for (; instance < instance_count; ++instance)
+	{
+		compose(SceneGraphLanes1(), instance);
+	}
+}
+
+// Instance transforms of a node using EXT_mesh_gpu_instancing. Returns false if an attribute can't be unpacked.
+inline bool build_instance_transforms(const GltfNode& node, vector<InstanceTransform>& out_transforms)
+{
+	const uint32_t instance_count = node.num_instances;
+	out_transforms.resize(instance_count);
+	if (instance_count == 0)
+	{
+		return true;
+	}
+
+	// Interleaved as read from the accessors, then split into one array per component
+	const GltfAccessor* accessors[3] = { node.instance_translations, node.instance_rotations, node.instance_scales };
+	const uint32_t component_counts[3] = { 3, 4, 3 };
+	const float default_values[3][4] = { { 0.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 0.0f } };
+
+	vector<float> interleaved((size_t) instance_count * 4);
+	vector<float> components[10];
+	uint32_t first_component = 0;
+	for (uint32_t attribute = 0; attribute < 3; ++attribute)
+	{
+		const uint32_t component_count = component_counts[attribute];
+		if (accessors[attribute] && !gltf_accessor_unpack_floats(accessors[attribute], component_count, interleaved.data(), component_count * sizeof(float)))
+		{
+			return false;
+		}
+		for (uint32_t component = 0; component < component_count; ++component)
+		{
+			vector<float>& values = components[first_component + component];
+			if (!accessors[attribute])
+			{
+				values.assign(instance_count, default_values[attribute][component]);
+				continue;
+			}
+			values.resize(instance_count);
+			for (uint32_t instance = 0; instance < instance_count; ++instance)
+			{
+				values[instance] = interleaved[(size_t) instance * component_count + component];
+			}
+		}
+		first_component += component_count;
+	}
+
+	const float* const translation[3] = { components[0].data(), components[1].data(), components[2].data() };
+	const float* const rotation[4] = { components[3].data(), components[4].data(), components[5].data(), components[6].data() };
+	const float* const scale[3] = { components[7].data(), components[8].data(), components[9].data() };
+	compose_instance_transforms(translation, rotation, scale, instance_count, out_transforms.data());
+	return true;
+}
+
+// Instances laid out in columns of rows_per_column along +x and -y, starting at offset (e.g. to compare materials on a grid of copies).
+// Translations only, applied in world space so the node's rotation and scale don't change the grid.
+inline void build_instance_grid(uint32_t instance_count, uint32_t rows_per_column, float spacing, const float offset[3], vector<InstanceTransform>& out_transforms)
+{
+	out_transforms.resize(instance_count);
+	for (uint32_t instance = 0; instance < instance_count; ++instance)
+	{
+		InstanceTransform& transform = out_transforms[instance];
+		memset(&transform, 0, sizeof(InstanceTransform));
+		transform.rows[0][0] = transform.rows[1][1] = transform.rows[2][2] = 1.0f;
+		transform.rows[0][3] = offset[0] + spacing * (instance / rows_per_column);
+		transform.rows[1][3] = offset[1] - spacing * (instance % rows_per_column);
+		transform.rows[2][3] = offset[2];
+	}
+}
@@ -20,6 +20,7 @@ using eastl::optional;
 using eastl::array;
 #include <EASTL/vector.h>
 using eastl::vector;
+#include <EASTL/algorithm.h>
 
 //EASTL requires you to define these two operator news
 void* __cdecl operator new[](size_t size, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
@@ -52,6 +53,22 @@ void* __cdecl operator new[](size_t size, size_t alignment, size_t alignmentOffs
 
 #include "d3d12_helpers.h"
 #include "d3d12_texture.h"
+#include "image_service.h"
+
+//Mesh Optimization
+#include "mesh_optimize.h"
+#include "mesh_cache.h"
+#include "meshlet.h"
+#include "culling.h"
+#include "mesh_lod.h"
+#include "vertex_pack.h"
+
+//Scene Graph, Skinning and Morph Targets
+#include "scene_graph.h"
+#include "skinning.h"
+#include "morph.h"
+#include "animation.h"
+#include "instancing.h"
 
 #define IMGUI_IMPLEMENTATION
 #include "../third_party/DearImGui/misc/single_file/imgui_single_file.h"
@@ -208,8 +225,23 @@ struct GpuVertex
 	XMFLOAT2 uv;
 };
 
+//Import time vertex of skinned or morphed primitives, so joints, weights and morph deltas stay with their vertex through deduplication and reordering.
+//Vertices are only merged when they also have the same influences and morph source (see compute_morph_sources).
+struct DeformableGpuVertex
+{
+	GpuVertex vertex;
+	SkinInfluences influences;
+	uint32_t morph_source;
+};
+
 static const UINT backbuffer_count = 3;
 
+//Block compressed textures of imported images, see texture_cache.h
+static const char* TEXTURE_CACHE_DIRECTORY = "data/texture_cache";
+
+//Prints per primitive import timings and vertex cache, LOD and meshlet stats while loading models
+static const bool PRINT_MESH_IMPORT_STATS = false;
+
 bool is_key_down(const int in_key)
 {
 	return GetKeyState(in_key) & 0x8000;
@@ -534,7 +566,7 @@ int main()
 	//TODO: Helpers for this in BindlessResourceManager?
 	ComPtr<ID3D12RootSignature> bindless_root_signature;
 	{
-		array<CD3DX12_ROOT_PARAMETER, 4> root_parameters;
+		array<CD3DX12_ROOT_PARAMETER, 7> root_parameters;
 
 		// Constant Buffer View
 		root_parameters[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
@@ -559,6 +591,15 @@ int main()
 		cube_range.RegisterSpace = TEXTURE_CUBE_REGISTER_SPACE;
 		root_parameters[3].InitAsDescriptorTable(1, &cube_range);
 
+		// Node world matrix, then whether the instance transforms apply in world space
+		root_parameters[4].InitAsConstants(17, 2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+		// Instance transforms (StructuredBuffer<InstanceTransform>)
+		root_parameters[5].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+		// Instance indices of the draw's LOD (StructuredBuffer<uint>)
+		root_parameters[6].InitAsShaderResourceView(1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
 		array<CD3DX12_STATIC_SAMPLER_DESC, 1> samplers;
 		samplers[0].Init(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR);
 		samplers[0].AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
@@ -620,11 +661,15 @@ int main()
 	Texture hdr_equirectangular_texture = TextureBuilder()
 		.from_file("data/hdr/Newport_Loft.hdr")
 		.flip_vertically(true)
+		.with_usage(TextureUsage::Environment, &task_scheduler)
+		.with_hdr_format(DXGI_FORMAT_R9G9B9E5_SHAREDEXP) //Only used if the map can't be BC6H compressed
+		.with_compression_cache(TEXTURE_CACHE_DIRECTORY)
 		.with_debug_name("Env Map (equirectangular)")
 		.build(device, gpu_memory_allocator, command_queue);
 
 	const UINT hdr_cube_size = 1024;
-	DXGI_FORMAT cubemap_format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	//Cubemap shaders only write and read rgb, and radiance is never negative
+	DXGI_FORMAT cubemap_format = DXGI_FORMAT_R11G11B10_FLOAT;
 	
 	Texture hdr_cubemap_texture = TextureBuilder()
 		.with_format(cubemap_format)
@@ -679,6 +724,10 @@ int main()
 	
 	BindlessResourceManager bindless_resource_manager(device, gpu_memory_allocator);
 
+	//Model textures: each glTF image is built and registered once however many primitives use it
+	ImageService image_service(device, gpu_memory_allocator, command_queue, &task_scheduler, &bindless_resource_manager);
+	image_service.with_compression_cache(TEXTURE_CACHE_DIRECTORY);
+
 	//TODO: cubemap specific register function (checks that texture has 6 array elements), remove set_is_cubemap function from "Texture"
 	bindless_resource_manager.register_texture(hdr_cubemap_texture);
 	bindless_resource_manager.register_texture(ibl_cubemap_texture);
@@ -1019,11 +1068,25 @@ int main()
 		TConstantBufferArray<MeshRenderConstantBuffer, backbuffer_count> constant_buffers;
 
 		//TODO: Separate these, add to a 'material' struct
-		optional<Texture> base_color_texture;	
-		optional<Texture> metallic_roughness_texture;
+		//Shared with every other primitive using the same image, see ImageService
+		TextureRef base_color_texture;
+		TextureRef metallic_roughness_texture;
+
+		//Bind pose and influences of skinned primitives, and sparse targets of morphed primitives. render_data then only provides the index buffer.
+		optional<SkinnedPrimitive> skinned;
+		optional<MorphedPrimitive> morphed;
+
+		//Clusters of LOD 0's triangles with their culling bounds (bind pose bounds for skinned and morphed primitives)
+		Meshlets meshlets;
+
+		//Ranges of render_data's index buffer, LOD 0 then progressively simplified triangle lists of the same vertices
+		MeshLods lods;
+
+		//Object space box and sphere of the vertices, which instances are frustum culled and LODs selected with
+		PrimitiveBounds bounds;
 
 		GpuPrimitive() {}
-		GpuPrimitive(const GpuRenderData& in_render_data, D3D12MA::Allocator* in_gpu_memory_allocator, const optional<Texture>& in_base_color_texture, const optional<Texture>& in_metallic_roughness_texture)
+		GpuPrimitive(const GpuRenderData& in_render_data, D3D12MA::Allocator* in_gpu_memory_allocator, const TextureRef& in_base_color_texture, const TextureRef& in_metallic_roughness_texture)
 		: render_data(in_render_data)
 		, constant_buffers(in_gpu_memory_allocator)
 		, base_color_texture(in_base_color_texture)
@@ -1043,9 +1106,36 @@ int main()
 		{}
 	};
 
+	//A skinned or morphed primitive instanced by a node, deformed into its own vertex buffer each frame
+	struct DeformedDraw
+	{
+		uint32_t node = 0;
+		uint32_t mesh_index = 0;
+		uint32_t primitive_index = 0;
+		int32_t skin_index = SCENE_GRAPH_INVALID_INDEX; //Skinned (after morphing) when set
+		optional<MorphInstance> morph;
+		array<GpuDynamicVertexBuffer, backbuffer_count> vertex_buffers;
+	};
+
 	struct GpuModel
 	{
 		vector<GpuMesh> meshes;
+		SceneGraph scene_graph;
+		Animations animations;
+		vector<Skin> skins;
+		vector<DeformedDraw> deformed_draws;
+		vector<int32_t> node_instance_buffers; //Per scene graph node, index into instance_buffers or SCENE_GRAPH_INVALID_INDEX if it isn't instanced
+		vector<GpuStructuredBuffer> instance_buffers;
+		vector<vector<InstanceTransform>> instance_transforms; //CPU copies of instance_buffers, for LOD selection
+		vector<uint8_t> lod_states; //LOD each instance of each primitive drew last frame (see draw_primitive_lods)
+
+		//A skinned primitive of a skinned node is drawn static when the node's skin failed to build or lacks joints the primitive uses
+		bool is_drawn_skinned(const uint32_t node, const GpuPrimitive& primitive) const
+		{
+			const int32_t skin_index = scene_graph.skin_indices[node];
+			return skin_index != SCENE_GRAPH_INVALID_INDEX && primitive.skinned && skins[skin_index].joint_count() > 0
+				&& primitive.skinned->joint_count <= skins[skin_index].joint_count();
+		}
 	};
 
 	size_t num_models_to_load = _countof(model_paths);
@@ -1061,7 +1151,23 @@ int main()
 		GltfAsset gltf_asset;
 		{
 			rmt_ScopedCPUSample(gltf_load_asset, 0);
-			if (!gltf_load_asset(model_paths[i], &gltf_asset))
+
+			//Buffers (and the images in them) point straight into the mapped file.
+			//External files and data uris are loaded by tasks on the scheduler.
+			GltfLoadOptions load_options = {};
+			load_options.flags = GLTF_LOAD_FLAGS_MEMORY_MAP | GLTF_LOAD_FLAGS_STRUCTURAL_INDEX;
+			load_options.parallel_for = [](void* user_data, uint32_t count, GltfTaskFunction task_function, void* task_data)
+			{
+				enki::TaskScheduler* task_scheduler = (enki::TaskScheduler*) user_data;
+				enki::TaskSet parallel_for_task(count, [task_function, task_data](enki::TaskSetPartition range, uint32_t threadnum)
+				{
+					task_function(task_data, range.start, range.end);
+				});
+				task_scheduler->AddTaskSetToPipe(&parallel_for_task);
+				task_scheduler->WaitforTask(&parallel_for_task);
+			};
+			load_options.parallel_for_user_data = &task_scheduler;
+			if (!gltf_load_asset_with_options(model_paths[i], &load_options, &gltf_asset))
 			{
 				printf("FAILED TO LOAD GLTF ASSET: %s\n", model_paths[i]);
 				return;
@@ -1072,11 +1178,61 @@ int main()
 
 		GpuModel model;
 		model.meshes.resize(gltf_asset.num_meshes);
+		{
+			rmt_ScopedCPUSample(BuildSceneGraph, 0);
+			model.scene_graph.build(gltf_asset);
+		}
+		{
+			rmt_ScopedCPUSample(BuildAnimations, 0);
+			model.animations.build(gltf_asset, model.scene_graph);
+			if (!model.animations.clips.empty())
+			{
+				model.animations.clips[0].playing = true;
+			}
+		}
+		//EXT_mesh_gpu_instancing nodes get their instance transforms uploaded once, they are drawn with one instanced draw per primitive
+		{
+			rmt_ScopedCPUSample(BuildInstances, 0);
+
+			model.node_instance_buffers.assign(model.scene_graph.node_count, SCENE_GRAPH_INVALID_INDEX);
+			vector<InstanceTransform> instance_transforms;
+			for (uint32_t gltf_node_idx = 0; gltf_node_idx < gltf_asset.num_nodes; ++gltf_node_idx)
+			{
+				const GltfNode& gltf_node = gltf_asset.nodes[gltf_node_idx];
+				const int32_t node = model.scene_graph.node_from_gltf_node[gltf_node_idx];
+				if (gltf_node.num_instances == 0 || !gltf_node.mesh || node == SCENE_GRAPH_INVALID_INDEX)
+				{
+					continue;
+				}
+				if (!build_instance_transforms(gltf_node, instance_transforms))
+				{
+					printf("%s: node %u has unsupported instance attributes, drawing it once\n", model_paths[i], gltf_node_idx);
+					continue;
+				}
+
+				model.node_instance_buffers[node] = (int32_t) model.instance_buffers.size();
+				model.instance_buffers.push_back(GpuStructuredBuffer(gpu_memory_allocator, instance_transforms.data(), sizeof(InstanceTransform), gltf_node.num_instances));
+				model.instance_transforms.push_back(instance_transforms);
+			}
+		}
+
+		//Primitives are copied from the mesh cache when it was built from this exact source, otherwise they're imported and the cache is rewritten
+		const std::string mesh_cache_path = std::string(model_paths[i]) + ".meshcache";
+		const uint64_t source_hash = hash_gltf_source(gltf_asset);
+		MeshCache mesh_cache;
+		optional<MeshCacheWriter> mesh_cache_writer;
+		{
+			rmt_ScopedCPUSample(OpenMeshCache, 0);
+			if (!mesh_cache.open(mesh_cache_path.c_str(), source_hash, sizeof(GpuVertex)))
+			{
+				mesh_cache_writer.emplace(gltf_asset);
+			}
+		}
 
 		//FCS TODO: Parallel gltf mesh load
 		//FCS TODO: Parallel gltf primitive load
 
-		enki::TaskSet load_mesh_task(gltf_asset.num_meshes, [&task_scheduler, &model, &gltf_asset, &device, &gpu_memory_allocator, &command_queue, &bindless_resource_manager]( enki::TaskSetPartition mesh_range, uint32_t threadnum)
+		enki::TaskSet load_mesh_task(gltf_asset.num_meshes, [&task_scheduler, &model, &gltf_asset, &mesh_cache, &mesh_cache_writer, &device, &gpu_memory_allocator, &command_queue, &image_service]( enki::TaskSetPartition mesh_range, uint32_t threadnum)
 		{
 			const uint32_t mesh_idx = mesh_range.start;
 			rmt_ScopedCPUSample(LoadGltfMesh, 0);
@@ -1086,73 +1242,292 @@ int main()
 			vector<GpuPrimitive> primitives;
 			primitives.resize(gltf_mesh->num_primitives);
 			
-			enki::TaskSet load_prim_task(gltf_mesh->num_primitives, [&primitives, &gltf_mesh, &device, &gpu_memory_allocator, &command_queue, &bindless_resource_manager]( enki::TaskSetPartition prim_range, uint32_t threadnum)
+			enki::TaskSet load_prim_task(gltf_mesh->num_primitives, [mesh_idx, &primitives, &gltf_mesh, &task_scheduler, &mesh_cache, &mesh_cache_writer, &device, &gpu_memory_allocator, &command_queue, &image_service]( enki::TaskSetPartition prim_range, uint32_t threadnum)
 			{
 				const uint32_t prim_idx = prim_range.start;
 				
 				rmt_ScopedCPUSample(LoadGltfPrimitive, 0);
 				
-				vector<GpuVertex> vertices;
-				vector<UINT32> indices;
-		
 				GltfPrimitive* gltf_primitive = &gltf_mesh->primitives[prim_idx];
-	
-				//Vertices
-				uint8_t* positions_buffer = gltf_primitive->positions->buffer_view->buffer->data;
-				positions_buffer += gltf_accessor_get_initial_offset(gltf_primitive->positions);
-				uint32_t positions_byte_stride = gltf_accessor_get_stride(gltf_primitive->positions);
-	
-				uint8_t* normals_buffer = gltf_primitive->normals->buffer_view->buffer->data;
-				normals_buffer += gltf_accessor_get_initial_offset(gltf_primitive->normals);
-				uint32_t normals_byte_stride = gltf_accessor_get_stride(gltf_primitive->normals);
-	
-				uint8_t* uvs_buffer = gltf_primitive->texcoord0->buffer_view->buffer->data;
-				uvs_buffer += gltf_accessor_get_initial_offset(gltf_primitive->texcoord0);
-				uint32_t uvs_byte_stride = gltf_accessor_get_stride(gltf_primitive->texcoord0);
 
+				GpuRenderData render_data;
+				optional<SkinnedPrimitive> skinned_primitive;
+				auto build_skinned_primitive = [&skinned_primitive](const void* vertices, size_t vertex_count, const SkinInfluences* influences)
 				{
-					rmt_ScopedCPUSample(LoadPrimitiveVerts, 0);
-					
-					uint32_t vertices_count = gltf_primitive->positions->count;
-					vertices.reserve(vertices_count);
+					skinned_primitive.emplace();
+					if (!skinned_primitive->build(vertices, sizeof(GpuVertex), offsetof(GpuVertex, position), offsetof(GpuVertex, normal), (uint32_t) vertex_count, influences))
+					{
+						skinned_primitive.reset();
+					}
+				};
+				optional<MorphedPrimitive> morphed_primitive;
+				Meshlets meshlets;
+				MeshLods lods;
+				PrimitiveBounds bounds;
+
+				if (const MeshCachePrimitive* cached_primitive = mesh_cache.find_primitive(mesh_idx, prim_idx))
+				{
+					rmt_ScopedCPUSample(LoadCachedPrimitive, 0);
+					const DXGI_FORMAT index_format = cached_primitive->index_size == sizeof(UINT16) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+					render_data = GpuRenderData(gpu_memory_allocator, mesh_cache.vertex_data(*cached_primitive), sizeof(GpuVertex), cached_primitive->vertex_count,
+						mesh_cache.index_data(*cached_primitive), index_format, cached_primitive->index_count);
 
-					for (uint32_t vert_idx = 0; vert_idx < vertices_count; ++vert_idx) 
+					if (cached_primitive->skin_stride == sizeof(SkinInfluences))
 					{
-						GpuVertex vertex;
-						memcpy(&vertex.position, positions_buffer, positions_byte_stride);
-						memcpy(&vertex.normal, normals_buffer, normals_byte_stride);
-						vertex.color = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
-						memcpy(&vertex.uv, uvs_buffer, uvs_byte_stride);
-		
-						positions_buffer += positions_byte_stride;
-						normals_buffer += normals_byte_stride;
-						uvs_buffer += uvs_byte_stride;
-	
-						vertices.push_back(vertex);
+						build_skinned_primitive(mesh_cache.vertex_data(*cached_primitive), cached_primitive->vertex_count, (const SkinInfluences*) mesh_cache.skin_data(*cached_primitive));
 					}
+					if (const uint8_t* morph_data = mesh_cache.morph_data(*cached_primitive))
+					{
+						morphed_primitive.emplace();
+						if (!morphed_primitive->deserialize(morph_data, cached_primitive->morph_size, mesh_cache.vertex_data(*cached_primitive), sizeof(GpuVertex),
+							offsetof(GpuVertex, position), offsetof(GpuVertex, normal), cached_primitive->vertex_count))
+						{
+							morphed_primitive.reset();
+						}
+					}
+					const uint8_t* meshlet_data = mesh_cache.meshlet_data(*cached_primitive);
+					if (!meshlet_data || !meshlets.deserialize(meshlet_data, cached_primitive->meshlet_size, cached_primitive->vertex_count))
+					{
+						meshlets = Meshlets();
+					}
+					const uint8_t* lod_data = mesh_cache.lod_data(*cached_primitive);
+					if (!lod_data || !lods.deserialize(lod_data, cached_primitive->lod_size, cached_primitive->index_count))
+					{
+						lods.build_single(cached_primitive->index_count);
+					}
+					bounds = compute_primitive_bounds(reinterpret_cast<const float*>(mesh_cache.vertex_data(*cached_primitive) + offsetof(GpuVertex, position)), sizeof(GpuVertex),
+						cached_primitive->vertex_count, gltf_primitive->positions);
 				}
-
+				else
 				{
-					rmt_ScopedCPUSample(LoadPrimitiveIndices, 0);
-					//Indices
-					uint8_t* indices_buffer = gltf_primitive->indices->buffer_view->buffer->data;
-					indices_buffer += gltf_accessor_get_initial_offset(gltf_primitive->indices);
-					uint32_t indices_byte_stride = gltf_accessor_get_stride(gltf_primitive->indices);
-	
-					uint32_t indices_count = gltf_primitive->indices->count;
-					indices.reserve(indices_count);
-	
-					for (uint32_t indices_idx = 0; indices_idx < indices_count; ++indices_idx) 
+					vector<GpuVertex> vertices;
+					vector<SkinInfluences> skin_influences; //One per vertex for skinned primitives, otherwise empty
+					vector<SparseMorphTarget> morph_targets;
+					vector<uint32_t> morph_sources;         //One per vertex for morphed primitives, otherwise empty
+					vector<UINT32> indices;
+
+					//Vertices
 					{
-						UINT32 index = 0;
-						memcpy(&index, indices_buffer, indices_byte_stride);
-						indices_buffer += indices_byte_stride;
-						indices.push_back(index);
+						rmt_ScopedCPUSample(LoadPrimitiveVerts, 0);
+
+						//Gathered straight into GpuVertex from each accessor's stride and component type (including normalized and KHR_mesh_quantization data)
+						const uint32_t vertices_count = gltf_primitive->positions->count;
+						vertices.resize(vertices_count);
+
+						VertexPackAttribute attributes[4];
+						attributes[0].accessor = gltf_primitive->positions;
+						attributes[0].offset = offsetof(GpuVertex, position);
+						attributes[0].format = VertexPackFormat::Float3;
+
+						attributes[1].accessor = gltf_primitive->normals && gltf_primitive->normals->count == vertices_count ? gltf_primitive->normals : nullptr;
+						attributes[1].offset = offsetof(GpuVertex, normal);
+						attributes[1].format = VertexPackFormat::Float3;
+						attributes[1].default_value[2] = 1.0f;
+
+						attributes[2].offset = offsetof(GpuVertex, color);
+						attributes[2].format = VertexPackFormat::Float4;
+						attributes[2].default_value[0] = 1.0f;
+						attributes[2].default_value[3] = 1.0f;
+
+						attributes[3].accessor = gltf_primitive->texcoord0 && gltf_primitive->texcoord0->count == vertices_count ? gltf_primitive->texcoord0 : nullptr;
+						attributes[3].offset = offsetof(GpuVertex, uv);
+						attributes[3].format = VertexPackFormat::Float2;
+
+						const double pack_start = gltf_get_time_seconds();
+						if (!pack_vertices(attributes, _countof(attributes), vertices_count, vertices.data(), sizeof(GpuVertex)))
+						{
+							printf("%s [%u]: unsupported vertex attribute type\n", gltf_mesh->name, prim_idx);
+						}
+						const double pack_seconds = gltf_get_time_seconds() - pack_start;
+						if (PRINT_MESH_IMPORT_STATS)
+						{
+							printf("%s [%u]: packed %u vertices in %.3f ms (%.1f M vertices/s)\n", gltf_mesh->name, prim_idx, vertices_count, pack_seconds * 1000.0,
+								pack_seconds > 0.0 ? vertices_count / pack_seconds * 1e-6 : 0.0);
+						}
+
+						if (gltf_primitive->joints0 && gltf_primitive->weights0)
+						{
+							skin_influences.resize(vertices_count);
+							if (!unpack_skin_influences(*gltf_primitive, skin_influences.data(), sizeof(SkinInfluences)))
+							{
+								printf("%s [%u]: unsupported joints or weights, drawing it unskinned\n", gltf_mesh->name, prim_idx);
+								skin_influences.clear();
+							}
+						}
+
+						if (gltf_primitive->num_targets > 0)
+						{
+							if (unpack_morph_targets(*gltf_primitive, morph_targets))
+							{
+								morph_sources = compute_morph_sources(morph_targets, vertices_count);
+							}
+							else
+							{
+								printf("%s [%u]: unsupported morph targets, drawing it unmorphed\n", gltf_mesh->name, prim_idx);
+								morph_targets.clear();
+							}
+						}
+					}
+
+					{
+						rmt_ScopedCPUSample(LoadPrimitiveIndices, 0);
+						//Indices (unsigned byte, short or int)
+						uint32_t indices_count = gltf_primitive->indices->count;
+						indices.resize(indices_count);
+						gltf_accessor_unpack_indices(gltf_primitive->indices, indices.data());
+					}
+
+					bool indices_valid = indices.size() % 3 == 0;
+					for (const UINT32 index : indices) { indices_valid &= index < vertices.size(); }
+
+					//Merge duplicate vertices, reorder for the post-transform vertex cache, then for overdraw, then renumber vertices for fetch locality
+					{
+						rmt_ScopedCPUSample(OptimizePrimitive, 0);
+
+						if (indices_valid && !indices.empty())
+						{
+							const VertexCacheStats stats_before = PRINT_MESH_IMPORT_STATS ? analyze_vertex_cache(indices.data(), indices.size(), vertices.size()) : VertexCacheStats{};
+							const size_t loaded_vertex_count = vertices.size();
+
+							//Positions come first in both GpuVertex and DeformableGpuVertex
+							auto optimize_vertices = [&indices](auto& optimized_vertices)
+							{
+								deduplicate_vertices(optimized_vertices, indices);
+
+								const vector<uint32_t> hard_boundaries = optimize_vertex_cache(indices.data(), indices.size(), optimized_vertices.size());
+								optimize_overdraw(indices.data(), indices.size(), hard_boundaries, reinterpret_cast<const float*>(optimized_vertices.data()), sizeof(optimized_vertices[0]), optimized_vertices.size());
+								optimize_vertex_fetch(optimized_vertices, indices);
+							};
+
+							if (skin_influences.empty() && morph_sources.empty())
+							{
+								optimize_vertices(vertices);
+							}
+							else
+							{
+								vector<DeformableGpuVertex> deformable_vertices(vertices.size());
+								for (size_t vertex_idx = 0; vertex_idx < vertices.size(); ++vertex_idx)
+								{
+									DeformableGpuVertex& deformable_vertex = deformable_vertices[vertex_idx];
+									memset(&deformable_vertex, 0, sizeof(DeformableGpuVertex));
+									deformable_vertex.vertex = vertices[vertex_idx];
+									if (!skin_influences.empty())
+									{
+										deformable_vertex.influences = skin_influences[vertex_idx];
+									}
+									deformable_vertex.morph_source = morph_sources.empty() ? MORPH_INVALID_SOURCE : morph_sources[vertex_idx];
+								}
+
+								optimize_vertices(deformable_vertices);
+
+								vertices.resize(deformable_vertices.size());
+								skin_influences.resize(skin_influences.empty() ? 0 : deformable_vertices.size());
+								morph_sources.resize(morph_sources.empty() ? 0 : deformable_vertices.size());
+								for (size_t vertex_idx = 0; vertex_idx < deformable_vertices.size(); ++vertex_idx)
+								{
+									vertices[vertex_idx] = deformable_vertices[vertex_idx].vertex;
+									if (!skin_influences.empty())
+									{
+										skin_influences[vertex_idx] = deformable_vertices[vertex_idx].influences;
+									}
+									if (!morph_sources.empty())
+									{
+										morph_sources[vertex_idx] = deformable_vertices[vertex_idx].morph_source;
+									}
+								}
+							}
+
+							if (PRINT_MESH_IMPORT_STATS)
+							{
+								const VertexCacheStats stats_after = analyze_vertex_cache(indices.data(), indices.size(), vertices.size());
+								printf("%s [%u]: vertices %zu -> %zu, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", gltf_mesh->name, prim_idx, loaded_vertex_count, vertices.size(),
+									stats_before.acmr, stats_after.acmr, stats_before.atvr, stats_after.atvr);
+							}
+						}
+					}
+
+					//Simplified LODs are appended to indices, so every LOD is drawn from the same index buffer
+					vector<uint8_t> lod_blob;
+					{
+						rmt_ScopedCPUSample(BuildLods, 0);
+
+						const uint8_t* vertex_bytes = reinterpret_cast<const uint8_t*>(vertices.data());
+						const float* positions = reinterpret_cast<const float*>(vertex_bytes + offsetof(GpuVertex, position));
+						bounds = compute_primitive_bounds(positions, sizeof(GpuVertex), vertices.size(), gltf_primitive->positions);
+						if (indices_valid && !indices.empty())
+						{
+							const double lod_start = gltf_get_time_seconds();
+							lods.build(indices, positions, reinterpret_cast<const float*>(vertex_bytes + offsetof(GpuVertex, normal)),
+								reinterpret_cast<const float*>(vertex_bytes + offsetof(GpuVertex, uv)), sizeof(GpuVertex), vertices.size());
+							const double lod_seconds = gltf_get_time_seconds() - lod_start;
+
+							if (PRINT_MESH_IMPORT_STATS)
+							{
+								char lod_triangles[256] = {};
+								int lod_triangles_length = 0;
+								for (const MeshLod& lod : lods.lods)
+								{
+									lod_triangles_length += snprintf(lod_triangles + lod_triangles_length, sizeof(lod_triangles) - lod_triangles_length, " %u (%.2g)", lod.index_count / 3, lod.error);
+								}
+								printf("%s [%u]: %zu LODs in %.3f ms, triangles (error):%s\n", gltf_mesh->name, prim_idx, lods.lods.size(), lod_seconds * 1000.0, lod_triangles);
+							}
+						}
+						else
+						{
+							lods.build_single((uint32_t) indices.size());
+						}
+						lods.serialize(lod_blob);
+					}
+
+					render_data = GpuRenderData(gpu_memory_allocator, vertices, indices);
+					if (!skin_influences.empty())
+					{
+						build_skinned_primitive(vertices.data(), vertices.size(), skin_influences.data());
+					}
+					vector<uint8_t> morph_blob;
+					if (!morph_sources.empty())
+					{
+						morphed_primitive.emplace();
+						if (morphed_primitive->build(vertices.data(), sizeof(GpuVertex), offsetof(GpuVertex, position), offsetof(GpuVertex, normal), (uint32_t) vertices.size(),
+							morph_sources.data(), morph_targets))
+						{
+							morphed_primitive->serialize(morph_blob);
+						}
+						else
+						{
+							morphed_primitive.reset();
+						}
+					}
+					vector<uint8_t> meshlet_blob;
+					{
+						rmt_ScopedCPUSample(BuildMeshlets, 0);
+
+						//Invalid indices leave meshlets empty, the primitive is then drawn without them
+						const double meshlet_start = gltf_get_time_seconds();
+						const bool meshlets_built = indices_valid && !indices.empty()
+							&& meshlets.build(indices.data(), lods.lods[0].index_count, reinterpret_cast<const float*>(vertices.data()), sizeof(GpuVertex), vertices.size());
+						const double meshlet_seconds = gltf_get_time_seconds() - meshlet_start;
+
+						if (PRINT_MESH_IMPORT_STATS && meshlets_built)
+						{
+							const MeshletStats meshlet_stats = meshlets.analyze(vertices.size());
+							printf("%s [%u]: %zu meshlets in %.3f ms, %.1f vertices %.1f triangles each, vertex ratio %.3f, %.0f%% cone cullable\n", gltf_mesh->name, prim_idx,
+								meshlets.meshlets.size(), meshlet_seconds * 1000.0, meshlet_stats.average_vertices, meshlet_stats.average_triangles, meshlet_stats.vertex_ratio,
+								meshlet_stats.cullable_ratio * 100.0f);
+						}
+						meshlets.serialize(meshlet_blob);
+					}
+					if (mesh_cache_writer)
+					{
+						const uint32_t index_size = render_data.index_buffer_view.Format == DXGI_FORMAT_R16_UINT ? sizeof(UINT16) : sizeof(UINT32);
+						mesh_cache_writer->record_primitive(mesh_idx, prim_idx, vertices.data(), sizeof(GpuVertex), vertices.size(), indices.data(), indices.size(), index_size,
+							skin_influences.empty() ? nullptr : skin_influences.data(), sizeof(SkinInfluences), morph_blob.empty() ? nullptr : morph_blob.data(), morph_blob.size(),
+							meshlets.meshlets.empty() ? nullptr : meshlet_blob.data(), meshlet_blob.size(), lod_blob.data(), lod_blob.size());
 					}
 				}
 
-				optional<Texture> base_color_texture;
-				optional<Texture> metallic_roughness_texture;
+				TextureRef base_color_texture;
+				TextureRef metallic_roughness_texture;
 				{
 					rmt_ScopedCPUSample(LoadPrimitiveMaterial, 0);
 				
@@ -1161,35 +1536,32 @@ int main()
 						GltfPbrMetallicRoughness* gltf_pbr = &gltf_primitive->material->pbr_metallic_roughness;
 						if (GltfTexture* gltf_base_color_texture = gltf_pbr->base_color_texture)
 						{
-							GltfBufferView* gltf_buffer_view = gltf_base_color_texture->image->buffer_view;
-							GltfBuffer* gltf_buffer = gltf_buffer_view->buffer;
-				
-							uint8_t* buffer_ptr = gltf_buffer->data + gltf_buffer_view->byte_offset;
-							size_t byte_length = gltf_buffer_view->byte_length;
-
-							base_color_texture = TextureBuilder().from_binary_data(buffer_ptr, byte_length).build(device, gpu_memory_allocator, command_queue);
+							ImageSettings base_color_settings;
+							base_color_settings.usage = TextureUsage::Color;
+							base_color_settings.mip_filter = MipFilter::Kaiser;
+							base_color_settings.generate_mips = true;
 							std::string base_color_string = std::string(gltf_mesh->name) + "_BaseColorTexture";
-							base_color_texture->set_name(base_color_string.c_str());
-							bindless_resource_manager.register_texture(*base_color_texture);
+							base_color_texture = image_service.request(gltf_base_color_texture->image, base_color_settings, base_color_string.c_str());
 						}
 				
 						if (GltfTexture* gltf_metallic_roughness_texture = gltf_pbr->metallic_roughness_texture)
 						{
-							GltfBufferView* gltf_buffer_view = gltf_metallic_roughness_texture->image->buffer_view;
-							GltfBuffer* gltf_buffer = gltf_buffer_view->buffer;
-				
-							uint8_t* buffer_ptr = gltf_buffer->data + gltf_buffer_view->byte_offset;
-							size_t byte_length = gltf_buffer_view->byte_length;
-				
-							metallic_roughness_texture = TextureBuilder().from_binary_data(buffer_ptr, byte_length).build(device, gpu_memory_allocator, command_queue);
-							std::string base_color_string = std::string(gltf_mesh->name) + "_MetallicRoughnessTexture";
-							metallic_roughness_texture->set_name(base_color_string.c_str());
-							bindless_resource_manager.register_texture(*metallic_roughness_texture);
+							ImageSettings metallic_roughness_settings;
+							metallic_roughness_settings.usage = TextureUsage::MetallicRoughness;
+							metallic_roughness_settings.mip_filter = MipFilter::Box;
+							metallic_roughness_settings.generate_mips = true;
+							std::string metallic_roughness_string = std::string(gltf_mesh->name) + "_MetallicRoughnessTexture";
+							metallic_roughness_texture = image_service.request(gltf_metallic_roughness_texture->image, metallic_roughness_settings, metallic_roughness_string.c_str());
 						}
 					}
 				}
 
-				primitives[prim_idx] = GpuPrimitive(GpuRenderData(gpu_memory_allocator, vertices, indices), gpu_memory_allocator, base_color_texture, metallic_roughness_texture);
+				primitives[prim_idx] = GpuPrimitive(render_data, gpu_memory_allocator, base_color_texture, metallic_roughness_texture);
+				primitives[prim_idx].skinned = skinned_primitive;
+				primitives[prim_idx].morphed = morphed_primitive;
+				primitives[prim_idx].meshlets = meshlets;
+				primitives[prim_idx].lods = lods;
+				primitives[prim_idx].bounds = bounds;
 			});
 
 			task_scheduler.AddTaskSetToPipe(&load_prim_task);
@@ -1201,6 +1573,86 @@ int main()
 		task_scheduler.AddTaskSetToPipe(&load_mesh_task);
 		task_scheduler.WaitforTask(&load_mesh_task);
 
+		if (mesh_cache.is_open())
+		{
+			printf("Mesh Cache: loaded %s\n", mesh_cache_path.c_str());
+		}
+		else if (mesh_cache_writer)
+		{
+			rmt_ScopedCPUSample(WriteMeshCache, 0);
+			if (mesh_cache_writer->write(mesh_cache_path.c_str(), source_hash, sizeof(GpuVertex)))
+			{
+				printf("Mesh Cache: wrote %s\n", mesh_cache_path.c_str());
+			}
+			else
+			{
+				printf("Mesh Cache: FAILED TO WRITE %s\n", mesh_cache_path.c_str());
+			}
+		}
+		mesh_cache.release();
+
+		//Each node using a skinned or morphed primitive gets its own vertex buffers, so instances of a mesh are posed by their own skin and weights
+		{
+			rmt_ScopedCPUSample(SetupSkinning, 0);
+
+			model.skins.resize(gltf_asset.num_skins);
+			for (uint32_t skin_idx = 0; skin_idx < gltf_asset.num_skins; ++skin_idx)
+			{
+				if (!model.skins[skin_idx].build(gltf_asset.skins[skin_idx], gltf_asset, model.scene_graph))
+				{
+					printf("%s: skin %u has joints outside of the scene, its primitives are drawn unskinned\n", model_paths[i], skin_idx);
+				}
+			}
+
+			const SceneGraph& scene_graph = model.scene_graph;
+			for (uint32_t node = 0; node < scene_graph.node_count; ++node)
+			{
+				const int32_t mesh_index = scene_graph.mesh_indices[node];
+				if (mesh_index == SCENE_GRAPH_INVALID_INDEX)
+				{
+					continue;
+				}
+				const int32_t skin_index = scene_graph.skin_indices[node];
+				const bool node_is_morphed = scene_graph.morph_weight_counts[node] > 0;
+
+				const vector<GpuPrimitive>& primitives = model.meshes[mesh_index].primitives;
+				for (uint32_t prim_idx = 0; prim_idx < primitives.size(); ++prim_idx)
+				{
+					const optional<SkinnedPrimitive>& skinned = primitives[prim_idx].skinned;
+					const optional<MorphedPrimitive>& morphed = primitives[prim_idx].morphed;
+
+					DeformedDraw deformed_draw;
+					deformed_draw.node = node;
+					deformed_draw.mesh_index = mesh_index;
+					deformed_draw.primitive_index = prim_idx;
+					if (model.is_drawn_skinned(node, primitives[prim_idx]))
+					{
+						deformed_draw.skin_index = skin_index;
+					}
+					else if (skin_index != SCENE_GRAPH_INVALID_INDEX && skinned && model.skins[skin_index].joint_count() > 0)
+					{
+						printf("%s: mesh %d [%u] uses joints skin %d doesn't have, drawing it unskinned\n", model_paths[i], mesh_index, prim_idx, skin_index);
+					}
+					if (node_is_morphed && morphed)
+					{
+						deformed_draw.morph.emplace(*morphed);
+					}
+					if (deformed_draw.skin_index == SCENE_GRAPH_INVALID_INDEX && !deformed_draw.morph)
+					{
+						continue;
+					}
+
+					const uint32_t vertex_stride = deformed_draw.morph ? morphed->vertex_stride : skinned->vertex_stride;
+					const uint32_t vertex_count = deformed_draw.morph ? morphed->vertex_count : skinned->vertex_count;
+					for (GpuDynamicVertexBuffer& vertex_buffer : deformed_draw.vertex_buffers)
+					{
+						vertex_buffer = GpuDynamicVertexBuffer(gpu_memory_allocator, vertex_stride, vertex_count);
+					}
+					model.deformed_draws.push_back(deformed_draw);
+				}
+			}
+		}
+
 		models[i] = model;
 
 		gltf_free_asset(&gltf_asset);
@@ -1211,6 +1663,55 @@ int main()
 
 	TConstantBufferArray<SceneConstantBuffer, backbuffer_count> scene_constant_buffers(gpu_memory_allocator);
 
+	//Nodes that aren't instanced by their glTF are drawn mesh_instance_count times on this grid, 10 instances per column.
+	//Grid offsets apply in world space, after the node's world matrix, so every node of a model (and its deformed draws) moves as one.
+	const int max_mesh_instance_count = 100;
+	GpuStructuredBuffer mesh_instance_grid;
+	vector<InstanceTransform> grid_transforms;
+	{
+		const float grid_offset[3] = { -10.0f, 0.0f, 0.0f };
+		build_instance_grid(max_mesh_instance_count, 10, 2.25f, grid_offset, grid_transforms);
+		mesh_instance_grid = GpuStructuredBuffer(gpu_memory_allocator, grid_transforms.data(), sizeof(InstanceTransform), max_mesh_instance_count);
+	}
+
+	//Instanced draws write the indices of their instances, grouped by LOD, to this frame's instance index buffer.
+	//Every primitive of every node (and every deformed draw) has its own range, reserved in draw order for as many instances as it can have.
+	auto count_lod_slots = [max_mesh_instance_count](const GpuModel& model) -> size_t
+	{
+		auto instance_capacity = [&](int32_t instance_buffer_index) -> size_t
+		{
+			return instance_buffer_index == SCENE_GRAPH_INVALID_INDEX ? max_mesh_instance_count : model.instance_buffers[instance_buffer_index].element_count;
+		};
+
+		size_t lod_slots = 0;
+		for (uint32_t node = 0; node < model.scene_graph.node_count; ++node)
+		{
+			const int32_t mesh_index = model.scene_graph.mesh_indices[node];
+			if (mesh_index != SCENE_GRAPH_INVALID_INDEX)
+			{
+				lod_slots += instance_capacity(model.node_instance_buffers[node]) * model.meshes[mesh_index].primitives.size();
+			}
+		}
+		for (const DeformedDraw& deformed_draw : model.deformed_draws)
+		{
+			lod_slots += instance_capacity(deformed_draw.skin_index != SCENE_GRAPH_INVALID_INDEX ? SCENE_GRAPH_INVALID_INDEX : model.node_instance_buffers[deformed_draw.node]);
+		}
+		return lod_slots;
+	};
+
+	size_t max_lod_slots = 0;
+	for (GpuModel& model : models)
+	{
+		const size_t lod_slots = count_lod_slots(model);
+		model.lod_states.assign(lod_slots, 0);
+		max_lod_slots = lod_slots > max_lod_slots ? lod_slots : max_lod_slots;
+	}
+	array<GpuDynamicStructuredBuffer, backbuffer_count> lod_instance_buffers;
+	for (GpuDynamicStructuredBuffer& lod_instance_buffer : lod_instance_buffers)
+	{
+		lod_instance_buffer = GpuDynamicStructuredBuffer(gpu_memory_allocator, sizeof(uint32_t), static_cast<UINT>(max_lod_slots));
+	}
+
 	//Eventually these will hold per-frame data (transform, etc.)
 	// TConstantBufferArray<MeshRenderConstantBuffer, backbuffer_count> mesh_constant_buffers(gpu_memory_allocator); //TODO: Move into GpuPrimitive
 	TConstantBufferArray<InstanceConstantBuffer, backbuffer_count> skybox_constant_buffers(gpu_memory_allocator);
@@ -1260,7 +1761,28 @@ int main()
 	int skybox_texture_lod = 0;
 	bool draw_skybox = true;
 	
-	int mesh_instance_count = 100;
+	int mesh_instance_count = max_mesh_instance_count;
+
+	//Instances draw the coarsest LOD whose error projects to fewer than lod_threshold_pixels pixels
+	float lod_threshold_pixels = 1.0f;
+	float lod_hysteresis = 0.1f;
+	int forced_lod = -1;
+	uint32_t lod_instance_counts[MESH_LOD_MAX_COUNT] = {}; //Drawn last frame
+	uint64_t lod_triangle_count = 0;
+	vector<float> lod_pixels_per_unit;
+	vector<uint32_t> lod_instances;
+
+	//Instances whose bounding sphere is outside the view frustum are dropped before LOD selection
+	bool frustum_culling = true;
+	double culling_seconds = 0.0; //Last frame's totals
+	uint32_t culling_tested_count = 0;
+	uint32_t culling_visible_count = 0;
+	InstanceSpheres culling_spheres;
+	vector<uint32_t> culling_visible;
+
+	float animation_speed = 1.0f;
+	vector<MorphJob> morph_jobs;
+	vector<SkinningJob> skinning_jobs;
 
 	bool use_reference_lut = false;
 
@@ -1390,7 +1912,80 @@ int main()
 					ImGui::EndCombo();
 				}
 
-				ImGui::SliderInt("Instances", &mesh_instance_count, 1, 100);
+				ImGui::SliderInt("Instances", &mesh_instance_count, 1, max_mesh_instance_count);
+
+				//One clip of the model plays at a time
+				vector<AnimationClip>& clips = models[model_to_render_idx].animations.clips;
+				if (!clips.empty())
+				{
+					int playing_clip_idx = -1;
+					for (uint32_t i = 0; i < clips.size(); ++i)
+					{
+						playing_clip_idx = clips[i].playing ? (int) i : playing_clip_idx;
+					}
+
+					auto clip_label = [&](int clip_idx)
+					{
+						static char label[64];
+						if (clip_idx < 0)
+						{
+							return "None";
+						}
+						if (!clips[clip_idx].name.empty())
+						{
+							return clips[clip_idx].name.c_str();
+						}
+						snprintf(label, sizeof(label), "Animation %d", clip_idx);
+						return (const char*) label;
+					};
+
+					if (ImGui::BeginCombo("Animation", clip_label(playing_clip_idx)))
+					{
+						for (int i = -1; i < (int) clips.size(); ++i)
+						{
+							const bool is_selected = i == playing_clip_idx;
+							if (ImGui::Selectable(clip_label(i), is_selected))
+							{
+								for (uint32_t j = 0; j < clips.size(); ++j)
+								{
+									clips[j].playing = (int) j == i;
+									clips[j].time = 0.0f;
+								}
+							}
+
+							if (is_selected)
+							{
+								ImGui::SetItemDefaultFocus();
+							}
+						}
+
+						ImGui::EndCombo();
+					}
+					ImGui::SliderFloat("Animation Speed", &animation_speed, 0.0f, 4.0f);
+				}
+				ImGui::Unindent();
+			}
+
+			if (ImGui::CollapsingHeader("Level of Detail"))
+			{
+				ImGui::Indent();
+				ImGui::SliderFloat("Error Threshold (pixels)", &lod_threshold_pixels, 0.25f, 16.0f);
+				ImGui::SliderFloat("Hysteresis", &lod_hysteresis, 0.0f, 0.5f);
+				ImGui::SliderInt("Force LOD", &forced_lod, -1, MESH_LOD_MAX_COUNT - 1);
+				ImGui::Text("Triangles drawn: %llu", (unsigned long long) lod_triangle_count);
+				for (uint32_t lod_idx = 0; lod_idx < MESH_LOD_MAX_COUNT; ++lod_idx)
+				{
+					ImGui::Text("LOD %u: %u instances", lod_idx, lod_instance_counts[lod_idx]);
+				}
+				ImGui::Unindent();
+			}
+
+			if (ImGui::CollapsingHeader("Frustum Culling"))
+			{
+				ImGui::Indent();
+				ImGui::Checkbox("Enable Culling", &frustum_culling);
+				ImGui::Text("CPU time: %.3f ms", culling_seconds * 1000.0);
+				ImGui::Text("Instances visible: %u / %u tested", culling_visible_count, culling_tested_count);
 				ImGui::Unindent();
 			}
 
@@ -1410,14 +2005,14 @@ int main()
 						{
 							for (auto& primitive : mesh.primitives)
 							{
-								if (primitive.base_color_texture && primitive.base_color_texture->bindless_index != BINDLESS_INVALID_INDEX)
+								//Textures are shared between primitives, only list them once
+								for (Texture* primitive_texture : {primitive.base_color_texture.get(), primitive.metallic_roughness_texture.get()})
 								{
-									debug_view_textures.push_back(&(*primitive.base_color_texture));
-								}
-
-								if (primitive.metallic_roughness_texture && primitive.metallic_roughness_texture->bindless_index != BINDLESS_INVALID_INDEX)
-								{
-									debug_view_textures.push_back(&(*primitive.metallic_roughness_texture));
+									if (primitive_texture && primitive_texture->bindless_index != BINDLESS_INVALID_INDEX
+										&& eastl::find(debug_view_textures.begin(), debug_view_textures.end(), primitive_texture) == debug_view_textures.end())
+									{
+										debug_view_textures.push_back(primitive_texture);
+									}
 								}
 							}
 						}
@@ -1511,6 +2106,12 @@ int main()
 			float fov_y = 45.0f;
 			float aspect_ratio = static_cast<float>(width) / static_cast<float>(height);
 			scene_cbuffer_data.proj = XMMatrixPerspectiveFovLH(fov_y, aspect_ratio, 0.01f, 100000.0f);
+			//Pixels covered by one unit at a distance of one unit, for LOD selection
+			const float projection_scale = 0.5f * static_cast<float>(height) * fabsf(XMVectorGetY(scene_cbuffer_data.proj.r[1]));
+
+			XMFLOAT4X4 view_proj;
+			XMStoreFloat4x4(&view_proj, XMMatrixMultiply(scene_cbuffer_data.view, scene_cbuffer_data.proj));
+			const Frustum frustum = extract_frustum(&view_proj.m[0][0]);
 			
 			scene_cbuffer_data.cam_pos = cam_pos;
 			scene_cbuffer_data.cam_dir = cam_forward;
@@ -1519,6 +2120,71 @@ int main()
 			skybox_constant_buffers.data(frame_resources.frame_index).texture_lod = skybox_texture_lod;
 
 			GpuModel& model_to_render = models[model_to_render_idx];
+			{
+				rmt_ScopedCPUSample(EvaluateAnimations, 0);
+				model_to_render.animations.advance(static_cast<float>(delta_time) * animation_speed);
+				model_to_render.animations.evaluate(model_to_render.scene_graph, task_scheduler);
+			}
+			{
+				rmt_ScopedCPUSample(UpdateWorldTransforms, 0);
+				model_to_render.scene_graph.update_world_transforms(task_scheduler);
+			}
+
+			//Morph targets are blended first (directly into this frame's vertex buffer when there is no skin to apply afterwards)
+			if (!model_to_render.deformed_draws.empty())
+			{
+				rmt_ScopedCPUSample(MorphVertices, 0);
+
+				const SceneGraph& scene_graph = model_to_render.scene_graph;
+				morph_jobs.clear();
+				for (DeformedDraw& deformed_draw : model_to_render.deformed_draws)
+				{
+					if (!deformed_draw.morph)
+					{
+						continue;
+					}
+
+					MorphJob morph_job;
+					morph_job.primitive = &*model_to_render.meshes[deformed_draw.mesh_index].primitives[deformed_draw.primitive_index].morphed;
+					morph_job.instance = &*deformed_draw.morph;
+					morph_job.weights = &scene_graph.morph_weights[scene_graph.morph_weight_offsets[deformed_draw.node]];
+					morph_job.weight_count = scene_graph.morph_weight_counts[deformed_draw.node];
+					if (deformed_draw.skin_index == SCENE_GRAPH_INVALID_INDEX)
+					{
+						morph_job.out_vertices = deformed_draw.vertex_buffers[frame_resources.frame_index].mapped_data;
+					}
+					morph_jobs.push_back(morph_job);
+				}
+				morph_batch(task_scheduler, morph_jobs.data(), (uint32_t) morph_jobs.size());
+			}
+
+			//Joint matrices follow the updated joints, then every skinned draw is skinned into this frame's vertex buffer
+			if (!model_to_render.deformed_draws.empty())
+			{
+				rmt_ScopedCPUSample(SkinVertices, 0);
+
+				for (Skin& skin : model_to_render.skins)
+				{
+					skin.update_joint_matrices(model_to_render.scene_graph);
+				}
+
+				skinning_jobs.clear();
+				for (DeformedDraw& deformed_draw : model_to_render.deformed_draws)
+				{
+					if (deformed_draw.skin_index == SCENE_GRAPH_INVALID_INDEX)
+					{
+						continue;
+					}
+
+					SkinningJob skinning_job;
+					skinning_job.primitive = &*model_to_render.meshes[deformed_draw.mesh_index].primitives[deformed_draw.primitive_index].skinned;
+					skinning_job.joint_matrices = model_to_render.skins[deformed_draw.skin_index].joint_matrices.data();
+					skinning_job.bind_vertices = deformed_draw.morph ? deformed_draw.morph->vertices.data() : nullptr;
+					skinning_job.out_vertices = deformed_draw.vertex_buffers[frame_resources.frame_index].mapped_data;
+					skinning_jobs.push_back(skinning_job);
+				}
+				skin_batch(task_scheduler, skinning_jobs.data(), (uint32_t) skinning_jobs.size());
+			}
 			
 			for (GpuMesh& mesh : model_to_render.meshes)
 			{
@@ -1526,9 +2192,9 @@ int main()
 				{
 					primitive.constant_buffers.data(frame_resources.frame_index).specular_lut_texture_index = use_reference_lut ? reference_lut.bindless_index : specular_lut_texture.bindless_index;
 					//TODO: Below only needs to be set up once
-					const bool has_base_color = primitive.base_color_texture.has_value();
+					const bool has_base_color = primitive.base_color_texture != nullptr;
 					primitive.constant_buffers.data(frame_resources.frame_index).base_color_texture_index = has_base_color ? primitive.base_color_texture->bindless_index : BINDLESS_INVALID_INDEX;
-					const bool has_metallic_rough = primitive.metallic_roughness_texture.has_value();
+					const bool has_metallic_rough = primitive.metallic_roughness_texture != nullptr;
 					primitive.constant_buffers.data(frame_resources.frame_index).metallic_roughness_texture_index = has_metallic_rough ? primitive.metallic_roughness_texture->bindless_index : BINDLESS_INVALID_INDEX;
 				}
 			}
@@ -1552,6 +2218,7 @@ int main()
 			command_list->SetGraphicsRootDescriptorTable(2, bindless_resource_manager.get_texture_gpu_handle());
 			//Slot 3: bindless cubemap table
 			command_list->SetGraphicsRootDescriptorTable(3, bindless_resource_manager.get_cubemap_gpu_handle());
+			//Slot 4: set per-node
 
 			D3D12_VIEWPORT viewport = {};
 			viewport.TopLeftX = 0.0f;
@@ -1583,10 +2250,131 @@ int main()
 			command_list->ClearRenderTargetView(rtv_handle, clear_color, 0, nullptr);
 			command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 			
-			for (GpuMesh& mesh : model_to_render.meshes)
+			struct NodeInstances
 			{
-				for (GpuPrimitive& primitive : mesh.primitives)
+				const InstanceTransform* transforms = nullptr;
+				UINT count = 0;
+				UINT capacity = 0; //Instance index range reserved per primitive (see count_lod_slots)
+				bool in_world_space = false; //Grid transforms apply after the node's world matrix, EXT_mesh_gpu_instancing ones before it
+			};
+
+			//Slot 5: instance transforms of the node's EXT_mesh_gpu_instancing, or the instance grid
+			//Slot 4 (after the world matrix): whether they apply in world space
+			auto set_node_instances = [&](int32_t instance_buffer_index) -> NodeInstances
+			{
+				NodeInstances instances;
+				if (instance_buffer_index == SCENE_GRAPH_INVALID_INDEX)
+				{
+					command_list->SetGraphicsRootShaderResourceView(5, mesh_instance_grid.get_gpu_virtual_address());
+					command_list->SetGraphicsRoot32BitConstant(4, 1, 16);
+					instances.transforms = grid_transforms.data();
+					instances.count = static_cast<UINT>(mesh_instance_count);
+					instances.capacity = max_mesh_instance_count;
+					instances.in_world_space = true;
+					return instances;
+				}
+				command_list->SetGraphicsRoot32BitConstant(4, 0, 16);
+				const GpuStructuredBuffer& instance_buffer = model_to_render.instance_buffers[instance_buffer_index];
+				command_list->SetGraphicsRootShaderResourceView(5, instance_buffer.get_gpu_virtual_address());
+				instances.transforms = model_to_render.instance_transforms[instance_buffer_index].data();
+				instances.count = instance_buffer.element_count;
+				instances.capacity = instance_buffer.element_count;
+				return instances;
+			};
+
+			//Culls the instances against the frustum, selects each visible instance's LOD, then draws the instances of each LOD with one instanced draw.
+			//Slot 6: the instances of the draw, a range of the instance indices written to this primitive's slots.
+			const float camera_position[3] = { XMVectorGetX(cam_pos), XMVectorGetY(cam_pos), XMVectorGetZ(cam_pos) };
+			GpuDynamicStructuredBuffer& lod_instance_buffer = lod_instance_buffers[frame_resources.frame_index];
+			uint32_t* lod_instance_indices = reinterpret_cast<uint32_t*>(lod_instance_buffer.mapped_data);
+			size_t lod_slot = 0;
+			memset(lod_instance_counts, 0, sizeof(lod_instance_counts));
+			lod_triangle_count = 0;
+			culling_seconds = 0.0;
+			culling_tested_count = 0;
+			culling_visible_count = 0;
+
+			auto draw_primitive_lods = [&](const GpuPrimitive& primitive, const float world_matrix[16], const NodeInstances& instances, bool cull)
+			{
+				const MeshLods& mesh_lods = primitive.lods;
+				if (!mesh_lods.lods.empty() && instances.count > 0)
 				{
+					uint32_t visible_count = instances.count;
+					{
+						rmt_ScopedCPUSample(CullInstances, 0);
+
+						const double culling_start = gltf_get_time_seconds();
+						culling_spheres.compute(primitive.bounds, world_matrix, instances.transforms, instances.count, instances.in_world_space);
+						culling_visible.resize(culling_spheres.x.size());
+						if (cull && frustum_culling)
+						{
+							visible_count = cull_instances(frustum, culling_spheres, instances.count, culling_visible.data());
+							culling_tested_count += instances.count;
+							culling_visible_count += visible_count;
+						}
+						else
+						{
+							for (uint32_t instance = 0; instance < instances.count; ++instance)
+							{
+								culling_visible[instance] = instance;
+							}
+						}
+						culling_seconds += gltf_get_time_seconds() - culling_start;
+					}
+
+					lod_pixels_per_unit.resize(visible_count);
+					lod_instances.resize(visible_count);
+					compute_instance_pixels_per_unit(culling_spheres, culling_visible.data(), visible_count, camera_position, projection_scale, lod_pixels_per_unit.data());
+
+					uint32_t instance_counts[MESH_LOD_MAX_COUNT];
+					select_instance_lods(mesh_lods, culling_visible.data(), lod_pixels_per_unit.data(), visible_count, lod_threshold_pixels, lod_hysteresis, forced_lod,
+						&model_to_render.lod_states[lod_slot], lod_instances.data(), instance_counts);
+					memcpy(lod_instance_indices + lod_slot, lod_instances.data(), visible_count * sizeof(uint32_t));
+
+					UINT first_instance = 0;
+					for (uint32_t lod_idx = 0; lod_idx < mesh_lods.lods.size(); ++lod_idx)
+					{
+						const MeshLod& lod = mesh_lods.lods[lod_idx];
+						if (instance_counts[lod_idx] == 0)
+						{
+							continue;
+						}
+						command_list->SetGraphicsRootShaderResourceView(6, lod_instance_buffer.get_gpu_virtual_address(static_cast<UINT>(lod_slot) + first_instance));
+						command_list->DrawIndexedInstanced(lod.index_count, instance_counts[lod_idx], lod.first_index, 0, 0);
+						first_instance += instance_counts[lod_idx];
+
+						lod_instance_counts[lod_idx] += instance_counts[lod_idx];
+						lod_triangle_count += (uint64_t) (lod.index_count / 3) * instance_counts[lod_idx];
+					}
+				}
+				lod_slot += instances.capacity;
+			};
+
+			const SceneGraph& scene_graph = model_to_render.scene_graph;
+			for (uint32_t node = 0; node < scene_graph.node_count; ++node)
+			{
+				const int32_t mesh_index = scene_graph.mesh_indices[node];
+				if (mesh_index == SCENE_GRAPH_INVALID_INDEX)
+				{
+					continue;
+				}
+				const bool node_is_morphed = scene_graph.morph_weight_counts[node] > 0;
+				const NodeInstances instances = set_node_instances(model_to_render.node_instance_buffers[node]);
+
+				//Slot 4: node world matrix
+				float world_matrix[16];
+				scene_graph.get_world_matrix(node, world_matrix);
+				command_list->SetGraphicsRoot32BitConstants(4, 16, world_matrix, 0);
+
+				for (GpuPrimitive& primitive : model_to_render.meshes[mesh_index].primitives)
+				{
+					//Drawn below from its deformed vertex buffer, same conditions as its DeformedDraw
+					if (model_to_render.is_drawn_skinned(node, primitive) || (node_is_morphed && primitive.morphed))
+					{
+						lod_slot += instances.capacity;
+						continue;
+					}
+
 					//Slot 1: set instance cbuffer
 					command_list->SetGraphicsRootConstantBufferView(1, primitive.constant_buffers.get_gpu_virtual_address(frame_resources.frame_index));
 					
@@ -1594,10 +2382,39 @@ int main()
 
 					command_list->IASetVertexBuffers(0, 1, &render_data.vertex_buffer_view);
 					command_list->IASetIndexBuffer(&render_data.index_buffer_view);
-					command_list->DrawIndexedInstanced(render_data.index_count(), mesh_instance_count, 0, 0, 0);
+					draw_primitive_lods(primitive, world_matrix, instances, true);
 				}
 			}
 
+			//Skinned vertices are already in world space (glTF ignores the transform of a skinned mesh's node) so they only use the instance grid,
+			//morphed only vertices are still in node space. LODs of skinned primitives are selected with their bind pose bounds, which can't be
+			//trusted for culling once the vertices move, so deformed primitives are never culled.
+			for (const DeformedDraw& deformed_draw : model_to_render.deformed_draws)
+			{
+				float world_matrix[16];
+				NodeInstances instances;
+				if (deformed_draw.skin_index != SCENE_GRAPH_INVALID_INDEX)
+				{
+					XMStoreFloat4x4((XMFLOAT4X4*) world_matrix, XMMatrixIdentity());
+					instances = set_node_instances(SCENE_GRAPH_INVALID_INDEX);
+				}
+				else
+				{
+					scene_graph.get_world_matrix(deformed_draw.node, world_matrix);
+					instances = set_node_instances(model_to_render.node_instance_buffers[deformed_draw.node]);
+				}
+				command_list->SetGraphicsRoot32BitConstants(4, 16, world_matrix, 0);
+
+				GpuPrimitive& primitive = model_to_render.meshes[deformed_draw.mesh_index].primitives[deformed_draw.primitive_index];
+				command_list->SetGraphicsRootConstantBufferView(1, primitive.constant_buffers.get_gpu_virtual_address(frame_resources.frame_index));
+
+				const GpuRenderData& render_data = primitive.render_data;
+
+				command_list->IASetVertexBuffers(0, 1, &deformed_draw.vertex_buffers[frame_resources.frame_index].vertex_buffer_view);
+				command_list->IASetIndexBuffer(&render_data.index_buffer_view);
+				draw_primitive_lods(primitive, world_matrix, instances, false);
+			}
+
 			//Render Skybox
 			if (draw_skybox)
 			{
@@ -1666,8 +2483,6 @@ int main()
 	printf("FPS: %f\n", static_cast<float>(frames_rendered) / accumulated_delta_time);
 
 	{ //Free all memory allocated with D3D12 Memory Allocator
-		bindless_resource_manager.release();
-		
 		hdr_equirectangular_texture.release();
 		
 		hdr_cubemap_texture.release();
@@ -1686,17 +2501,35 @@ int main()
 
 					primitive.constant_buffers.release();
 				
-					if (primitive.base_color_texture)
-					{
-						primitive.base_color_texture->release();
-					}
+					//Shared textures are released along with their last reference
+					primitive.base_color_texture.reset();
+					primitive.metallic_roughness_texture.reset();
+				}
+			}
 
-					if (primitive.metallic_roughness_texture)
-					{
-						primitive.metallic_roughness_texture->release();
-					}
+			for (DeformedDraw& deformed_draw : model.deformed_draws)
+			{
+				for (GpuDynamicVertexBuffer& vertex_buffer : deformed_draw.vertex_buffers)
+				{
+					vertex_buffer.release();
 				}
 			}
+
+			for (GpuStructuredBuffer& instance_buffer : model.instance_buffers)
+			{
+				instance_buffer.release();
+			}
+		}
+
+		image_service.release();
+
+		//After the shared textures, their deleters unregister them and point their slots at the invalid textures
+		bindless_resource_manager.release();
+
+		mesh_instance_grid.release();
+		for (GpuDynamicStructuredBuffer& lod_instance_buffer : lod_instance_buffers)
+		{
+			lod_instance_buffer.release();
 		}
 
 		cube.release();
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "gltf.h"
+
+// Binary cache of imported glTF primitives, written next to the source file after the first import.
+// Vertex and index blobs are stored in their runtime format (optimized, deduplicated, 16 bit indices where possible),
+// so later runs map the cache and copy each blob straight into upload memory.
+//
+// Skinned primitives also store a per vertex skin blob (joint indices and weights, in the same vertex order),
+// and morphed primitives a morph blob with their sparse targets (see MorphedPrimitive::serialize).
+// Every primitive with triangles also stores its meshlets (see Meshlets::serialize), so they are only built on the first import.
+// The index blob holds all of a primitive's LODs back to back, the LOD blob their ranges and errors (see MeshLods::serialize).
+//
+// Layout: MeshCacheHeader, MeshCachePrimitive table, then the blobs, each aligned to MESH_CACHE_BLOB_ALIGNMENT.
+// The cache is keyed by a hash of the source bytes and rejected when the hash, version or vertex stride don't match.
+
+static const uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+// Bump whenever the vertex layout or the import processing changes, the hash only covers the source file
+static const uint32_t MESH_CACHE_VERSION = 6;
+static const uint64_t MESH_CACHE_BLOB_ALIGNMENT = 256;
+
+struct MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t source_hash;
+	uint64_t file_size;
+	uint32_t vertex_stride;
+	uint32_t primitive_count;
+};
+
+struct MeshCachePrimitive
+{
+	uint32_t mesh_index;
+	uint32_t primitive_index;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t index_size; // 2 or 4 bytes
+	uint32_t skin_stride; // Bytes per vertex in the skin blob, 0 if the primitive isn't skinned
+	uint64_t vertex_offset; // From the start of the file
+	uint64_t index_offset;
+	uint64_t skin_offset;
+	uint64_t morph_offset;
+	uint64_t morph_size; // 0 if the primitive has no morph targets
+	uint64_t meshlet_offset;
+	uint64_t meshlet_size; // 0 if the primitive has no meshlets
+	uint64_t lod_offset;
+	uint64_t lod_size; // 0 if the primitive has no LOD table
+};
+
+static_assert(sizeof(MeshCacheHeader) == 32, "MeshCacheHeader is written to disk as is");
+static_assert(sizeof(MeshCachePrimitive) == 96, "MeshCachePrimitive is written to disk as is");
+
+inline uint64_t mesh_cache_rotl(uint64_t value, int shift)
+{
+	return (value << shift) | (value >> (64 - shift));
+}
+
+// 64 bit hash of a byte range (xxHash64). Chain ranges by passing the previous hash as the seed.
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0)
+{
+	const uint64_t p1 = 11400714785074694791ULL;
+	const uint64_t p2 = 14029467366897019727ULL;
+	const uint64_t p3 = 1609587929392839161ULL;
+	const uint64_t p4 = 9650029242287828579ULL;
+	const uint64_t p5 = 2870177450012600261ULL;
+
+	auto round = [p1, p2](uint64_t accumulator, uint64_t input)
+	{
+		return mesh_cache_rotl(accumulator + input * p2, 31) * p1;
+	};
+
+	auto read_u64 = [](const uint8_t* bytes)
+	{
+		uint64_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	};
+
+	const uint8_t* bytes = (const uint8_t*) data;
+	const uint8_t* end = bytes + size;
+	uint64_t hash;
+
+	if (size >= 32)
+	{
+		// Four independent lanes per 32 byte stripe
+		uint64_t v1 = seed + p1 + p2;
+		uint64_t v2 = seed + p2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - p1;
+		for (; bytes + 32 <= end; bytes += 32)
+		{
+			v1 = round(v1, read_u64(bytes));
+			v2 = round(v2, read_u64(bytes + 8));
+			v3 = round(v3, read_u64(bytes + 16));
+			v4 = round(v4, read_u64(bytes + 24));
+		}
+
+		hash = mesh_cache_rotl(v1, 1) + mesh_cache_rotl(v2, 7) + mesh_cache_rotl(v3, 12) + mesh_cache_rotl(v4, 18);
+		hash = (hash ^ round(0, v1)) * p1 + p4;
+		hash = (hash ^ round(0, v2)) * p1 + p4;
+		hash = (hash ^ round(0, v3)) * p1 + p4;
+		hash = (hash ^ round(0, v4)) * p1 + p4;
+	}
+	else
+	{
+		hash = seed + p5;
+	}
+
+	hash += size;
+
+	for (; bytes + 8 <= end; bytes += 8)
+	{
+		hash = mesh_cache_rotl(hash ^ round(0, read_u64(bytes)), 27) * p1 + p4;
+	}
+	if (bytes + 4 <= end)
+	{
+		uint32_t word;
+		memcpy(&word, bytes, sizeof(word));
+		hash = mesh_cache_rotl(hash ^ (word * p1), 23) * p2 + p3;
+		bytes += 4;
+	}
+	for (; bytes < end; ++bytes)
+	{
+		hash = mesh_cache_rotl(hash ^ (*bytes * p5), 11) * p1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= p2;
+	hash ^= hash >> 29;
+	hash *= p3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+// Hash of everything primitives are imported from: the .gltf/.glb file and any external buffers.
+// Fallback buffers are skipped, they only hold data decoded from other buffers.
+inline uint64_t hash_gltf_source(const GltfAsset& asset)
+{
+	uint64_t hash = hash_bytes(asset.file.data, (size_t) asset.file.size);
+	for (uint32_t buffer_idx = 0; buffer_idx < asset.num_buffers; ++buffer_idx)
+	{
+		const GltfBuffer& buffer = asset.buffers[buffer_idx];
+		if (buffer.uri && !buffer.is_fallback)
+		{
+			hash = hash_bytes(buffer.data, (size_t) buffer.byte_length, hash);
+		}
+	}
+	return hash;
+}
+
+// Read side: the mapped cache file. Blob pointers stay valid until release().
+struct MeshCache
+{
+	GltfFileData file = {};
+	const MeshCacheHeader* header = nullptr;
+	const MeshCachePrimitive* primitives = nullptr;
+
+	// Fails if the file is missing, truncated or was built from a different source, version or vertex layout
+	bool open(const char* path, uint64_t source_hash, uint32_t vertex_stride)
+	{
+		release();
+
+		if (!gltf_file_map(path, &file))
+		{
+			return false;
+		}
+
+		const MeshCacheHeader* in_header = (const MeshCacheHeader*) file.data;
+		bool valid = file.size >= sizeof(MeshCacheHeader)
+			&& in_header->magic == MESH_CACHE_MAGIC
+			&& in_header->version == MESH_CACHE_VERSION
+			&& in_header->source_hash == source_hash
+			&& in_header->file_size == file.size
+			&& in_header->vertex_stride == vertex_stride
+			&& sizeof(MeshCacheHeader) + (uint64_t) in_header->primitive_count * sizeof(MeshCachePrimitive) <= file.size;
+
+		const MeshCachePrimitive* in_primitives = (const MeshCachePrimitive*) (file.data + sizeof(MeshCacheHeader));
+		for (uint32_t i = 0; valid && i < in_header->primitive_count; ++i)
+		{
+			const MeshCachePrimitive& primitive = in_primitives[i];
+			valid = (primitive.index_size == 2 || primitive.index_size == 4)
+				&& primitive.vertex_offset <= file.size && (uint64_t) primitive.vertex_count * vertex_stride <= file.size - primitive.vertex_offset
+				&& primitive.index_offset <= file.size && (uint64_t) primitive.index_count * primitive.index_size <= file.size - primitive.index_offset
+				&& primitive.skin_offset <= file.size && (uint64_t) primitive.vertex_count * primitive.skin_stride <= file.size - primitive.skin_offset
+				&& primitive.morph_offset <= file.size && primitive.morph_size <= file.size - primitive.morph_offset
+				&& primitive.meshlet_offset <= file.size && primitive.meshlet_size <= file.size - primitive.meshlet_offset
+				&& primitive.lod_offset <= file.size && primitive.lod_size <= file.size - primitive.lod_offset;
+		}
+
+		if (!valid)
+		{
+			release();
+			return false;
+		}
+
+		header = in_header;
+		primitives = in_primitives;
+		return true;
+	}
+
+	bool is_open() const { return header != nullptr; }
+
+	const MeshCachePrimitive* find_primitive(uint32_t mesh_index, uint32_t primitive_index) const
+	{
+		for (uint32_t i = 0; header && i < header->primitive_count; ++i)
+		{
+			if (primitives[i].mesh_index == mesh_index && primitives[i].primitive_index == primitive_index)
+			{
+				return &primitives[i];
+			}
+		}
+		return nullptr;
+	}
+
+	const uint8_t* vertex_data(const MeshCachePrimitive& primitive) const { return file.data + primitive.vertex_offset; }
+	const uint8_t* index_data(const MeshCachePrimitive& primitive) const { return file.data + primitive.index_offset; }
+	const uint8_t* skin_data(const MeshCachePrimitive& primitive) const { return primitive.skin_stride ? file.data + primitive.skin_offset : nullptr; }
+	const uint8_t* morph_data(const MeshCachePrimitive& primitive) const { return primitive.morph_size ? file.data + primitive.morph_offset : nullptr; }
+	const uint8_t* meshlet_data(const MeshCachePrimitive& primitive) const { return primitive.meshlet_size ? file.data + primitive.meshlet_offset : nullptr; }
+	const uint8_t* lod_data(const MeshCachePrimitive& primitive) const { return primitive.lod_size ? file.data + primitive.lod_offset : nullptr; }
+
+	void release()
+	{
+		if (file.data)
+		{
+			gltf_file_release(&file);
+		}
+		header = nullptr;
+		primitives = nullptr;
+	}
+};
+
+// Write side: primitives are recorded from the import tasks (one slot per glTF primitive, so tasks don't contend), then written in one go
+struct MeshCacheWriter
+{
+	struct Entry
+	{
+		bool recorded = false;
+		uint32_t mesh_index = 0;
+		uint32_t primitive_index = 0;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		uint32_t index_size = 0;
+		uint32_t skin_stride = 0;
+		vector<uint8_t> vertex_data;
+		vector<uint8_t> index_data;
+		vector<uint8_t> skin_data;
+		vector<uint8_t> morph_data;
+		vector<uint8_t> meshlet_data;
+		vector<uint8_t> lod_data;
+	};
+
+	vector<uint32_t> mesh_first_entry;
+	vector<Entry> entries;
+
+	explicit MeshCacheWriter(const GltfAsset& asset)
+	{
+		mesh_first_entry.resize(asset.num_meshes);
+		uint32_t entry_count = 0;
+		for (uint32_t mesh_idx = 0; mesh_idx < asset.num_meshes; ++mesh_idx)
+		{
+			mesh_first_entry[mesh_idx] = entry_count;
+			entry_count += asset.meshes[mesh_idx].num_primitives;
+		}
+		entries.resize(entry_count);
+	}
+
+	// Indices are stored with index_size bytes each (2 or 4), matching the index buffer format they were uploaded with.
+	// skin_data (skin_stride bytes per vertex) is only passed for skinned primitives, morph_data for morphed ones.
+	void record_primitive(uint32_t mesh_index, uint32_t primitive_index, const void* vertices, uint32_t vertex_stride, size_t vertex_count, const uint32_t* indices, size_t index_count, uint32_t index_size,
+		const void* skin_data = nullptr, uint32_t skin_stride = 0, const void* morph_data = nullptr, size_t morph_size = 0, const void* meshlet_data = nullptr, size_t meshlet_size = 0,
+		const void* lod_data = nullptr, size_t lod_size = 0)
+	{
+		Entry& entry = entries[mesh_first_entry[mesh_index] + primitive_index];
+		entry.mesh_index = mesh_index;
+		entry.primitive_index = primitive_index;
+		entry.vertex_count = (uint32_t) vertex_count;
+		entry.index_count = (uint32_t) index_count;
+		entry.index_size = index_size;
+
+		entry.vertex_data.resize(vertex_count * vertex_stride);
+		memcpy(entry.vertex_data.data(), vertices, entry.vertex_data.size());
+
+		entry.index_data.resize(index_count * index_size);
+		if (index_size == sizeof(uint16_t))
+		{
+			uint16_t* indices_16 = (uint16_t*) entry.index_data.data();
+			for (size_t i = 0; i < index_count; ++i)
+			{
+				indices_16[i] = (uint16_t) indices[i];
+			}
+		}
+		else
+		{
+			memcpy(entry.index_data.data(), indices, entry.index_data.size());
+		}
+
+		entry.skin_stride = skin_data ? skin_stride : 0;
+		entry.skin_data.resize(vertex_count * entry.skin_stride);
+		if (!entry.skin_data.empty())
+		{
+			memcpy(entry.skin_data.data(), skin_data, entry.skin_data.size());
+		}
+
+		entry.morph_data.resize(morph_data ? morph_size : 0);
+		if (!entry.morph_data.empty())
+		{
+			memcpy(entry.morph_data.data(), morph_data, entry.morph_data.size());
+		}
+
+		entry.meshlet_data.resize(meshlet_data ? meshlet_size : 0);
+		if (!entry.meshlet_data.empty())
+		{
+			memcpy(entry.meshlet_data.data(), meshlet_data, entry.meshlet_data.size());
+		}
+
+		entry.lod_data.resize(lod_data ? lod_size : 0);
+		if (!entry.lod_data.empty())
+		{
+			memcpy(entry.lod_data.data(), lod_data, entry.lod_data.size());
+		}
+
+		entry.recorded = true;
+	}
+
+	// The header goes in last, so a partially written file never passes MeshCache::open
+	bool write(const char* path, uint64_t source_hash, uint32_t vertex_stride) const
+	{
+		for (const Entry& entry : entries)
+		{
+			if (!entry.recorded)
+			{
+				return false;
+			}
+		}
+
+		auto align = [](uint64_t offset) { return (offset + MESH_CACHE_BLOB_ALIGNMENT - 1) & ~(MESH_CACHE_BLOB_ALIGNMENT - 1); };
+
+		vector<MeshCachePrimitive> table(entries.size());
+		uint64_t offset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCachePrimitive);
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			const Entry& entry = entries[i];
+			MeshCachePrimitive& primitive = table[i];
+			memset(&primitive, 0, sizeof(MeshCachePrimitive));
+			primitive.mesh_index = entry.mesh_index;
+			primitive.primitive_index = entry.primitive_index;
+			primitive.vertex_count = entry.vertex_count;
+			primitive.index_count = entry.index_count;
+			primitive.index_size = entry.index_size;
+			primitive.skin_stride = entry.skin_stride;
+			primitive.vertex_offset = align(offset);
+			primitive.index_offset = align(primitive.vertex_offset + entry.vertex_data.size());
+			primitive.skin_offset = align(primitive.index_offset + entry.index_data.size());
+			primitive.morph_offset = align(primitive.skin_offset + entry.skin_data.size());
+			primitive.morph_size = entry.morph_data.size();
+			primitive.meshlet_offset = align(primitive.morph_offset + entry.morph_data.size());
+			primitive.meshlet_size = entry.meshlet_data.size();
+			primitive.lod_offset = align(primitive.meshlet_offset + entry.meshlet_data.size());
+			primitive.lod_size = entry.lod_data.size();
+			offset = primitive.lod_offset + entry.lod_data.size();
+		}
+
+		MeshCacheHeader header_data = {};
+		header_data.magic = MESH_CACHE_MAGIC;
+		header_data.version = MESH_CACHE_VERSION;
+		header_data.source_hash = source_hash;
+		header_data.file_size = offset;
+		header_data.vertex_stride = vertex_stride;
+		header_data.primitive_count = (uint32_t) table.size();
+
+		#ifdef _MSC_VER
+		FILE* file = nullptr;
+		if (fopen_s(&file, path, "wb") != 0)
+		{
+			file = nullptr;
+		}
+		#else
+		FILE* file = fopen(path, "wb");
+		#endif
+		if (!file)
+		{
+			return false;
+		}
+
+		const MeshCacheHeader empty_header = {};
+		bool succeeded = fwrite(&empty_header, sizeof(MeshCacheHeader), 1, file) == 1;
+		succeeded = succeeded && (table.empty() || fwrite(table.data(), sizeof(MeshCachePrimitive), table.size(), file) == table.size());
+
+		const uint8_t zeros[MESH_CACHE_BLOB_ALIGNMENT] = {};
+		uint64_t position = sizeof(MeshCacheHeader) + table.size() * sizeof(MeshCachePrimitive);
+		auto write_blob = [&](uint64_t blob_offset, const vector<uint8_t>& blob)
+		{
+			const size_t padding = (size_t) (blob_offset - position);
+			bool blob_written = (padding == 0 || fwrite(zeros, 1, padding, file) == padding)
+				&& (blob.empty() || fwrite(blob.data(), 1, blob.size(), file) == blob.size());
+			position = blob_offset + blob.size();
+			return blob_written;
+		};
+
+		for (size_t i = 0; succeeded && i < entries.size(); ++i)
+		{
+			succeeded = write_blob(table[i].vertex_offset, entries[i].vertex_data) && write_blob(table[i].index_offset, entries[i].index_data)
+				&& write_blob(table[i].skin_offset, entries[i].skin_data) && write_blob(table[i].morph_offset, entries[i].morph_data)
+				&& write_blob(table[i].meshlet_offset, entries[i].meshlet_data) && write_blob(table[i].lod_offset, entries[i].lod_data);
+		}
+
+		succeeded = succeeded && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header_data, sizeof(MeshCacheHeader), 1, file) == 1;
+		succeeded = fclose(file) == 0 && succeeded;
+
+		if (!succeeded)
+		{
+			remove(path);
+		}
+		return succeeded;
+	}
+};
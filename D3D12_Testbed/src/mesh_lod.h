@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "culling.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+
+// Discrete LOD chains of a primitive: LOD 0 is the imported triangle list, each further LOD simplifies the previous one to about
+// half its triangles. All LODs index the same vertices and are stored back to back in one index buffer.
+// At runtime each instance draws the coarsest LOD whose error, projected to the screen, stays under a pixel threshold.
+
+static const uint32_t MESH_LOD_MAX_COUNT = 5;
+static const float MESH_LOD_TRIANGLE_RATIO = 0.5f;	// Target triangle count of each LOD relative to the previous one
+static const float MESH_LOD_MIN_REDUCTION = 0.1f;	// The chain stops once a LOD removes less than this fraction of triangles
+static const float MESH_LOD_MAX_ERROR = 0.05f;		// Largest collapse error per LOD, relative to the primitive's extent
+
+// Attribute weights of the simplifier, per component of the packed normal and uv (see build_lods)
+static const float MESH_LOD_NORMAL_WEIGHT = 0.01f;
+static const float MESH_LOD_UV_WEIGHT = 0.25f;
+
+struct MeshLod
+{
+	uint32_t first_index;
+	uint32_t index_count;
+	float error; // Object space distance the LOD may deviate from LOD 0 (conservatively, the sum of each step's error)
+};
+
+struct MeshLods
+{
+	vector<MeshLod> lods;
+
+	// Simplifies indices[0, index_count) and appends each LOD's indices to indices.
+	// positions and the optional normals and uvs are read with stride bytes between vertices.
+	void build(vector<uint32_t>& indices, const float* positions, const float* normals, const float* uvs, size_t stride, size_t vertex_count)
+	{
+		auto vertex_float = [stride](const float* base, size_t v) { return (const float*) ((const uint8_t*) base + v * stride); };
+
+		lods.clear();
+		lods.push_back(MeshLod{ 0, (uint32_t) indices.size(), 0.0f });
+
+		// Normal and uv packed per vertex for the simplifier's attribute error
+		const uint32_t attribute_count = 5;
+		const float attribute_weights[attribute_count] = { MESH_LOD_NORMAL_WEIGHT, MESH_LOD_NORMAL_WEIGHT, MESH_LOD_NORMAL_WEIGHT, MESH_LOD_UV_WEIGHT, MESH_LOD_UV_WEIGHT };
+		vector<float> attributes(vertex_count * attribute_count, 0.0f);
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			float* attribute = &attributes[v * attribute_count];
+			for (uint32_t component = 0; normals && component < 3; ++component)
+			{
+				attribute[component] = vertex_float(normals, v)[component];
+			}
+			for (uint32_t component = 0; uvs && component < 2; ++component)
+			{
+				attribute[3 + component] = vertex_float(uvs, v)[component];
+			}
+		}
+
+		vector<uint32_t> lod_indices;
+		while (lods.size() < MESH_LOD_MAX_COUNT)
+		{
+			const MeshLod previous = lods.back();
+			const size_t target_index_count = (size_t) (previous.index_count / 3 * MESH_LOD_TRIANGLE_RATIO) * 3;
+
+			lod_indices.resize(previous.index_count);
+			float lod_error = 0.0f;
+			const size_t lod_index_count = simplify_mesh(lod_indices.data(), indices.data() + previous.first_index, previous.index_count, positions, stride, vertex_count,
+				attributes.data(), attribute_count * sizeof(float), attribute_weights, attribute_count, target_index_count, MESH_LOD_MAX_ERROR, &lod_error);
+			if (lod_index_count == 0 || (float) lod_index_count > (float) previous.index_count * (1.0f - MESH_LOD_MIN_REDUCTION))
+			{
+				break;
+			}
+
+			optimize_vertex_cache(lod_indices.data(), lod_index_count, vertex_count);
+			lods.push_back(MeshLod{ (uint32_t) indices.size(), (uint32_t) lod_index_count, previous.error + lod_error });
+			indices.insert(indices.end(), lod_indices.begin(), lod_indices.begin() + lod_index_count);
+		}
+	}
+
+	// A single LOD drawing all indices (primitives that can't be simplified)
+	void build_single(uint32_t index_count)
+	{
+		lods.clear();
+		lods.push_back(MeshLod{ 0, index_count, 0.0f });
+	}
+
+	uint32_t total_index_count() const
+	{
+		return lods.empty() ? 0 : lods.back().first_index + lods.back().index_count;
+	}
+
+	// Layout: lod count, then the MeshLod array
+	void serialize(vector<uint8_t>& out_blob) const
+	{
+		const uint32_t lod_count = (uint32_t) lods.size();
+		out_blob.resize(sizeof(lod_count) + lods.size() * sizeof(MeshLod));
+		memcpy(out_blob.data(), &lod_count, sizeof(lod_count));
+		memcpy(out_blob.data() + sizeof(lod_count), lods.data(), lods.size() * sizeof(MeshLod));
+	}
+
+	// Fails if the blob is truncated or a LOD reads past index_count
+	bool deserialize(const uint8_t* blob, size_t blob_size, uint32_t index_count)
+	{
+		uint32_t lod_count;
+		if (blob_size < sizeof(lod_count))
+		{
+			return false;
+		}
+		memcpy(&lod_count, blob, sizeof(lod_count));
+		if (lod_count == 0 || lod_count > MESH_LOD_MAX_COUNT || sizeof(lod_count) + (uint64_t) lod_count * sizeof(MeshLod) != blob_size)
+		{
+			return false;
+		}
+
+		lods.resize(lod_count);
+		memcpy(lods.data(), blob + sizeof(lod_count), lods.size() * sizeof(MeshLod));
+
+		bool valid = true;
+		for (const MeshLod& lod : lods)
+		{
+			valid &= lod.first_index <= index_count && lod.index_count <= index_count - lod.first_index && lod.index_count % 3 == 0;
+		}
+		if (!valid)
+		{
+			lods.clear();
+		}
+		return valid;
+	}
+};
+
+// Moves current_lod towards the coarsest LOD whose projected error is under threshold_pixels.
+// pixels_per_unit converts object space distances to pixels at the instance's distance. A LOD switch needs the error to clear
+// the threshold by the hysteresis fraction, so instances near a boundary don't alternate between LODs every frame.
+inline uint32_t select_lod(const MeshLod* lods, uint32_t lod_count, float pixels_per_unit, uint32_t current_lod, float threshold_pixels, float hysteresis)
+{
+	uint32_t lod = current_lod < lod_count ? current_lod : lod_count - 1;
+	while (lod > 0 && lods[lod].error * pixels_per_unit > threshold_pixels * (1.0f + hysteresis))
+	{
+		--lod;
+	}
+	while (lod + 1 < lod_count && lods[lod + 1].error * pixels_per_unit <= threshold_pixels * (1.0f - hysteresis))
+	{
+		++lod;
+	}
+	return lod;
+}
+
+// Pixels per object space unit of each of the instances, at the distance of the nearest point of its bounding sphere.
+// projection_scale is the viewport height in pixels over 2 tan(fov_y / 2).
+inline void compute_instance_pixels_per_unit(const InstanceSpheres& spheres, const uint32_t* instances, uint32_t instance_count, const float camera_position[3],
+	float projection_scale, float* out_pixels_per_unit)
+{
+	const float min_distance = 1e-3f;
+	for (uint32_t i = 0; i < instance_count; ++i)
+	{
+		const uint32_t instance = instances[i];
+		const float dx = spheres.x[instance] - camera_position[0];
+		const float dy = spheres.y[instance] - camera_position[1];
+		const float dz = spheres.z[instance] - camera_position[2];
+		const float distance = sqrtf(dx * dx + dy * dy + dz * dz) - spheres.radius[instance];
+		out_pixels_per_unit[i] = projection_scale * spheres.scale[instance] / (distance > min_distance ? distance : min_distance);
+	}
+}
+
+// Selects the LOD of each of the instances and groups them by it: out_instances receives the instance indices ordered by LOD and
+// out_lod_instance_counts the number of instances drawing each LOD. lod_states holds the LOD each instance drew with last
+// (indexed by instance). forced_lod >= 0 draws every instance with that LOD (clamped to the chain).
+inline void select_instance_lods(const MeshLods& mesh_lods, const uint32_t* instances, const float* pixels_per_unit, uint32_t instance_count, float threshold_pixels, float hysteresis,
+	int32_t forced_lod, uint8_t* lod_states, uint32_t* out_instances, uint32_t out_lod_instance_counts[MESH_LOD_MAX_COUNT])
+{
+	const uint32_t lod_count = (uint32_t) mesh_lods.lods.size();
+	memset(out_lod_instance_counts, 0, MESH_LOD_MAX_COUNT * sizeof(uint32_t));
+	for (uint32_t i = 0; i < instance_count; ++i)
+	{
+		uint8_t& lod_state = lod_states[instances[i]];
+		uint32_t lod = 0;
+		if (forced_lod >= 0)
+		{
+			lod = (uint32_t) forced_lod < lod_count ? (uint32_t) forced_lod : lod_count - 1;
+		}
+		else
+		{
+			lod = select_lod(mesh_lods.lods.data(), lod_count, pixels_per_unit[i], lod_state, threshold_pixels, hysteresis);
+		}
+		lod_state = (uint8_t) lod;
+		out_lod_instance_counts[lod]++;
+	}
+
+	// Counting sort by LOD
+	uint32_t lod_offsets[MESH_LOD_MAX_COUNT];
+	uint32_t offset = 0;
+	for (uint32_t lod = 0; lod < MESH_LOD_MAX_COUNT; ++lod)
+	{
+		lod_offsets[lod] = offset;
+		offset += out_lod_instance_counts[lod];
+	}
+	for (uint32_t i = 0; i < instance_count; ++i)
+	{
+		out_instances[lod_offsets[lod_states[instances[i]]]++] = instances[i];
+	}
+}
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+#include <EASTL/sort.h>
+
+// Import-time vertex deduplication and index and vertex reordering for triangle lists.
+// deduplicate_vertices: merges bitwise identical vertices
+// optimize_vertex_cache: Tipsify (Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007)
+// optimize_overdraw: the same paper's cluster sort, clusters facing away from the mesh center are drawn first
+// optimize_vertex_fetch: vertices in first use order, so vertex fetches walk memory linearly
+
+static const uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats
+{
+	float acmr = 0.0f; // Average cache miss ratio: vertices transformed per triangle (0.5 is the limit for large regular grids, 3 is the worst)
+	float atvr = 0.0f; // Average transformed vertex ratio: vertices transformed per vertex (1 is optimal)
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries
+inline VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size = VERTEX_CACHE_SIZE)
+{
+	VertexCacheStats stats;
+	if (index_count < 3 || vertex_count == 0)
+	{
+		return stats;
+	}
+
+	// A vertex is in the cache while fewer than cache_size misses have happened since it was added
+	vector<uint32_t> cache_timestamps(vertex_count, 0);
+	uint32_t misses = 0;
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		const uint32_t index = indices[i];
+		if (cache_timestamps[index] == 0 || misses + 1 - cache_timestamps[index] > cache_size)
+		{
+			++misses;
+			cache_timestamps[index] = misses;
+		}
+	}
+
+	stats.acmr = (float) misses / (float) (index_count / 3);
+	stats.atvr = (float) misses / (float) vertex_count;
+	return stats;
+}
+
+// Triangles using each vertex, as offsets into one shared array
+struct TriangleAdjacency
+{
+	vector<uint32_t> counts;
+	vector<uint32_t> offsets;
+	vector<uint32_t> triangles;
+
+	TriangleAdjacency(const uint32_t* indices, size_t index_count, size_t vertex_count)
+		: counts(vertex_count, 0)
+		, offsets(vertex_count, 0)
+		, triangles(index_count)
+	{
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			counts[indices[i]]++;
+		}
+
+		uint32_t offset = 0;
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			offsets[v] = offset;
+			offset += counts[v];
+		}
+
+		vector<uint32_t> fill_offsets = offsets;
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			triangles[fill_offsets[indices[i]]++] = (uint32_t) (i / 3);
+		}
+	}
+};
+
+// Reorders triangles so recently used vertices are reused while they're still in a cache of cache_size entries.
+// Returns the triangle offsets where the order had to jump to an unconnected part of the mesh (always starting with 0),
+// which optimize_overdraw uses as cluster boundaries.
+inline vector<uint32_t> optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size = VERTEX_CACHE_SIZE)
+{
+	vector<uint32_t> hard_boundaries;
+	const size_t triangle_count = index_count / 3;
+	if (triangle_count == 0 || vertex_count == 0)
+	{
+		return hard_boundaries;
+	}
+
+	const TriangleAdjacency adjacency(indices, triangle_count * 3, vertex_count);
+	vector<uint32_t> live_triangles = adjacency.counts;
+	vector<uint32_t> cache_timestamps(vertex_count, 0);
+	vector<bool> emitted(triangle_count, false);
+	vector<uint32_t> dead_end_stack;
+	vector<uint32_t> candidates;
+	vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+
+	uint32_t timestamp = cache_size + 1;
+	uint32_t input_cursor = 1;
+	int64_t fanning_vertex = 0;
+	bool jumped = true;
+
+	while (fanning_vertex >= 0)
+	{
+		const uint32_t fan = (uint32_t) fanning_vertex;
+		if (jumped && adjacency.counts[fan] > 0)
+		{
+			hard_boundaries.push_back((uint32_t) (output.size() / 3));
+			jumped = false;
+		}
+
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t i = 0; i < adjacency.counts[fan]; ++i)
+		{
+			const uint32_t triangle = adjacency.triangles[adjacency.offsets[fan] + i];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				dead_end_stack.push_back(vertex);
+				candidates.push_back(vertex);
+				live_triangles[vertex]--;
+				if (timestamp - cache_timestamps[vertex] > cache_size)
+				{
+					cache_timestamps[vertex] = timestamp++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		// Next fan: the candidate that's been in the cache longest while it will still be there after its remaining triangles
+		fanning_vertex = -1;
+		int64_t best_priority = -1;
+		for (const uint32_t vertex : candidates)
+		{
+			if (live_triangles[vertex] > 0)
+			{
+				int64_t priority = 0;
+				if (timestamp - cache_timestamps[vertex] + 2 * live_triangles[vertex] <= cache_size)
+				{
+					priority = timestamp - cache_timestamps[vertex];
+				}
+				if (priority > best_priority)
+				{
+					best_priority = priority;
+					fanning_vertex = vertex;
+				}
+			}
+		}
+
+		// Dead end: back up to a recent vertex with triangles left, or else the next such vertex in input order
+		if (fanning_vertex < 0)
+		{
+			jumped = true;
+			while (!dead_end_stack.empty() && fanning_vertex < 0)
+			{
+				const uint32_t vertex = dead_end_stack.back();
+				dead_end_stack.pop_back();
+				if (live_triangles[vertex] > 0)
+				{
+					fanning_vertex = vertex;
+				}
+			}
+			for (; fanning_vertex < 0 && input_cursor < vertex_count; ++input_cursor)
+			{
+				if (live_triangles[input_cursor] > 0)
+				{
+					fanning_vertex = input_cursor;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+	return hard_boundaries;
+}
+
+// Sorts clusters of triangles (ranges starting at the hard boundaries from optimize_vertex_cache) so that outward facing clusters
+// are drawn first and occlude the ones behind them. Clusters are first split further wherever the vertex cache
+// efficiency so far is within threshold of the cluster's own, so the reordering costs little cache efficiency.
+inline void optimize_overdraw(uint32_t* indices, size_t index_count, const vector<uint32_t>& hard_boundaries, const float* positions, size_t position_stride,
+	size_t vertex_count, float threshold = 1.05f, uint32_t cache_size = VERTEX_CACHE_SIZE)
+{
+	const size_t triangle_count = index_count / 3;
+	if (triangle_count == 0 || hard_boundaries.empty())
+	{
+		return;
+	}
+
+	auto get_position = [positions, position_stride](uint32_t index)
+	{
+		return (const float*) ((const uint8_t*) positions + index * position_stride);
+	};
+
+	// Soft boundaries
+	vector<uint32_t> clusters;
+	vector<uint32_t> cache_timestamps(vertex_count, 0);
+	uint32_t misses = 0;
+	auto count_misses = [&](size_t triangle)
+	{
+		uint32_t new_misses = 0;
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			const uint32_t index = indices[triangle * 3 + corner];
+			if (cache_timestamps[index] == 0 || misses + 1 - cache_timestamps[index] > cache_size)
+			{
+				cache_timestamps[index] = ++misses;
+				++new_misses;
+			}
+		}
+		return new_misses;
+	};
+	// Advancing the miss counter past the cache size evicts everything
+	auto flush_cache = [&]() { misses += cache_size + 1; };
+
+	for (size_t i = 0; i < hard_boundaries.size(); ++i)
+	{
+		const size_t begin = hard_boundaries[i];
+		const size_t end = i + 1 < hard_boundaries.size() ? hard_boundaries[i + 1] : triangle_count;
+
+		flush_cache();
+		uint32_t cluster_misses = 0;
+		for (size_t triangle = begin; triangle < end; ++triangle)
+		{
+			cluster_misses += count_misses(triangle);
+		}
+		const float cluster_threshold = threshold * (float) cluster_misses / (float) (end - begin);
+
+		flush_cache();
+		clusters.push_back((uint32_t) begin);
+		size_t soft_begin = begin;
+		uint32_t soft_misses = 0;
+		for (size_t triangle = begin; triangle < end; ++triangle)
+		{
+			soft_misses += count_misses(triangle);
+			if (triangle + 1 < end && (float) soft_misses / (float) (triangle + 1 - soft_begin) <= cluster_threshold)
+			{
+				// Sorted clusters are drawn after unrelated ones, so each is measured from a cold cache
+				clusters.push_back((uint32_t) (triangle + 1));
+				soft_begin = triangle + 1;
+				soft_misses = 0;
+				flush_cache();
+			}
+		}
+	}
+
+	// Area weighted centroid and normal of each cluster, and of the whole mesh
+	struct ClusterSortKey
+	{
+		uint32_t cluster;
+		float dot;
+	};
+	vector<float> cluster_centroids(clusters.size() * 3, 0.0f);
+	vector<float> cluster_normals(clusters.size() * 3, 0.0f);
+	float mesh_centroid[3] = {};
+	float mesh_area = 0.0f;
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+		float cluster_area = 0.0f;
+		for (size_t triangle = clusters[c]; triangle < end; ++triangle)
+		{
+			const float* p0 = get_position(indices[triangle * 3 + 0]);
+			const float* p1 = get_position(indices[triangle * 3 + 1]);
+			const float* p2 = get_position(indices[triangle * 3 + 2]);
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int k = 0; k < 3; ++k)
+			{
+				const float centroid = (p0[k] + p1[k] + p2[k]) / 3.0f;
+				cluster_centroids[c * 3 + k] += centroid * area;
+				cluster_normals[c * 3 + k] += normal[k];
+				mesh_centroid[k] += centroid * area;
+			}
+			cluster_area += area;
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			cluster_centroids[c * 3 + k] = cluster_area > 0.0f ? cluster_centroids[c * 3 + k] / cluster_area : 0.0f;
+		}
+		mesh_area += cluster_area;
+	}
+	for (int k = 0; k < 3; ++k)
+	{
+		mesh_centroid[k] = mesh_area > 0.0f ? mesh_centroid[k] / mesh_area : 0.0f;
+	}
+
+	vector<ClusterSortKey> sort_keys(clusters.size());
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		const float* normal = &cluster_normals[c * 3];
+		const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float dot = 0.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			dot += (cluster_centroids[c * 3 + k] - mesh_centroid[k]) * (length > 0.0f ? normal[k] / length : 0.0f);
+		}
+		sort_keys[c] = { (uint32_t) c, dot };
+	}
+	eastl::sort(sort_keys.begin(), sort_keys.end(), [](const ClusterSortKey& a, const ClusterSortKey& b)
+	{
+		return a.dot != b.dot ? a.dot > b.dot : a.cluster < b.cluster;
+	});
+
+	vector<uint32_t> sorted_indices;
+	sorted_indices.reserve(triangle_count * 3);
+	for (const ClusterSortKey& sort_key : sort_keys)
+	{
+		const size_t begin = clusters[sort_key.cluster];
+		const size_t end = sort_key.cluster + 1 < clusters.size() ? clusters[sort_key.cluster + 1] : triangle_count;
+		sorted_indices.insert(sorted_indices.end(), indices + begin * 3, indices + end * 3);
+	}
+	memcpy(indices, sorted_indices.data(), sorted_indices.size() * sizeof(uint32_t));
+}
+
+// Renumbers vertices in the order the indices first use them and drops unused vertices
+template <typename T>
+inline void optimize_vertex_fetch(vector<T>& vertices, vector<uint32_t>& indices)
+{
+	const uint32_t unused = UINT32_MAX;
+	vector<uint32_t> remap(vertices.size(), unused);
+	vector<T> fetch_ordered_vertices;
+	fetch_ordered_vertices.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (uint32_t) fetch_ordered_vertices.size();
+			fetch_ordered_vertices.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(fetch_ordered_vertices);
+}
+
+// Hash of a vertex's bytes, a word at a time (MurmurHash2 mixing)
+inline uint32_t hash_vertex(const void* vertex, size_t vertex_size)
+{
+	const uint32_t m = 0x5bd1e995;
+	uint32_t hash = (uint32_t) vertex_size;
+	for (size_t offset = 0; offset < vertex_size; offset += sizeof(uint32_t))
+	{
+		uint32_t word;
+		memcpy(&word, (const uint8_t*) vertex + offset, sizeof(word));
+		word *= m;
+		word ^= word >> 24;
+		word *= m;
+		hash = hash * m ^ word;
+	}
+	hash ^= hash >> 13;
+	hash *= m;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+// Merges bitwise identical vertices, keeping the first of each, and remaps indices to them.
+// T is compared as raw bytes, so it can't have padding.
+template <typename T>
+inline void deduplicate_vertices(vector<T>& vertices, vector<uint32_t>& indices)
+{
+	static_assert(sizeof(T) % sizeof(uint32_t) == 0, "vertices are hashed a 32 bit word at a time");
+
+	// Open addressing table of unique vertex indices, at most half full
+	const uint32_t empty = UINT32_MAX;
+	size_t table_size = 1;
+	while (table_size < vertices.size() * 2)
+	{
+		table_size *= 2;
+	}
+	vector<uint32_t> table(table_size, empty);
+
+	vector<uint32_t> remap(vertices.size());
+	vector<T> unique_vertices;
+	unique_vertices.reserve(vertices.size());
+
+	for (size_t v = 0; v < vertices.size(); ++v)
+	{
+		size_t slot = hash_vertex(&vertices[v], sizeof(T)) & (table_size - 1);
+		while (table[slot] != empty && memcmp(&unique_vertices[table[slot]], &vertices[v], sizeof(T)) != 0)
+		{
+			slot = (slot + 1) & (table_size - 1);
+		}
+		if (table[slot] == empty)
+		{
+			table[slot] = (uint32_t) unique_vertices.size();
+			unique_vertices.push_back(vertices[v]);
+		}
+		remap[v] = table[slot];
+	}
+
+	for (uint32_t& index : indices)
+	{
+		index = remap[index];
+	}
+	vertices.swap(unique_vertices);
+}
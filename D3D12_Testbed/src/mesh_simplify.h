@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+#include <EASTL/sort.h>
+#include <EASTL/algorithm.h>
+
+#include "mesh_optimize.h"
+
+// Import-time triangle list simplification by edge collapse (Garland, Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997).
+// Collapses are half edge collapses: a vertex is merged into one of its neighbors and never moved, so simplified indices still
+// index the original vertex buffer and every LOD of a primitive can share it.
+//
+// Collapse cost: the collapsed vertex's quadric (area weighted planes of the triangles it has absorbed) at the target position,
+// plus the weighted squared difference of their attributes (normals, uvs, ...) so collapses across shading discontinuities cost more.
+// Positions are normalized to the mesh's largest extent, so target errors are relative to the mesh size.
+//
+// Vertices on open borders or non manifold edges are locked so outlines don't shrink. Vertices split on attribute seams
+// (several vertices at one position) collapse together: each of them must map to the target's vertex on the same side of the
+// seam, which holds for collapses along the seam and keeps it closed. Where that mapping doesn't exist (across a seam, or at a
+// vertex of a flat shaded mesh) the collapse is skipped.
+
+struct SimplifyQuadric
+{
+	// Symmetric 4x4 matrix [A b; b' c], the error at p is p'Ap + 2b'p + c
+	double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+	double weight = 0.0;
+
+	// Squared distance to the plane n.p + d = 0 (n unit length), weighted
+	void add_plane(const float n[3], float d, float plane_weight)
+	{
+		a00 += plane_weight * n[0] * n[0];
+		a11 += plane_weight * n[1] * n[1];
+		a22 += plane_weight * n[2] * n[2];
+		a01 += plane_weight * n[0] * n[1];
+		a02 += plane_weight * n[0] * n[2];
+		a12 += plane_weight * n[1] * n[2];
+		b0 += plane_weight * n[0] * d;
+		b1 += plane_weight * n[1] * d;
+		b2 += plane_weight * n[2] * d;
+		c += plane_weight * d * d;
+		weight += plane_weight;
+	}
+
+	void add(const SimplifyQuadric& other)
+	{
+		a00 += other.a00; a11 += other.a11; a22 += other.a22;
+		a01 += other.a01; a02 += other.a02; a12 += other.a12;
+		b0 += other.b0; b1 += other.b1; b2 += other.b2;
+		c += other.c;
+		weight += other.weight;
+	}
+
+	// Weighted mean squared distance to the planes
+	double error(const float p[3]) const
+	{
+		const double x = p[0], y = p[1], z = p[2];
+		const double e = x * (a00 * x + a01 * y + a02 * z) + y * (a01 * x + a11 * y + a12 * z) + z * (a02 * x + a12 * y + a22 * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return weight > 0.0 ? fabs(e) / weight : 0.0;
+	}
+};
+
+// Simplifies a triangle list towards target_index_count indices, stopping early when the next collapse would exceed target_error
+// (relative to the mesh's largest extent). attributes (attribute_count floats per vertex, attribute_stride bytes apart) are optional.
+// Writes the simplified triangles to out_indices (which may be indices) and returns their index count.
+// out_error receives the largest positional error (without the attribute term) of the collapses performed, in position units.
+inline size_t simplify_mesh(uint32_t* out_indices, const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count,
+	const float* attributes, size_t attribute_stride, const float* attribute_weights, uint32_t attribute_count, size_t target_index_count, float target_error, float* out_error)
+{
+	auto position = [&](size_t v) { return (const float*) ((const uint8_t*) positions + v * position_stride); };
+	auto attribute = [&](size_t v) { return (const float*) ((const uint8_t*) attributes + v * attribute_stride); };
+
+	if (out_error)
+	{
+		*out_error = 0.0f;
+	}
+
+	// Normalized positions, so errors don't depend on the mesh's scale
+	float min_position[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float max_position[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			min_position[axis] = position(v)[axis] < min_position[axis] ? position(v)[axis] : min_position[axis];
+			max_position[axis] = position(v)[axis] > max_position[axis] ? position(v)[axis] : max_position[axis];
+		}
+	}
+	float extent = 0.0f;
+	for (int axis = 0; axis < 3 && vertex_count > 0; ++axis)
+	{
+		extent = max_position[axis] - min_position[axis] > extent ? max_position[axis] - min_position[axis] : extent;
+	}
+	const float inverse_extent = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+	vector<float> normalized_positions(vertex_count * 3);
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			normalized_positions[v * 3 + axis] = (position(v)[axis] - min_position[axis]) * inverse_extent;
+		}
+	}
+	auto normalized = [&](uint32_t v) { return &normalized_positions[(size_t) v * 3]; };
+
+	// Vertices at bitwise identical positions share one position id (the first of them), their quadric and their locks
+	vector<uint32_t> position_ids(vertex_count);
+	{
+		const uint32_t empty = UINT32_MAX;
+		size_t table_size = 1;
+		while (table_size < vertex_count * 2)
+		{
+			table_size *= 2;
+		}
+		vector<uint32_t> table(table_size, empty);
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			size_t slot = hash_vertex(position(v), 3 * sizeof(float)) & (table_size - 1);
+			while (table[slot] != empty && memcmp(position(table[slot]), position(v), 3 * sizeof(float)) != 0)
+			{
+				slot = (slot + 1) & (table_size - 1);
+			}
+			if (table[slot] == empty)
+			{
+				table[slot] = (uint32_t) v;
+			}
+			position_ids[v] = table[slot];
+		}
+	}
+
+	// Triangles collapsed to a line or point by welding are dropped up front
+	vector<uint32_t> result;
+	result.reserve(index_count);
+	for (size_t i = 0; i + 2 < index_count; i += 3)
+	{
+		const uint32_t a = position_ids[indices[i]], b = position_ids[indices[i + 1]], c = position_ids[indices[i + 2]];
+		if (a != b && b != c && c != a)
+		{
+			result.push_back(indices[i]);
+			result.push_back(indices[i + 1]);
+			result.push_back(indices[i + 2]);
+		}
+	}
+
+	// An edge is interior when it's used exactly once in each direction, otherwise it's on a border or non manifold
+	vector<bool> locked(vertex_count, false);
+	{
+		vector<uint64_t> directed_edges;
+		directed_edges.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				const uint64_t from = position_ids[result[i + corner]];
+				const uint64_t to = position_ids[result[i + (corner + 1) % 3]];
+				directed_edges.push_back(from << 32 | to);
+			}
+		}
+		eastl::sort(directed_edges.begin(), directed_edges.end());
+
+		const uint64_t* edges_begin = directed_edges.data();
+		const uint64_t* edges_end = edges_begin + directed_edges.size();
+		auto edge_count = [edges_begin, edges_end](uint64_t edge)
+		{
+			const uint64_t* first = eastl::lower_bound(edges_begin, edges_end, edge);
+			const uint64_t* last = eastl::upper_bound(first, edges_end, edge);
+			return (size_t) (last - first);
+		};
+
+		for (size_t e = 0; e < directed_edges.size(); ++e)
+		{
+			const uint64_t edge = directed_edges[e];
+			const bool duplicate = (e > 0 && directed_edges[e - 1] == edge) || (e + 1 < directed_edges.size() && directed_edges[e + 1] == edge);
+			if (duplicate || edge_count(edge << 32 | edge >> 32) != 1)
+			{
+				locked[(uint32_t) (edge >> 32)] = true;
+				locked[(uint32_t) edge] = true;
+			}
+		}
+	}
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		locked[v] = locked[position_ids[v]];
+	}
+
+	// Area weighted plane quadrics, accumulated per position id
+	vector<SimplifyQuadric> quadrics(vertex_count);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const float* p0 = normalized(result[i]);
+		const float* p1 = normalized(result[i + 1]);
+		const float* p2 = normalized(result[i + 2]);
+		const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0f)
+		{
+			continue;
+		}
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		const float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			quadrics[position_ids[result[i + corner]]].add_plane(n, d, length * 0.5f);
+		}
+	}
+
+	auto attribute_error = [&](uint32_t from, uint32_t to)
+	{
+		double error = 0.0;
+		for (uint32_t k = 0; attributes && k < attribute_count; ++k)
+		{
+			const double difference = attribute(from)[k] - attribute(to)[k];
+			error += attribute_weights[k] * difference * difference;
+		}
+		return error;
+	};
+
+	// Normal of p0 p1 p2, unnormalized
+	auto triangle_normal = [](const float* p0, const float* p1, const float* p2, float out_normal[3])
+	{
+		const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		out_normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		out_normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		out_normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float cost;
+		float position_error;
+	};
+	vector<Collapse> collapses;
+	vector<uint32_t> remap(vertex_count);
+	vector<bool> pass_locked(vertex_count);
+	vector<uint32_t> result_position_ids;
+	vector<uint32_t> wedge_targets(vertex_count, UINT32_MAX); // Target of each vertex at the collapsed position, while a collapse is checked
+	const double max_cost = (double) target_error * target_error;
+	double largest_position_error = 0.0;
+
+	// Each pass collapses the cheapest edges it can without two collapses touching the same vertex, then rebuilds the triangle list
+	while (result.size() > target_index_count)
+	{
+		// Triangles around each position, whichever of its vertices they use
+		result_position_ids.resize(result.size());
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			result_position_ids[i] = position_ids[result[i]];
+		}
+		const TriangleAdjacency adjacency(result_position_ids.data(), result_position_ids.size(), vertex_count);
+
+		// Every directed edge of every triangle, an interior edge is seen once in each direction
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				const uint32_t from = result[i + corner];
+				const uint32_t to = result[i + (corner + 1) % 3];
+				if (locked[from])
+				{
+					continue;
+				}
+				const double position_error = quadrics[position_ids[from]].error(normalized(to));
+				collapses.push_back(Collapse{ from, to, (float) (position_error + attribute_error(from, to)), (float) position_error });
+			}
+		}
+		eastl::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			remap[v] = (uint32_t) v;
+		}
+		pass_locked.assign(vertex_count, false);
+
+		const size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+		size_t triangles_removed = 0;
+		size_t collapse_count = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > max_cost || triangles_removed >= triangles_to_remove)
+			{
+				break;
+			}
+			const uint32_t from_id = position_ids[collapse.from];
+			const uint32_t to_id = position_ids[collapse.to];
+			if (pass_locked[from_id] || pass_locked[to_id])
+			{
+				continue;
+			}
+
+			const uint32_t* fan = &adjacency.triangles[adjacency.offsets[from_id]];
+			const uint32_t fan_size = adjacency.counts[from_id];
+			auto from_corner = [&](const uint32_t* triangle) { return position_ids[triangle[0]] == from_id ? 0 : position_ids[triangle[1]] == from_id ? 1 : 2; };
+
+			// Each vertex at the collapsed position goes to the target position's vertex it shares the collapsed edge's triangles with,
+			// which has to be the same vertex in all of them
+			bool valid = true;
+			size_t edge_triangles = 0;
+			for (uint32_t t = 0; t < fan_size; ++t)
+			{
+				const uint32_t* triangle = &result[(size_t) fan[t] * 3];
+				const int corner = from_corner(triangle);
+				const uint32_t b = triangle[(corner + 1) % 3];
+				const uint32_t c = triangle[(corner + 2) % 3];
+				if (position_ids[b] == to_id || position_ids[c] == to_id)
+				{
+					const uint32_t target = position_ids[b] == to_id ? b : c;
+					uint32_t& wedge_target = wedge_targets[triangle[corner]];
+					valid &= wedge_target == UINT32_MAX || wedge_target == target;
+					wedge_target = target;
+					edge_triangles++;
+				}
+			}
+
+			// The remaining triangles must have a target for their vertex and must not flip
+			for (uint32_t t = 0; valid && t < fan_size; ++t)
+			{
+				const uint32_t* triangle = &result[(size_t) fan[t] * 3];
+				const int corner = from_corner(triangle);
+				const uint32_t b = triangle[(corner + 1) % 3];
+				const uint32_t c = triangle[(corner + 2) % 3];
+				if (position_ids[b] == to_id || position_ids[c] == to_id)
+				{
+					continue;
+				}
+
+				float normal_before[3];
+				float normal_after[3];
+				triangle_normal(normalized(from_id), normalized(b), normalized(c), normal_before);
+				triangle_normal(normalized(to_id), normalized(b), normalized(c), normal_after);
+				valid = wedge_targets[triangle[corner]] != UINT32_MAX
+					&& normal_before[0] * normal_after[0] + normal_before[1] * normal_after[1] + normal_before[2] * normal_after[2] > 0.0f;
+			}
+
+			for (uint32_t t = 0; t < fan_size; ++t)
+			{
+				const uint32_t* triangle = &result[(size_t) fan[t] * 3];
+				const uint32_t from = triangle[from_corner(triangle)];
+				if (valid && wedge_targets[from] != UINT32_MAX)
+				{
+					remap[from] = wedge_targets[from];
+				}
+				wedge_targets[from] = UINT32_MAX;
+			}
+			if (!valid)
+			{
+				continue;
+			}
+
+			quadrics[to_id].add(quadrics[from_id]);
+			pass_locked[from_id] = true;
+			pass_locked[to_id] = true;
+			triangles_removed += edge_triangles;
+			largest_position_error = collapse.position_error > largest_position_error ? collapse.position_error : largest_position_error;
+			collapse_count++;
+		}
+
+		if (collapse_count == 0)
+		{
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (position_ids[a] != position_ids[b] && position_ids[b] != position_ids[c] && position_ids[c] != position_ids[a])
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	if (out_error)
+	{
+		*out_error = (float) sqrt(largest_position_error) * extent;
+	}
+	if (!result.empty())
+	{
+		memcpy(out_indices, result.data(), result.size() * sizeof(uint32_t));
+	}
+	return result.size();
+}
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "mesh_optimize.h"
+
+// Import-time meshlet (cluster) builder, for cluster culling and mesh shaders.
+// A primitive's triangles are split into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles
+// (the sizes that fill a mesh shader threadgroup's output on most GPUs). Each meshlet stores its unique vertices (indices into the primitive's
+// vertex buffer) and its triangles as 8 bit indices into those, 3 bytes per triangle.
+// Meshlets are grown greedily from adjacent triangles. One that adds no vertices is taken right away, otherwise the best scoring is:
+// near the meshlet's centroid (compact meshlets have tight bounds), adding few vertices, and using up vertices no other triangle needs
+// (which avoids leaving isolated triangles behind). When nothing adjacent fits, the next unused triangle in index order seeds
+// the rest of the meshlet, which keeps vertex cache optimized meshes spatially coherent.
+// Each meshlet gets a bounding sphere for frustum culling and a normal cone for backface culling (see Meshlet::cone_cutoff).
+
+static const uint32_t MESHLET_MAX_VERTICES = 64;
+static const uint32_t MESHLET_MAX_TRIANGLES = 124;
+static const float MESHLET_MIN_CONE_DOT = 0.1f; // Wider cones (normals more than ~84 degrees from the axis) are too wide to ever cull
+
+struct Meshlet
+{
+	uint32_t vertex_offset = 0;		// Into Meshlets::vertices
+	uint32_t triangle_offset = 0;	// Into Meshlets::triangles, in bytes
+	uint32_t vertex_count = 0;
+	uint32_t triangle_count = 0;
+	float center[3] = {};			// Bounding sphere
+	float radius = 0.0f;
+	float cone_apex[3] = {};
+	float cone_cutoff = 1.0f;		// Every triangle faces away from the camera if dot(normalize(cone_apex - camera_position), cone_axis) >= cone_cutoff
+	float cone_axis[3] = {};		// Zero (with cone_cutoff 1) when the meshlet can't be backface culled as a whole
+	uint32_t padding = 0;
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlet is stored in the mesh cache as is");
+
+struct MeshletStats
+{
+	float average_vertices = 0.0f;
+	float average_triangles = 0.0f;
+	float vertex_ratio = 0.0f;		// Meshlet vertices per primitive vertex: how often vertices are duplicated across meshlets (1 is optimal)
+	float cullable_ratio = 0.0f;	// Fraction of meshlets with a normal cone
+};
+
+struct Meshlets
+{
+	vector<Meshlet> meshlets;
+	vector<uint32_t> vertices;	// Primitive vertex index of every meshlet vertex
+	vector<uint8_t> triangles;	// Meshlet vertex indices, 3 per triangle
+
+	// max_vertices has to be between 3 and 255 (meshlet vertex indices are 8 bit), max_triangles at least 1
+	// Returns false (and builds no meshlets) if index_count isn't a multiple of 3 or an index is out of range
+	bool build(const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count,
+		uint32_t max_vertices = MESHLET_MAX_VERTICES, uint32_t max_triangles = MESHLET_MAX_TRIANGLES)
+	{
+		meshlets.clear();
+		vertices.clear();
+		triangles.clear();
+
+		if (index_count % 3 != 0)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			if (indices[i] >= vertex_count)
+			{
+				return false;
+			}
+		}
+
+		const size_t triangle_count = index_count / 3;
+		if (triangle_count == 0)
+		{
+			return true;
+		}
+
+		auto position = [positions, position_stride](uint32_t vertex)
+		{
+			return (const float*) ((const uint8_t*) positions + vertex * position_stride);
+		};
+
+		const TriangleAdjacency adjacency(indices, index_count, vertex_count);
+		vector<uint32_t> live_triangles = adjacency.counts;		// Triangles using each vertex that aren't in a meshlet yet
+		vector<uint8_t> emitted(triangle_count, 0);
+		vector<uint8_t> local_indices(vertex_count, 0xFF);		// Index of each vertex in the current meshlet, 0xFF if it isn't in it
+
+		Meshlet meshlet;
+		float centroid_sum[3] = {};
+		size_t seed_cursor = 0;
+
+		for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+		{
+			auto new_vertices = [&](uint32_t triangle)
+			{
+				const uint32_t* triangle_indices = &indices[triangle * 3];
+				return (uint32_t) (local_indices[triangle_indices[0]] == 0xFF) + (local_indices[triangle_indices[1]] == 0xFF) + (local_indices[triangle_indices[2]] == 0xFF);
+			};
+
+			uint32_t best_triangle = UINT32_MAX;
+			if (meshlet.triangle_count < max_triangles)
+			{
+				float best_score = INFINITY;
+				const float inverse_vertex_count = meshlet.vertex_count > 0 ? 1.0f / meshlet.vertex_count : 0.0f;
+				const float centroid[3] = { centroid_sum[0] * inverse_vertex_count, centroid_sum[1] * inverse_vertex_count, centroid_sum[2] * inverse_vertex_count };
+
+				for (uint32_t i = 0; i < meshlet.vertex_count && best_score > 0.0f; ++i)
+				{
+					const uint32_t vertex = vertices[meshlet.vertex_offset + i];
+					if (live_triangles[vertex] == 0)
+					{
+						continue;
+					}
+
+					const uint32_t* vertex_triangles = &adjacency.triangles[adjacency.offsets[vertex]];
+					for (uint32_t j = 0; j < adjacency.counts[vertex]; ++j)
+					{
+						const uint32_t triangle = vertex_triangles[j];
+						if (emitted[triangle])
+						{
+							continue;
+						}
+						const uint32_t triangle_new_vertices = new_vertices(triangle);
+						if (triangle_new_vertices == 0)
+						{
+							best_triangle = triangle;
+							best_score = 0.0f;
+							break;
+						}
+						if (meshlet.vertex_count + triangle_new_vertices > max_vertices)
+						{
+							continue;
+						}
+
+						const uint32_t* triangle_indices = &indices[triangle * 3];
+						const float* a = position(triangle_indices[0]);
+						const float* b = position(triangle_indices[1]);
+						const float* c = position(triangle_indices[2]);
+						float distance = 0.0f;
+						for (uint32_t k = 0; k < 3; ++k)
+						{
+							const float delta = (a[k] + b[k] + c[k]) * (1.0f / 3.0f) - centroid[k];
+							distance += delta * delta;
+						}
+						const uint32_t finished_vertices = (live_triangles[triangle_indices[0]] == 1) + (live_triangles[triangle_indices[1]] == 1) + (live_triangles[triangle_indices[2]] == 1);
+						const float score = distance * (1 + triangle_new_vertices) / (1 + finished_vertices);
+						if (score < best_score)
+						{
+							best_triangle = triangle;
+							best_score = score;
+						}
+					}
+				}
+
+				// Nothing adjacent fits, continue with the next unused triangle if it does
+				if (best_triangle == UINT32_MAX)
+				{
+					while (emitted[seed_cursor])
+					{
+						++seed_cursor;
+					}
+					if (meshlet.vertex_count + new_vertices((uint32_t) seed_cursor) <= max_vertices)
+					{
+						best_triangle = (uint32_t) seed_cursor;
+					}
+				}
+			}
+
+			if (best_triangle == UINT32_MAX)
+			{
+				finish_meshlet(meshlet, positions, position_stride, local_indices);
+				centroid_sum[0] = centroid_sum[1] = centroid_sum[2] = 0.0f;
+
+				while (emitted[seed_cursor])
+				{
+					++seed_cursor;
+				}
+				best_triangle = (uint32_t) seed_cursor;
+			}
+
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				const uint32_t vertex = indices[best_triangle * 3 + k];
+				if (local_indices[vertex] == 0xFF)
+				{
+					local_indices[vertex] = (uint8_t) meshlet.vertex_count++;
+					vertices.push_back(vertex);
+					const float* p = position(vertex);
+					centroid_sum[0] += p[0];
+					centroid_sum[1] += p[1];
+					centroid_sum[2] += p[2];
+				}
+				triangles.push_back(local_indices[vertex]);
+				--live_triangles[vertex];
+			}
+			emitted[best_triangle] = 1;
+			++meshlet.triangle_count;
+		}
+
+		finish_meshlet(meshlet, positions, position_stride, local_indices);
+		return true;
+	}
+
+	// Computes the bounds of the meshlet being built, appends it and starts the next one
+	void finish_meshlet(Meshlet& meshlet, const float* positions, size_t position_stride, vector<uint8_t>& local_indices)
+	{
+		if (meshlet.triangle_count == 0)
+		{
+			return;
+		}
+
+		auto position = [&](uint32_t local_index)
+		{
+			return (const float*) ((const uint8_t*) positions + vertices[meshlet.vertex_offset + local_index] * position_stride);
+		};
+
+		// Sphere around the center of the bounding box
+		float min_bounds[3] = { INFINITY, INFINITY, INFINITY };
+		float max_bounds[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint32_t i = 0; i < meshlet.vertex_count; ++i)
+		{
+			const float* p = position(i);
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				min_bounds[k] = p[k] < min_bounds[k] ? p[k] : min_bounds[k];
+				max_bounds[k] = p[k] > max_bounds[k] ? p[k] : max_bounds[k];
+			}
+		}
+		float radius_squared = 0.0f;
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			meshlet.center[k] = (min_bounds[k] + max_bounds[k]) * 0.5f;
+		}
+		for (uint32_t i = 0; i < meshlet.vertex_count; ++i)
+		{
+			const float* p = position(i);
+			const float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+			const float distance_squared = dx * dx + dy * dy + dz * dz;
+			radius_squared = distance_squared > radius_squared ? distance_squared : radius_squared;
+		}
+		meshlet.radius = sqrtf(radius_squared);
+
+		// Normal cone around the average triangle normal. Degenerate triangles don't constrain it.
+		const uint8_t* meshlet_triangles = &triangles[meshlet.triangle_offset];
+		vector<float> normals((size_t) meshlet.triangle_count * 3);
+		float axis[3] = {};
+		for (uint32_t triangle = 0; triangle < meshlet.triangle_count; ++triangle)
+		{
+			const float* a = position(meshlet_triangles[triangle * 3]);
+			const float* b = position(meshlet_triangles[triangle * 3 + 1]);
+			const float* c = position(meshlet_triangles[triangle * 3 + 2]);
+			const float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			float* normal = &normals[triangle * 3];
+			normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+			normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+			normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+			const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			const float inverse_length = length > 0.0f ? 1.0f / length : 0.0f;
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				normal[k] *= inverse_length;
+				axis[k] += normal[k];
+			}
+		}
+
+		const float axis_length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		float min_dot = axis_length > 0.0f ? 1.0f : -1.0f;
+		for (uint32_t k = 0; k < 3 && axis_length > 0.0f; ++k)
+		{
+			axis[k] /= axis_length;
+		}
+		for (uint32_t triangle = 0; triangle < meshlet.triangle_count && axis_length > 0.0f; ++triangle)
+		{
+			const float* normal = &normals[triangle * 3];
+			const float d = normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2];
+			const bool degenerate = normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f;
+			min_dot = !degenerate && d < min_dot ? d : min_dot;
+		}
+
+		if (min_dot < MESHLET_MIN_CONE_DOT)
+		{
+			memcpy(meshlet.cone_apex, meshlet.center, sizeof(meshlet.center));
+			meshlet.cone_axis[0] = meshlet.cone_axis[1] = meshlet.cone_axis[2] = 0.0f;
+			meshlet.cone_cutoff = 1.0f;
+		}
+		else
+		{
+			// Move the apex back along the axis until every triangle's plane is in front of it
+			float max_t = 0.0f;
+			for (uint32_t triangle = 0; triangle < meshlet.triangle_count; ++triangle)
+			{
+				const float* a = position(meshlet_triangles[triangle * 3]);
+				const float* normal = &normals[triangle * 3];
+				const float dc = (meshlet.center[0] - a[0]) * normal[0] + (meshlet.center[1] - a[1]) * normal[1] + (meshlet.center[2] - a[2]) * normal[2];
+				const float dn = axis[0] * normal[0] + axis[1] * normal[1] + axis[2] * normal[2];
+				const float t = dn > 0.0f ? dc / dn : 0.0f;
+				max_t = t > max_t ? t : max_t;
+			}
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				meshlet.cone_apex[k] = meshlet.center[k] - axis[k] * max_t;
+				meshlet.cone_axis[k] = axis[k];
+			}
+			meshlet.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+		}
+
+		for (uint32_t i = 0; i < meshlet.vertex_count; ++i)
+		{
+			local_indices[vertices[meshlet.vertex_offset + i]] = 0xFF;
+		}
+		meshlets.push_back(meshlet);
+
+		meshlet = Meshlet();
+		meshlet.vertex_offset = (uint32_t) vertices.size();
+		meshlet.triangle_offset = (uint32_t) triangles.size();
+	}
+
+	MeshletStats analyze(size_t vertex_count) const
+	{
+		MeshletStats stats;
+		if (meshlets.empty() || vertex_count == 0)
+		{
+			return stats;
+		}
+
+		uint32_t cullable_count = 0;
+		for (const Meshlet& meshlet : meshlets)
+		{
+			cullable_count += meshlet.cone_cutoff < 1.0f;
+		}
+		stats.average_vertices = (float) vertices.size() / meshlets.size();
+		stats.average_triangles = (float) (triangles.size() / 3) / meshlets.size();
+		stats.vertex_ratio = (float) vertices.size() / vertex_count;
+		stats.cullable_ratio = (float) cullable_count / meshlets.size();
+		return stats;
+	}
+
+	// Mesh cache blob: meshlet count, vertex count, triangle byte count, then the meshlets, vertices and triangles
+	void serialize(vector<uint8_t>& out_blob) const
+	{
+		const uint32_t counts[3] = { (uint32_t) meshlets.size(), (uint32_t) vertices.size(), (uint32_t) triangles.size() };
+		out_blob.resize(sizeof(counts) + meshlets.size() * sizeof(Meshlet) + vertices.size() * sizeof(uint32_t) + triangles.size());
+
+		uint8_t* out = out_blob.data();
+		memcpy(out, counts, sizeof(counts));
+		out += sizeof(counts);
+		memcpy(out, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+		out += meshlets.size() * sizeof(Meshlet);
+		memcpy(out, vertices.data(), vertices.size() * sizeof(uint32_t));
+		out += vertices.size() * sizeof(uint32_t);
+		memcpy(out, triangles.data(), triangles.size());
+	}
+
+	// Fails if the blob is truncated or references vertices or triangles that don't exist
+	bool deserialize(const uint8_t* blob, size_t blob_size, uint32_t vertex_count)
+	{
+		uint32_t counts[3];
+		if (blob_size < sizeof(counts))
+		{
+			return false;
+		}
+		memcpy(counts, blob, sizeof(counts));
+		const uint64_t expected_size = sizeof(counts) + (uint64_t) counts[0] * sizeof(Meshlet) + (uint64_t) counts[1] * sizeof(uint32_t) + counts[2];
+		if (expected_size != blob_size)
+		{
+			return false;
+		}
+
+		const uint8_t* in = blob + sizeof(counts);
+		meshlets.resize(counts[0]);
+		memcpy(meshlets.data(), in, meshlets.size() * sizeof(Meshlet));
+		in += meshlets.size() * sizeof(Meshlet);
+		vertices.resize(counts[1]);
+		memcpy(vertices.data(), in, vertices.size() * sizeof(uint32_t));
+		in += vertices.size() * sizeof(uint32_t);
+		triangles.resize(counts[2]);
+		memcpy(triangles.data(), in, triangles.size());
+
+		bool valid = true;
+		for (const Meshlet& meshlet : meshlets)
+		{
+			valid &= meshlet.vertex_offset <= counts[1] && meshlet.vertex_count <= counts[1] - meshlet.vertex_offset
+				&& meshlet.triangle_offset <= counts[2] && (uint64_t) meshlet.triangle_count * 3 <= counts[2] - meshlet.triangle_offset;
+			for (uint32_t i = 0; valid && i < meshlet.triangle_count * 3; ++i)
+			{
+				valid &= triangles[meshlet.triangle_offset + i] < meshlet.vertex_count;
+			}
+		}
+		for (const uint32_t vertex : vertices)
+		{
+			valid &= vertex < vertex_count;
+		}
+		return valid;
+	}
+};
@@ -0,0 +1,481 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "gltf.h"
+#include "EnkiTS/TaskScheduler.h"
+
+// Mip chains of imported textures, generated on the CPU.
+// Each level is resampled from the level above it by a separable filter: a horizontal pass into a scratch image (level width by
+// previous level height), then a vertical pass. Texels are filtered as linear float4, sRGB texels being decoded through a table
+// first and re-encoded exactly afterwards, so the averages are gamma-correct. Levels stay in float between passes, so rounding
+// doesn't accumulate down the chain. Both passes split their rows into tasks of MIP_TASK_ROWS on enkiTS.
+
+static const uint32_t MIP_TASK_ROWS = 16;
+static const float MIP_KAISER_RADIUS = 3.0f;	// Support of the Kaiser filter on each side, in destination texels
+static const float MIP_KAISER_ALPHA = 4.0f;		// Window shape: higher trades sharpness for less ringing
+static const uint32_t MIP_SRGB_TABLE_SIZE = 4096;
+
+enum class MipFilter : uint8_t
+{
+	Box,	// Average of the source texels each destination texel covers (2x2 for even sizes)
+	Kaiser,	// Kaiser windowed sinc: keeps more detail than Box but can ring, clamped for UNORM formats
+};
+
+// Texel formats of the chain, all RGBA
+enum class MipFormat : uint8_t
+{
+	RGBA8_UNORM,
+	RGBA8_SRGB,
+	RGBA32_FLOAT,
+};
+
+inline uint32_t mip_format_texel_size(MipFormat format)
+{
+	return format == MipFormat::RGBA32_FLOAT ? 4 * sizeof(float) : 4;
+}
+
+// Levels of a full chain, down to 1x1
+inline uint32_t mip_level_count(uint32_t width, uint32_t height)
+{
+	uint32_t size = width > height ? width : height;
+	uint32_t level_count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		++level_count;
+	}
+	return level_count;
+}
+
+struct MipLevel
+{
+	size_t offset; // Into MipChain::data
+	uint32_t width;
+	uint32_t height;
+	uint32_t row_pitch;
+};
+
+// The levels below a texture's base level, tightly packed back to back in the base level's format
+struct MipChain
+{
+	vector<uint8_t> data;
+	vector<MipLevel> levels;
+
+	const uint8_t* level_data(uint32_t level) const
+	{
+		return data.data() + levels[level].offset;
+	}
+};
+
+// Source texels and weights of each destination texel along one axis.
+// Every destination texel has tap_count taps, unused ones have a weight of 0. Sources are clamped to the edge.
+struct MipFilterTaps
+{
+	uint32_t tap_count = 0;
+	vector<uint32_t> sources;
+	vector<float> weights;
+};
+
+// Modified Bessel function of the first kind, order 0 (power series)
+inline float mip_bessel_i0(float x)
+{
+	const float quarter_x_squared = 0.25f * x * x;
+	float sum = 1.0f;
+	float term = 1.0f;
+	for (uint32_t k = 1; k < 32 && term > sum * 1e-8f; ++k)
+	{
+		term *= quarter_x_squared / (float) (k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+// Windowed sinc at x destination texels from the filter's center
+inline float mip_kaiser(float x)
+{
+	const float t = x / MIP_KAISER_RADIUS;
+	if (t * t >= 1.0f)
+	{
+		return 0.0f;
+	}
+	const float pi = 3.14159265358979f;
+	const float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf(pi * x) / (pi * x);
+	return sinc * mip_bessel_i0(MIP_KAISER_ALPHA * sqrtf(1.0f - t * t)) / mip_bessel_i0(MIP_KAISER_ALPHA);
+}
+
+inline void build_mip_filter_taps(uint32_t source_size, uint32_t destination_size, MipFilter filter, MipFilterTaps& out_taps)
+{
+	const float scale = (float) source_size / (float) destination_size;
+	const float support = (filter == MipFilter::Box ? 0.5f : MIP_KAISER_RADIUS) * scale; // In source texels
+
+	// Source texels [first, last] have their center (Kaiser) or part of their area (Box) inside the support
+	auto source_range = [filter, scale, support](uint32_t destination, int32_t& out_first, int32_t& out_last)
+	{
+		const float center = ((float) destination + 0.5f) * scale;
+		if (filter == MipFilter::Box)
+		{
+			out_first = (int32_t) floorf(center - support);
+			out_last = (int32_t) ceilf(center + support) - 1;
+		}
+		else
+		{
+			out_first = (int32_t) ceilf(center - support - 0.5f);
+			out_last = (int32_t) floorf(center + support - 0.5f);
+		}
+	};
+
+	out_taps.tap_count = 1;
+	for (uint32_t destination = 0; destination < destination_size; ++destination)
+	{
+		int32_t first, last;
+		source_range(destination, first, last);
+		const uint32_t tap_count = (uint32_t) (last - first + 1);
+		out_taps.tap_count = tap_count > out_taps.tap_count ? tap_count : out_taps.tap_count;
+	}
+
+	out_taps.sources.resize(destination_size * out_taps.tap_count);
+	out_taps.weights.resize(destination_size * out_taps.tap_count);
+	for (uint32_t destination = 0; destination < destination_size; ++destination)
+	{
+		const float center = ((float) destination + 0.5f) * scale;
+		int32_t first, last;
+		source_range(destination, first, last);
+
+		uint32_t* sources = &out_taps.sources[destination * out_taps.tap_count];
+		float* weights = &out_taps.weights[destination * out_taps.tap_count];
+		float weight_sum = 0.0f;
+		for (uint32_t tap = 0; tap < out_taps.tap_count; ++tap)
+		{
+			const int32_t source = first + (int32_t) tap;
+			float weight = 0.0f;
+			if (source <= last)
+			{
+				if (filter == MipFilter::Box)
+				{
+					const float low = (float) source > center - support ? (float) source : center - support;
+					const float high = (float) (source + 1) < center + support ? (float) (source + 1) : center + support;
+					weight = high > low ? high - low : 0.0f;
+				}
+				else
+				{
+					weight = mip_kaiser(((float) source + 0.5f - center) / scale);
+				}
+			}
+			sources[tap] = source < 0 ? 0 : ((uint32_t) source >= source_size ? source_size - 1 : (uint32_t) source);
+			weights[tap] = weight;
+			weight_sum += weight;
+		}
+		for (uint32_t tap = 0; tap < out_taps.tap_count; ++tap)
+		{
+			weights[tap] /= weight_sum;
+		}
+	}
+}
+
+// sRGB transfer function tables. Encoding looks up the code at the start of the value's bucket, then steps over the midpoint to
+// the next code if the value is past it, so it rounds like the sRGB curve would. Buckets are narrower than the closest two
+// midpoints (1 / 4096 against about 1 / 3300 near black), so a bucket never holds more than one midpoint.
+struct MipSrgbTables
+{
+	float to_linear[256];
+	float midpoints[257];						// midpoints[code] is the linear value halfway between code - 1 and code (0 and 2 past the ends)
+	uint8_t from_linear[MIP_SRGB_TABLE_SIZE];	// Code of each bucket's lowest value
+
+	MipSrgbTables()
+	{
+		auto srgb_to_linear = [](float srgb) { return srgb <= 0.04045f ? srgb / 12.92f : powf((srgb + 0.055f) / 1.055f, 2.4f); };
+		for (uint32_t code = 0; code < 256; ++code)
+		{
+			to_linear[code] = srgb_to_linear((float) code / 255.0f);
+			midpoints[code] = code == 0 ? 0.0f : srgb_to_linear(((float) code - 0.5f) / 255.0f);
+		}
+		midpoints[256] = 2.0f;
+
+		uint32_t code = 0;
+		for (uint32_t bucket = 0; bucket < MIP_SRGB_TABLE_SIZE; ++bucket)
+		{
+			const float value = (float) bucket / (float) MIP_SRGB_TABLE_SIZE;
+			while (code < 255 && value >= midpoints[code + 1])
+			{
+				++code;
+			}
+			from_linear[bucket] = (uint8_t) code;
+		}
+	}
+
+	uint8_t encode(float value) const
+	{
+		value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+		const uint32_t bucket = (uint32_t) (value * (float) MIP_SRGB_TABLE_SIZE);
+		const uint32_t code = from_linear[bucket < MIP_SRGB_TABLE_SIZE ? bucket : MIP_SRGB_TABLE_SIZE - 1];
+		return (uint8_t) (code + (value >= midpoints[code + 1]));
+	}
+};
+
+inline const MipSrgbTables& mip_srgb_tables()
+{
+	static const MipSrgbTables tables;
+	return tables;
+}
+
+inline uint8_t mip_encode_unorm8(float value)
+{
+	value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+	return (uint8_t) (value * 255.0f + 0.5f);
+}
+
+// Converts a row of RGBA8 texels to linear float4
+inline void mip_decode_row(const uint8_t* texels, uint32_t width, MipFormat format, float* out_row)
+{
+	if (format == MipFormat::RGBA8_SRGB)
+	{
+		const float* to_linear = mip_srgb_tables().to_linear;
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			out_row[x * 4 + 0] = to_linear[texels[x * 4 + 0]];
+			out_row[x * 4 + 1] = to_linear[texels[x * 4 + 1]];
+			out_row[x * 4 + 2] = to_linear[texels[x * 4 + 2]];
+			out_row[x * 4 + 3] = (float) texels[x * 4 + 3] * (1.0f / 255.0f);
+		}
+		return;
+	}
+	for (uint32_t i = 0; i < width * 4; ++i)
+	{
+		out_row[i] = (float) texels[i] * (1.0f / 255.0f);
+	}
+}
+
+inline void mip_encode_row(const float* row, uint32_t width, MipFormat format, uint8_t* out_texels)
+{
+	if (format == MipFormat::RGBA32_FLOAT)
+	{
+		// Negative lobes of the Kaiser filter can take HDR values below zero
+		float* out_row = (float*) out_texels;
+		for (uint32_t i = 0; i < width * 4; ++i)
+		{
+			out_row[i] = row[i] > 0.0f ? row[i] : 0.0f;
+		}
+		return;
+	}
+
+	if (format == MipFormat::RGBA8_SRGB)
+	{
+		const MipSrgbTables& srgb_tables = mip_srgb_tables();
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			out_texels[x * 4 + 0] = srgb_tables.encode(row[x * 4 + 0]);
+			out_texels[x * 4 + 1] = srgb_tables.encode(row[x * 4 + 1]);
+			out_texels[x * 4 + 2] = srgb_tables.encode(row[x * 4 + 2]);
+			out_texels[x * 4 + 3] = mip_encode_unorm8(row[x * 4 + 3]);
+		}
+		return;
+	}
+	for (uint32_t i = 0; i < width * 4; ++i)
+	{
+		out_texels[i] = mip_encode_unorm8(row[i]);
+	}
+}
+
+// Horizontal pass over one row of float4 texels, one texel per SIMD operation
+inline void mip_filter_row(const float* row, const MipFilterTaps& taps, uint32_t destination_width, float* out_row)
+{
+	const uint32_t tap_count = taps.tap_count;
+	for (uint32_t x = 0; x < destination_width; ++x)
+	{
+		const uint32_t* sources = &taps.sources[x * tap_count];
+		const float* weights = &taps.weights[x * tap_count];
+#if GLTF_SIMD_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (uint32_t tap = 0; tap < tap_count; ++tap)
+		{
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&row[sources[tap] * 4]), _mm_set1_ps(weights[tap])));
+		}
+		_mm_storeu_ps(&out_row[x * 4], sum);
+#elif GLTF_SIMD_NEON
+		float32x4_t sum = vdupq_n_f32(0.0f);
+		for (uint32_t tap = 0; tap < tap_count; ++tap)
+		{
+			sum = vmlaq_n_f32(sum, vld1q_f32(&row[sources[tap] * 4]), weights[tap]);
+		}
+		vst1q_f32(&out_row[x * 4], sum);
+#else
+		float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (uint32_t tap = 0; tap < tap_count; ++tap)
+		{
+			for (uint32_t channel = 0; channel < 4; ++channel)
+			{
+				sum[channel] += row[sources[tap] * 4 + channel] * weights[tap];
+			}
+		}
+		memcpy(&out_row[x * 4], sum, sizeof(sum));
+#endif
+	}
+}
+
+// Vertical pass: out_row is the weighted sum of rows, float_count floats each (8 per operation with AVX2, 4 with SSE2 or NEON)
+inline void mip_blend_rows(const float* const* rows, const float* weights, uint32_t row_count, uint32_t float_count, float* out_row)
+{
+	uint32_t i = 0;
+#if GLTF_SIMD_AVX2
+	for (; i + 8 <= float_count; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (uint32_t row = 0; row < row_count; ++row)
+		{
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(&rows[row][i]), _mm256_set1_ps(weights[row])));
+		}
+		_mm256_storeu_ps(&out_row[i], sum);
+	}
+#endif
+#if GLTF_SIMD_SSE2
+	for (; i + 4 <= float_count; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (uint32_t row = 0; row < row_count; ++row)
+		{
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&rows[row][i]), _mm_set1_ps(weights[row])));
+		}
+		_mm_storeu_ps(&out_row[i], sum);
+	}
+#elif GLTF_SIMD_NEON
+	for (; i + 4 <= float_count; i += 4)
+	{
+		float32x4_t sum = vdupq_n_f32(0.0f);
+		for (uint32_t row = 0; row < row_count; ++row)
+		{
+			sum = vmlaq_n_f32(sum, vld1q_f32(&rows[row][i]), weights[row]);
+		}
+		vst1q_f32(&out_row[i], sum);
+	}
+#endif
+	for (; i < float_count; ++i)
+	{
+		float sum = 0.0f;
+		for (uint32_t row = 0; row < row_count; ++row)
+		{
+			sum += rows[row][i] * weights[row];
+		}
+		out_row[i] = sum;
+	}
+}
+
+// Runs function(first_row, end_row) over [0, row_count) in tasks of MIP_TASK_ROWS rows, inline without a scheduler
+template <typename Function>
+inline void mip_parallel_rows(enki::TaskScheduler* task_scheduler, uint32_t row_count, const Function& function)
+{
+	const uint32_t task_count = (row_count + MIP_TASK_ROWS - 1) / MIP_TASK_ROWS;
+	auto run_tasks = [row_count, &function](uint32_t first_task, uint32_t end_task)
+	{
+		const uint32_t end_row = end_task * MIP_TASK_ROWS;
+		function(first_task * MIP_TASK_ROWS, end_row < row_count ? end_row : row_count);
+	};
+
+	if (!task_scheduler || task_count <= 1)
+	{
+		run_tasks(0, task_count);
+		return;
+	}
+	enki::TaskSet mip_task(task_count, [&run_tasks](enki::TaskSetPartition range, uint32_t /*threadnum*/)
+	{
+		run_tasks(range.start, range.end);
+	});
+	task_scheduler->AddTaskSetToPipe(&mip_task);
+	task_scheduler->WaitforTask(&mip_task);
+}
+
+// Builds levels 1 to level_count - 1 (the full chain when level_count is 0) below a tightly packed base level.
+// task_scheduler is optional, without one every pass runs on the calling thread.
+inline void generate_mip_chain(const void* base_level, uint32_t width, uint32_t height, MipFormat format, MipFilter filter, uint32_t level_count,
+	enki::TaskScheduler* task_scheduler, MipChain& out_chain)
+{
+	const uint32_t full_level_count = mip_level_count(width, height);
+	level_count = level_count == 0 || level_count > full_level_count ? full_level_count : level_count;
+	const uint32_t texel_size = mip_format_texel_size(format);
+
+	out_chain.levels.clear();
+	size_t data_size = 0;
+	for (uint32_t level = 1; level < level_count; ++level)
+	{
+		MipLevel mip_level;
+		mip_level.offset = data_size;
+		mip_level.width = (width >> level) > 0 ? width >> level : 1;
+		mip_level.height = (height >> level) > 0 ? height >> level : 1;
+		mip_level.row_pitch = mip_level.width * texel_size;
+		out_chain.levels.push_back(mip_level);
+		data_size += (size_t) mip_level.row_pitch * mip_level.height;
+	}
+	out_chain.data.resize(data_size);
+	if (out_chain.levels.empty())
+	{
+		return;
+	}
+
+	// The base level is read straight from base_level, converted a row at a time. Later levels read the float copy of the level above.
+	vector<float> source_level;
+	vector<float> scratch;
+	vector<float> destination_level;
+	MipFilterTaps horizontal_taps;
+	MipFilterTaps vertical_taps;
+	uint32_t source_width = width;
+	uint32_t source_height = height;
+	for (uint32_t level = 0; level < out_chain.levels.size(); ++level)
+	{
+		const MipLevel& mip_level = out_chain.levels[level];
+		const uint32_t destination_width = mip_level.width;
+		const uint32_t destination_height = mip_level.height;
+		build_mip_filter_taps(source_width, destination_width, filter, horizontal_taps);
+		build_mip_filter_taps(source_height, destination_height, filter, vertical_taps);
+
+		scratch.resize((size_t) destination_width * source_height * 4);
+		mip_parallel_rows(task_scheduler, source_height, [&](uint32_t first_row, uint32_t end_row)
+		{
+			vector<float> decoded_row;
+			for (uint32_t y = first_row; y < end_row; ++y)
+			{
+				const float* row = nullptr;
+				if (level > 0)
+				{
+					row = &source_level[(size_t) y * source_width * 4];
+				}
+				else if (format == MipFormat::RGBA32_FLOAT)
+				{
+					row = (const float*) base_level + (size_t) y * width * 4;
+				}
+				else
+				{
+					decoded_row.resize((size_t) width * 4);
+					mip_decode_row((const uint8_t*) base_level + (size_t) y * width * 4, width, format, decoded_row.data());
+					row = decoded_row.data();
+				}
+				mip_filter_row(row, horizontal_taps, destination_width, &scratch[(size_t) y * destination_width * 4]);
+			}
+		});
+
+		destination_level.resize((size_t) destination_width * destination_height * 4);
+		mip_parallel_rows(task_scheduler, destination_height, [&](uint32_t first_row, uint32_t end_row)
+		{
+			const uint32_t tap_count = vertical_taps.tap_count;
+			vector<const float*> rows(tap_count);
+			for (uint32_t y = first_row; y < end_row; ++y)
+			{
+				for (uint32_t tap = 0; tap < tap_count; ++tap)
+				{
+					rows[tap] = &scratch[(size_t) vertical_taps.sources[y * tap_count + tap] * destination_width * 4];
+				}
+				float* destination_row = &destination_level[(size_t) y * destination_width * 4];
+				mip_blend_rows(rows.data(), &vertical_taps.weights[y * tap_count], tap_count, destination_width * 4, destination_row);
+				mip_encode_row(destination_row, destination_width, format, out_chain.data.data() + mip_level.offset + (size_t) y * mip_level.row_pitch);
+			}
+		});
+
+		source_level.swap(destination_level);
+		source_width = destination_width;
+		source_height = destination_height;
+	}
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+#include <EASTL/algorithm.h>
+#include <EASTL/sort.h>
+#include <EASTL/utility.h>
+
+#include "gltf.h"
+#include "EnkiTS/TaskScheduler.h"
+
+// Morph targets (blend shapes) with sparse storage.
+// A target only keeps the vertices it moves: an ascending vertex list, and one 16 byte delta per vertex
+// (position and normal as int16, quantized against the target's largest delta of each).
+// Blending an instance first restores the vertices the previous blend moved. It then accumulates only the targets weighted above MORPH_MIN_WEIGHT,
+// one whole delta per SIMD operation (8 lanes with AVX2, two 4-lane halves with SSE2 or NEON), and finally rewrites just the moved vertices.
+// The cost follows the deltas of the active targets rather than the target or vertex count, so a facial rig with dozens of targets
+// and a few active ones stays cheap, and an instance whose weights didn't change isn't blended at all.
+
+static const float MORPH_MIN_WEIGHT = 1e-5f;
+static const uint32_t MORPH_DELTA_COMPONENTS = 8;			// Position xyz, 0, normal xyz, 0
+static const uint32_t MORPH_INVALID_SOURCE = UINT32_MAX;
+
+// A target as loaded from the glTF primitive, before quantization
+struct SparseMorphTarget
+{
+	vector<uint32_t> vertices;	// Ascending
+	vector<float> deltas;		// 6 per vertex: position xyz, normal xyz
+};
+
+// Keeps the vertices with a non-zero position or normal delta of every target.
+// Fails if a target's accessors aren't 3 component vectors with one element per vertex.
+inline bool unpack_morph_targets(const GltfPrimitive& primitive, vector<SparseMorphTarget>& out_targets)
+{
+	const uint32_t vertex_count = primitive.positions->count;
+	out_targets.clear();
+	out_targets.resize(primitive.num_targets);
+
+	vector<float> dense_deltas((size_t) vertex_count * 6);
+	for (uint32_t target_idx = 0; target_idx < primitive.num_targets; ++target_idx)
+	{
+		const GltfMorphTarget& target = primitive.targets[target_idx];
+		const GltfAccessor* accessors[2] = { target.positions, target.normals };
+
+		memset(dense_deltas.data(), 0, dense_deltas.size() * sizeof(float));
+		for (uint32_t attribute = 0; attribute < 2; ++attribute)
+		{
+			const GltfAccessor* accessor = accessors[attribute];
+			if (!accessor)
+			{
+				continue;
+			}
+			if (accessor->accessor_type != GLTF_ACCESSOR_TYPE_VEC3 || accessor->count != vertex_count
+				|| !gltf_accessor_unpack_floats(accessor, 3, &dense_deltas[attribute * 3], 6 * sizeof(float)))
+			{
+				return false;
+			}
+		}
+
+		SparseMorphTarget& sparse_target = out_targets[target_idx];
+		for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+		{
+			const float* vertex_deltas = &dense_deltas[(size_t) vertex * 6];
+			bool moved = false;
+			for (uint32_t component = 0; component < 6; ++component)
+			{
+				moved |= vertex_deltas[component] != 0.0f;
+			}
+			if (moved)
+			{
+				sparse_target.vertices.push_back(vertex);
+				sparse_target.deltas.insert(sparse_target.deltas.end(), vertex_deltas, vertex_deltas + 6);
+			}
+		}
+	}
+	return true;
+}
+
+// Deltas of vertex in target, or nullptr if the target doesn't move it
+inline const float* find_morph_deltas(const SparseMorphTarget& target, uint32_t vertex)
+{
+	const uint32_t* found = eastl::lower_bound(target.vertices.begin(), target.vertices.end(), vertex);
+	return found != target.vertices.end() && *found == vertex ? &target.deltas[(size_t) (found - target.vertices.begin()) * 6] : nullptr;
+}
+
+// Morph identity of each vertex, for deduplication: MORPH_INVALID_SOURCE if no target moves it,
+// otherwise the first vertex with exactly the same deltas in every target. Vertices with different sources must not be merged.
+inline vector<uint32_t> compute_morph_sources(const vector<SparseMorphTarget>& targets, uint32_t vertex_count)
+{
+	vector<uint32_t> sources(vertex_count, MORPH_INVALID_SOURCE);
+	vector<uint64_t> hashes(vertex_count, 14695981039346656037ULL);
+	const uint64_t prime = 1099511628211ULL;
+
+	// FNV-1a over (target, delta bits) of every delta a vertex has, in target order
+	for (uint32_t target_idx = 0; target_idx < targets.size(); ++target_idx)
+	{
+		const SparseMorphTarget& target = targets[target_idx];
+		for (uint32_t i = 0; i < target.vertices.size(); ++i)
+		{
+			const uint32_t vertex = target.vertices[i];
+			uint64_t hash = (hashes[vertex] ^ (target_idx + 1)) * prime;
+			for (uint32_t component = 0; component < 6; ++component)
+			{
+				uint32_t bits;
+				memcpy(&bits, &target.deltas[(size_t) i * 6 + component], sizeof(bits));
+				hash = (hash ^ bits) * prime;
+			}
+			hashes[vertex] = hash;
+			sources[vertex] = vertex;
+		}
+	}
+
+	vector<eastl::pair<uint64_t, uint32_t>> moved_vertices;
+	for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+	{
+		if (sources[vertex] != MORPH_INVALID_SOURCE)
+		{
+			moved_vertices.push_back(eastl::make_pair(hashes[vertex], vertex));
+		}
+	}
+	eastl::sort(moved_vertices.begin(), moved_vertices.end());
+
+	auto same_deltas = [&targets](uint32_t a, uint32_t b)
+	{
+		for (const SparseMorphTarget& target : targets)
+		{
+			const float* deltas_a = find_morph_deltas(target, a);
+			const float* deltas_b = find_morph_deltas(target, b);
+			if ((deltas_a == nullptr) != (deltas_b == nullptr) || (deltas_a && memcmp(deltas_a, deltas_b, 6 * sizeof(float)) != 0))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	// Equal hashes are only candidates, every match is checked
+	for (size_t group_begin = 0; group_begin < moved_vertices.size();)
+	{
+		size_t group_end = group_begin + 1;
+		while (group_end < moved_vertices.size() && moved_vertices[group_end].first == moved_vertices[group_begin].first)
+		{
+			++group_end;
+		}
+		for (size_t i = group_begin + 1; i < group_end; ++i)
+		{
+			const uint32_t vertex = moved_vertices[i].second;
+			for (size_t j = group_begin; j < i; ++j)
+			{
+				const uint32_t candidate = moved_vertices[j].second;
+				if (sources[candidate] == candidate && same_deltas(vertex, candidate))
+				{
+					sources[vertex] = candidate;
+					break;
+				}
+			}
+		}
+		group_begin = group_end;
+	}
+	return sources;
+}
+
+struct MorphTarget
+{
+	uint32_t first_delta = 0;		// Into MorphedPrimitive::delta_vertices, and deltas in units of MORPH_DELTA_COMPONENTS
+	uint32_t delta_count = 0;
+	float position_scale = 0.0f;	// Dequantizes position deltas
+	float normal_scale = 0.0f;
+};
+
+static_assert(sizeof(MorphTarget) == 16, "MorphTarget is stored in the mesh cache as is");
+
+// Base vertices and sparse targets of a morphed primitive, in the same vertex order as the primitive's vertex buffer
+struct MorphedPrimitive
+{
+	uint32_t vertex_count = 0;
+	uint32_t vertex_stride = 0;
+	uint32_t position_offset = 0;	// float3, moved by position deltas
+	uint32_t normal_offset = 0;		// float3, moved by normal deltas then renormalized. The rest of the vertex is copied as is
+	vector<uint8_t> base_vertices;
+	vector<MorphTarget> targets;
+	vector<uint32_t> delta_vertices;
+	vector<int16_t> deltas;			// MORPH_DELTA_COMPONENTS per delta
+
+	// vertex_sources gives the vertex each (possibly deduplicated and reordered) vertex had in sparse_targets, as from compute_morph_sources
+	bool build(const void* in_vertices, uint32_t in_vertex_stride, uint32_t in_position_offset, uint32_t in_normal_offset, uint32_t in_vertex_count,
+		const uint32_t* vertex_sources, const vector<SparseMorphTarget>& sparse_targets)
+	{
+		if (!set_base_vertices(in_vertices, in_vertex_stride, in_position_offset, in_normal_offset, in_vertex_count))
+		{
+			return false;
+		}
+
+		targets.resize(sparse_targets.size());
+		delta_vertices.clear();
+		deltas.clear();
+		for (uint32_t target_idx = 0; target_idx < sparse_targets.size(); ++target_idx)
+		{
+			const SparseMorphTarget& sparse_target = sparse_targets[target_idx];
+			MorphTarget& target = targets[target_idx];
+
+			float max_position_delta = 0.0f;
+			float max_normal_delta = 0.0f;
+			for (uint32_t i = 0; i < sparse_target.deltas.size(); ++i)
+			{
+				float& max_delta = i % 6 < 3 ? max_position_delta : max_normal_delta;
+				const float delta = fabsf(sparse_target.deltas[i]);
+				max_delta = delta > max_delta ? delta : max_delta;
+			}
+			target.position_scale = max_position_delta / 32767.0f;
+			target.normal_scale = max_normal_delta / 32767.0f;
+			target.first_delta = (uint32_t) delta_vertices.size();
+
+			for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+			{
+				const float* vertex_deltas = vertex_sources[vertex] != MORPH_INVALID_SOURCE ? find_morph_deltas(sparse_target, vertex_sources[vertex]) : nullptr;
+				if (!vertex_deltas)
+				{
+					continue;
+				}
+
+				int16_t quantized[MORPH_DELTA_COMPONENTS] = {};
+				for (uint32_t component = 0; component < 3; ++component)
+				{
+					quantized[component] = quantize(vertex_deltas[component], target.position_scale);
+					quantized[4 + component] = quantize(vertex_deltas[3 + component], target.normal_scale);
+				}
+				delta_vertices.push_back(vertex);
+				deltas.insert(deltas.end(), quantized, quantized + MORPH_DELTA_COMPONENTS);
+			}
+			target.delta_count = (uint32_t) delta_vertices.size() - target.first_delta;
+		}
+		return true;
+	}
+
+	static int16_t quantize(float value, float scale)
+	{
+		if (scale == 0.0f)
+		{
+			return 0;
+		}
+		const float scaled = value / scale;
+		const float clamped = scaled > 32767.0f ? 32767.0f : (scaled < -32767.0f ? -32767.0f : scaled);
+		return (int16_t) lrintf(clamped);
+	}
+
+	bool set_base_vertices(const void* in_vertices, uint32_t in_vertex_stride, uint32_t in_position_offset, uint32_t in_normal_offset, uint32_t in_vertex_count)
+	{
+		if (in_position_offset + 3 * sizeof(float) > in_vertex_stride || in_normal_offset + 3 * sizeof(float) > in_vertex_stride)
+		{
+			return false;
+		}
+
+		vertex_count = in_vertex_count;
+		vertex_stride = in_vertex_stride;
+		position_offset = in_position_offset;
+		normal_offset = in_normal_offset;
+		base_vertices.resize((size_t) vertex_count * vertex_stride);
+		memcpy(base_vertices.data(), in_vertices, base_vertices.size());
+		return true;
+	}
+
+	// Mesh cache blob: target count, delta count, then the targets, delta vertices and deltas
+	void serialize(vector<uint8_t>& out_blob) const
+	{
+		const uint32_t counts[2] = { (uint32_t) targets.size(), (uint32_t) delta_vertices.size() };
+		out_blob.resize(sizeof(counts) + targets.size() * sizeof(MorphTarget) + delta_vertices.size() * sizeof(uint32_t) + deltas.size() * sizeof(int16_t));
+
+		uint8_t* out = out_blob.data();
+		memcpy(out, counts, sizeof(counts));
+		out += sizeof(counts);
+		memcpy(out, targets.data(), targets.size() * sizeof(MorphTarget));
+		out += targets.size() * sizeof(MorphTarget);
+		memcpy(out, delta_vertices.data(), delta_vertices.size() * sizeof(uint32_t));
+		out += delta_vertices.size() * sizeof(uint32_t);
+		memcpy(out, deltas.data(), deltas.size() * sizeof(int16_t));
+	}
+
+	// Fails if the blob is truncated or references vertices or deltas that don't exist
+	bool deserialize(const uint8_t* blob, size_t blob_size, const void* in_vertices, uint32_t in_vertex_stride, uint32_t in_position_offset, uint32_t in_normal_offset, uint32_t in_vertex_count)
+	{
+		uint32_t counts[2];
+		if (blob_size < sizeof(counts) || !set_base_vertices(in_vertices, in_vertex_stride, in_position_offset, in_normal_offset, in_vertex_count))
+		{
+			return false;
+		}
+		memcpy(counts, blob, sizeof(counts));
+		const uint64_t expected_size = sizeof(counts) + (uint64_t) counts[0] * sizeof(MorphTarget)
+			+ (uint64_t) counts[1] * (sizeof(uint32_t) + MORPH_DELTA_COMPONENTS * sizeof(int16_t));
+		if (expected_size != blob_size)
+		{
+			return false;
+		}
+
+		const uint8_t* in = blob + sizeof(counts);
+		targets.resize(counts[0]);
+		memcpy(targets.data(), in, targets.size() * sizeof(MorphTarget));
+		in += targets.size() * sizeof(MorphTarget);
+		delta_vertices.resize(counts[1]);
+		memcpy(delta_vertices.data(), in, delta_vertices.size() * sizeof(uint32_t));
+		in += delta_vertices.size() * sizeof(uint32_t);
+		deltas.resize((size_t) counts[1] * MORPH_DELTA_COMPONENTS);
+		memcpy(deltas.data(), in, deltas.size() * sizeof(int16_t));
+
+		bool valid = true;
+		for (const MorphTarget& target : targets)
+		{
+			valid &= target.first_delta <= counts[1] && target.delta_count <= counts[1] - target.first_delta;
+		}
+		for (const uint32_t vertex : delta_vertices)
+		{
+			valid &= vertex < vertex_count;
+		}
+		return valid;
+	}
+};
+
+// Adds count deltas, scaled by (position_weight, normal_weight), to the accumulators of their vertices
+inline void morph_accumulate(const int16_t* deltas, const uint32_t* vertices, uint32_t count, float position_weight, float normal_weight, float* accumulators)
+{
+#if GLTF_SIMD_AVX2
+	const __m256 weights = _mm256_setr_ps(position_weight, position_weight, position_weight, 0.0f, normal_weight, normal_weight, normal_weight, 0.0f);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const __m256 delta = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) &deltas[i * MORPH_DELTA_COMPONENTS])));
+		float* accumulator = &accumulators[(size_t) vertices[i] * MORPH_DELTA_COMPONENTS];
+		_mm256_storeu_ps(accumulator, _mm256_add_ps(_mm256_loadu_ps(accumulator), _mm256_mul_ps(delta, weights)));
+	}
+#elif GLTF_SIMD_SSE2
+	const __m128 position_weights = _mm_setr_ps(position_weight, position_weight, position_weight, 0.0f);
+	const __m128 normal_weights = _mm_setr_ps(normal_weight, normal_weight, normal_weight, 0.0f);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		// Sign extends each int16 by unpacking it into the top half of a 32 bit lane, then shifting it down
+		const __m128i packed = _mm_loadu_si128((const __m128i*) &deltas[i * MORPH_DELTA_COMPONENTS]);
+		const __m128 position_delta = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+		const __m128 normal_delta = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16));
+		float* accumulator = &accumulators[(size_t) vertices[i] * MORPH_DELTA_COMPONENTS];
+		_mm_storeu_ps(accumulator, _mm_add_ps(_mm_loadu_ps(accumulator), _mm_mul_ps(position_delta, position_weights)));
+		_mm_storeu_ps(accumulator + 4, _mm_add_ps(_mm_loadu_ps(accumulator + 4), _mm_mul_ps(normal_delta, normal_weights)));
+	}
+#elif GLTF_SIMD_NEON
+	const float position_weight_values[4] = { position_weight, position_weight, position_weight, 0.0f };
+	const float normal_weight_values[4] = { normal_weight, normal_weight, normal_weight, 0.0f };
+	const float32x4_t position_weights = vld1q_f32(position_weight_values);
+	const float32x4_t normal_weights = vld1q_f32(normal_weight_values);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const int16x8_t packed = vld1q_s16(&deltas[i * MORPH_DELTA_COMPONENTS]);
+		const float32x4_t position_delta = vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed)));
+		const float32x4_t normal_delta = vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed)));
+		float* accumulator = &accumulators[(size_t) vertices[i] * MORPH_DELTA_COMPONENTS];
+		vst1q_f32(accumulator, vmlaq_f32(vld1q_f32(accumulator), position_delta, position_weights));
+		vst1q_f32(accumulator + 4, vmlaq_f32(vld1q_f32(accumulator + 4), normal_delta, normal_weights));
+	}
+#else
+	const float weights[MORPH_DELTA_COMPONENTS] = { position_weight, position_weight, position_weight, 0.0f, normal_weight, normal_weight, normal_weight, 0.0f };
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float* accumulator = &accumulators[(size_t) vertices[i] * MORPH_DELTA_COMPONENTS];
+		for (uint32_t component = 0; component < MORPH_DELTA_COMPONENTS; ++component)
+		{
+			accumulator[component] += deltas[i * MORPH_DELTA_COMPONENTS + component] * weights[component];
+		}
+	}
+#endif
+}
+
+// Blended vertices of one instance of a morphed primitive, e.g. the primitive as drawn by one node
+struct MorphInstance
+{
+	vector<uint8_t> vertices;			// The primitive's base vertices with the last blended weights applied
+	vector<float> weights;				// Last blended weights, empty before the first blend
+	vector<uint32_t> moved_vertices;	// Vertices that differ from the base vertices
+	vector<uint8_t> moved;				// Per vertex flag for moved_vertices
+	vector<float> accumulators;			// MORPH_DELTA_COMPONENTS per vertex, zero outside of blend_morph_targets
+
+	explicit MorphInstance(const MorphedPrimitive& primitive)
+		: vertices(primitive.base_vertices)
+		, moved(primitive.vertex_count, 0)
+		, accumulators((size_t) primitive.vertex_count * MORPH_DELTA_COMPONENTS, 0.0f)
+	{}
+};
+
+// Applies weights (one per target, missing ones are 0) to instance.vertices.
+// Returns false without touching the vertices if the weights are the same as last time.
+inline bool blend_morph_targets(const MorphedPrimitive& primitive, const float* weights, uint32_t weight_count, MorphInstance& instance)
+{
+	weight_count = weight_count < primitive.targets.size() ? weight_count : (uint32_t) primitive.targets.size();
+	if (instance.weights.size() == weight_count && memcmp(instance.weights.data(), weights, weight_count * sizeof(float)) == 0)
+	{
+		return false;
+	}
+	instance.weights.assign(weights, weights + weight_count);
+
+	const uint32_t stride = primitive.vertex_stride;
+	for (const uint32_t vertex : instance.moved_vertices)
+	{
+		memcpy(&instance.vertices[(size_t) vertex * stride], &primitive.base_vertices[(size_t) vertex * stride], stride);
+		instance.moved[vertex] = 0;
+	}
+	instance.moved_vertices.clear();
+
+	for (uint32_t target_idx = 0; target_idx < weight_count; ++target_idx)
+	{
+		const float weight = weights[target_idx];
+		const MorphTarget& target = primitive.targets[target_idx];
+		if (fabsf(weight) <= MORPH_MIN_WEIGHT || target.delta_count == 0)
+		{
+			continue;
+		}
+
+		const uint32_t* target_vertices = &primitive.delta_vertices[target.first_delta];
+		morph_accumulate(&primitive.deltas[(size_t) target.first_delta * MORPH_DELTA_COMPONENTS], target_vertices, target.delta_count,
+			weight * target.position_scale, weight * target.normal_scale, instance.accumulators.data());
+
+		for (uint32_t i = 0; i < target.delta_count; ++i)
+		{
+			const uint32_t vertex = target_vertices[i];
+			if (!instance.moved[vertex])
+			{
+				instance.moved[vertex] = 1;
+				instance.moved_vertices.push_back(vertex);
+			}
+		}
+	}
+
+	for (const uint32_t vertex : instance.moved_vertices)
+	{
+		const uint8_t* base_vertex = &primitive.base_vertices[(size_t) vertex * stride];
+		uint8_t* out_vertex = &instance.vertices[(size_t) vertex * stride];
+		float* accumulator = &instance.accumulators[(size_t) vertex * MORPH_DELTA_COMPONENTS];
+
+		float position[3];
+		float normal[3];
+		memcpy(position, base_vertex + primitive.position_offset, sizeof(position));
+		memcpy(normal, base_vertex + primitive.normal_offset, sizeof(normal));
+		for (uint32_t component = 0; component < 3; ++component)
+		{
+			position[component] += accumulator[component];
+			normal[component] += accumulator[4 + component];
+		}
+		const float normal_length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (normal_length > 0.0f)
+		{
+			for (float& component : normal) { component /= normal_length; }
+		}
+		memcpy(out_vertex + primitive.position_offset, position, sizeof(position));
+		memcpy(out_vertex + primitive.normal_offset, normal, sizeof(normal));
+		memset(accumulator, 0, MORPH_DELTA_COMPONENTS * sizeof(float));
+	}
+	return true;
+}
+
+struct MorphJob
+{
+	const MorphedPrimitive* primitive = nullptr;
+	MorphInstance* instance = nullptr;
+	const float* weights = nullptr;
+	uint32_t weight_count = 0;
+	uint8_t* out_vertices = nullptr;	// Optional, receives a copy of the blended vertices (e.g. a mapped upload buffer) even if they didn't change
+};
+
+// Blends every job, one job per task
+inline void morph_batch(enki::TaskScheduler& task_scheduler, const MorphJob* jobs, uint32_t job_count)
+{
+	if (job_count == 0)
+	{
+		return;
+	}
+
+	enki::TaskSet morph_task(job_count, [jobs](enki::TaskSetPartition range, uint32_t /*threadnum*/)
+	{
+		for (uint32_t job = range.start; job < range.end; ++job)
+		{
+			const MorphJob& morph_job = jobs[job];
+			blend_morph_targets(*morph_job.primitive, morph_job.weights, morph_job.weight_count, *morph_job.instance);
+			if (morph_job.out_vertices)
+			{
+				memcpy(morph_job.out_vertices, morph_job.instance->vertices.data(), morph_job.instance->vertices.size());
+			}
+		}
+	});
+	task_scheduler.AddTaskSetToPipe(&morph_task);
+	task_scheduler.WaitforTask(&morph_task);
+}
@@ -0,0 +1,462 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "gltf.h"
+#include "EnkiTS/TaskScheduler.h"
+
+// Flattened node hierarchy of a glTF scene.
+// Nodes are stored breadth first, so every level is a contiguous range and parents come before their children.
+// Local TRS values and world matrices are structure of arrays, so a level is updated several nodes at a time:
+// 8 lanes with AVX2, 4 with SSE2 or NEON (following gltf.h's SIMD defines), and large levels are split across enkiTS tasks.
+// World matrices use DirectXMath's row vector convention (world = scale * rotation * translation * parent_world),
+// and only nodes whose local transform or an ancestor's changed since the last update are recomputed.
+
+static const int32_t SCENE_GRAPH_INVALID_INDEX = -1;
+static const uint32_t SCENE_GRAPH_TASK_NODES = 4096; // Levels with more nodes than this are split into tasks of this many nodes
+
+// The affine part of a row vector 4x4 matrix: world[row * 3 + column], rows 0-2 are the 3x3 and row 3 is the translation
+static const uint32_t SCENE_GRAPH_WORLD_COMPONENTS = 12;
+
+struct SceneGraphLanes1
+{
+	typedef float Type;
+	static const uint32_t WIDTH = 1;
+	static Type load(const float* p) { return *p; }
+	static void store(float* p, Type v) { *p = v; }
+	static Type gather(const float* base, const int32_t* indices) { return base[indices[0]]; }
+	static Type splat(float f) { return f; }
+	static Type add(Type a, Type b) { return a + b; }
+	static Type sub(Type a, Type b) { return a - b; }
+	static Type mul(Type a, Type b) { return a * b; }
+	static Type div(Type a, Type b) { return a / b; }
+	static Type sqrt(Type a) { return sqrtf(a); }
+	static Type copy_sign(Type a, Type sign) { return copysignf(a, sign); } // a with the sign bit of sign
+};
+
+#if GLTF_SIMD_SSE2
+struct SceneGraphLanesSSE2
+{
+	typedef __m128 Type;
+	static const uint32_t WIDTH = 4;
+	static Type load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, Type v) { _mm_storeu_ps(p, v); }
+	static Type gather(const float* base, const int32_t* indices) { return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]); }
+	static Type splat(float f) { return _mm_set1_ps(f); }
+	static Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+	static Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+	static Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+	static Type div(Type a, Type b) { return _mm_div_ps(a, b); }
+	static Type sqrt(Type a) { return _mm_sqrt_ps(a); }
+	static Type copy_sign(Type a, Type sign)
+	{
+		const __m128 sign_mask = _mm_set1_ps(-0.0f);
+		return _mm_or_ps(_mm_andnot_ps(sign_mask, a), _mm_and_ps(sign_mask, sign));
+	}
+};
+#endif
+
+#if GLTF_SIMD_AVX2
+struct SceneGraphLanesAVX2
+{
+	typedef __m256 Type;
+	static const uint32_t WIDTH = 8;
+	static Type load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, Type v) { _mm256_storeu_ps(p, v); }
+	static Type gather(const float* base, const int32_t* indices) { return _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*) indices), sizeof(float)); }
+	static Type splat(float f) { return _mm256_set1_ps(f); }
+	static Type add(Type a, Type b) { return _mm256_add_ps(a, b); }
+	static Type sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+	static Type mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+	static Type div(Type a, Type b) { return _mm256_div_ps(a, b); }
+	static Type sqrt(Type a) { return _mm256_sqrt_ps(a); }
+	static Type copy_sign(Type a, Type sign)
+	{
+		const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+		return _mm256_or_ps(_mm256_andnot_ps(sign_mask, a), _mm256_and_ps(sign_mask, sign));
+	}
+};
+#endif
+
+#if GLTF_SIMD_NEON
+struct SceneGraphLanesNEON
+{
+	typedef float32x4_t Type;
+	static const uint32_t WIDTH = 4;
+	static Type load(const float* p) { return vld1q_f32(p); }
+	static void store(float* p, Type v) { vst1q_f32(p, v); }
+	static Type gather(const float* base, const int32_t* indices)
+	{
+		Type v = vdupq_n_f32(base[indices[0]]);
+		v = vsetq_lane_f32(base[indices[1]], v, 1);
+		v = vsetq_lane_f32(base[indices[2]], v, 2);
+		return vsetq_lane_f32(base[indices[3]], v, 3);
+	}
+	static Type splat(float f) { return vdupq_n_f32(f); }
+	static Type add(Type a, Type b) { return vaddq_f32(a, b); }
+	static Type sub(Type a, Type b) { return vsubq_f32(a, b); }
+	static Type mul(Type a, Type b) { return vmulq_f32(a, b); }
+	static Type div(Type a, Type b) { return vdivq_f32(a, b); }
+	static Type sqrt(Type a) { return vsqrtq_f32(a); }
+	static Type copy_sign(Type a, Type sign) { return vbslq_f32(vdupq_n_u32(0x80000000u), sign, a); }
+};
+#endif
+
+#if GLTF_SIMD_AVX2
+typedef SceneGraphLanesAVX2 SceneGraphLanes;
+#elif GLTF_SIMD_SSE2
+typedef SceneGraphLanesSSE2 SceneGraphLanes;
+#elif GLTF_SIMD_NEON
+typedef SceneGraphLanesNEON SceneGraphLanes;
+#else
+typedef SceneGraphLanes1 SceneGraphLanes;
+#endif
+
+// Affine matrices (laid out like SceneGraph::world) of the Lanes::WIDTH TRS transforms starting at first, from structure of arrays inputs
+template <typename Lanes>
+inline void scene_graph_compose_lanes(const float* const translation[3], const float* const rotation[4], const float* const scale[3], uint32_t first,
+	typename Lanes::Type out_matrix[SCENE_GRAPH_WORLD_COMPONENTS])
+{
+	typedef typename Lanes::Type V;
+
+	const V qx = Lanes::load(&rotation[0][first]);
+	const V qy = Lanes::load(&rotation[1][first]);
+	const V qz = Lanes::load(&rotation[2][first]);
+	const V qw = Lanes::load(&rotation[3][first]);
+	const V sx = Lanes::load(&scale[0][first]);
+	const V sy = Lanes::load(&scale[1][first]);
+	const V sz = Lanes::load(&scale[2][first]);
+	const V one = Lanes::splat(1.0f);
+
+	const V x2 = Lanes::add(qx, qx), y2 = Lanes::add(qy, qy), z2 = Lanes::add(qz, qz);
+	const V xx = Lanes::mul(qx, x2), yy = Lanes::mul(qy, y2), zz = Lanes::mul(qz, z2);
+	const V xy = Lanes::mul(qx, y2), xz = Lanes::mul(qx, z2), yz = Lanes::mul(qy, z2);
+	const V wx = Lanes::mul(qw, x2), wy = Lanes::mul(qw, y2), wz = Lanes::mul(qw, z2);
+
+	// Rows match XMMatrixRotationQuaternion, each scaled by its axis' scale
+	out_matrix[0] = Lanes::mul(sx, Lanes::sub(one, Lanes::add(yy, zz)));
+	out_matrix[1] = Lanes::mul(sx, Lanes::add(xy, wz));
+	out_matrix[2] = Lanes::mul(sx, Lanes::sub(xz, wy));
+	out_matrix[3] = Lanes::mul(sy, Lanes::sub(xy, wz));
+	out_matrix[4] = Lanes::mul(sy, Lanes::sub(one, Lanes::add(xx, zz)));
+	out_matrix[5] = Lanes::mul(sy, Lanes::add(yz, wx));
+	out_matrix[6] = Lanes::mul(sz, Lanes::add(xz, wy));
+	out_matrix[7] = Lanes::mul(sz, Lanes::sub(yz, wx));
+	out_matrix[8] = Lanes::mul(sz, Lanes::sub(one, Lanes::add(xx, yy)));
+	out_matrix[9] = Lanes::load(&translation[0][first]);
+	out_matrix[10] = Lanes::load(&translation[1][first]);
+	out_matrix[11] = Lanes::load(&translation[2][first]);
+}
+
+struct SceneGraph
+{
+	uint32_t node_count = 0;
+	vector<int32_t> parents;				// SCENE_GRAPH_INVALID_INDEX for roots, otherwise always less than the node's own index
+	vector<int32_t> mesh_indices;			// Index into the asset's meshes, or SCENE_GRAPH_INVALID_INDEX
+	vector<int32_t> skin_indices;			// Index into the asset's skins, or SCENE_GRAPH_INVALID_INDEX
+	vector<uint32_t> level_offsets;			// Nodes at depth d are [level_offsets[d], level_offsets[d + 1])
+	vector<int32_t> node_from_gltf_node;	// glTF node index to graph node index, SCENE_GRAPH_INVALID_INDEX if the node isn't in the scene
+
+	// Local transforms
+	vector<float> translation[3];
+	vector<float> rotation[4];				// Unit quaternion x, y, z, w
+	vector<float> scale[3];
+
+	vector<float> world[SCENE_GRAPH_WORLD_COMPONENTS];
+
+	// Morph target weights of each node: morph_weight_counts[node] (the mesh's target count) starting at morph_weight_offsets[node]
+	vector<uint32_t> morph_weight_offsets;
+	vector<uint32_t> morph_weight_counts;
+	vector<float> morph_weights;
+
+	vector<uint8_t> dirty;					// Set when a node's world matrix is out of date
+	uint32_t dirty_count = 0;
+
+	// Builds the graph from the asset's default scene, or from every root node if it has none.
+	// Assets without nodes get one node per mesh at the origin.
+	void build(const GltfAsset& asset)
+	{
+		vector<const GltfNode*> ordered_nodes;
+		node_from_gltf_node.assign(asset.num_nodes, SCENE_GRAPH_INVALID_INDEX);
+		level_offsets.clear();
+		parents.clear();
+
+		auto add_node = [&](const GltfNode* gltf_node, int32_t parent)
+		{
+			int32_t& graph_index = node_from_gltf_node[gltf_node - asset.nodes];
+			if (graph_index == SCENE_GRAPH_INVALID_INDEX)
+			{
+				graph_index = (int32_t) ordered_nodes.size();
+				ordered_nodes.push_back(gltf_node);
+				parents.push_back(parent);
+			}
+		};
+
+		if (asset.num_nodes > 0)
+		{
+			const GltfScene* scene = asset.scene ? asset.scene : (asset.num_scenes > 0 ? &asset.scenes[0] : nullptr);
+			if (scene)
+			{
+				for (uint32_t i = 0; i < scene->num_nodes; ++i)
+				{
+					add_node(scene->nodes[i], SCENE_GRAPH_INVALID_INDEX);
+				}
+			}
+			else
+			{
+				for (uint32_t i = 0; i < asset.num_nodes; ++i)
+				{
+					if (!asset.nodes[i].parent)
+					{
+						add_node(&asset.nodes[i], SCENE_GRAPH_INVALID_INDEX);
+					}
+				}
+			}
+
+			// Breadth first, one level at a time
+			uint32_t level_begin = 0;
+			while (level_begin < ordered_nodes.size())
+			{
+				level_offsets.push_back(level_begin);
+				const uint32_t level_end = (uint32_t) ordered_nodes.size();
+				for (uint32_t parent = level_begin; parent < level_end; ++parent)
+				{
+					const GltfNode* gltf_node = ordered_nodes[parent];
+					for (uint32_t child = 0; child < gltf_node->num_children; ++child)
+					{
+						add_node(gltf_node->children[child], (int32_t) parent);
+					}
+				}
+				level_begin = level_end;
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < asset.num_meshes; ++i)
+			{
+				parents.push_back(SCENE_GRAPH_INVALID_INDEX);
+			}
+			if (asset.num_meshes > 0)
+			{
+				level_offsets.push_back(0);
+			}
+		}
+
+		node_count = (uint32_t) parents.size();
+		level_offsets.push_back(node_count);
+
+		mesh_indices.resize(node_count);
+		skin_indices.assign(node_count, SCENE_GRAPH_INVALID_INDEX);
+		for (vector<float>& component : translation) { component.assign(node_count, 0.0f); }
+		for (vector<float>& component : rotation) { component.assign(node_count, 0.0f); }
+		for (vector<float>& component : scale) { component.assign(node_count, 1.0f); }
+		for (vector<float>& component : world) { component.assign(node_count, 0.0f); }
+		rotation[3].assign(node_count, 1.0f);
+		dirty.assign(node_count, 1);
+		dirty_count = node_count;
+		morph_weight_offsets.assign(node_count, 0);
+		morph_weight_counts.assign(node_count, 0);
+		morph_weights.clear();
+
+		for (uint32_t i = 0; i < node_count; ++i)
+		{
+			if (ordered_nodes.empty())
+			{
+				mesh_indices[i] = (int32_t) i;
+				add_morph_weights(i, asset.meshes[i], nullptr);
+				continue;
+			}
+
+			const GltfNode* gltf_node = ordered_nodes[i];
+			mesh_indices[i] = gltf_node->mesh ? (int32_t) (gltf_node->mesh - asset.meshes) : SCENE_GRAPH_INVALID_INDEX;
+			skin_indices[i] = gltf_node->skin ? (int32_t) (gltf_node->skin - asset.skins) : SCENE_GRAPH_INVALID_INDEX;
+			set_local_transform(i, gltf_node->translation, gltf_node->rotation, gltf_node->scale);
+			if (gltf_node->mesh)
+			{
+				add_morph_weights(i, *gltf_node->mesh, gltf_node);
+			}
+		}
+	}
+
+	// Initial weights come from the node, then the mesh, and are 0 when neither has one per target
+	void add_morph_weights(uint32_t node, const GltfMesh& mesh, const GltfNode* gltf_node)
+	{
+		uint32_t target_count = 0;
+		for (uint32_t i = 0; i < mesh.num_primitives; ++i)
+		{
+			target_count = mesh.primitives[i].num_targets > target_count ? mesh.primitives[i].num_targets : target_count;
+		}
+
+		const float* initial_weights = nullptr;
+		if (gltf_node && gltf_node->num_weights == target_count)
+		{
+			initial_weights = gltf_node->weights;
+		}
+		else if (mesh.num_weights == target_count)
+		{
+			initial_weights = mesh.weights;
+		}
+
+		morph_weight_offsets[node] = (uint32_t) morph_weights.size();
+		morph_weight_counts[node] = target_count;
+		for (uint32_t i = 0; i < target_count; ++i)
+		{
+			morph_weights.push_back(initial_weights ? initial_weights[i] : 0.0f);
+		}
+	}
+
+	void set_local_transform(uint32_t node, const float in_translation[3], const float in_rotation[4], const float in_scale[3])
+	{
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			translation[i][node] = in_translation[i];
+			scale[i][node] = in_scale[i];
+		}
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			rotation[i][node] = in_rotation[i];
+		}
+		mark_dirty(node);
+	}
+
+	// Call after writing a node's local transform arrays directly
+	void mark_dirty(uint32_t node)
+	{
+		if (!dirty[node])
+		{
+			dirty[node] = 1;
+			++dirty_count;
+		}
+	}
+
+	// Row vector 4x4 matrix, the layout of XMFLOAT4X4
+	void get_world_matrix(uint32_t node, float out_matrix[16]) const
+	{
+		for (uint32_t row = 0; row < 4; ++row)
+		{
+			for (uint32_t column = 0; column < 3; ++column)
+			{
+				out_matrix[row * 4 + column] = world[row * 3 + column][node];
+			}
+			out_matrix[row * 4 + 3] = row == 3 ? 1.0f : 0.0f;
+		}
+	}
+
+	// Recomputes dirty world matrices one level at a time. Parents are always finished before their children are read.
+	void update_world_transforms(enki::TaskScheduler& task_scheduler)
+	{
+		if (dirty_count == 0)
+		{
+			return;
+		}
+
+		for (uint32_t level = 0; level + 1 < level_offsets.size(); ++level)
+		{
+			const uint32_t level_begin = level_offsets[level];
+			const uint32_t level_end = level_offsets[level + 1];
+			const bool has_parents = level > 0;
+
+			const uint32_t task_count = (level_end - level_begin + SCENE_GRAPH_TASK_NODES - 1) / SCENE_GRAPH_TASK_NODES;
+			if (task_count <= 1)
+			{
+				update_range(level_begin, level_end, has_parents);
+				continue;
+			}
+
+			enki::TaskSet update_task(task_count, [this, level_begin, level_end, has_parents](enki::TaskSetPartition range, uint32_t /*threadnum*/)
+			{
+				const uint32_t begin = level_begin + range.start * SCENE_GRAPH_TASK_NODES;
+				const uint32_t task_end = level_begin + range.end * SCENE_GRAPH_TASK_NODES;
+				const uint32_t end = task_end < level_end ? task_end : level_end;
+				update_range(begin, end, has_parents);
+			});
+			task_scheduler.AddTaskSetToPipe(&update_task);
+			task_scheduler.WaitforTask(&update_task);
+		}
+
+		memset(dirty.data(), 0, dirty.size());
+		dirty_count = 0;
+	}
+
+	void update_range(uint32_t begin, uint32_t end, bool has_parents)
+	{
+		uint32_t node = begin;
+		for (; node + SceneGraphLanes::WIDTH <= end; node += SceneGraphLanes::WIDTH)
+		{
+			if (propagate_dirty(node, SceneGraphLanes::WIDTH, has_parents))
+			{
+				has_parents ? update_lanes<SceneGraphLanes, true>(node) : update_lanes<SceneGraphLanes, false>(node);
+			}
+		}
+		for (; node < end; ++node)
+		{
+			if (propagate_dirty(node, 1, has_parents))
+			{
+				has_parents ? update_lanes<SceneGraphLanes1, true>(node) : update_lanes<SceneGraphLanes1, false>(node);
+			}
+		}
+	}
+
+	// A node is dirty if it or its parent is. Returns true if any of the nodes are.
+	bool propagate_dirty(uint32_t first, uint32_t count, bool has_parents)
+	{
+		uint8_t any_dirty = 0;
+		for (uint32_t node = first; node < first + count; ++node)
+		{
+			if (has_parents)
+			{
+				dirty[node] |= dirty[parents[node]];
+			}
+			any_dirty |= dirty[node];
+		}
+		return any_dirty != 0;
+	}
+
+	// World matrices of Lanes::WIDTH consecutive nodes. Clean nodes in the batch are recomputed to the same values.
+	template <typename Lanes, bool HasParents>
+	void update_lanes(uint32_t first)
+	{
+		typedef typename Lanes::Type V;
+
+		const float* const translations[3] = { translation[0].data(), translation[1].data(), translation[2].data() };
+		const float* const rotations[4] = { rotation[0].data(), rotation[1].data(), rotation[2].data(), rotation[3].data() };
+		const float* const scales[3] = { scale[0].data(), scale[1].data(), scale[2].data() };
+		V local[SCENE_GRAPH_WORLD_COMPONENTS];
+		scene_graph_compose_lanes<Lanes>(translations, rotations, scales, first, local);
+
+		if (!HasParents)
+		{
+			for (uint32_t i = 0; i < SCENE_GRAPH_WORLD_COMPONENTS; ++i)
+			{
+				Lanes::store(&world[i][first], local[i]);
+			}
+			return;
+		}
+
+		V parent[SCENE_GRAPH_WORLD_COMPONENTS];
+		for (uint32_t i = 0; i < SCENE_GRAPH_WORLD_COMPONENTS; ++i)
+		{
+			parent[i] = Lanes::gather(world[i].data(), &parents[first]);
+		}
+
+		for (uint32_t row = 0; row < 4; ++row)
+		{
+			for (uint32_t column = 0; column < 3; ++column)
+			{
+				V result = Lanes::mul(local[row * 3 + 0], parent[0 * 3 + column]);
+				result = Lanes::add(result, Lanes::mul(local[row * 3 + 1], parent[1 * 3 + column]));
+				result = Lanes::add(result, Lanes::mul(local[row * 3 + 2], parent[2 * 3 + column]));
+				if (row == 3)
+				{
+					result = Lanes::add(result, parent[9 + column]);
+				}
+				Lanes::store(&world[row * 3 + column][first], result);
+			}
+		}
+	}
+};
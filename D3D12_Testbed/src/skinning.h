@@ -0,0 +1,318 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+#include <EASTL/algorithm.h>
+
+#include "gltf.h"
+#include "scene_graph.h"
+#include "EnkiTS/TaskScheduler.h"
+
+// CPU linear blend skinning.
+// Each skin's joint matrices (inverse bind matrix * joint world matrix) are row vector 4x4 matrices, 16 floats per joint,
+// the layout of a float4x4 structured buffer, so a GPU path can consume the same joint matrices and SkinInfluences.
+// skin_batch skins any number of primitive instances (e.g. a crowd of characters) in one go: the vertices of every job are split into
+// tasks of SKINNING_TASK_VERTICES, and each task skins SKINNING_BATCH_VERTICES at a time into a staging buffer on the stack,
+// then writes whole vertices out with one copy, so write combined upload memory only sees sequential writes.
+// A vertex's 4 influences are blended one matrix row (4 floats) at a time, in SSE2 or NEON registers when available.
+
+static const uint32_t SKINNING_MAX_INFLUENCES = 4;
+static const uint32_t SKINNING_BATCH_VERTICES = 64;
+static const uint32_t SKINNING_TASK_VERTICES = 4096;
+static const uint32_t SKINNING_MAX_VERTEX_STRIDE = 128;
+
+struct SkinInfluences
+{
+	uint16_t joints[SKINNING_MAX_INFLUENCES];
+	float weights[SKINNING_MAX_INFLUENCES]; // Sum to 1
+};
+
+static_assert(sizeof(SkinInfluences) == 24, "SkinInfluences is stored in the mesh cache as is");
+
+// Decodes JOINTS_0 and WEIGHTS_0 (any glTF component type) into out_influences, out_stride bytes apart, and normalizes the weights.
+// Fails if the primitive isn't skinned or the accessors don't have an element per vertex.
+inline bool unpack_skin_influences(const GltfPrimitive& primitive, SkinInfluences* out_influences, size_t out_stride)
+{
+	const GltfAccessor* joints = primitive.joints0;
+	const GltfAccessor* weights = primitive.weights0;
+	if (!joints || !weights || !primitive.positions || joints->count != primitive.positions->count || weights->count != primitive.positions->count
+		|| (joints->component_type != GLTF_COMPONENT_TYPE_UNSIGNED_BYTE && joints->component_type != GLTF_COMPONENT_TYPE_UNSIGNED_SHORT) || joints->normalized)
+	{
+		return false;
+	}
+
+	const uint32_t vertex_count = joints->count;
+	vector<float> joint_values(vertex_count * SKINNING_MAX_INFLUENCES);
+	vector<float> weight_values(vertex_count * SKINNING_MAX_INFLUENCES);
+	if (!gltf_accessor_unpack_floats(joints, SKINNING_MAX_INFLUENCES, joint_values.data(), SKINNING_MAX_INFLUENCES * sizeof(float))
+		|| !gltf_accessor_unpack_floats(weights, SKINNING_MAX_INFLUENCES, weight_values.data(), SKINNING_MAX_INFLUENCES * sizeof(float)))
+	{
+		return false;
+	}
+
+	uint8_t* out = (uint8_t*) out_influences;
+	for (uint32_t i = 0; i < vertex_count; ++i, out += out_stride)
+	{
+		SkinInfluences influences;
+		float weight_sum = 0.0f;
+		for (uint32_t j = 0; j < SKINNING_MAX_INFLUENCES; ++j)
+		{
+			influences.joints[j] = (uint16_t) joint_values[i * SKINNING_MAX_INFLUENCES + j];
+			influences.weights[j] = weight_values[i * SKINNING_MAX_INFLUENCES + j];
+			weight_sum += influences.weights[j];
+		}
+
+		// glTF requires weights to sum to 1, quantized weights only get close
+		if (weight_sum > 0.0f)
+		{
+			for (float& weight : influences.weights) { weight /= weight_sum; }
+		}
+		else
+		{
+			influences.weights[0] = 1.0f;
+		}
+		memcpy(out, &influences, sizeof(SkinInfluences));
+	}
+	return true;
+}
+
+// Bind pose vertices of a skinned primitive, in the same order as the primitive's vertex buffer
+struct SkinnedPrimitive
+{
+	uint32_t vertex_count = 0;
+	uint32_t vertex_stride = 0;
+	uint32_t position_offset = 0;	// float3, transformed by the skin
+	uint32_t normal_offset = 0;		// float3, rotated by the skin. The rest of the vertex is copied as is
+	uint32_t joint_count = 0;		// Highest joint index used + 1
+	vector<uint8_t> bind_vertices;
+	vector<SkinInfluences> influences;
+
+	bool build(const void* in_vertices, uint32_t in_vertex_stride, uint32_t in_position_offset, uint32_t in_normal_offset, uint32_t in_vertex_count, const SkinInfluences* in_influences)
+	{
+		if (in_vertex_stride > SKINNING_MAX_VERTEX_STRIDE || in_position_offset + 3 * sizeof(float) > in_vertex_stride || in_normal_offset + 3 * sizeof(float) > in_vertex_stride)
+		{
+			return false;
+		}
+
+		vertex_count = in_vertex_count;
+		vertex_stride = in_vertex_stride;
+		position_offset = in_position_offset;
+		normal_offset = in_normal_offset;
+		bind_vertices.resize((size_t) vertex_count * vertex_stride);
+		memcpy(bind_vertices.data(), in_vertices, bind_vertices.size());
+		influences.assign(in_influences, in_influences + vertex_count);
+
+		joint_count = 0;
+		for (const SkinInfluences& vertex_influences : influences)
+		{
+			for (uint32_t j = 0; j < SKINNING_MAX_INFLUENCES; ++j)
+			{
+				joint_count = vertex_influences.joints[j] >= joint_count ? vertex_influences.joints[j] + 1 : joint_count;
+			}
+		}
+		return true;
+	}
+};
+
+#if GLTF_SIMD_SSE2
+typedef __m128 SkinningRow;
+inline SkinningRow skinning_load(const float* p) { return _mm_loadu_ps(p); }
+inline void skinning_store(float* p, SkinningRow v) { _mm_storeu_ps(p, v); }
+inline SkinningRow skinning_splat(float f) { return _mm_set1_ps(f); }
+inline SkinningRow skinning_mul(SkinningRow a, SkinningRow b) { return _mm_mul_ps(a, b); }
+inline SkinningRow skinning_madd(SkinningRow a, SkinningRow b, SkinningRow c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#elif GLTF_SIMD_NEON
+typedef float32x4_t SkinningRow;
+inline SkinningRow skinning_load(const float* p) { return vld1q_f32(p); }
+inline void skinning_store(float* p, SkinningRow v) { vst1q_f32(p, v); }
+inline SkinningRow skinning_splat(float f) { return vdupq_n_f32(f); }
+inline SkinningRow skinning_mul(SkinningRow a, SkinningRow b) { return vmulq_f32(a, b); }
+inline SkinningRow skinning_madd(SkinningRow a, SkinningRow b, SkinningRow c) { return vmlaq_f32(c, a, b); }
+#else
+struct SkinningRow { float v[4]; };
+inline SkinningRow skinning_load(const float* p) { SkinningRow r; memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void skinning_store(float* p, SkinningRow v) { memcpy(p, v.v, sizeof(v.v)); }
+inline SkinningRow skinning_splat(float f) { SkinningRow r = { { f, f, f, f } }; return r; }
+inline SkinningRow skinning_mul(SkinningRow a, SkinningRow b) { for (uint32_t i = 0; i < 4; ++i) { a.v[i] *= b.v[i]; } return a; }
+inline SkinningRow skinning_madd(SkinningRow a, SkinningRow b, SkinningRow c) { for (uint32_t i = 0; i < 4; ++i) { c.v[i] += a.v[i] * b.v[i]; } return c; }
+#endif
+
+// Row vector 4x4 product out = a * b, where both are affine
+inline void skinning_multiply_matrices(const float a[16], const float b[16], float out[16])
+{
+	const SkinningRow b0 = skinning_load(&b[0]);
+	const SkinningRow b1 = skinning_load(&b[4]);
+	const SkinningRow b2 = skinning_load(&b[8]);
+	const SkinningRow b3 = skinning_load(&b[12]);
+	for (uint32_t row = 0; row < 4; ++row)
+	{
+		const float* a_row = &a[row * 4];
+		SkinningRow result = skinning_mul(skinning_splat(a_row[0]), b0);
+		result = skinning_madd(skinning_splat(a_row[1]), b1, result);
+		result = skinning_madd(skinning_splat(a_row[2]), b2, result);
+		result = skinning_madd(skinning_splat(a_row[3]), b3, result);
+		skinning_store(&out[row * 4], result);
+	}
+}
+
+struct Skin
+{
+	vector<int32_t> joint_nodes;			// Scene graph node of each joint
+	vector<float> inverse_bind_matrices;	// 16 floats per joint, row vector
+	vector<float> joint_matrices;			// 16 floats per joint, row vector, recomputed by update_joint_matrices
+
+	// Fails (leaving the skin without joints) if a joint isn't in the scene graph
+	bool build(const GltfSkin& gltf_skin, const GltfAsset& asset, const SceneGraph& scene_graph)
+	{
+		joint_nodes.resize(gltf_skin.num_joints);
+		inverse_bind_matrices.resize(gltf_skin.num_joints * 16);
+		joint_matrices.resize(gltf_skin.num_joints * 16);
+
+		for (uint32_t joint = 0; joint < gltf_skin.num_joints; ++joint)
+		{
+			joint_nodes[joint] = scene_graph.node_from_gltf_node[gltf_skin.joints[joint] - asset.nodes];
+			if (joint_nodes[joint] == SCENE_GRAPH_INVALID_INDEX)
+			{
+				joint_nodes.clear();
+				return false;
+			}
+
+			// glTF matrices are column major column vector matrices, which is the same memory as a row major row vector matrix
+			float* inverse_bind_matrix = &inverse_bind_matrices[joint * 16];
+			if (const GltfAccessor* accessor = gltf_skin.inverse_bind_matrices)
+			{
+				const uint8_t* data = accessor->buffer_view->buffer->data + gltf_accessor_get_initial_offset(accessor) + (size_t) joint * gltf_accessor_get_stride(accessor);
+				memcpy(inverse_bind_matrix, data, 16 * sizeof(float));
+			}
+			else
+			{
+				memset(inverse_bind_matrix, 0, 16 * sizeof(float));
+				inverse_bind_matrix[0] = inverse_bind_matrix[5] = inverse_bind_matrix[10] = inverse_bind_matrix[15] = 1.0f;
+			}
+		}
+		return true;
+	}
+
+	uint32_t joint_count() const { return (uint32_t) joint_nodes.size(); }
+
+	// Call after the scene graph's world transforms are updated
+	void update_joint_matrices(const SceneGraph& scene_graph)
+	{
+		for (uint32_t joint = 0; joint < joint_count(); ++joint)
+		{
+			float world_matrix[16];
+			scene_graph.get_world_matrix(joint_nodes[joint], world_matrix);
+			skinning_multiply_matrices(&inverse_bind_matrices[joint * 16], world_matrix, &joint_matrices[joint * 16]);
+		}
+	}
+};
+
+// Skins vertices [begin, end) of primitive into out_vertices (the whole primitive's vertex buffer).
+// bind_vertices is usually primitive.bind_vertices, or the same vertices after morphing. joint_matrices needs primitive.joint_count matrices.
+inline void skin_vertices(const SkinnedPrimitive& primitive, const uint8_t* bind_vertices, const float* joint_matrices, uint32_t begin, uint32_t end, uint8_t* out_vertices)
+{
+	const uint32_t stride = primitive.vertex_stride;
+	alignas(16) uint8_t staging[SKINNING_BATCH_VERTICES * SKINNING_MAX_VERTEX_STRIDE];
+
+	for (uint32_t batch_begin = begin; batch_begin < end; batch_begin += SKINNING_BATCH_VERTICES)
+	{
+		const uint32_t batch_count = end - batch_begin < SKINNING_BATCH_VERTICES ? end - batch_begin : SKINNING_BATCH_VERTICES;
+		memcpy(staging, bind_vertices + (size_t) batch_begin * stride, (size_t) batch_count * stride);
+
+		for (uint32_t i = 0; i < batch_count; ++i)
+		{
+			const SkinInfluences& influences = primitive.influences[batch_begin + i];
+			uint8_t* vertex = &staging[i * stride];
+
+			// Blend the rows of the influencing joint matrices
+			const float* joint_matrix = &joint_matrices[influences.joints[0] * 16];
+			SkinningRow weight = skinning_splat(influences.weights[0]);
+			SkinningRow row0 = skinning_mul(weight, skinning_load(&joint_matrix[0]));
+			SkinningRow row1 = skinning_mul(weight, skinning_load(&joint_matrix[4]));
+			SkinningRow row2 = skinning_mul(weight, skinning_load(&joint_matrix[8]));
+			SkinningRow row3 = skinning_mul(weight, skinning_load(&joint_matrix[12]));
+			for (uint32_t j = 1; j < SKINNING_MAX_INFLUENCES; ++j)
+			{
+				joint_matrix = &joint_matrices[influences.joints[j] * 16];
+				weight = skinning_splat(influences.weights[j]);
+				row0 = skinning_madd(weight, skinning_load(&joint_matrix[0]), row0);
+				row1 = skinning_madd(weight, skinning_load(&joint_matrix[4]), row1);
+				row2 = skinning_madd(weight, skinning_load(&joint_matrix[8]), row2);
+				row3 = skinning_madd(weight, skinning_load(&joint_matrix[12]), row3);
+			}
+
+			float position[3];
+			float normal[3];
+			memcpy(position, vertex + primitive.position_offset, sizeof(position));
+			memcpy(normal, vertex + primitive.normal_offset, sizeof(normal));
+
+			SkinningRow skinned_position = skinning_madd(skinning_splat(position[0]), row0, row3);
+			skinned_position = skinning_madd(skinning_splat(position[1]), row1, skinned_position);
+			skinned_position = skinning_madd(skinning_splat(position[2]), row2, skinned_position);
+
+			SkinningRow skinned_normal = skinning_mul(skinning_splat(normal[0]), row0);
+			skinned_normal = skinning_madd(skinning_splat(normal[1]), row1, skinned_normal);
+			skinned_normal = skinning_madd(skinning_splat(normal[2]), row2, skinned_normal);
+
+			float result[4];
+			skinning_store(result, skinned_position);
+			memcpy(vertex + primitive.position_offset, result, sizeof(position));
+			skinning_store(result, skinned_normal);
+			memcpy(vertex + primitive.normal_offset, result, sizeof(normal));
+		}
+
+		memcpy(out_vertices + (size_t) batch_begin * stride, staging, (size_t) batch_count * stride);
+	}
+}
+
+struct SkinningJob
+{
+	const SkinnedPrimitive* primitive = nullptr;
+	const uint8_t* bind_vertices = nullptr;	// Optional, replaces primitive->bind_vertices (e.g. with morphed vertices)
+	const float* joint_matrices = nullptr;	// At least primitive->joint_count matrices
+	uint8_t* out_vertices = nullptr;		// primitive->vertex_count vertices of primitive->vertex_stride bytes, e.g. a mapped upload buffer
+};
+
+// Skins every job, with the vertices of all jobs split evenly across the task scheduler's threads
+inline void skin_batch(enki::TaskScheduler& task_scheduler, const SkinningJob* jobs, uint32_t job_count)
+{
+	// First task of each job, plus the total at the end
+	vector<uint32_t> job_first_task(job_count + 1);
+	uint32_t task_count = 0;
+	for (uint32_t job = 0; job < job_count; ++job)
+	{
+		job_first_task[job] = task_count;
+		task_count += (jobs[job].primitive->vertex_count + SKINNING_TASK_VERTICES - 1) / SKINNING_TASK_VERTICES;
+	}
+	job_first_task[job_count] = task_count;
+
+	if (task_count == 0)
+	{
+		return;
+	}
+
+	enki::TaskSet skinning_task(task_count, [jobs, &job_first_task](enki::TaskSetPartition range, uint32_t /*threadnum*/)
+	{
+		// Partitions are contiguous, so find the first task's job then walk forward
+		uint32_t job = (uint32_t) (eastl::upper_bound(job_first_task.begin(), job_first_task.end(), range.start) - job_first_task.begin()) - 1;
+		for (uint32_t task = range.start; task < range.end; ++task)
+		{
+			while (task >= job_first_task[job + 1])
+			{
+				++job;
+			}
+
+			const SkinningJob& skinning_job = jobs[job];
+			const uint32_t begin = (task - job_first_task[job]) * SKINNING_TASK_VERTICES;
+			const uint32_t remaining = skinning_job.primitive->vertex_count - begin;
+			const uint32_t end = begin + (remaining < SKINNING_TASK_VERTICES ? remaining : SKINNING_TASK_VERTICES);
+			const uint8_t* bind_vertices = skinning_job.bind_vertices ? skinning_job.bind_vertices : skinning_job.primitive->bind_vertices.data();
+			skin_vertices(*skinning_job.primitive, bind_vertices, skinning_job.joint_matrices, begin, end, skinning_job.out_vertices);
+		}
+	});
+	task_scheduler.AddTaskSetToPipe(&skinning_task);
+	task_scheduler.WaitforTask(&skinning_task);
+}
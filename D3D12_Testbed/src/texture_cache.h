@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "gltf.h"
+#include "mesh_cache.h"
+
+// Disk cache of processed textures: every mip level in its final GPU format (block compressed or not), so later runs map the
+// file and upload the levels without decoding, filtering or compressing anything.
+//
+// Each texture is its own file in the cache directory, named after its key: a hash of the encoded image bytes seeded with
+// the settings that affect the output (see texture_cache_key).
+// Layout: TextureCacheHeader, TextureCacheLevel table, then the levels' rows, each level aligned to TEXTURE_CACHE_LEVEL_ALIGNMENT.
+
+static const uint32_t TEXTURE_CACHE_MAGIC = 0x58455454; // "TTEX"
+// Bump whenever mip generation or compression output changes
+static const uint32_t TEXTURE_CACHE_VERSION = 1;
+static const uint64_t TEXTURE_CACHE_LEVEL_ALIGNMENT = 256;
+static const uint32_t TEXTURE_CACHE_MAX_LEVELS = 16;
+
+struct TextureCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t file_size;
+	uint32_t format; // DXGI_FORMAT
+	uint32_t width;
+	uint32_t height;
+	uint32_t level_count;
+	uint32_t component_mapping; // Shader4ComponentMapping of the texture's SRV
+	uint32_t padding;
+};
+
+struct TextureCacheLevel
+{
+	uint64_t offset; // From the start of the file
+	uint32_t row_pitch; // Bytes per row of texels, or of blocks for block compressed formats
+	uint32_t row_count;
+};
+
+static_assert(sizeof(TextureCacheHeader) == 48, "TextureCacheHeader is written to disk as is");
+static_assert(sizeof(TextureCacheLevel) == 16, "TextureCacheLevel is written to disk as is");
+
+// Source of one level when writing
+struct TextureCacheLevelData
+{
+	const void* data;
+	uint32_t row_pitch;
+	uint32_t row_count;
+};
+
+// settings is a plain struct of whatever else the output depends on (format choice, filters, flips...)
+inline uint64_t texture_cache_key(const void* encoded_data, size_t encoded_size, const void* settings, size_t settings_size)
+{
+	const uint64_t settings_hash = hash_bytes(settings, settings_size, TEXTURE_CACHE_VERSION);
+	return hash_bytes(encoded_data, encoded_size, settings_hash);
+}
+
+inline std::string texture_cache_path(const char* directory, uint64_t key)
+{
+	char file_name[32];
+	snprintf(file_name, sizeof(file_name), "%016llx.texcache", (unsigned long long) key);
+	return std::string(directory) + "/" + file_name;
+}
+
+// Creates the directory (not its parents), succeeds if it already exists
+inline bool texture_cache_create_directory(const char* directory)
+{
+	#ifdef _WIN32
+	const int result = _mkdir(directory);
+	#else
+	const int result = mkdir(directory, 0755);
+	#endif
+	return result == 0 || errno == EEXIST;
+}
+
+// Read side: the mapped cache file. Level pointers stay valid until release().
+struct TextureCache
+{
+	GltfFileData file = {};
+	const TextureCacheHeader* header = nullptr;
+	const TextureCacheLevel* levels = nullptr;
+
+	// Fails if the file is missing, truncated or was written for a different key or version
+	bool open(const char* path, uint64_t key)
+	{
+		release();
+
+		if (!gltf_file_map(path, &file))
+		{
+			return false;
+		}
+
+		const TextureCacheHeader* in_header = (const TextureCacheHeader*) file.data;
+		bool valid = file.size >= sizeof(TextureCacheHeader)
+			&& in_header->magic == TEXTURE_CACHE_MAGIC
+			&& in_header->version == TEXTURE_CACHE_VERSION
+			&& in_header->key == key
+			&& in_header->file_size == file.size
+			&& in_header->level_count > 0 && in_header->level_count <= TEXTURE_CACHE_MAX_LEVELS
+			&& sizeof(TextureCacheHeader) + (uint64_t) in_header->level_count * sizeof(TextureCacheLevel) <= file.size;
+
+		const TextureCacheLevel* in_levels = (const TextureCacheLevel*) (file.data + sizeof(TextureCacheHeader));
+		for (uint32_t i = 0; valid && i < in_header->level_count; ++i)
+		{
+			valid = in_levels[i].offset <= file.size && (uint64_t) in_levels[i].row_pitch * in_levels[i].row_count <= file.size - in_levels[i].offset;
+		}
+
+		if (!valid)
+		{
+			release();
+			return false;
+		}
+
+		header = in_header;
+		levels = in_levels;
+		return true;
+	}
+
+	bool is_open() const { return header != nullptr; }
+
+	const uint8_t* level_data(uint32_t level) const { return file.data + levels[level].offset; }
+
+	void release()
+	{
+		if (file.data)
+		{
+			gltf_file_release(&file);
+		}
+		header = nullptr;
+		levels = nullptr;
+	}
+};
+
+// Writes to a temporary file renamed into place once complete, so tasks caching the same image at once never see each other's
+// partial files. Where rename doesn't replace existing files (Windows), the first writer's file is kept and this returns false.
+inline bool write_texture_cache(const char* path, uint64_t key, uint32_t format, uint32_t width, uint32_t height, uint32_t component_mapping,
+	const TextureCacheLevelData* levels, uint32_t level_count)
+{
+	if (level_count == 0 || level_count > TEXTURE_CACHE_MAX_LEVELS)
+	{
+		return false;
+	}
+
+	auto align = [](uint64_t offset) { return (offset + TEXTURE_CACHE_LEVEL_ALIGNMENT - 1) & ~(TEXTURE_CACHE_LEVEL_ALIGNMENT - 1); };
+
+	TextureCacheLevel table[TEXTURE_CACHE_MAX_LEVELS] = {};
+	uint64_t offset = sizeof(TextureCacheHeader) + level_count * sizeof(TextureCacheLevel);
+	for (uint32_t i = 0; i < level_count; ++i)
+	{
+		table[i].offset = align(offset);
+		table[i].row_pitch = levels[i].row_pitch;
+		table[i].row_count = levels[i].row_count;
+		offset = table[i].offset + (uint64_t) levels[i].row_pitch * levels[i].row_count;
+	}
+
+	TextureCacheHeader header_data = {};
+	header_data.magic = TEXTURE_CACHE_MAGIC;
+	header_data.version = TEXTURE_CACHE_VERSION;
+	header_data.key = key;
+	header_data.file_size = offset;
+	header_data.format = format;
+	header_data.width = width;
+	header_data.height = height;
+	header_data.level_count = level_count;
+	header_data.component_mapping = component_mapping;
+
+	static std::atomic<uint32_t> temporary_counter = 0;
+	const std::string temporary_path = std::string(path) + ".tmp" + std::to_string(temporary_counter++);
+
+	#ifdef _MSC_VER
+	FILE* file = nullptr;
+	if (fopen_s(&file, temporary_path.c_str(), "wb") != 0)
+	{
+		file = nullptr;
+	}
+	#else
+	FILE* file = fopen(temporary_path.c_str(), "wb");
+	#endif
+	if (!file)
+	{
+		return false;
+	}
+
+	bool succeeded = fwrite(&header_data, sizeof(TextureCacheHeader), 1, file) == 1
+		&& fwrite(table, sizeof(TextureCacheLevel), level_count, file) == level_count;
+
+	const uint8_t zeros[TEXTURE_CACHE_LEVEL_ALIGNMENT] = {};
+	uint64_t position = sizeof(TextureCacheHeader) + level_count * sizeof(TextureCacheLevel);
+	for (uint32_t i = 0; succeeded && i < level_count; ++i)
+	{
+		const size_t padding = (size_t) (table[i].offset - position);
+		const size_t level_size = (size_t) levels[i].row_pitch * levels[i].row_count;
+		succeeded = (padding == 0 || fwrite(zeros, 1, padding, file) == padding) && fwrite(levels[i].data, 1, level_size, file) == level_size;
+		position = table[i].offset + level_size;
+	}
+	succeeded = fclose(file) == 0 && succeeded;
+
+	succeeded = succeeded && rename(temporary_path.c_str(), path) == 0;
+	if (!succeeded)
+	{
+		remove(temporary_path.c_str());
+	}
+	return succeeded;
+}
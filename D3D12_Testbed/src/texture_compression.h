@@ -0,0 +1,801 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "EnkiTS/TaskScheduler.h"
+
+// Block compression of texture levels on the CPU.
+// BC1, BC4 and BC5 take RGBA8 texels, BC7 RGBA8 color (mode 6 only: one subset, 7.7.7.7 endpoints with a p-bit each and 4 bit
+// indices), and BC6H unsigned float4 texels (mode 11 only: one region, 10 bit endpoints without deltas, 4 bit indices).
+// Every encoder fits a line through the block's texels along their principal axis, quantizes its ends, picks each texel's
+// closest palette entry and then refines the endpoints by least squares for a few iterations, keeping the best fit.
+// Rows of blocks are split into tasks of BC_TASK_BLOCK_ROWS on enkiTS.
+
+static const uint32_t BC_TASK_BLOCK_ROWS = 4;
+static const uint32_t BC_REFINE_ITERATIONS = 2;
+
+enum class BlockFormat : uint8_t
+{
+	BC1,	// RGB, 4 bits per texel
+	BC4,	// One channel, 4 bits per texel
+	BC5,	// Two channels, 8 bits per texel
+	BC6H,	// Unsigned half float RGB, 8 bits per texel
+	BC7,	// RGBA, 8 bits per texel
+};
+
+inline uint32_t block_format_size(BlockFormat format)
+{
+	return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+// Interpolation weights (out of 64) of 4 bit BC6H and BC7 indices
+static const uint32_t BC_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Writes fields least significant bit first into a zeroed block
+struct BcBitWriter
+{
+	uint8_t* block;
+	uint32_t position = 0;
+
+	explicit BcBitWriter(uint8_t* in_block) : block(in_block) {}
+
+	void write(uint32_t value, uint32_t bit_count)
+	{
+		for (uint32_t bit = 0; bit < bit_count; ++bit, ++position)
+		{
+			block[position >> 3] |= (uint8_t) (((value >> bit) & 1) << (position & 7));
+		}
+	}
+};
+
+// Principal axis of 16 points with N components by power iteration on their covariance, starting from the bounding box diagonal
+template <uint32_t N>
+inline void bc_principal_axis(const float points[16][4], float out_mean[N], float out_axis[N])
+{
+	float minimum[N], maximum[N];
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		out_mean[c] = 0.0f;
+		minimum[c] = maximum[c] = points[0][c];
+	}
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < N; ++c)
+		{
+			out_mean[c] += points[i][c] * (1.0f / 16.0f);
+			minimum[c] = points[i][c] < minimum[c] ? points[i][c] : minimum[c];
+			maximum[c] = points[i][c] > maximum[c] ? points[i][c] : maximum[c];
+		}
+	}
+
+	float covariance[N][N] = {};
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t a = 0; a < N; ++a)
+		{
+			for (uint32_t b = 0; b < N; ++b)
+			{
+				covariance[a][b] += (points[i][a] - out_mean[a]) * (points[i][b] - out_mean[b]);
+			}
+		}
+	}
+
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		out_axis[c] = maximum[c] - minimum[c];
+	}
+	for (uint32_t iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[N] = {};
+		float largest = 0.0f;
+		for (uint32_t a = 0; a < N; ++a)
+		{
+			for (uint32_t b = 0; b < N; ++b)
+			{
+				next[a] += covariance[a][b] * out_axis[b];
+			}
+			largest = fabsf(next[a]) > largest ? fabsf(next[a]) : largest;
+		}
+		if (largest == 0.0f)
+		{
+			break;
+		}
+		for (uint32_t c = 0; c < N; ++c)
+		{
+			out_axis[c] = next[c] / largest;
+		}
+	}
+
+	float length_squared = 0.0f;
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		length_squared += out_axis[c] * out_axis[c];
+	}
+	const float inverse_length = length_squared > 0.0f ? 1.0f / sqrtf(length_squared) : 0.0f;
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		out_axis[c] *= inverse_length;
+	}
+}
+
+// Ends of the segment of the principal axis the points project onto
+template <uint32_t N>
+inline void bc_fit_line(const float points[16][4], float out_start[N], float out_end[N])
+{
+	float mean[N], axis[N];
+	bc_principal_axis<N>(points, mean, axis);
+
+	float t_min = 0.0f, t_max = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float t = 0.0f;
+		for (uint32_t c = 0; c < N; ++c)
+		{
+			t += (points[i][c] - mean[c]) * axis[c];
+		}
+		t_min = t < t_min ? t : t_min;
+		t_max = t > t_max ? t : t_max;
+	}
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		out_start[c] = mean[c] + axis[c] * t_min;
+		out_end[c] = mean[c] + axis[c] * t_max;
+	}
+}
+
+// Endpoints minimizing the squared error of points[i] ~ (1 - weights[i]) * start + weights[i] * end. False if the weights are all equal.
+template <uint32_t N>
+inline bool bc_least_squares_endpoints(const float points[16][4], const float weights[16], float out_start[N], float out_end[N])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[N] = {}, bx[N] = {};
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const float b = weights[i];
+		const float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (uint32_t c = 0; c < N; ++c)
+		{
+			ax[c] += a * points[i][c];
+			bx[c] += b * points[i][c];
+		}
+	}
+	const float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+	{
+		return false;
+	}
+	const float inverse_determinant = 1.0f / determinant;
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		out_start[c] = (bb * ax[c] - ab * bx[c]) * inverse_determinant;
+		out_end[c] = (aa * bx[c] - ab * ax[c]) * inverse_determinant;
+	}
+	return true;
+}
+
+inline int32_t bc_clamp(int32_t value, int32_t minimum, int32_t maximum)
+{
+	return value < minimum ? minimum : (value > maximum ? maximum : value);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// BC1
+
+inline uint16_t bc1_pack_565(const float color[3])
+{
+	const int32_t r = bc_clamp((int32_t) (color[0] * (31.0f / 255.0f) + 0.5f), 0, 31);
+	const int32_t g = bc_clamp((int32_t) (color[1] * (63.0f / 255.0f) + 0.5f), 0, 63);
+	const int32_t b = bc_clamp((int32_t) (color[2] * (31.0f / 255.0f) + 0.5f), 0, 31);
+	return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+inline void bc1_unpack_565(uint16_t packed, int32_t out_color[3])
+{
+	const int32_t r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	out_color[0] = (r << 3) | (r >> 2);
+	out_color[1] = (g << 2) | (g >> 4);
+	out_color[2] = (b << 3) | (b >> 2);
+}
+
+// Picks each texel's index for color0 > color1 (four color mode), returns the squared error
+inline uint32_t bc1_fit_indices(const float texels[16][4], uint16_t color0, uint16_t color1, uint8_t out_indices[16])
+{
+	int32_t palette[4][3];
+	bc1_unpack_565(color0, palette[0]);
+	bc1_unpack_565(color1, palette[1]);
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t error = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		uint32_t best_error = UINT32_MAX;
+		for (uint8_t index = 0; index < 4; ++index)
+		{
+			uint32_t index_error = 0;
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const int32_t difference = (int32_t) texels[i][c] - palette[index][c];
+				index_error += (uint32_t) (difference * difference);
+			}
+			if (index_error < best_error)
+			{
+				best_error = index_error;
+				out_indices[i] = index;
+			}
+		}
+		error += best_error;
+	}
+	return error;
+}
+
+// Orders the endpoints for four color mode (color0 > color1). Equal endpoints give three color mode, where index 0 still decodes to color0.
+inline uint32_t bc1_fit(const float texels[16][4], uint16_t& io_color0, uint16_t& io_color1, uint8_t out_indices[16])
+{
+	if (io_color0 < io_color1)
+	{
+		const uint16_t color = io_color0;
+		io_color0 = io_color1;
+		io_color1 = color;
+	}
+	const uint32_t error = bc1_fit_indices(texels, io_color0, io_color1, out_indices);
+	if (io_color0 == io_color1)
+	{
+		memset(out_indices, 0, 16);
+	}
+	return error;
+}
+
+inline void encode_bc1_block(const uint8_t texels[16][4], uint8_t* out_block)
+{
+	float points[16][4];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			points[i][c] = texels[i][c];
+		}
+	}
+
+	float start[3], end[3];
+	bc_fit_line<3>(points, start, end);
+	uint16_t color0 = bc1_pack_565(end);
+	uint16_t color1 = bc1_pack_565(start);
+	uint8_t indices[16];
+	uint32_t error = bc1_fit(points, color0, color1, indices);
+
+	// Weight of color1 of each index in four color mode
+	static const float index_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	for (uint32_t iteration = 0; iteration < BC_REFINE_ITERATIONS && error > 0; ++iteration)
+	{
+		float weights[16];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			weights[i] = index_weights[indices[i]];
+		}
+		if (!bc_least_squares_endpoints<3>(points, weights, start, end))
+		{
+			break;
+		}
+		uint16_t refined_color0 = bc1_pack_565(start);
+		uint16_t refined_color1 = bc1_pack_565(end);
+		uint8_t refined_indices[16];
+		const uint32_t refined_error = bc1_fit(points, refined_color0, refined_color1, refined_indices);
+		if (refined_error >= error)
+		{
+			break;
+		}
+		color0 = refined_color0;
+		color1 = refined_color1;
+		memcpy(indices, refined_indices, sizeof(indices));
+		error = refined_error;
+	}
+
+	memset(out_block, 0, 8);
+	BcBitWriter writer(out_block);
+	writer.write(color0, 16);
+	writer.write(color1, 16);
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		writer.write(indices[i], 2);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// BC4 and BC5
+
+// Palette of both BC4 modes: 8 interpolated values when endpoint0 > endpoint1, otherwise 6 interpolated values plus 0 and 255
+inline void bc4_palette(uint8_t endpoint0, uint8_t endpoint1, float out_palette[8])
+{
+	out_palette[0] = endpoint0;
+	out_palette[1] = endpoint1;
+	if (endpoint0 > endpoint1)
+	{
+		for (uint32_t i = 1; i < 7; ++i)
+		{
+			out_palette[i + 1] = ((float) (7 - i) * endpoint0 + (float) i * endpoint1) / 7.0f;
+		}
+	}
+	else
+	{
+		for (uint32_t i = 1; i < 5; ++i)
+		{
+			out_palette[i + 1] = ((float) (5 - i) * endpoint0 + (float) i * endpoint1) / 5.0f;
+		}
+		out_palette[6] = 0.0f;
+		out_palette[7] = 255.0f;
+	}
+}
+
+inline float bc4_fit(const uint8_t values[16], uint8_t endpoint0, uint8_t endpoint1, uint8_t out_indices[16])
+{
+	float palette[8];
+	bc4_palette(endpoint0, endpoint1, palette);
+	float error = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float best_error = FLT_MAX;
+		for (uint8_t index = 0; index < 8; ++index)
+		{
+			// Decoders round the interpolated values, so compare against what they'll return
+			const float difference = (float) values[i] - floorf(palette[index] + 0.5f);
+			if (difference * difference < best_error)
+			{
+				best_error = difference * difference;
+				out_indices[i] = index;
+			}
+		}
+		error += best_error;
+	}
+	return error;
+}
+
+// Tries both modes: 8 values spanning the range, or 6 values spanning the range without 0 and 255 (which the palette has exactly)
+inline void encode_bc4_block(const uint8_t values[16], uint8_t* out_block)
+{
+	uint8_t minimum = 255, maximum = 0;
+	uint8_t inner_minimum = 255, inner_maximum = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		minimum = values[i] < minimum ? values[i] : minimum;
+		maximum = values[i] > maximum ? values[i] : maximum;
+		if (values[i] != 0 && values[i] != 255)
+		{
+			inner_minimum = values[i] < inner_minimum ? values[i] : inner_minimum;
+			inner_maximum = values[i] > inner_maximum ? values[i] : inner_maximum;
+		}
+	}
+	if (inner_minimum > inner_maximum)
+	{
+		inner_minimum = inner_maximum = minimum;
+	}
+
+	uint8_t endpoint0 = maximum, endpoint1 = minimum;
+	uint8_t indices[16];
+	float error = bc4_fit(values, endpoint0, endpoint1, indices);
+
+	uint8_t six_value_indices[16];
+	const float six_value_error = bc4_fit(values, inner_minimum, inner_maximum, six_value_indices);
+	if (six_value_error < error)
+	{
+		endpoint0 = inner_minimum;
+		endpoint1 = inner_maximum;
+		memcpy(indices, six_value_indices, sizeof(indices));
+	}
+
+	memset(out_block, 0, 8);
+	BcBitWriter writer(out_block);
+	writer.write(endpoint0, 8);
+	writer.write(endpoint1, 8);
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		writer.write(indices[i], 3);
+	}
+}
+
+// channel of each texel as a BC4 block
+inline void encode_bc4_channel(const uint8_t texels[16][4], uint32_t channel, uint8_t* out_block)
+{
+	uint8_t values[16];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		values[i] = texels[i][channel];
+	}
+	encode_bc4_block(values, out_block);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// BC7 mode 6
+
+// Endpoint as 7 bits per channel plus a p-bit shared by the channels, picking the p-bit that lands closest
+inline void bc7_quantize_endpoint(const float endpoint[4], uint8_t out_quantized[4], uint8_t& out_p_bit)
+{
+	float best_error = FLT_MAX;
+	out_p_bit = 0;
+	for (uint8_t p_bit = 0; p_bit < 2; ++p_bit)
+	{
+		uint8_t quantized[4];
+		float error = 0.0f;
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			quantized[c] = (uint8_t) bc_clamp((int32_t) floorf((endpoint[c] - (float) p_bit) * 0.5f + 0.5f), 0, 127);
+			const float difference = (float) ((quantized[c] << 1) | p_bit) - endpoint[c];
+			error += difference * difference;
+		}
+		if (error < best_error)
+		{
+			best_error = error;
+			memcpy(out_quantized, quantized, 4);
+			out_p_bit = p_bit;
+		}
+	}
+}
+
+inline uint32_t bc7_mode6_fit(const uint8_t texels[16][4], const uint8_t quantized0[4], uint8_t p_bit0, const uint8_t quantized1[4], uint8_t p_bit1, uint8_t out_indices[16])
+{
+	int32_t palette[16][4];
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		const int32_t endpoint0 = (quantized0[c] << 1) | p_bit0;
+		const int32_t endpoint1 = (quantized1[c] << 1) | p_bit1;
+		for (uint32_t index = 0; index < 16; ++index)
+		{
+			palette[index][c] = (endpoint0 * (64 - (int32_t) BC_WEIGHTS_4[index]) + endpoint1 * (int32_t) BC_WEIGHTS_4[index] + 32) >> 6;
+		}
+	}
+
+	uint32_t error = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		uint32_t best_error = UINT32_MAX;
+		for (uint8_t index = 0; index < 16; ++index)
+		{
+			uint32_t index_error = 0;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const int32_t difference = (int32_t) texels[i][c] - palette[index][c];
+				index_error += (uint32_t) (difference * difference);
+			}
+			if (index_error < best_error)
+			{
+				best_error = index_error;
+				out_indices[i] = index;
+			}
+		}
+		error += best_error;
+	}
+	return error;
+}
+
+inline void encode_bc7_block(const uint8_t texels[16][4], uint8_t* out_block)
+{
+	float points[16][4];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			points[i][c] = texels[i][c];
+		}
+	}
+
+	float start[4], end[4];
+	bc_fit_line<4>(points, start, end);
+	uint8_t quantized0[4], quantized1[4], p_bit0, p_bit1;
+	bc7_quantize_endpoint(start, quantized0, p_bit0);
+	bc7_quantize_endpoint(end, quantized1, p_bit1);
+	uint8_t indices[16];
+	uint32_t error = bc7_mode6_fit(texels, quantized0, p_bit0, quantized1, p_bit1, indices);
+
+	for (uint32_t iteration = 0; iteration < BC_REFINE_ITERATIONS && error > 0; ++iteration)
+	{
+		float weights[16];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			weights[i] = (float) BC_WEIGHTS_4[indices[i]] / 64.0f;
+		}
+		if (!bc_least_squares_endpoints<4>(points, weights, start, end))
+		{
+			break;
+		}
+		uint8_t refined0[4], refined1[4], refined_p_bit0, refined_p_bit1;
+		bc7_quantize_endpoint(start, refined0, refined_p_bit0);
+		bc7_quantize_endpoint(end, refined1, refined_p_bit1);
+		uint8_t refined_indices[16];
+		const uint32_t refined_error = bc7_mode6_fit(texels, refined0, refined_p_bit0, refined1, refined_p_bit1, refined_indices);
+		if (refined_error >= error)
+		{
+			break;
+		}
+		memcpy(quantized0, refined0, 4);
+		memcpy(quantized1, refined1, 4);
+		p_bit0 = refined_p_bit0;
+		p_bit1 = refined_p_bit1;
+		memcpy(indices, refined_indices, sizeof(indices));
+		error = refined_error;
+	}
+
+	// The first texel's index is stored without its top bit, so it has to be below 8
+	if (indices[0] & 8)
+	{
+		uint8_t quantized[4];
+		memcpy(quantized, quantized0, 4);
+		memcpy(quantized0, quantized1, 4);
+		memcpy(quantized1, quantized, 4);
+		const uint8_t p_bit = p_bit0;
+		p_bit0 = p_bit1;
+		p_bit1 = p_bit;
+		for (uint8_t& index : indices)
+		{
+			index = 15 - index;
+		}
+	}
+
+	memset(out_block, 0, 16);
+	BcBitWriter writer(out_block);
+	writer.write(1 << 6, 7); // Mode 6
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		writer.write(quantized0[c], 7);
+		writer.write(quantized1[c], 7);
+	}
+	writer.write(p_bit0, 1);
+	writer.write(p_bit1, 1);
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		writer.write(indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// BC6H mode 11
+
+// Bits of the unsigned half float closest to value (negative values and NaN become 0, values past the largest half clamp to it)
+inline uint32_t bc6h_float_to_half(float value)
+{
+	if (!(value > 0.0f))
+	{
+		return 0;
+	}
+	if (value >= 65504.0f)
+	{
+		return 0x7BFF;
+	}
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const int32_t exponent = (int32_t) ((bits >> 23) & 0xFF) - 127 + 15;
+	if (exponent <= 0)
+	{
+		// Denormal half: value / 2^-24, rounded to nearest
+		return (uint32_t) (value * 16777216.0f + 0.5f);
+	}
+	const uint32_t mantissa = bits & 0x7FFFFF;
+	uint32_t half = ((uint32_t) exponent << 10) | (mantissa >> 13);
+	half += (mantissa >> 12) & 1; // Round half up, a carry into the exponent is still the nearest half
+	return half < 0x7BFF ? half : 0x7BFF;
+}
+
+// Decoders expand the 10 bit endpoints to 16 bits, interpolate there, then scale by 31 / 64 to the half's bits
+inline int32_t bc6h_unquantize(int32_t quantized)
+{
+	return quantized == 0 ? 0 : (quantized == 1023 ? 0xFFFF : ((quantized << 16) + 0x8000) >> 10);
+}
+
+inline void bc6h_quantize_endpoint(const float endpoint[3], int32_t out_quantized[3])
+{
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		out_quantized[c] = bc_clamp((int32_t) floorf((endpoint[c] - 32.0f) / 64.0f + 0.5f), 0, 1023);
+	}
+}
+
+// Error is measured between half float bits, which are roughly logarithmic in the value
+inline uint64_t bc6h_mode11_fit(const int32_t halves[16][3], const int32_t quantized0[3], const int32_t quantized1[3], uint8_t out_indices[16])
+{
+	int32_t palette[16][3];
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		const int32_t endpoint0 = bc6h_unquantize(quantized0[c]);
+		const int32_t endpoint1 = bc6h_unquantize(quantized1[c]);
+		for (uint32_t index = 0; index < 16; ++index)
+		{
+			const int32_t interpolated = (endpoint0 * (64 - (int32_t) BC_WEIGHTS_4[index]) + endpoint1 * (int32_t) BC_WEIGHTS_4[index] + 32) >> 6;
+			palette[index][c] = (interpolated * 31) >> 6;
+		}
+	}
+
+	uint64_t error = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		uint64_t best_error = UINT64_MAX;
+		for (uint8_t index = 0; index < 16; ++index)
+		{
+			uint64_t index_error = 0;
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const int64_t difference = halves[i][c] - palette[index][c];
+				index_error += (uint64_t) (difference * difference);
+			}
+			if (index_error < best_error)
+			{
+				best_error = index_error;
+				out_indices[i] = index;
+			}
+		}
+		error += best_error;
+	}
+	return error;
+}
+
+inline void encode_bc6h_block(const float texels[16][4], uint8_t* out_block)
+{
+	// Endpoints are fit in the 16 bit space decoders interpolate in
+	int32_t halves[16][3];
+	float points[16][4];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			halves[i][c] = (int32_t) bc6h_float_to_half(texels[i][c]);
+			points[i][c] = (float) halves[i][c] * (64.0f / 31.0f);
+		}
+		points[i][3] = 0.0f;
+	}
+
+	float start[3], end[3];
+	bc_fit_line<3>(points, start, end);
+	int32_t quantized0[3], quantized1[3];
+	bc6h_quantize_endpoint(start, quantized0);
+	bc6h_quantize_endpoint(end, quantized1);
+	uint8_t indices[16];
+	uint64_t error = bc6h_mode11_fit(halves, quantized0, quantized1, indices);
+
+	for (uint32_t iteration = 0; iteration < BC_REFINE_ITERATIONS && error > 0; ++iteration)
+	{
+		float weights[16];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			weights[i] = (float) BC_WEIGHTS_4[indices[i]] / 64.0f;
+		}
+		if (!bc_least_squares_endpoints<3>(points, weights, start, end))
+		{
+			break;
+		}
+		int32_t refined0[3], refined1[3];
+		bc6h_quantize_endpoint(start, refined0);
+		bc6h_quantize_endpoint(end, refined1);
+		uint8_t refined_indices[16];
+		const uint64_t refined_error = bc6h_mode11_fit(halves, refined0, refined1, refined_indices);
+		if (refined_error >= error)
+		{
+			break;
+		}
+		memcpy(quantized0, refined0, sizeof(quantized0));
+		memcpy(quantized1, refined1, sizeof(quantized1));
+		memcpy(indices, refined_indices, sizeof(indices));
+		error = refined_error;
+	}
+
+	// Same anchor rule as BC7: the first texel's index has no top bit
+	if (indices[0] & 8)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			const int32_t quantized = quantized0[c];
+			quantized0[c] = quantized1[c];
+			quantized1[c] = quantized;
+		}
+		for (uint8_t& index : indices)
+		{
+			index = 15 - index;
+		}
+	}
+
+	memset(out_block, 0, 16);
+	BcBitWriter writer(out_block);
+	writer.write(0x03, 5); // Mode 11
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		writer.write((uint32_t) quantized0[c], 10);
+	}
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		writer.write((uint32_t) quantized1[c], 10);
+	}
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		writer.write(indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Levels
+
+// Size of a level's blocks, rows of blocks are row_pitch bytes apart
+inline void block_level_layout(uint32_t width, uint32_t height, BlockFormat format, uint32_t& out_row_pitch, uint32_t& out_row_count)
+{
+	out_row_pitch = (width + 3) / 4 * block_format_size(format);
+	out_row_count = (height + 3) / 4;
+}
+
+// Texels of the 4x4 block at (block_x, block_y) of a tightly packed level, repeating the last row and column past the edges
+template <typename T>
+inline void bc_load_block(const T* texels, uint32_t width, uint32_t height, uint32_t block_x, uint32_t block_y, T out_block[16][4])
+{
+	for (uint32_t y = 0; y < 4; ++y)
+	{
+		const uint32_t texel_y = block_y * 4 + y < height ? block_y * 4 + y : height - 1;
+		for (uint32_t x = 0; x < 4; ++x)
+		{
+			const uint32_t texel_x = block_x * 4 + x < width ? block_x * 4 + x : width - 1;
+			memcpy(out_block[y * 4 + x], &texels[((size_t) texel_y * width + texel_x) * 4], 4 * sizeof(T));
+		}
+	}
+}
+
+// Compresses a tightly packed level: RGBA8 texels, or float4 for BC6H. BC4 encodes first_channel, BC5 first_channel and the one after it.
+// out_blocks receives block_level_layout's rows back to back.
+inline void compress_level(const void* texels, uint32_t width, uint32_t height, BlockFormat format, uint32_t first_channel, enki::TaskScheduler* task_scheduler, uint8_t* out_blocks)
+{
+	uint32_t row_pitch, row_count;
+	block_level_layout(width, height, format, row_pitch, row_count);
+	const uint32_t block_size = block_format_size(format);
+	const uint32_t blocks_x = (width + 3) / 4;
+
+	auto compress_rows = [=](uint32_t first_row, uint32_t end_row)
+	{
+		for (uint32_t block_y = first_row; block_y < end_row; ++block_y)
+		{
+			for (uint32_t block_x = 0; block_x < blocks_x; ++block_x)
+			{
+				uint8_t* out_block = out_blocks + (size_t) block_y * row_pitch + (size_t) block_x * block_size;
+				if (format == BlockFormat::BC6H)
+				{
+					float block[16][4];
+					bc_load_block((const float*) texels, width, height, block_x, block_y, block);
+					encode_bc6h_block(block, out_block);
+					continue;
+				}
+
+				uint8_t block[16][4];
+				bc_load_block((const uint8_t*) texels, width, height, block_x, block_y, block);
+				switch (format)
+				{
+					case BlockFormat::BC1: encode_bc1_block(block, out_block); break;
+					case BlockFormat::BC4: encode_bc4_channel(block, first_channel, out_block); break;
+					case BlockFormat::BC5:
+						encode_bc4_channel(block, first_channel, out_block);
+						encode_bc4_channel(block, first_channel + 1, out_block + 8);
+						break;
+					case BlockFormat::BC7: encode_bc7_block(block, out_block); break;
+					default: break;
+				}
+			}
+		}
+	};
+
+	const uint32_t task_count = (row_count + BC_TASK_BLOCK_ROWS - 1) / BC_TASK_BLOCK_ROWS;
+	if (!task_scheduler || task_count <= 1)
+	{
+		compress_rows(0, row_count);
+		return;
+	}
+	enki::TaskSet compress_task(task_count, [&compress_rows, row_count](enki::TaskSetPartition range, uint32_t /*threadnum*/)
+	{
+		const uint32_t end_row = range.end * BC_TASK_BLOCK_ROWS;
+		compress_rows(range.start * BC_TASK_BLOCK_ROWS, end_row < row_count ? end_row : row_count);
+	});
+	task_scheduler->AddTaskSetToPipe(&compress_task);
+	task_scheduler->WaitforTask(&compress_task);
+}
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <dxgiformat.h>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "gltf.h"
+#include "zstd_decode.h"
+
+// DDS and KTX2 texture containers: every mip level and array layer (cubemap faces included) already in a GPU format.
+// Files are mapped and subresources point straight into the mapping, so building the texture is a copy into upload memory.
+// Only zstd supercompressed KTX2 levels are decompressed, into memory owned by the container.
+//
+// Subresources are in D3D12 order (every mip of array slice 0, then every mip of slice 1...), which is the order DDS stores them in.
+// KTX2 stores all slices of mip 0 first, so its subresources are gathered out of order.
+
+struct TextureFormatInfo
+{
+	DXGI_FORMAT dxgi_format;
+	uint32_t vk_format; // VkFormat used by KTX2, 0 if there's none
+	uint32_t element_size; // Bytes per texel, or per 4x4 block
+	bool is_block_compressed;
+};
+
+// Formats whose data can be copied as is. Vulkan's BC1 RGB and RGBA variants both map to DXGI's BC1.
+static const TextureFormatInfo TEXTURE_FORMAT_INFOS[] = {
+	{ DXGI_FORMAT_R32G32B32A32_FLOAT,	109, 16, false },
+	{ DXGI_FORMAT_R16G16B16A16_FLOAT,	97,  8,  false },
+	{ DXGI_FORMAT_R16G16B16A16_UNORM,	91,  8,  false },
+	{ DXGI_FORMAT_R32G32_FLOAT,			103, 8,  false },
+	{ DXGI_FORMAT_R10G10B10A2_UNORM,	64,  4,  false },
+	{ DXGI_FORMAT_R11G11B10_FLOAT,		122, 4,  false },
+	{ DXGI_FORMAT_R9G9B9E5_SHAREDEXP,	123, 4,  false },
+	{ DXGI_FORMAT_R8G8B8A8_UNORM,		37,  4,  false },
+	{ DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,	43,  4,  false },
+	{ DXGI_FORMAT_B8G8R8A8_UNORM,		44,  4,  false },
+	{ DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,	50,  4,  false },
+	{ DXGI_FORMAT_B8G8R8X8_UNORM,		0,   4,  false },
+	{ DXGI_FORMAT_R16G16_FLOAT,			83,  4,  false },
+	{ DXGI_FORMAT_R32_FLOAT,			100, 4,  false },
+	{ DXGI_FORMAT_R8G8_UNORM,			16,  2,  false },
+	{ DXGI_FORMAT_R16_FLOAT,			76,  2,  false },
+	{ DXGI_FORMAT_R8_UNORM,				9,   1,  false },
+	{ DXGI_FORMAT_BC1_UNORM,			131, 8,  true },
+	{ DXGI_FORMAT_BC1_UNORM,			133, 8,  true },
+	{ DXGI_FORMAT_BC1_UNORM_SRGB,		132, 8,  true },
+	{ DXGI_FORMAT_BC1_UNORM_SRGB,		134, 8,  true },
+	{ DXGI_FORMAT_BC2_UNORM,			135, 16, true },
+	{ DXGI_FORMAT_BC2_UNORM_SRGB,		136, 16, true },
+	{ DXGI_FORMAT_BC3_UNORM,			137, 16, true },
+	{ DXGI_FORMAT_BC3_UNORM_SRGB,		138, 16, true },
+	{ DXGI_FORMAT_BC4_UNORM,			139, 8,  true },
+	{ DXGI_FORMAT_BC4_SNORM,			140, 8,  true },
+	{ DXGI_FORMAT_BC5_UNORM,			141, 16, true },
+	{ DXGI_FORMAT_BC5_SNORM,			142, 16, true },
+	{ DXGI_FORMAT_BC6H_UF16,			143, 16, true },
+	{ DXGI_FORMAT_BC6H_SF16,			144, 16, true },
+	{ DXGI_FORMAT_BC7_UNORM,			145, 16, true },
+	{ DXGI_FORMAT_BC7_UNORM_SRGB,		146, 16, true },
+};
+
+inline const TextureFormatInfo* find_texture_format_dxgi(DXGI_FORMAT format)
+{
+	for (const TextureFormatInfo& info : TEXTURE_FORMAT_INFOS)
+	{
+		if (info.dxgi_format == format)
+		{
+			return &info;
+		}
+	}
+	return nullptr;
+}
+
+inline const TextureFormatInfo* find_texture_format_vk(uint32_t vk_format)
+{
+	for (const TextureFormatInfo& info : TEXTURE_FORMAT_INFOS)
+	{
+		if (vk_format != 0 && info.vk_format == vk_format)
+		{
+			return &info;
+		}
+	}
+	return nullptr;
+}
+
+// Tightly packed size of one image of a level: row_count rows (of blocks for block compressed formats) of row_pitch bytes
+inline void texture_level_layout(const TextureFormatInfo& info, uint32_t width, uint32_t height, uint32_t& out_row_pitch, uint32_t& out_row_count)
+{
+	const uint32_t block_dimension = info.is_block_compressed ? 4 : 1;
+	out_row_pitch = (width + block_dimension - 1) / block_dimension * info.element_size;
+	out_row_count = (height + block_dimension - 1) / block_dimension;
+}
+
+static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+inline bool is_texture_container(const uint8_t* data, size_t size)
+{
+	return (size >= 4 && memcmp(data, &DDS_MAGIC, 4) == 0) || (size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0);
+}
+
+// Checks the file's first bytes without reading the rest
+inline bool is_texture_container_file(const char* path)
+{
+	uint8_t identifier[sizeof(KTX2_IDENTIFIER)];
+	size_t identifier_size = 0;
+	if (FILE* file = open_binary_file(path)) //See gltf.h
+	{
+		identifier_size = fread(identifier, 1, sizeof(identifier), file);
+		fclose(file);
+	}
+	return is_texture_container(identifier, identifier_size);
+}
+
+struct TextureSubresource
+{
+	const uint8_t* data;
+	uint32_t row_pitch;
+	uint32_t row_count;
+};
+
+struct TextureContainer
+{
+	GltfFileData file = {};
+	vector<uint8_t> decompressed_data;
+
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mip_count = 0;
+	uint32_t array_size = 0; // Six per cube for cubemaps
+	bool is_cubemap = false;
+	vector<TextureSubresource> subresources; // D3D12 order: mip + array_slice * mip_count
+
+	const char* error = nullptr; // Why open or parse failed
+
+	// Maps a .dds or .ktx2 file, subresources stay valid until release()
+	bool open(const char* path)
+	{
+		release();
+		if (!gltf_file_map(path, &file))
+		{
+			error = "Couldn't open the file";
+			return false;
+		}
+		if (!parse(file.data, (size_t) file.size))
+		{
+			gltf_file_release(&file);
+			return false;
+		}
+		return true;
+	}
+
+	// data has to outlive the container's subresources
+	bool parse(const uint8_t* data, size_t size)
+	{
+		subresources.clear();
+		decompressed_data.clear();
+		bool parsed = false;
+		if (size >= 4 && memcmp(data, &DDS_MAGIC, 4) == 0)
+		{
+			parsed = parse_dds(data, size);
+		}
+		else if (size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+		{
+			parsed = parse_ktx2(data, size);
+		}
+		else
+		{
+			return fail("Not a DDS or KTX2 file");
+		}
+
+		// D3D12 can't create block compressed textures whose top level isn't a whole number of blocks (smaller mips can be partial)
+		if (parsed && find_texture_format_dxgi(format)->is_block_compressed && (width % 4 != 0 || height % 4 != 0))
+		{
+			return fail("Block compressed texture size isn't a multiple of 4");
+		}
+		return parsed;
+	}
+
+	void release()
+	{
+		if (file.data)
+		{
+			gltf_file_release(&file);
+		}
+		file = {};
+		decompressed_data.clear();
+		subresources.clear();
+	}
+
+	bool fail(const char* message)
+	{
+		error = message;
+		subresources.clear();
+		return false;
+	}
+
+	bool set_size(uint32_t in_width, uint32_t in_height, uint32_t in_mip_count, uint32_t in_array_size)
+	{
+		width = in_width;
+		height = in_height;
+		mip_count = in_mip_count;
+		array_size = in_array_size;
+		// Mips past a 1x1 level or more than D3D12 allows are invalid
+		return width > 0 && height > 0 && array_size > 0 && array_size <= 2048 && mip_count > 0 && mip_count <= 16
+			&& ((width | height) >> (mip_count - 1)) > 0;
+	}
+
+	static uint32_t level_size(uint32_t top_level_size, uint32_t level) { return top_level_size >> level > 0 ? top_level_size >> level : 1; }
+
+	size_t level_image_size(const TextureFormatInfo& info, uint32_t level) const
+	{
+		uint32_t row_pitch, row_count;
+		texture_level_layout(info, level_size(width, level), level_size(height, level), row_pitch, row_count);
+		return (size_t) row_pitch * row_count;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////
+	// DDS: magic, 124 byte header, optional DX10 header, then every mip of each array slice
+
+	bool parse_dds(const uint8_t* data, size_t size)
+	{
+		const size_t header_size = 4 + 124;
+		if (size < header_size)
+		{
+			return fail("Truncated DDS header");
+		}
+		uint32_t header[31];
+		memcpy(header, data + 4, sizeof(header));
+		const uint32_t flags = header[1];
+		const uint32_t pixel_format_flags = header[19];
+		const uint32_t four_cc = header[20];
+		const uint32_t caps2 = header[27];
+
+		const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+		const uint32_t DDSD_DEPTH = 0x800000;
+		const uint32_t DDPF_FOURCC = 0x4;
+		const uint32_t DDPF_RGB = 0x40;
+		const uint32_t DDPF_LUMINANCE = 0x20000;
+		const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+		const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00;
+		const uint32_t DDSCAPS2_VOLUME = 0x200000;
+		auto make_four_cc = [](const char* code) { return (uint32_t) code[0] | ((uint32_t) code[1] << 8) | ((uint32_t) code[2] << 16) | ((uint32_t) code[3] << 24); };
+
+		size_t data_offset = header_size;
+		uint32_t cube_count = 0;
+		uint32_t array_layers = 1;
+		DXGI_FORMAT dds_format = DXGI_FORMAT_UNKNOWN;
+		if ((pixel_format_flags & DDPF_FOURCC) && four_cc == make_four_cc("DX10"))
+		{
+			const size_t dx10_header_size = 20;
+			if (size < header_size + dx10_header_size)
+			{
+				return fail("Truncated DDS DX10 header");
+			}
+			uint32_t dx10_header[5];
+			memcpy(dx10_header, data + header_size, sizeof(dx10_header));
+			data_offset += dx10_header_size;
+
+			const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+			const uint32_t D3D10_RESOURCE_MISC_TEXTURECUBE = 0x4;
+			if (dx10_header[1] != D3D10_RESOURCE_DIMENSION_TEXTURE2D)
+			{
+				return fail("Only 2D DDS textures are supported");
+			}
+			dds_format = (DXGI_FORMAT) dx10_header[0];
+			array_layers = dx10_header[3];
+			cube_count = (dx10_header[2] & D3D10_RESOURCE_MISC_TEXTURECUBE) ? array_layers : 0;
+		}
+		else
+		{
+			if ((caps2 & DDSCAPS2_VOLUME) || (flags & DDSD_DEPTH))
+			{
+				return fail("Volume DDS textures aren't supported");
+			}
+			if (caps2 & DDSCAPS2_CUBEMAP)
+			{
+				if ((caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+				{
+					return fail("DDS cubemaps need all six faces");
+				}
+				cube_count = 1;
+			}
+
+			const uint32_t bit_count = header[21];
+			const uint32_t masks[4] = { header[22], header[23], header[24], header[25] };
+			if (pixel_format_flags & DDPF_FOURCC)
+			{
+				struct { const char* code; DXGI_FORMAT format; } four_cc_formats[] = {
+					{ "DXT1", DXGI_FORMAT_BC1_UNORM }, { "DXT2", DXGI_FORMAT_BC2_UNORM }, { "DXT3", DXGI_FORMAT_BC2_UNORM },
+					{ "DXT4", DXGI_FORMAT_BC3_UNORM }, { "DXT5", DXGI_FORMAT_BC3_UNORM }, { "ATI1", DXGI_FORMAT_BC4_UNORM },
+					{ "BC4U", DXGI_FORMAT_BC4_UNORM }, { "BC4S", DXGI_FORMAT_BC4_SNORM }, { "ATI2", DXGI_FORMAT_BC5_UNORM },
+					{ "BC5U", DXGI_FORMAT_BC5_UNORM }, { "BC5S", DXGI_FORMAT_BC5_SNORM },
+				};
+				for (const auto& entry : four_cc_formats)
+				{
+					dds_format = four_cc == make_four_cc(entry.code) ? entry.format : dds_format;
+				}
+				// D3DFORMAT values stored as the four CC
+				switch (four_cc)
+				{
+					case 36:  dds_format = DXGI_FORMAT_R16G16B16A16_UNORM; break;
+					case 111: dds_format = DXGI_FORMAT_R16_FLOAT; break;
+					case 112: dds_format = DXGI_FORMAT_R16G16_FLOAT; break;
+					case 113: dds_format = DXGI_FORMAT_R16G16B16A16_FLOAT; break;
+					case 114: dds_format = DXGI_FORMAT_R32_FLOAT; break;
+					case 115: dds_format = DXGI_FORMAT_R32G32_FLOAT; break;
+					case 116: dds_format = DXGI_FORMAT_R32G32B32A32_FLOAT; break;
+					default: break;
+				}
+			}
+			else if ((pixel_format_flags & DDPF_RGB) && bit_count == 32)
+			{
+				if (masks[0] == 0x000000FF && masks[1] == 0x0000FF00 && masks[2] == 0x00FF0000)
+				{
+					// X8B8G8R8 has no DXGI format, and reading it as RGBA8 would sample alpha from the undefined X byte
+					if (masks[3] != 0xFF000000)
+					{
+						return fail("X8B8G8R8 DDS files aren't supported");
+					}
+					dds_format = DXGI_FORMAT_R8G8B8A8_UNORM;
+				}
+				else if (masks[0] == 0x00FF0000 && masks[1] == 0x0000FF00 && masks[2] == 0x000000FF)
+				{
+					dds_format = masks[3] ? DXGI_FORMAT_B8G8R8A8_UNORM : DXGI_FORMAT_B8G8R8X8_UNORM;
+				}
+			}
+			else if ((pixel_format_flags & DDPF_LUMINANCE) && bit_count == 8)
+			{
+				dds_format = DXGI_FORMAT_R8_UNORM;
+			}
+		}
+
+		const TextureFormatInfo* info = find_texture_format_dxgi(dds_format);
+		if (!info)
+		{
+			return fail("Unsupported DDS pixel format");
+		}
+		format = dds_format;
+		is_cubemap = cube_count > 0;
+
+		const uint32_t dds_mip_count = (flags & DDSD_MIPMAPCOUNT) && header[6] > 0 ? header[6] : 1;
+		if (!set_size(header[3], header[2], dds_mip_count, is_cubemap ? cube_count * 6 : array_layers))
+		{
+			return fail("Invalid DDS size, mip count or array size");
+		}
+
+		subresources.resize((size_t) mip_count * array_size);
+		size_t offset = data_offset;
+		for (uint32_t slice = 0; slice < array_size; ++slice)
+		{
+			for (uint32_t mip = 0; mip < mip_count; ++mip)
+			{
+				TextureSubresource& subresource = subresources[(size_t) slice * mip_count + mip];
+				texture_level_layout(*info, level_size(width, mip), level_size(height, mip), subresource.row_pitch, subresource.row_count);
+				const size_t image_size = (size_t) subresource.row_pitch * subresource.row_count;
+				if (image_size > size - offset)
+				{
+					return fail("Truncated DDS data");
+				}
+				subresource.data = data + offset;
+				offset += image_size;
+			}
+		}
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////
+	// KTX2: identifier, header, index, level index, then the levels (smallest first in the file, but found through the index).
+	// Each level holds every layer's faces back to back, zstd supercompression compresses a level as a whole.
+
+	bool parse_ktx2(const uint8_t* data, size_t size)
+	{
+		const size_t header_size = 80;
+		if (size < header_size)
+		{
+			return fail("Truncated KTX2 header");
+		}
+		uint32_t header[9];
+		memcpy(header, data + 12, sizeof(header));
+		const uint32_t vk_format = header[0];
+		const uint32_t pixel_width = header[2];
+		const uint32_t pixel_height = header[3];
+		const uint32_t pixel_depth = header[4];
+		const uint32_t layer_count = header[5] > 0 ? header[5] : 1;
+		const uint32_t face_count = header[6];
+		const uint32_t level_count = header[7] > 0 ? header[7] : 1; // 0 asks for mips to be generated at load, only the base is stored
+		const uint32_t supercompression_scheme = header[8];
+
+		const uint32_t KTX2_SUPERCOMPRESSION_NONE = 0;
+		const uint32_t KTX2_SUPERCOMPRESSION_BASIS_LZ = 1;
+		const uint32_t KTX2_SUPERCOMPRESSION_ZSTD = 2;
+		if (vk_format == 0 || supercompression_scheme == KTX2_SUPERCOMPRESSION_BASIS_LZ)
+		{
+			return fail("Basis Universal KTX2 textures need transcoding, which isn't supported");
+		}
+		if (supercompression_scheme != KTX2_SUPERCOMPRESSION_NONE && supercompression_scheme != KTX2_SUPERCOMPRESSION_ZSTD)
+		{
+			return fail("Unsupported KTX2 supercompression scheme");
+		}
+		if (pixel_depth > 0 || pixel_height == 0)
+		{
+			return fail("Only 2D KTX2 textures are supported");
+		}
+		if (face_count != 1 && face_count != 6)
+		{
+			return fail("Invalid KTX2 face count");
+		}
+		const TextureFormatInfo* info = find_texture_format_vk(vk_format);
+		if (!info)
+		{
+			return fail("Unsupported KTX2 format");
+		}
+		format = info->dxgi_format;
+		is_cubemap = face_count == 6;
+		if (!set_size(pixel_width, pixel_height, level_count, layer_count * face_count))
+		{
+			return fail("Invalid KTX2 size, level count or layer count");
+		}
+
+		const size_t level_index_entry_size = 24;
+		if ((size - header_size) / level_index_entry_size < mip_count)
+		{
+			return fail("Truncated KTX2 level index");
+		}
+
+		// Zstd levels are decompressed back to back
+		size_t decompressed_size = 0;
+		for (uint32_t mip = 0; mip < mip_count && supercompression_scheme == KTX2_SUPERCOMPRESSION_ZSTD; ++mip)
+		{
+			decompressed_size += level_image_size(*info, mip) * array_size;
+		}
+		decompressed_data.resize(decompressed_size);
+
+		subresources.resize((size_t) mip_count * array_size);
+		size_t decompressed_offset = 0;
+		for (uint32_t mip = 0; mip < mip_count; ++mip)
+		{
+			uint64_t level_index[3]; // Byte offset, byte length, uncompressed byte length
+			memcpy(level_index, data + header_size + mip * level_index_entry_size, sizeof(level_index));
+			const size_t image_size = level_image_size(*info, mip);
+			const size_t level_data_size = image_size * array_size;
+			if (level_index[0] > size || level_index[1] > size - level_index[0])
+			{
+				return fail("Truncated KTX2 level data");
+			}
+
+			const uint8_t* level_data = data + level_index[0];
+			if (supercompression_scheme == KTX2_SUPERCOMPRESSION_ZSTD)
+			{
+				uint8_t* decompressed_level = decompressed_data.data() + decompressed_offset;
+				if (level_index[2] != level_data_size || !zstd_decompress(level_data, (size_t) level_index[1], decompressed_level, level_data_size))
+				{
+					return fail("Corrupt zstd supercompressed KTX2 level");
+				}
+				level_data = decompressed_level;
+				decompressed_offset += level_data_size;
+			}
+			else if (level_index[1] != level_data_size)
+			{
+				return fail("KTX2 level size doesn't match its format");
+			}
+
+			for (uint32_t slice = 0; slice < array_size; ++slice)
+			{
+				TextureSubresource& subresource = subresources[(size_t) slice * mip_count + mip];
+				texture_level_layout(*info, level_size(width, mip), level_size(height, mip), subresource.row_pitch, subresource.row_count);
+				subresource.data = level_data + image_size * slice;
+			}
+		}
+		return true;
+	}
+};
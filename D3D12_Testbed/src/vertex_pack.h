@@ -0,0 +1,582 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <cassert>
+
+#include "gltf.h"
+
+// Batch kernel that gathers glTF vertex attributes into an interleaved vertex layout.
+// Attributes can have any stride and component type (floats, or integer and normalized bytes and shorts as in KHR_mesh_quantization).
+// Vertices are processed VERTEX_PACK_BATCH_SIZE at a time: each attribute of a batch is decoded to structure of arrays floats,
+// 4 vertices at a time with SSE2 or NEON, then encoded to its output format, 8 at a time with AVX2 or 4 with SSE2 or NEON.
+// The paths follow gltf.h's SIMD defines, so GLTF_DISABLE_SIMD forces the scalar code.
+
+#if GLTF_SIMD_AVX2 && (defined(__F16C__) || defined(_MSC_VER))
+	#define VERTEX_PACK_F16C 1
+#endif
+
+static const uint32_t VERTEX_PACK_BATCH_SIZE = 16;
+static const uint32_t VERTEX_PACK_MAX_ATTRIBUTES = 8;
+
+enum class VertexPackFormat : uint8_t
+{
+	Float2,
+	Float3,
+	Float4,
+	Half2,        // DXGI_FORMAT_R16G16_FLOAT
+	Octahedral16, // Unit vector folded onto an octahedron, DXGI_FORMAT_R16G16_SNORM. Decoded by n = (x, y, 1 - |x| - |y|), n.xy = n.z < 0 ? (1 - |n.yx|) * sign(n.xy) : n.xy, normalize(n)
+};
+
+struct VertexPackAttribute
+{
+	const GltfAccessor* accessor = nullptr; // nullptr writes default_value to every vertex
+	uint32_t offset = 0;                    // Byte offset in the output vertex
+	VertexPackFormat format = VertexPackFormat::Float3;
+	float default_value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+// Where an accessor's elements are and how to widen them. Components past component_count decode as 0.
+struct VertexPackSource
+{
+	const uint8_t* data = nullptr;
+	uint32_t stride = 0;
+	uint32_t component_count = 0;
+	GltfComponentType component_type = GLTF_COMPONENT_TYPE_FLOAT;
+	bool normalized = false;
+	uint32_t wide_vertex_count = 0; // Leading elements that can be read with one 4 component load without leaving the buffer
+};
+
+inline uint32_t vertex_pack_wide_load_size(GltfComponentType component_type)
+{
+	switch (component_type)
+	{
+		case GLTF_COMPONENT_TYPE_FLOAT:				return 4 * sizeof(float);
+		case GLTF_COMPONENT_TYPE_SHORT:
+		case GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:	return 4 * sizeof(uint16_t);
+		case GLTF_COMPONENT_TYPE_BYTE:
+		case GLTF_COMPONENT_TYPE_UNSIGNED_BYTE:		return 4 * sizeof(uint8_t);
+		default:									return 0; // Unsigned int attributes only take the scalar path
+	}
+}
+
+inline bool vertex_pack_make_source(const GltfAccessor* accessor, VertexPackSource& out_source)
+{
+	if (accessor->accessor_type > GLTF_ACCESSOR_TYPE_VEC4 || gltf_component_type_size(accessor->component_type) == 0)
+	{
+		return false;
+	}
+
+	const GltfBuffer* buffer = accessor->buffer_view->buffer;
+	const uint64_t offset = gltf_accessor_get_initial_offset(accessor);
+
+	out_source.data = buffer->data + offset;
+	out_source.stride = gltf_accessor_get_stride(accessor);
+	out_source.component_count = gltf_accessor_type_size(accessor->accessor_type);
+	out_source.component_type = accessor->component_type;
+	out_source.normalized = accessor->normalized;
+
+	const uint32_t wide_load_size = vertex_pack_wide_load_size(accessor->component_type);
+	out_source.wide_vertex_count = 0;
+	if (wide_load_size > 0 && out_source.stride > 0 && offset + wide_load_size <= buffer->byte_length)
+	{
+		const uint64_t wide_vertex_count = (buffer->byte_length - offset - wide_load_size) / out_source.stride + 1;
+		out_source.wide_vertex_count = wide_vertex_count < accessor->count ? (uint32_t) wide_vertex_count : accessor->count;
+	}
+	return true;
+}
+
+// Divisor and lower bound applied after widening, matching gltf_component_to_float
+inline void vertex_pack_normalization(GltfComponentType component_type, bool normalized, float& out_divisor, float& out_minimum)
+{
+	out_divisor = 1.0f;
+	out_minimum = -FLT_MAX;
+	if (normalized)
+	{
+		switch (component_type)
+		{
+			case GLTF_COMPONENT_TYPE_BYTE:				out_divisor = 127.0f;	out_minimum = -1.0f; break;
+			case GLTF_COMPONENT_TYPE_UNSIGNED_BYTE:		out_divisor = 255.0f;	break;
+			case GLTF_COMPONENT_TYPE_SHORT:				out_divisor = 32767.0f;	out_minimum = -1.0f; break;
+			case GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:	out_divisor = 65535.0f;	break;
+			default: break;
+		}
+	}
+}
+
+// Round to nearest even half float, matching F16C (Fabian Giesen's float_to_half_fast3_rtne)
+inline uint16_t vertex_pack_float_to_half(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = bits & 0x80000000u;
+	uint32_t magnitude = bits ^ sign;
+
+	uint32_t half;
+	if (magnitude >= (127u + 16u) << 23)
+	{
+		// Overflow to infinity, NaNs stay quiet NaNs
+		half = magnitude > 0x7F800000u ? 0x7E00u : 0x7C00u;
+	}
+	else if (magnitude < 113u << 23)
+	{
+		// Denormals and zero: adding the magic number rounds the mantissa into place
+		const uint32_t denormal_magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+		float magnitude_float, denormal_magic;
+		memcpy(&magnitude_float, &magnitude, sizeof(magnitude));
+		memcpy(&denormal_magic, &denormal_magic_bits, sizeof(denormal_magic_bits));
+		magnitude_float += denormal_magic;
+		memcpy(&magnitude, &magnitude_float, sizeof(magnitude));
+		half = magnitude - denormal_magic_bits;
+	}
+	else
+	{
+		// Rebias the exponent and round the mantissa to nearest even
+		const uint32_t mantissa_odd = (magnitude >> 13) & 1;
+		magnitude += ((15u - 127u) << 23) + 0xFFFu + mantissa_odd;
+		half = magnitude >> 13;
+	}
+	return (uint16_t) (half | (sign >> 16));
+}
+
+inline uint32_t vertex_pack_octahedral(float x, float y, float z)
+{
+	const float l1_norm = fmaxf(fabsf(x) + fabsf(y) + fabsf(z), FLT_MIN);
+	float u = x / l1_norm;
+	float v = y / l1_norm;
+	if (z < 0.0f)
+	{
+		const float folded_u = (1.0f - fabsf(v)) * copysignf(1.0f, u);
+		const float folded_v = (1.0f - fabsf(u)) * copysignf(1.0f, v);
+		u = folded_u;
+		v = folded_v;
+	}
+	u = fminf(fmaxf(u, -1.0f), 1.0f);
+	v = fminf(fmaxf(v, -1.0f), 1.0f);
+	const uint32_t snorm_u = (uint32_t) (int32_t) lrintf(u * 32767.0f) & 0xFFFF;
+	const uint32_t snorm_v = (uint32_t) (int32_t) lrintf(v * 32767.0f) & 0xFFFF;
+	return snorm_u | (snorm_v << 16);
+}
+
+#if GLTF_SIMD_SSE2
+inline __m128i vertex_pack_widen_sse2(const uint8_t* element, GltfComponentType component_type)
+{
+	switch (component_type)
+	{
+		case GLTF_COMPONENT_TYPE_SHORT:
+		{
+			const __m128i shorts = _mm_loadl_epi64((const __m128i*) element);
+			return _mm_srai_epi32(_mm_unpacklo_epi16(shorts, shorts), 16);
+		}
+		case GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) element), _mm_setzero_si128());
+		case GLTF_COMPONENT_TYPE_BYTE:
+		{
+			int32_t word;
+			memcpy(&word, element, sizeof(word));
+			const __m128i bytes = _mm_cvtsi32_si128(word);
+			const __m128i shorts = _mm_unpacklo_epi8(bytes, bytes);
+			return _mm_srai_epi32(_mm_unpacklo_epi16(shorts, shorts), 24);
+		}
+		default: // GLTF_COMPONENT_TYPE_UNSIGNED_BYTE
+		{
+			int32_t word;
+			memcpy(&word, element, sizeof(word));
+			const __m128i shorts = _mm_unpacklo_epi8(_mm_cvtsi32_si128(word), _mm_setzero_si128());
+			return _mm_unpacklo_epi16(shorts, _mm_setzero_si128());
+		}
+	}
+}
+
+// Decodes 4 elements and transposes them into lanes[component][first_lane .. first_lane + 3]
+inline void vertex_pack_decode_4_sse2(const VertexPackSource& source, const uint8_t* element, float lanes[4][VERTEX_PACK_BATCH_SIZE], uint32_t first_lane)
+{
+	const __m128i component_index = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128 component_mask = _mm_castsi128_ps(_mm_cmplt_epi32(component_index, _mm_set1_epi32((int) source.component_count)));
+
+	__m128 elements[4];
+	if (source.component_type == GLTF_COMPONENT_TYPE_FLOAT)
+	{
+		for (uint32_t i = 0; i < 4; ++i, element += source.stride)
+		{
+			elements[i] = _mm_and_ps(_mm_loadu_ps((const float*) element), component_mask);
+		}
+	}
+	else
+	{
+		float divisor, minimum;
+		vertex_pack_normalization(source.component_type, source.normalized, divisor, minimum);
+		const __m128 divisors = _mm_set1_ps(divisor);
+		const __m128 minimums = _mm_set1_ps(minimum);
+		for (uint32_t i = 0; i < 4; ++i, element += source.stride)
+		{
+			const __m128 values = _mm_cvtepi32_ps(vertex_pack_widen_sse2(element, source.component_type));
+			elements[i] = _mm_and_ps(_mm_max_ps(_mm_div_ps(values, divisors), minimums), component_mask);
+		}
+	}
+
+	_MM_TRANSPOSE4_PS(elements[0], elements[1], elements[2], elements[3]);
+	for (uint32_t component = 0; component < 4; ++component)
+	{
+		_mm_store_ps(&lanes[component][first_lane], elements[component]);
+	}
+}
+
+// Rounds to nearest even, matching vertex_pack_float_to_half
+inline __m128i vertex_pack_float_to_half_sse2(__m128 values)
+{
+	const __m128i bits = _mm_castps_si128(values);
+	const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32((int) 0x80000000u));
+	const __m128i magnitude = _mm_xor_si128(bits, sign);
+
+	const __m128i is_overflow = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(((127 + 16) << 23) - 1));
+	const __m128i is_nan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7F800000));
+	const __m128i overflow = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(is_nan, _mm_set1_epi32(0x0200)));
+
+	const __m128i denormal_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	const __m128i is_denormal = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(113 << 23));
+	const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), _mm_castsi128_ps(denormal_magic))), denormal_magic);
+
+	const __m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+	const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(magnitude, _mm_set1_epi32((int) (((15u - 127u) << 23) + 0xFFFu))), mantissa_odd), 13);
+
+	__m128i half = _mm_or_si128(_mm_and_si128(is_denormal, denormal), _mm_andnot_si128(is_denormal, normal));
+	half = _mm_or_si128(_mm_and_si128(is_overflow, overflow), _mm_andnot_si128(is_overflow, half));
+	return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+
+inline __m128i vertex_pack_octahedral_sse2(__m128 x, __m128 y, __m128 z)
+{
+	const __m128 sign_bit = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	const __m128 l1_norm = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign_bit, x), _mm_andnot_ps(sign_bit, y)), _mm_andnot_ps(sign_bit, z)), _mm_set1_ps(FLT_MIN));
+	__m128 u = _mm_div_ps(x, l1_norm);
+	__m128 v = _mm_div_ps(y, l1_norm);
+
+	const __m128 folded_u = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_bit, v)), _mm_or_ps(_mm_and_ps(u, sign_bit), one));
+	const __m128 folded_v = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_bit, u)), _mm_or_ps(_mm_and_ps(v, sign_bit), one));
+	const __m128 lower_hemisphere = _mm_cmplt_ps(z, _mm_setzero_ps());
+	u = _mm_or_ps(_mm_and_ps(lower_hemisphere, folded_u), _mm_andnot_ps(lower_hemisphere, u));
+	v = _mm_or_ps(_mm_and_ps(lower_hemisphere, folded_v), _mm_andnot_ps(lower_hemisphere, v));
+
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128i snorm_u = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(u, _mm_set1_ps(-1.0f)), one), scale));
+	const __m128i snorm_v = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), one), scale));
+	return _mm_or_si128(_mm_and_si128(snorm_u, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(snorm_v, 16));
+}
+#endif
+
+#if GLTF_SIMD_AVX2
+inline __m256i vertex_pack_octahedral_avx2(__m256 x, __m256 y, __m256 z)
+{
+	const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	const __m256 l1_norm = _mm256_max_ps(_mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(sign_bit, x), _mm256_andnot_ps(sign_bit, y)), _mm256_andnot_ps(sign_bit, z)), _mm256_set1_ps(FLT_MIN));
+	__m256 u = _mm256_div_ps(x, l1_norm);
+	__m256 v = _mm256_div_ps(y, l1_norm);
+
+	const __m256 folded_u = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign_bit, v)), _mm256_or_ps(_mm256_and_ps(u, sign_bit), one));
+	const __m256 folded_v = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign_bit, u)), _mm256_or_ps(_mm256_and_ps(v, sign_bit), one));
+	const __m256 lower_hemisphere = _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ);
+	u = _mm256_blendv_ps(u, folded_u, lower_hemisphere);
+	v = _mm256_blendv_ps(v, folded_v, lower_hemisphere);
+
+	const __m256 scale = _mm256_set1_ps(32767.0f);
+	const __m256i snorm_u = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(u, _mm256_set1_ps(-1.0f)), one), scale));
+	const __m256i snorm_v = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-1.0f)), one), scale));
+	return _mm256_or_si256(_mm256_and_si256(snorm_u, _mm256_set1_epi32(0xFFFF)), _mm256_slli_epi32(snorm_v, 16));
+}
+#endif
+
+#if GLTF_SIMD_NEON
+inline int32x4_t vertex_pack_widen_neon(const uint8_t* element, GltfComponentType component_type)
+{
+	switch (component_type)
+	{
+		case GLTF_COMPONENT_TYPE_SHORT:
+			return vmovl_s16(vld1_s16((const int16_t*) element));
+		case GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			return vreinterpretq_s32_u32(vmovl_u16(vld1_u16((const uint16_t*) element)));
+		case GLTF_COMPONENT_TYPE_BYTE:
+		{
+			uint32_t word;
+			memcpy(&word, element, sizeof(word));
+			return vmovl_s16(vget_low_s16(vmovl_s8(vreinterpret_s8_u32(vdup_n_u32(word)))));
+		}
+		default: // GLTF_COMPONENT_TYPE_UNSIGNED_BYTE
+		{
+			uint32_t word;
+			memcpy(&word, element, sizeof(word));
+			return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(word))))));
+		}
+	}
+}
+
+inline void vertex_pack_decode_4_neon(const VertexPackSource& source, const uint8_t* element, float lanes[4][VERTEX_PACK_BATCH_SIZE], uint32_t first_lane)
+{
+	const uint32_t component_index[4] = { 0, 1, 2, 3 };
+	const uint32x4_t component_mask = vcltq_u32(vld1q_u32(component_index), vdupq_n_u32(source.component_count));
+
+	float divisor, minimum;
+	vertex_pack_normalization(source.component_type, source.normalized, divisor, minimum);
+
+	float32x4_t elements[4];
+	for (uint32_t i = 0; i < 4; ++i, element += source.stride)
+	{
+		float32x4_t values;
+		if (source.component_type == GLTF_COMPONENT_TYPE_FLOAT)
+		{
+			values = vld1q_f32((const float*) element);
+		}
+		else
+		{
+			values = vmaxq_f32(vdivq_f32(vcvtq_f32_s32(vertex_pack_widen_neon(element, source.component_type)), vdupq_n_f32(divisor)), vdupq_n_f32(minimum));
+		}
+		elements[i] = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(values), component_mask));
+	}
+
+	const float32x4x2_t rows_01 = vtrnq_f32(elements[0], elements[1]);
+	const float32x4x2_t rows_23 = vtrnq_f32(elements[2], elements[3]);
+	vst1q_f32(&lanes[0][first_lane], vcombine_f32(vget_low_f32(rows_01.val[0]), vget_low_f32(rows_23.val[0])));
+	vst1q_f32(&lanes[1][first_lane], vcombine_f32(vget_low_f32(rows_01.val[1]), vget_low_f32(rows_23.val[1])));
+	vst1q_f32(&lanes[2][first_lane], vcombine_f32(vget_high_f32(rows_01.val[0]), vget_high_f32(rows_23.val[0])));
+	vst1q_f32(&lanes[3][first_lane], vcombine_f32(vget_high_f32(rows_01.val[1]), vget_high_f32(rows_23.val[1])));
+}
+
+inline uint32x4_t vertex_pack_octahedral_neon(float32x4_t x, float32x4_t y, float32x4_t z)
+{
+	const uint32x4_t sign_bit = vdupq_n_u32(0x80000000u);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+
+	const float32x4_t l1_norm = vmaxq_f32(vaddq_f32(vaddq_f32(vabsq_f32(x), vabsq_f32(y)), vabsq_f32(z)), vdupq_n_f32(FLT_MIN));
+	float32x4_t u = vdivq_f32(x, l1_norm);
+	float32x4_t v = vdivq_f32(y, l1_norm);
+
+	const float32x4_t sign_u = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(u), sign_bit), vreinterpretq_u32_f32(one)));
+	const float32x4_t sign_v = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(v), sign_bit), vreinterpretq_u32_f32(one)));
+	const float32x4_t folded_u = vmulq_f32(vsubq_f32(one, vabsq_f32(v)), sign_u);
+	const float32x4_t folded_v = vmulq_f32(vsubq_f32(one, vabsq_f32(u)), sign_v);
+	const uint32x4_t lower_hemisphere = vcltq_f32(z, vdupq_n_f32(0.0f));
+	u = vbslq_f32(lower_hemisphere, folded_u, u);
+	v = vbslq_f32(lower_hemisphere, folded_v, v);
+
+	const float32x4_t scale = vdupq_n_f32(32767.0f);
+	const int32x4_t snorm_u = vcvtnq_s32_f32(vmulq_f32(vminq_f32(vmaxq_f32(u, vdupq_n_f32(-1.0f)), one), scale));
+	const int32x4_t snorm_v = vcvtnq_s32_f32(vmulq_f32(vminq_f32(vmaxq_f32(v, vdupq_n_f32(-1.0f)), one), scale));
+	return vorrq_u32(vandq_u32(vreinterpretq_u32_s32(snorm_u), vdupq_n_u32(0xFFFF)), vshlq_n_u32(vreinterpretq_u32_s32(snorm_v), 16));
+}
+#endif
+
+// Decodes vertices [first_vertex, first_vertex + count) of source into lanes, lanes past count are zeroed
+inline void vertex_pack_decode(const VertexPackSource& source, uint32_t first_vertex, uint32_t count, float lanes[4][VERTEX_PACK_BATCH_SIZE])
+{
+	uint32_t lane = 0;
+
+	#if GLTF_SIMD_SSE2 || GLTF_SIMD_NEON
+	for (; lane + 4 <= count && first_vertex + lane + 4 <= source.wide_vertex_count; lane += 4)
+	{
+		const uint8_t* element = source.data + (size_t) (first_vertex + lane) * source.stride;
+		#if GLTF_SIMD_SSE2
+		vertex_pack_decode_4_sse2(source, element, lanes, lane);
+		#else
+		vertex_pack_decode_4_neon(source, element, lanes, lane);
+		#endif
+	}
+	#endif
+
+	const uint32_t component_size = gltf_component_type_size(source.component_type);
+	for (; lane < count; ++lane)
+	{
+		const uint8_t* element = source.data + (size_t) (first_vertex + lane) * source.stride;
+		for (uint32_t component = 0; component < 4; ++component)
+		{
+			lanes[component][lane] = component < source.component_count ? gltf_component_to_float(element + component * component_size, source.component_type, source.normalized) : 0.0f;
+		}
+	}
+
+	for (; lane < VERTEX_PACK_BATCH_SIZE; ++lane)
+	{
+		for (uint32_t component = 0; component < 4; ++component)
+		{
+			lanes[component][lane] = 0.0f;
+		}
+	}
+}
+
+// Writes component_count floats for each of the first count lanes, transposed back to one element per vertex
+inline void vertex_pack_encode_floats(const float lanes[4][VERTEX_PACK_BATCH_SIZE], uint32_t count, uint32_t component_count, uint8_t* out, uint32_t out_stride)
+{
+	uint32_t lane = 0;
+
+	#if GLTF_SIMD_SSE2
+	for (; lane + 4 <= count; lane += 4)
+	{
+		__m128 elements[4] = { _mm_load_ps(&lanes[0][lane]), _mm_load_ps(&lanes[1][lane]), _mm_load_ps(&lanes[2][lane]), _mm_load_ps(&lanes[3][lane]) };
+		_MM_TRANSPOSE4_PS(elements[0], elements[1], elements[2], elements[3]);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			float* out_element = (float*) (out + (size_t) (lane + i) * out_stride);
+			switch (component_count)
+			{
+				case 2: _mm_storel_pi((__m64*) out_element, elements[i]); break;
+				case 3: _mm_storel_pi((__m64*) out_element, elements[i]); _mm_store_ss(out_element + 2, _mm_movehl_ps(elements[i], elements[i])); break;
+				default: _mm_storeu_ps(out_element, elements[i]); break;
+			}
+		}
+	}
+	#elif GLTF_SIMD_NEON
+	for (; lane + 4 <= count; lane += 4)
+	{
+		const float32x4x2_t rows_01 = vtrnq_f32(vld1q_f32(&lanes[0][lane]), vld1q_f32(&lanes[1][lane]));
+		const float32x4x2_t rows_23 = vtrnq_f32(vld1q_f32(&lanes[2][lane]), vld1q_f32(&lanes[3][lane]));
+		const float32x4_t elements[4] =
+		{
+			vcombine_f32(vget_low_f32(rows_01.val[0]), vget_low_f32(rows_23.val[0])),
+			vcombine_f32(vget_low_f32(rows_01.val[1]), vget_low_f32(rows_23.val[1])),
+			vcombine_f32(vget_high_f32(rows_01.val[0]), vget_high_f32(rows_23.val[0])),
+			vcombine_f32(vget_high_f32(rows_01.val[1]), vget_high_f32(rows_23.val[1])),
+		};
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			float* out_element = (float*) (out + (size_t) (lane + i) * out_stride);
+			switch (component_count)
+			{
+				case 2: vst1_f32(out_element, vget_low_f32(elements[i])); break;
+				case 3: vst1_f32(out_element, vget_low_f32(elements[i])); vst1q_lane_f32(out_element + 2, elements[i], 2); break;
+				default: vst1q_f32(out_element, elements[i]); break;
+			}
+		}
+	}
+	#endif
+
+	for (; lane < count; ++lane)
+	{
+		float element[4] = { lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane] };
+		memcpy(out + (size_t) lane * out_stride, element, component_count * sizeof(float));
+	}
+}
+
+// One 32 bit value per vertex: two half floats (x, y) or two octahedral snorm16 coordinates
+inline void vertex_pack_encode_32_bit(const float lanes[4][VERTEX_PACK_BATCH_SIZE], uint32_t count, VertexPackFormat format, uint8_t* out, uint32_t out_stride)
+{
+	alignas(32) uint32_t packed[VERTEX_PACK_BATCH_SIZE];
+
+	if (format == VertexPackFormat::Half2)
+	{
+		#if VERTEX_PACK_F16C
+		for (uint32_t lane = 0; lane < VERTEX_PACK_BATCH_SIZE; lane += 8)
+		{
+			const __m128i half_x = _mm256_cvtps_ph(_mm256_load_ps(&lanes[0][lane]), 0);
+			const __m128i half_y = _mm256_cvtps_ph(_mm256_load_ps(&lanes[1][lane]), 0);
+			_mm_store_si128((__m128i*) &packed[lane], _mm_unpacklo_epi16(half_x, half_y));
+			_mm_store_si128((__m128i*) &packed[lane + 4], _mm_unpackhi_epi16(half_x, half_y));
+		}
+		#elif GLTF_SIMD_SSE2
+		for (uint32_t lane = 0; lane < VERTEX_PACK_BATCH_SIZE; lane += 4)
+		{
+			const __m128i half_x = vertex_pack_float_to_half_sse2(_mm_load_ps(&lanes[0][lane]));
+			const __m128i half_y = vertex_pack_float_to_half_sse2(_mm_load_ps(&lanes[1][lane]));
+			_mm_store_si128((__m128i*) &packed[lane], _mm_or_si128(half_x, _mm_slli_epi32(half_y, 16)));
+		}
+		#elif GLTF_SIMD_NEON
+		for (uint32_t lane = 0; lane < VERTEX_PACK_BATCH_SIZE; lane += 4)
+		{
+			const uint16x4_t half_x = vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(&lanes[0][lane])));
+			const uint16x4_t half_y = vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(&lanes[1][lane])));
+			const uint16x4x2_t interleaved = vzip_u16(half_x, half_y);
+			vst1q_u32(&packed[lane], vreinterpretq_u32_u16(vcombine_u16(interleaved.val[0], interleaved.val[1])));
+		}
+		#else
+		for (uint32_t lane = 0; lane < count; ++lane)
+		{
+			packed[lane] = vertex_pack_float_to_half(lanes[0][lane]) | ((uint32_t) vertex_pack_float_to_half(lanes[1][lane]) << 16);
+		}
+		#endif
+	}
+	else
+	{
+		#if GLTF_SIMD_AVX2
+		for (uint32_t lane = 0; lane < VERTEX_PACK_BATCH_SIZE; lane += 8)
+		{
+			_mm256_store_si256((__m256i*) &packed[lane], vertex_pack_octahedral_avx2(_mm256_load_ps(&lanes[0][lane]), _mm256_load_ps(&lanes[1][lane]), _mm256_load_ps(&lanes[2][lane])));
+		}
+		#elif GLTF_SIMD_SSE2
+		for (uint32_t lane = 0; lane < VERTEX_PACK_BATCH_SIZE; lane += 4)
+		{
+			_mm_store_si128((__m128i*) &packed[lane], vertex_pack_octahedral_sse2(_mm_load_ps(&lanes[0][lane]), _mm_load_ps(&lanes[1][lane]), _mm_load_ps(&lanes[2][lane])));
+		}
+		#elif GLTF_SIMD_NEON
+		for (uint32_t lane = 0; lane < VERTEX_PACK_BATCH_SIZE; lane += 4)
+		{
+			vst1q_u32(&packed[lane], vertex_pack_octahedral_neon(vld1q_f32(&lanes[0][lane]), vld1q_f32(&lanes[1][lane]), vld1q_f32(&lanes[2][lane])));
+		}
+		#else
+		for (uint32_t lane = 0; lane < count; ++lane)
+		{
+			packed[lane] = vertex_pack_octahedral(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+		}
+		#endif
+	}
+
+	for (uint32_t lane = 0; lane < count; ++lane)
+	{
+		memcpy(out + (size_t) lane * out_stride, &packed[lane], sizeof(uint32_t));
+	}
+}
+
+// Gathers vertex_count vertices from each attribute's accessor (or its default value) into out_vertices, out_stride bytes apart.
+// Fails without writing anything if an accessor has fewer elements than vertex_count or isn't a scalar or vector.
+inline bool pack_vertices(const VertexPackAttribute* attributes, uint32_t attribute_count, uint32_t vertex_count, void* out_vertices, uint32_t out_stride)
+{
+	assert(attribute_count <= VERTEX_PACK_MAX_ATTRIBUTES);
+
+	VertexPackSource sources[VERTEX_PACK_MAX_ATTRIBUTES];
+	for (uint32_t attribute_idx = 0; attribute_idx < attribute_count; ++attribute_idx)
+	{
+		const GltfAccessor* accessor = attributes[attribute_idx].accessor;
+		if (accessor && (accessor->count < vertex_count || !vertex_pack_make_source(accessor, sources[attribute_idx])))
+		{
+			return false;
+		}
+	}
+
+	alignas(32) float lanes[4][VERTEX_PACK_BATCH_SIZE];
+
+	for (uint32_t first_vertex = 0; first_vertex < vertex_count; first_vertex += VERTEX_PACK_BATCH_SIZE)
+	{
+		const uint32_t count = vertex_count - first_vertex < VERTEX_PACK_BATCH_SIZE ? vertex_count - first_vertex : VERTEX_PACK_BATCH_SIZE;
+		uint8_t* out = (uint8_t*) out_vertices + (size_t) first_vertex * out_stride;
+
+		for (uint32_t attribute_idx = 0; attribute_idx < attribute_count; ++attribute_idx)
+		{
+			const VertexPackAttribute& attribute = attributes[attribute_idx];
+			if (attribute.accessor)
+			{
+				vertex_pack_decode(sources[attribute_idx], first_vertex, count, lanes);
+			}
+			else
+			{
+				for (uint32_t component = 0; component < 4; ++component)
+				{
+					for (uint32_t lane = 0; lane < VERTEX_PACK_BATCH_SIZE; ++lane)
+					{
+						lanes[component][lane] = attribute.default_value[component];
+					}
+				}
+			}
+
+			switch (attribute.format)
+			{
+				case VertexPackFormat::Float2: vertex_pack_encode_floats(lanes, count, 2, out + attribute.offset, out_stride); break;
+				case VertexPackFormat::Float3: vertex_pack_encode_floats(lanes, count, 3, out + attribute.offset, out_stride); break;
+				case VertexPackFormat::Float4: vertex_pack_encode_floats(lanes, count, 4, out + attribute.offset, out_stride); break;
+				default: vertex_pack_encode_32_bit(lanes, count, attribute.format, out + attribute.offset, out_stride); break;
+			}
+		}
+	}
+	return true;
+}
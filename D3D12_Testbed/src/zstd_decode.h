@@ -0,0 +1,853 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <EASTL/vector.h>
+using eastl::vector;
+
+#include "mesh_cache.h"
+
+// Decoder for Zstandard frames (RFC 8878), as used by KTX2 zstd supercompression.
+// Supports every block type and entropy mode; frames that need a dictionary are rejected. Content checksums are verified with
+// hash_bytes (xxHash64, of which zstd stores the low 32 bits).
+//
+// Entropy coded streams are read backwards: ZstdBackwardBits starts at the stream's last set bit and reads towards its start,
+// returning zeros for bits before it (decoders check how far past the start they went to detect corruption).
+
+static const uint32_t ZSTD_MAGIC = 0xFD2FB528;
+static const uint32_t ZSTD_BLOCK_MAX_SIZE = 128 * 1024;
+static const uint32_t ZSTD_HUFFMAN_MAX_BITS = 11;
+static const uint32_t ZSTD_FSE_MAX_LOG = 9;
+
+static const uint32_t ZSTD_LITERAL_LENGTH_MAX_LOG = 9;
+static const uint32_t ZSTD_OFFSET_MAX_LOG = 8;
+static const uint32_t ZSTD_MATCH_LENGTH_MAX_LOG = 9;
+static const uint32_t ZSTD_LITERAL_LENGTH_MAX_CODE = 35;
+static const uint32_t ZSTD_OFFSET_MAX_CODE = 31;
+static const uint32_t ZSTD_MATCH_LENGTH_MAX_CODE = 52;
+
+static const uint32_t ZSTD_LITERAL_LENGTH_BASES[ZSTD_LITERAL_LENGTH_MAX_CODE + 1] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+	8192, 16384, 32768, 65536 };
+static const uint8_t ZSTD_LITERAL_LENGTH_BITS[ZSTD_LITERAL_LENGTH_MAX_CODE + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+static const uint32_t ZSTD_MATCH_LENGTH_BASES[ZSTD_MATCH_LENGTH_MAX_CODE + 1] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051, 4099, 8195, 16387, 32771, 65539 };
+static const uint8_t ZSTD_MATCH_LENGTH_BITS[ZSTD_MATCH_LENGTH_MAX_CODE + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+// Default distributions of the sequence codes, -1 is "less than 1"
+static const int16_t ZSTD_LITERAL_LENGTH_DEFAULT[ZSTD_LITERAL_LENGTH_MAX_CODE + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1, -1, -1, -1, -1 };
+static const int16_t ZSTD_OFFSET_DEFAULT[29] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1 };
+static const int16_t ZSTD_MATCH_LENGTH_DEFAULT[ZSTD_MATCH_LENGTH_MAX_CODE + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, -1, -1, -1, -1, -1, -1, -1 };
+
+inline uint32_t zstd_highest_bit(uint32_t value)
+{
+	uint32_t bit = 0;
+	while (value >>= 1)
+	{
+		++bit;
+	}
+	return bit;
+}
+
+inline uint64_t zstd_read_le(const uint8_t* bytes, uint32_t byte_count)
+{
+	uint64_t value = 0;
+	for (uint32_t i = 0; i < byte_count; ++i)
+	{
+		value |= (uint64_t) bytes[i] << (i * 8);
+	}
+	return value;
+}
+
+// Up to 57 bits starting at bit_position, zeros past the end of data
+inline uint64_t zstd_load_bits(const uint8_t* data, size_t size, size_t bit_position)
+{
+	const size_t byte_position = bit_position >> 3;
+	uint64_t word = 0;
+	if (byte_position + 8 <= size)
+	{
+		memcpy(&word, data + byte_position, sizeof(word)); // Little endian targets only, like the rest of the loaders
+	}
+	else if (byte_position < size)
+	{
+		word = zstd_read_le(data + byte_position, (uint32_t) (size - byte_position));
+	}
+	return word >> (bit_position & 7);
+}
+
+struct ZstdBackwardBits
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	int64_t position = 0; // Bits below position are unread, negative once reads went past the start
+
+	// Fails if the stream is empty or its last byte lacks the end marker
+	bool init(const uint8_t* in_data, size_t in_size)
+	{
+		if (in_size == 0 || in_data[in_size - 1] == 0)
+		{
+			return false;
+		}
+		data = in_data;
+		size = in_size;
+		position = (int64_t) in_size * 8 - 8 + zstd_highest_bit(in_data[in_size - 1]);
+		return true;
+	}
+
+	// count <= 32
+	uint32_t read(uint32_t count)
+	{
+		position -= count;
+		if (count == 0)
+		{
+			return 0;
+		}
+		if (position >= 0)
+		{
+			return (uint32_t) (zstd_load_bits(data, size, (size_t) position) & ((1ull << count) - 1));
+		}
+		const uint32_t missing = (uint32_t) -position;
+		if (missing >= count)
+		{
+			return 0;
+		}
+		return (uint32_t) ((zstd_load_bits(data, size, 0) & ((1ull << (count - missing)) - 1)) << missing);
+	}
+};
+
+struct ZstdFseTable
+{
+	uint32_t accuracy_log = 0;
+	uint8_t symbols[1 << ZSTD_FSE_MAX_LOG];
+	uint8_t bit_counts[1 << ZSTD_FSE_MAX_LOG];
+	uint16_t bases[1 << ZSTD_FSE_MAX_LOG];
+
+	uint32_t init_state(ZstdBackwardBits& bits) const { return bits.read(accuracy_log); }
+	uint32_t next_state(uint32_t state, ZstdBackwardBits& bits) const { return bases[state] + bits.read(bit_counts[state]); }
+};
+
+// Decoding table of a normalized distribution: symbols get cells in proportion to their probability, spread over the table
+inline bool zstd_build_fse_table(const int16_t* probabilities, uint32_t symbol_count, uint32_t accuracy_log, ZstdFseTable& out_table)
+{
+	const uint32_t size = 1u << accuracy_log;
+	uint16_t next_state[256];
+
+	// "Less than 1" symbols take one cell each at the end of the table
+	uint32_t high_threshold = size;
+	for (uint32_t symbol = 0; symbol < symbol_count; ++symbol)
+	{
+		if (probabilities[symbol] == -1)
+		{
+			out_table.symbols[--high_threshold] = (uint8_t) symbol;
+			next_state[symbol] = 1;
+		}
+	}
+
+	const uint32_t step = (size >> 1) + (size >> 3) + 3;
+	const uint32_t mask = size - 1;
+	uint32_t position = 0;
+	for (uint32_t symbol = 0; symbol < symbol_count; ++symbol)
+	{
+		if (probabilities[symbol] <= 0)
+		{
+			continue;
+		}
+		next_state[symbol] = (uint16_t) probabilities[symbol];
+		for (int32_t i = 0; i < probabilities[symbol]; ++i)
+		{
+			out_table.symbols[position] = (uint8_t) symbol;
+			do
+			{
+				position = (position + step) & mask;
+			} while (position >= high_threshold);
+		}
+	}
+	if (position != 0)
+	{
+		return false;
+	}
+
+	for (uint32_t state = 0; state < size; ++state)
+	{
+		const uint32_t next = next_state[out_table.symbols[state]]++;
+		out_table.bit_counts[state] = (uint8_t) (accuracy_log - zstd_highest_bit(next));
+		out_table.bases[state] = (uint16_t) ((next << out_table.bit_counts[state]) - size);
+	}
+	out_table.accuracy_log = accuracy_log;
+	return true;
+}
+
+inline void zstd_build_rle_table(uint8_t symbol, ZstdFseTable& out_table)
+{
+	out_table.accuracy_log = 0;
+	out_table.symbols[0] = symbol;
+	out_table.bit_counts[0] = 0;
+	out_table.bases[0] = 0;
+}
+
+// Reads a distribution description from the start of data and builds its table, returns the bytes it took (0 on error)
+inline size_t zstd_read_fse_table(const uint8_t* data, size_t size, uint32_t max_accuracy_log, uint32_t max_symbol, ZstdFseTable& out_table)
+{
+	size_t position = 0;
+	auto read_bits = [&](uint32_t count)
+	{
+		const uint32_t value = (uint32_t) (zstd_load_bits(data, size, position) & ((1u << count) - 1));
+		position += count;
+		return value;
+	};
+
+	const uint32_t accuracy_log = 5 + read_bits(4);
+	if (accuracy_log > max_accuracy_log)
+	{
+		return 0;
+	}
+
+	int16_t probabilities[256];
+	uint32_t symbol_count = 0;
+	int32_t remaining = 1 << accuracy_log;
+	while (remaining > 0 && symbol_count <= max_symbol)
+	{
+		// Values below threshold fit in one bit less
+		const uint32_t bit_count = zstd_highest_bit((uint32_t) remaining + 1) + 1;
+		uint32_t value = read_bits(bit_count);
+		const uint32_t lower_mask = (1u << (bit_count - 1)) - 1;
+		const uint32_t threshold = (1u << bit_count) - 1 - ((uint32_t) remaining + 1);
+		if ((value & lower_mask) < threshold)
+		{
+			position -= 1;
+			value &= lower_mask;
+		}
+		else if (value > lower_mask)
+		{
+			value -= threshold;
+		}
+
+		const int32_t probability = (int32_t) value - 1;
+		remaining -= probability < 0 ? -probability : probability;
+		probabilities[symbol_count++] = (int16_t) probability;
+
+		// Zero probabilities are followed by 2 bit repeat counts of further zeros, continued while they're 3
+		if (probability == 0)
+		{
+			uint32_t repeat;
+			do
+			{
+				repeat = read_bits(2);
+				for (uint32_t i = 0; i < repeat && symbol_count <= max_symbol; ++i)
+				{
+					probabilities[symbol_count++] = 0;
+				}
+			} while (repeat == 3 && symbol_count <= max_symbol);
+		}
+	}
+
+	const size_t byte_count = (position + 7) / 8;
+	if (remaining != 0 || byte_count > size || !zstd_build_fse_table(probabilities, symbol_count, accuracy_log, out_table))
+	{
+		return 0;
+	}
+	return byte_count;
+}
+
+struct ZstdHuffmanTable
+{
+	uint32_t max_bits = 0;
+	uint8_t symbols[1 << ZSTD_HUFFMAN_MAX_BITS];
+	uint8_t bit_counts[1 << ZSTD_HUFFMAN_MAX_BITS];
+};
+
+// Reads a Huffman tree description (symbol weights) from the start of data and builds its table, returns the bytes it took (0 on error)
+inline size_t zstd_read_huffman_table(const uint8_t* data, size_t size, ZstdHuffmanTable& out_table)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	// The last symbol's weight is implied, so there's room for 255 decoded ones
+	uint8_t weights[256];
+	uint32_t weight_count = 0;
+	size_t byte_count;
+	const uint32_t header = data[0];
+	if (header < 128)
+	{
+		// FSE compressed weights: two states alternate on one stream, decoding stops once it's exhausted
+		byte_count = 1 + header;
+		if (byte_count > size)
+		{
+			return 0;
+		}
+		ZstdFseTable table;
+		const size_t table_size = zstd_read_fse_table(data + 1, header, 6, 255, table);
+		ZstdBackwardBits bits;
+		if (table_size == 0 || !bits.init(data + 1 + table_size, header - table_size))
+		{
+			return 0;
+		}
+
+		uint32_t states[2] = { table.init_state(bits), table.init_state(bits) };
+		for (uint32_t current = 0;; current ^= 1)
+		{
+			if (weight_count >= 255)
+			{
+				return 0;
+			}
+			weights[weight_count++] = table.symbols[states[current]];
+			states[current] = table.next_state(states[current], bits);
+			if (bits.position < 0)
+			{
+				if (weight_count >= 255)
+				{
+					return 0;
+				}
+				weights[weight_count++] = table.symbols[states[current ^ 1]];
+				break;
+			}
+		}
+	}
+	else
+	{
+		// Direct representation, 4 bits per weight
+		weight_count = header - 127;
+		byte_count = 1 + (weight_count + 1) / 2;
+		if (byte_count > size)
+		{
+			return 0;
+		}
+		for (uint32_t i = 0; i < weight_count; ++i)
+		{
+			weights[i] = (i & 1) ? data[1 + i / 2] & 15 : data[1 + i / 2] >> 4;
+		}
+	}
+
+	// Weights sum to a power of two once the implied last one is added
+	uint32_t weight_total = 0;
+	for (uint32_t i = 0; i < weight_count; ++i)
+	{
+		if (weights[i] > ZSTD_HUFFMAN_MAX_BITS)
+		{
+			return 0;
+		}
+		weight_total += weights[i] ? 1u << (weights[i] - 1) : 0;
+	}
+	if (weight_total == 0)
+	{
+		return 0;
+	}
+	const uint32_t max_bits = zstd_highest_bit(weight_total) + 1;
+	const uint32_t last_weight_value = (1u << max_bits) - weight_total;
+	if (max_bits > ZSTD_HUFFMAN_MAX_BITS || (last_weight_value & (last_weight_value - 1)) != 0)
+	{
+		return 0;
+	}
+	weights[weight_count++] = (uint8_t) (zstd_highest_bit(last_weight_value) + 1);
+
+	// Codes are assigned from the longest down, each symbol covers the table range of states sharing its prefix
+	uint32_t rank_counts[ZSTD_HUFFMAN_MAX_BITS + 1] = {};
+	for (uint32_t symbol = 0; symbol < weight_count; ++symbol)
+	{
+		rank_counts[weights[symbol] ? max_bits + 1 - weights[symbol] : 0]++;
+	}
+	uint32_t rank_starts[ZSTD_HUFFMAN_MAX_BITS + 1];
+	uint32_t start = 0;
+	for (uint32_t bits = max_bits; bits >= 1; --bits)
+	{
+		rank_starts[bits] = start;
+		start += rank_counts[bits] << (max_bits - bits);
+	}
+	for (uint32_t symbol = 0; symbol < weight_count; ++symbol)
+	{
+		if (weights[symbol] == 0)
+		{
+			continue;
+		}
+		const uint32_t bits = max_bits + 1 - weights[symbol];
+		const uint32_t range = 1u << (max_bits - bits);
+		memset(&out_table.symbols[rank_starts[bits]], (int) symbol, range);
+		memset(&out_table.bit_counts[rank_starts[bits]], (int) bits, range);
+		rank_starts[bits] += range;
+	}
+	out_table.max_bits = max_bits;
+	return byte_count;
+}
+
+inline bool zstd_decode_huffman_stream(const ZstdHuffmanTable& table, const uint8_t* data, size_t size, uint8_t* out, size_t out_size)
+{
+	ZstdBackwardBits bits;
+	if (!bits.init(data, size))
+	{
+		return false;
+	}
+	const uint32_t mask = (1u << table.max_bits) - 1;
+	uint32_t state = bits.read(table.max_bits);
+	size_t i = 0;
+
+	// Four symbols (at most 44 bits) per load while the stream has 48 bits left
+	for (; i + 4 <= out_size && bits.position >= 48; i += 4)
+	{
+		const uint64_t word = zstd_load_bits(bits.data, bits.size, (size_t) bits.position - 48);
+		uint32_t available = 48;
+		for (size_t j = 0; j < 4; ++j)
+		{
+			out[i + j] = table.symbols[state];
+			const uint32_t bit_count = table.bit_counts[state];
+			available -= bit_count;
+			state = ((state << bit_count) | (uint32_t) ((word >> available) & ((1u << bit_count) - 1))) & mask;
+		}
+		bits.position -= 48 - available;
+	}
+
+	for (; i < out_size; ++i)
+	{
+		out[i] = table.symbols[state];
+		const uint32_t bit_count = table.bit_counts[state];
+		state = ((state << bit_count) | bits.read(bit_count)) & mask;
+	}
+	// The final state holds max_bits read past the start of the stream, and nothing else may be left
+	return bits.position == -(int64_t) table.max_bits;
+}
+
+// Entropy state carried from block to block within a frame
+struct ZstdFrameState
+{
+	ZstdHuffmanTable huffman;
+	bool has_huffman = false;
+
+	ZstdFseTable literal_lengths;
+	ZstdFseTable offsets;
+	ZstdFseTable match_lengths;
+	bool has_sequence_tables[3] = {};
+
+	uint32_t repeat_offsets[3] = { 1, 4, 8 };
+
+	vector<uint8_t> literals;
+
+	void reset()
+	{
+		has_huffman = false;
+		has_sequence_tables[0] = has_sequence_tables[1] = has_sequence_tables[2] = false;
+		repeat_offsets[0] = 1;
+		repeat_offsets[1] = 4;
+		repeat_offsets[2] = 8;
+	}
+};
+
+// Decodes the literals section at the start of a compressed block into frame.literals, returns the bytes it took (0 on error)
+inline size_t zstd_read_literals(const uint8_t* data, size_t size, ZstdFrameState& frame, size_t& out_literal_count)
+{
+	const uint32_t block_type = data[0] & 3;
+	const uint32_t size_format = (data[0] >> 2) & 3;
+	frame.literals.resize(ZSTD_BLOCK_MAX_SIZE);
+
+	if (block_type <= 1)
+	{
+		// Raw or RLE
+		const uint32_t header_size = size_format == 1 ? 2 : (size_format == 3 ? 3 : 1);
+		if (size < header_size)
+		{
+			return 0;
+		}
+		const uint32_t header = (uint32_t) zstd_read_le(data, header_size);
+		const size_t literal_count = header >> (header_size == 1 ? 3 : 4);
+		const size_t payload_size = block_type == 0 ? literal_count : 1;
+		if (literal_count > ZSTD_BLOCK_MAX_SIZE || size - header_size < payload_size)
+		{
+			return 0;
+		}
+		if (block_type == 0)
+		{
+			memcpy(frame.literals.data(), data + header_size, literal_count);
+		}
+		else
+		{
+			memset(frame.literals.data(), data[header_size], literal_count);
+		}
+		out_literal_count = literal_count;
+		return header_size + payload_size;
+	}
+
+	// Huffman compressed, with a new tree (2) or the previous block's (3)
+	const uint32_t header_size = size_format <= 1 ? 3 : size_format + 2;
+	const uint32_t size_bits = size_format <= 1 ? 10 : (size_format == 2 ? 14 : 18);
+	const uint32_t stream_count = size_format == 0 ? 1 : 4;
+	if (size < header_size)
+	{
+		return 0;
+	}
+	const uint64_t header = zstd_read_le(data, header_size);
+	const size_t literal_count = (size_t) ((header >> 4) & ((1u << size_bits) - 1));
+	const size_t compressed_size = (size_t) ((header >> (4 + size_bits)) & ((1u << size_bits) - 1));
+	if (literal_count > ZSTD_BLOCK_MAX_SIZE || size - header_size < compressed_size)
+	{
+		return 0;
+	}
+
+	const uint8_t* streams = data + header_size;
+	size_t streams_size = compressed_size;
+	if (block_type == 2)
+	{
+		const size_t tree_size = zstd_read_huffman_table(streams, streams_size, frame.huffman);
+		if (tree_size == 0)
+		{
+			return 0;
+		}
+		frame.has_huffman = true;
+		streams += tree_size;
+		streams_size -= tree_size;
+	}
+	else if (!frame.has_huffman)
+	{
+		return 0;
+	}
+
+	uint8_t* literals = frame.literals.data();
+	if (stream_count == 1)
+	{
+		if (!zstd_decode_huffman_stream(frame.huffman, streams, streams_size, literals, literal_count))
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		// Jump table of the first three streams' sizes, each decodes a quarter of the literals (rounded up, the last one takes the rest)
+		if (streams_size < 6)
+		{
+			return 0;
+		}
+		size_t stream_sizes[4];
+		size_t jump_total = 0;
+		for (uint32_t stream = 0; stream < 3; ++stream)
+		{
+			stream_sizes[stream] = (size_t) zstd_read_le(streams + stream * 2, 2);
+			jump_total += stream_sizes[stream];
+		}
+		const size_t segment_size = (literal_count + 3) / 4;
+		if (jump_total > streams_size - 6 || segment_size * 3 > literal_count)
+		{
+			return 0;
+		}
+		stream_sizes[3] = streams_size - 6 - jump_total;
+
+		const uint8_t* stream_data = streams + 6;
+		for (uint32_t stream = 0; stream < 4; ++stream)
+		{
+			const size_t stream_literal_count = stream < 3 ? segment_size : literal_count - segment_size * 3;
+			if (!zstd_decode_huffman_stream(frame.huffman, stream_data, stream_sizes[stream], literals + segment_size * stream, stream_literal_count))
+			{
+				return 0;
+			}
+			stream_data += stream_sizes[stream];
+		}
+	}
+	out_literal_count = literal_count;
+	return header_size + compressed_size;
+}
+
+// Table of one of the sequence codes per its compression mode: predefined, RLE, FSE compressed or repeated from the last block
+inline bool zstd_read_sequence_table(uint32_t mode, const uint8_t* data, size_t size, size_t& io_position, uint32_t max_accuracy_log, uint32_t max_symbol,
+	const int16_t* default_distribution, uint32_t default_symbol_count, uint32_t default_accuracy_log, ZstdFseTable& io_table, bool& io_has_table)
+{
+	switch (mode)
+	{
+		case 0:
+			zstd_build_fse_table(default_distribution, default_symbol_count, default_accuracy_log, io_table);
+			break;
+		case 1:
+			if (io_position >= size || data[io_position] > max_symbol)
+			{
+				return false;
+			}
+			zstd_build_rle_table(data[io_position++], io_table);
+			break;
+		case 2:
+		{
+			const size_t table_size = zstd_read_fse_table(data + io_position, size - io_position, max_accuracy_log, max_symbol, io_table);
+			if (table_size == 0)
+			{
+				return false;
+			}
+			io_position += table_size;
+			break;
+		}
+		default:
+			if (!io_has_table)
+			{
+				return false;
+			}
+			break;
+	}
+	io_has_table = true;
+	return true;
+}
+
+// Copies length bytes from offset bytes back, which may overlap the destination
+inline void zstd_copy_match(uint8_t* out, size_t offset, size_t length)
+{
+	const uint8_t* match = out - offset;
+	if (offset == 1)
+	{
+		memset(out, *match, length);
+		return;
+	}
+	// Chunks of at most offset bytes never overlap what they read
+	while (length > 0)
+	{
+		const size_t chunk = length < offset ? length : offset;
+		memcpy(out, match, chunk);
+		out += chunk;
+		match += chunk;
+		length -= chunk;
+	}
+}
+
+// Decodes a compressed block to dst[io_out, ...). Matches may reach back to frame_start.
+inline bool zstd_decode_block(const uint8_t* data, size_t size, ZstdFrameState& frame, uint8_t* dst, size_t dst_size, size_t frame_start, size_t& io_out)
+{
+	if (size == 0)
+	{
+		return false;
+	}
+	size_t literal_count = 0;
+	size_t position = zstd_read_literals(data, size, frame, literal_count);
+	if (position == 0 || position >= size)
+	{
+		return false;
+	}
+	const uint8_t* literals = frame.literals.data();
+	const uint8_t* literals_end = literals + literal_count;
+
+	uint32_t sequence_count = data[position++];
+	if (sequence_count >= 128)
+	{
+		const uint32_t extra_bytes = sequence_count == 255 ? 2 : 1;
+		if (size - position < extra_bytes)
+		{
+			return false;
+		}
+		sequence_count = sequence_count == 255 ? (uint32_t) zstd_read_le(data + position, 2) + 0x7F00 : ((sequence_count - 128) << 8) + data[position];
+		position += extra_bytes;
+	}
+
+	if (sequence_count > 0)
+	{
+		if (position >= size)
+		{
+			return false;
+		}
+		const uint32_t modes = data[position++];
+		if ((modes & 3) != 0
+			|| !zstd_read_sequence_table(modes >> 6, data, size, position, ZSTD_LITERAL_LENGTH_MAX_LOG, ZSTD_LITERAL_LENGTH_MAX_CODE,
+				ZSTD_LITERAL_LENGTH_DEFAULT, ZSTD_LITERAL_LENGTH_MAX_CODE + 1, 6, frame.literal_lengths, frame.has_sequence_tables[0])
+			|| !zstd_read_sequence_table((modes >> 4) & 3, data, size, position, ZSTD_OFFSET_MAX_LOG, ZSTD_OFFSET_MAX_CODE,
+				ZSTD_OFFSET_DEFAULT, 29, 5, frame.offsets, frame.has_sequence_tables[1])
+			|| !zstd_read_sequence_table((modes >> 2) & 3, data, size, position, ZSTD_MATCH_LENGTH_MAX_LOG, ZSTD_MATCH_LENGTH_MAX_CODE,
+				ZSTD_MATCH_LENGTH_DEFAULT, ZSTD_MATCH_LENGTH_MAX_CODE + 1, 6, frame.match_lengths, frame.has_sequence_tables[2]))
+		{
+			return false;
+		}
+
+		ZstdBackwardBits bits;
+		if (!bits.init(data + position, size - position))
+		{
+			return false;
+		}
+		uint32_t literal_length_state = frame.literal_lengths.init_state(bits);
+		uint32_t offset_state = frame.offsets.init_state(bits);
+		uint32_t match_length_state = frame.match_lengths.init_state(bits);
+
+		uint32_t* repeat_offsets = frame.repeat_offsets;
+		for (uint32_t sequence = 0; sequence < sequence_count; ++sequence)
+		{
+			// Extra bits are read offset first, then match length, then literal length
+			const uint32_t offset_code = frame.offsets.symbols[offset_state];
+			const uint32_t match_length_code = frame.match_lengths.symbols[match_length_state];
+			const uint32_t literal_length_code = frame.literal_lengths.symbols[literal_length_state];
+			const uint32_t offset_value = (1u << offset_code) + bits.read(offset_code);
+			const size_t match_length = ZSTD_MATCH_LENGTH_BASES[match_length_code] + bits.read(ZSTD_MATCH_LENGTH_BITS[match_length_code]);
+			const size_t literal_length = ZSTD_LITERAL_LENGTH_BASES[literal_length_code] + bits.read(ZSTD_LITERAL_LENGTH_BITS[literal_length_code]);
+
+			if (sequence + 1 < sequence_count)
+			{
+				literal_length_state = frame.literal_lengths.next_state(literal_length_state, bits);
+				match_length_state = frame.match_lengths.next_state(match_length_state, bits);
+				offset_state = frame.offsets.next_state(offset_state, bits);
+			}
+
+			// Offset values 1 to 3 pick a recent offset (shifted by one when there are no literals), larger ones are new offsets + 3
+			size_t offset;
+			if (offset_value > 3)
+			{
+				offset = offset_value - 3;
+				repeat_offsets[2] = repeat_offsets[1];
+				repeat_offsets[1] = repeat_offsets[0];
+				repeat_offsets[0] = (uint32_t) offset;
+			}
+			else
+			{
+				const uint32_t repeat_index = offset_value - 1 + (literal_length == 0 ? 1 : 0);
+				if (repeat_index == 0)
+				{
+					offset = repeat_offsets[0];
+				}
+				else
+				{
+					offset = repeat_index < 3 ? repeat_offsets[repeat_index] : repeat_offsets[0] - 1;
+					if (repeat_index > 1)
+					{
+						repeat_offsets[2] = repeat_offsets[1];
+					}
+					repeat_offsets[1] = repeat_offsets[0];
+					repeat_offsets[0] = (uint32_t) offset;
+				}
+			}
+
+			if (literal_length > (size_t) (literals_end - literals) || dst_size - io_out < literal_length + match_length
+				|| offset == 0 || offset > io_out + literal_length - frame_start)
+			{
+				return false;
+			}
+			memcpy(dst + io_out, literals, literal_length);
+			literals += literal_length;
+			io_out += literal_length;
+			zstd_copy_match(dst + io_out, offset, match_length);
+			io_out += match_length;
+		}
+		if (bits.position != 0)
+		{
+			return false;
+		}
+	}
+	else if (position != size)
+	{
+		return false;
+	}
+
+	// Literals left after the last sequence
+	const size_t remaining_literals = (size_t) (literals_end - literals);
+	if (dst_size - io_out < remaining_literals)
+	{
+		return false;
+	}
+	memcpy(dst + io_out, literals, remaining_literals);
+	io_out += remaining_literals;
+	return true;
+}
+
+// Decompresses the frames in src (skippable frames are ignored), which must produce exactly dst_size bytes
+inline bool zstd_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size)
+{
+	ZstdFrameState frame;
+	size_t in = 0;
+	size_t out = 0;
+	while (in < src_size)
+	{
+		if (src_size - in < 4)
+		{
+			return false;
+		}
+		const uint32_t magic = (uint32_t) zstd_read_le(src + in, 4);
+		if ((magic & 0xFFFFFFF0u) == 0x184D2A50u)
+		{
+			if (src_size - in < 8 || src_size - in - 8 < zstd_read_le(src + in + 4, 4))
+			{
+				return false;
+			}
+			in += 8 + (size_t) zstd_read_le(src + in + 4, 4);
+			continue;
+		}
+		if (magic != ZSTD_MAGIC || src_size - in < 5)
+		{
+			return false;
+		}
+		in += 4;
+
+		// Frame header: descriptor, window size, dictionary id and content size, the last three optional
+		const uint32_t descriptor = src[in++];
+		const uint32_t content_size_flag = descriptor >> 6;
+		const bool single_segment = (descriptor >> 5) & 1;
+		const bool has_checksum = (descriptor >> 2) & 1;
+		static const uint32_t dictionary_id_sizes[4] = { 0, 1, 2, 4 };
+		const uint32_t dictionary_id_size = dictionary_id_sizes[descriptor & 3];
+		const uint32_t content_size_size = content_size_flag == 0 ? (single_segment ? 1 : 0) : 1u << content_size_flag;
+		const size_t header_size = (single_segment ? 0 : 1) + dictionary_id_size + content_size_size;
+		if ((descriptor & 0x08) != 0 || src_size - in < header_size)
+		{
+			return false;
+		}
+		in += single_segment ? 0 : 1;
+		if (zstd_read_le(src + in, dictionary_id_size) != 0)
+		{
+			return false;
+		}
+		in += dictionary_id_size;
+		uint64_t content_size = zstd_read_le(src + in, content_size_size);
+		content_size += content_size_size == 2 ? 256 : 0;
+		in += content_size_size;
+
+		frame.reset();
+		const size_t frame_start = out;
+		for (bool last_block = false; !last_block;)
+		{
+			if (src_size - in < 3)
+			{
+				return false;
+			}
+			const uint32_t block_header = (uint32_t) zstd_read_le(src + in, 3);
+			in += 3;
+			last_block = block_header & 1;
+			const uint32_t block_type = (block_header >> 1) & 3;
+			const size_t block_size = block_header >> 3;
+			const size_t block_input_size = block_type == 1 ? 1 : block_size;
+			if (block_size > ZSTD_BLOCK_MAX_SIZE || block_type == 3 || src_size - in < block_input_size)
+			{
+				return false;
+			}
+
+			if (block_type == 0 || block_type == 1)
+			{
+				if (dst_size - out < block_size)
+				{
+					return false;
+				}
+				if (block_type == 0)
+				{
+					memcpy(dst + out, src + in, block_size);
+				}
+				else
+				{
+					memset(dst + out, src[in], block_size);
+				}
+				out += block_size;
+			}
+			else if (!zstd_decode_block(src + in, block_size, frame, dst, dst_size, frame_start, out))
+			{
+				return false;
+			}
+			in += block_input_size;
+		}
+
+		if (content_size_size > 0 && out - frame_start != content_size)
+		{
+			return false;
+		}
+		if (has_checksum)
+		{
+			if (src_size - in < 4 || (uint32_t) hash_bytes(dst + frame_start, out - frame_start) != (uint32_t) zstd_read_le(src + in, 4))
+			{
+				return false;
+			}
+			in += 4;
+		}
+	}
+	return out == dst_size;
+}